@@ -0,0 +1,87 @@
+#include <string>
+#include <vector>
+
+#include "bench/bench_input.h"
+#include "benchmark/benchmark.h"
+#include "nsasm/addressing_mode.h"
+#include "nsasm/assemble.h"
+#include "nsasm/expression.h"
+#include "nsasm/mnemonic.h"
+#include "nsasm/token.h"
+
+namespace nsasm {
+namespace bench {
+namespace {
+
+// Source lines for the code of a benchmark ROM.
+const std::vector<std::string>& Lines() {
+  static const auto* lines =
+      new std::vector<std::string>(MakeBenchmarkRom(4).source_lines);
+  return *lines;
+}
+
+void BM_Tokenize(benchmark::State& state) {
+  const std::vector<std::string>& lines = Lines();
+  int64_t bytes = 0;
+  for (const std::string& line : lines) {
+    bytes += line.size();
+  }
+  for (auto _ : state) {
+    for (const std::string& line : lines) {
+      auto tokens = Tokenize(line, Location());
+      benchmark::DoNotOptimize(tokens);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * lines.size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_Tokenize);
+
+void BM_Assemble(benchmark::State& state) {
+  std::vector<std::vector<Token>> token_lines;
+  int64_t bytes = 0;
+  for (const std::string& line : Lines()) {
+    token_lines.push_back(*Tokenize(line, Location()));
+    bytes += line.size();
+  }
+  for (auto _ : state) {
+    for (const std::vector<Token>& tokens : token_lines) {
+      auto assembled = Assemble(tokens);
+      benchmark::DoNotOptimize(assembled);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * token_lines.size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_Assemble);
+
+// Deduces the addressing mode of every mnemonic, in every syntactic form,
+// with byte, word and long arguments.
+void BM_DeduceMode(benchmark::State& state) {
+  const ExpressionOrNull args[] = {
+      ExpressionOrNull(Literal(0x12, T_byte)),
+      ExpressionOrNull(Literal(0x1234, T_word)),
+      ExpressionOrNull(Literal(0x123456, T_long)),
+  };
+  const ExpressionOrNull none;
+  int64_t calls = 0;
+  for (auto _ : state) {
+    for (Mnemonic mnemonic : AllMnemonics()) {
+      for (int smode = SA_imp; smode <= SA_mov; ++smode) {
+        for (const ExpressionOrNull& arg : args) {
+          auto mode =
+              DeduceMode(mnemonic, SyntacticAddressingMode(smode), arg,
+                         smode == SA_mov ? arg : none);
+          benchmark::DoNotOptimize(mode);
+          ++calls;
+        }
+      }
+    }
+  }
+  state.SetItemsProcessed(calls);
+}
+BENCHMARK(BM_DeduceMode);
+
+}  // namespace
+}  // namespace bench
+}  // namespace nsasm
@@ -0,0 +1,23 @@
+#include "bench/bench_input.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_split.h"
+#include "bench/synthetic.h"
+
+namespace nsasm {
+namespace bench {
+
+BenchmarkRom MakeBenchmarkRom(int banks) {
+  SyntheticRomOptions options;
+  options.mapping = kLoRom;
+  // Round up to a whole number of 64K
+  options.rom_size = std::max(1, (banks + 1) / 2) * 0x10000;
+  SyntheticRom synthetic = *GenerateSyntheticRom(options);
+  return {Rom(kLoRom, "bench.sfc", std::move(synthetic.data)),
+          std::move(synthetic.entry_points),
+          absl::StrSplit(synthetic.source, '\n', absl::SkipEmpty())};
+}
+
+}  // namespace bench
+}  // namespace nsasm
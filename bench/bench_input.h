@@ -0,0 +1,28 @@
+#ifndef BENCH_BENCH_INPUT_H_
+#define BENCH_BENCH_INPUT_H_
+
+#include <string>
+#include <vector>
+
+#include "nsasm/disassemble.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+namespace bench {
+
+// A deterministic LoRom image for benchmarks, with its code entry points.
+struct BenchmarkRom {
+  Rom rom;
+  std::vector<EntryPoint> entry_points;
+  // Source lines for the code in `rom`
+  std::vector<std::string> source_lines;
+};
+
+// Builds a synthetic LoRom image (see `GenerateSyntheticRom()`) of at least
+// `banks` 32K banks.  The same arguments always build the same image.
+BenchmarkRom MakeBenchmarkRom(int banks);
+
+}  // namespace bench
+}  // namespace nsasm
+
+#endif  // BENCH_BENCH_INPUT_H_
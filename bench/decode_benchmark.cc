@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <vector>
+
+#include "bench/bench_input.h"
+#include "benchmark/benchmark.h"
+#include "nsasm/decode.h"
+#include "nsasm/flag_state.h"
+
+namespace nsasm {
+namespace bench {
+namespace {
+
+// Decodes all 256 opcodes, with arbitrary operand bytes, in each of the
+// emulation and native register width states.
+void BM_Decode(benchmark::State& state) {
+  const FlagState flag_states[] = {
+      FlagState(B_on, B_on, B_on),    FlagState(B_off, B_on, B_on),
+      FlagState(B_off, B_on, B_off),  FlagState(B_off, B_off, B_on),
+      FlagState(B_off, B_off, B_off),
+  };
+  std::vector<uint8_t> bytes;
+  for (int opcode = 0; opcode < 256; ++opcode) {
+    bytes.insert(bytes.end(), {uint8_t(opcode), 0x34, 0x12, 0x7e});
+  }
+  int64_t decoded = 0;
+  for (auto _ : state) {
+    for (const FlagState& flag_state : flag_states) {
+      for (size_t i = 0; i < bytes.size(); i += 4) {
+        auto instruction =
+            Decode(absl::MakeConstSpan(&bytes[i], 4), flag_state);
+        benchmark::DoNotOptimize(instruction);
+        ++decoded;
+      }
+    }
+  }
+  state.SetItemsProcessed(decoded);
+  state.SetBytesProcessed(decoded * 4);
+}
+BENCHMARK(BM_Decode);
+
+// Steps the flag state through the instructions of a disassembled ROM, in
+// address order.
+void BM_FlagStateExecute(benchmark::State& state) {
+  BenchmarkRom input = MakeBenchmarkRom(4);
+  auto disassembly = DisassembleAll(input.rom, input.entry_points);
+  std::vector<Instruction> instructions;
+  for (const auto& node : *disassembly) {
+    instructions.push_back(node.second.instruction);
+  }
+  for (auto _ : state) {
+    FlagState flag_state(B_off, B_on, B_on);
+    for (const Instruction& instruction : instructions) {
+      flag_state = flag_state.Execute(instruction);
+    }
+    benchmark::DoNotOptimize(flag_state);
+  }
+  state.SetItemsProcessed(state.iterations() * instructions.size());
+}
+BENCHMARK(BM_FlagStateExecute);
+
+}  // namespace
+}  // namespace bench
+}  // namespace nsasm
@@ -0,0 +1,52 @@
+#include "bench/bench_input.h"
+#include "benchmark/benchmark.h"
+#include "nsasm/disassemble.h"
+
+namespace nsasm {
+namespace bench {
+namespace {
+
+int64_t CodeBytes(const Disassembly& disassembly) {
+  int64_t bytes = 0;
+  for (const auto& node : disassembly) {
+    bytes += InstructionLength(node.second.instruction.addressing_mode);
+  }
+  return bytes;
+}
+
+// Disassembles everything reachable from the reset vector of a 64K ROM.
+void BM_Disassemble(benchmark::State& state) {
+  BenchmarkRom input = MakeBenchmarkRom(2);
+  // The synthetic ROM's vectors are native NMI, then emulation RESET.
+  const InterruptVector& entry = input.rom.Vectors().back();
+  int64_t instructions = 0;
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    auto disassembly =
+        Disassemble(input.rom, entry.target, entry.flag_state);
+    instructions += disassembly->size();
+    bytes += CodeBytes(*disassembly);
+  }
+  state.SetItemsProcessed(instructions);
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_Disassemble);
+
+// Disassembles every routine of a ROM of `state.range(0)` banks.
+void BM_DisassembleAll(benchmark::State& state) {
+  BenchmarkRom input = MakeBenchmarkRom(state.range(0));
+  int64_t instructions = 0;
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    auto disassembly = DisassembleAll(input.rom, input.entry_points);
+    instructions += disassembly->size();
+    bytes += CodeBytes(*disassembly);
+  }
+  state.SetItemsProcessed(instructions);
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_DisassembleAll)->Arg(1)->Arg(16)->UseRealTime();
+
+}  // namespace
+}  // namespace bench
+}  // namespace nsasm
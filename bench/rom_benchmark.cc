@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+namespace bench {
+namespace {
+
+// Random addresses in the ROM area of the given mapping, including some that
+// map to work RAM or registers instead.
+std::vector<int> Addresses(Mapping mapping, int count) {
+  std::mt19937 random(count);
+  std::vector<int> addresses;
+  for (int i = 0; i < count; ++i) {
+    int address = random() & 0xffffff;
+    if (mapping == kLoRom && i % 8 != 0) {
+      address |= 0x8000;
+    }
+    addresses.push_back(address);
+  }
+  return addresses;
+}
+
+void BM_SnesToROMAddress(benchmark::State& state) {
+  const Mapping mapping = Mapping(state.range(0));
+  const std::vector<int> addresses = Addresses(mapping, 4096);
+  for (auto _ : state) {
+    for (int address : addresses) {
+      auto rom_address = SnesToROMAddress(address, mapping);
+      benchmark::DoNotOptimize(rom_address);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * addresses.size());
+}
+BENCHMARK(BM_SnesToROMAddress)->Arg(kLoRom)->Arg(kHiRom)->Arg(kExHiRom);
+
+// Reads `state.range(0)` bytes at a time from random places in a 4MB LoRom.
+void BM_RomRead(benchmark::State& state) {
+  const int length = state.range(0);
+  Rom rom(kLoRom, "bench.sfc", std::vector<uint8_t>(0x400000, 0xea));
+  std::vector<int> addresses;
+  std::mt19937 random(length);
+  for (int i = 0; i < 4096; ++i) {
+    addresses.push_back(0x800000 | (random() & 0x7f7fff) | 0x8000);
+  }
+  for (auto _ : state) {
+    for (int address : addresses) {
+      auto bytes = rom.Read(address, length);
+      benchmark::DoNotOptimize(bytes);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * addresses.size());
+  state.SetBytesProcessed(state.iterations() * addresses.size() * length);
+}
+BENCHMARK(BM_RomRead)->Arg(1)->Arg(4)->Arg(64);
+
+}  // namespace
+}  // namespace bench
+}  // namespace nsasm
@@ -0,0 +1,512 @@
+#include "bench/synthetic.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "nsasm/directive.h"
+#include "nsasm/format.h"
+#include "nsasm/instruction.h"
+#include "nsasm/opcode_map.h"
+
+namespace nsasm {
+namespace bench {
+
+namespace {
+
+// Code is laid out in 32K regions of ROM, each mapped to one contiguous range
+// of a SNES bank.  The end of every region is left free, keeping code clear of
+// the header.
+constexpr int kRegionSize = 0x8000;
+constexpr int kRegionReserve = 0x100;
+
+// Upper bound on the size of one subroutine, including its jump table cases.
+constexpr int kMaxRoutineSize = 0x400;
+// Bytes set aside at the start of the region at $00:8000 for the vector
+// handlers.
+constexpr int kVectorCodeSize = 0x20;
+
+// Offsets into the header, from ROM address of $00:ffb0.
+constexpr int kHeaderTitle = 0x10;
+constexpr int kHeaderMapMode = 0x25;
+constexpr int kHeaderRomSize = 0x27;
+constexpr int kHeaderRegion = 0x29;
+constexpr int kHeaderComplement = 0x2c;
+constexpr int kHeaderChecksum = 0x2e;
+constexpr int kHeaderVectors = 0x30;  // $00:ffe0
+
+// Opcodes by mnemonic and addressing mode.
+class OpcodeTable {
+ public:
+  OpcodeTable() {
+    for (int opcode = 0; opcode < 256; ++opcode) {
+      Instruction instruction = DecodeOpcode(opcode);
+      opcodes_[instruction.mnemonic][instruction.addressing_mode] = opcode;
+    }
+  }
+
+  uint8_t Opcode(Mnemonic m, AddressingMode mode) const {
+    return opcodes_[m][mode];
+  }
+
+ private:
+  std::array<std::array<uint8_t, A_imm_fx + 1>, PM_sub + 1> opcodes_{};
+};
+
+const OpcodeTable& Opcodes() {
+  static const auto* table = new OpcodeTable;
+  return *table;
+}
+
+std::string RoutineName(int address) {
+  std::string name = "sub_";
+  AppendHex(address, 6, &name);
+  return name;
+}
+
+std::string LocalLabelName(int address) {
+  std::string name = "l_";
+  AppendHex(address, 6, &name);
+  return name;
+}
+
+class Generator {
+ public:
+  Generator(const SyntheticRomOptions& options, SyntheticRom* rom)
+      : options_(options), rom_(*rom), random_(options.seed) {}
+
+  void Run();
+
+ private:
+  int Next(int n) { return random_() % n; }
+  uint8_t NextByte() { return random_(); }
+
+  // Emits source text.
+  void Line(absl::string_view text) {
+    rom_.source.append(text.data(), text.size());
+    rom_.source.push_back('\n');
+    ++rom_.source_lines;
+  }
+  void Label(const std::string& name) { Line(absl::StrCat(name, ":")); }
+  void LocalLabel(int address) {
+    if (address != last_local_label_) {
+      Label(LocalLabelName(address));
+      last_local_label_ = address;
+    }
+  }
+  void Org(int address) {
+    Directive org;
+    org.name = D_org;
+    org.argument = absl::make_unique<Literal>(address, T_long);
+    std::string text;
+    org.AppendTo(&text);
+    Line(text);
+  }
+
+  // Emits one instruction at the current address.  `value` is the argument,
+  // or the target address for branches (which are written with `label`).
+  void Emit(Mnemonic m, AddressingMode mode, int value = 0,
+            const std::string& label = "");
+  // Emits REP and SEP instructions to set the register widths.
+  void SetWidths(bool m16, bool x16);
+
+  // Emits a subroutine at the current address.
+  void Routine();
+  // Emits one random operation within a subroutine.
+  void Operation();
+  // Emits the end of a subroutine that dispatches through a jump table.
+  void JumpTableEnding(const std::string& name);
+  // Emits the root subroutine of the current region, which calls the last
+  // ordinary subroutine of the region, and the root of the previous region.
+  void RegionRoot();
+  // Emits the RESET and NMI handlers.
+  void VectorHandlers();
+
+  void WriteHeader();
+
+  const SyntheticRomOptions& options_;
+  SyntheticRom& rom_;
+  std::mt19937 random_;
+
+  int rom_pos_ = 0;
+  int snes_pos_ = 0;
+  bool m16_ = false;
+  bool x16_ = false;
+  // Address of the most recent local label, so that each is emitted once
+  int last_local_label_ = -1;
+
+  // Subroutines in the current region, callable with JSR.
+  std::vector<int> near_callees_;
+  // Address of the most recent region root, callable with JSL, or -1.
+  int previous_root_ = -1;
+
+  // Addresses of the vector handlers
+  int reset_ = 0;
+  int nmi_ = 0;
+};
+
+void Generator::Emit(Mnemonic m, AddressingMode mode, int value,
+                     const std::string& label) {
+  Instruction instruction;
+  instruction.mnemonic = m;
+  instruction.addressing_mode = mode;
+  int size = InstructionLength(mode) - 1;  // operand bytes
+  NumericType type = (size == 1) ? T_byte : (size == 2) ? T_word : T_long;
+  if (mode == A_imm_fm || mode == A_imm_fx) {
+    const bool wide = (mode == A_imm_fm) ? m16_ : x16_;
+    size = wide ? 2 : 1;
+    type = wide ? T_word : T_byte;
+  }
+  if (m == PM_add) {
+    // ADD is CLC followed by ADC.
+    rom_.data[rom_pos_++] = Opcodes().Opcode(M_clc, A_imp);
+    ++snes_pos_;
+  }
+  rom_.data[rom_pos_] = Opcodes().Opcode(m == PM_add ? M_adc : m, mode);
+  int operand = value;
+  if (mode == A_rel8) {
+    operand = value - (snes_pos_ + 2);
+    instruction.arg1 = absl::make_unique<Identifier>(label);
+  } else if (size > 0) {
+    instruction.arg1 = absl::make_unique<Literal>(value, type);
+  }
+  for (int i = 1; i <= size; ++i) {
+    rom_.data[rom_pos_ + i] = operand >> (8 * (i - 1));
+  }
+  rom_pos_ += size + 1;
+  snes_pos_ += size + 1;
+  ++rom_.instruction_count;
+
+  std::string text = "    ";
+  instruction.AppendTo(&text);
+  Line(text);
+}
+
+void Generator::SetWidths(bool m16, bool x16) {
+  const int wide_bits = (m16 ? 0x20 : 0) | (x16 ? 0x10 : 0);
+  if (wide_bits) {
+    Emit(M_rep, A_imm_b, wide_bits);
+  }
+  if (wide_bits != 0x30) {
+    Emit(M_sep, A_imm_b, 0x30 & ~wide_bits);
+  }
+  m16_ = m16;
+  x16_ = x16;
+}
+
+void Generator::Routine() {
+  const int start = snes_pos_;
+  const std::string name = RoutineName(start);
+  Label(name);
+  rom_.entry_points.push_back({start, FlagState(B_off)});
+  SetWidths(Next(2), Next(2));
+  const int count = 8 + Next(40);
+  // Every subroutine calls the one before it, early enough to stay within
+  // the size limit, so that the region's root reaches them all.
+  const int predecessor_call = Next(8);
+  for (int i = 0; i < count && snes_pos_ - start < kMaxRoutineSize - 0x140;
+       ++i) {
+    if (i == predecessor_call && !near_callees_.empty()) {
+      Emit(M_jsr, A_dir_w, near_callees_.back() & 0xffff);
+      SetWidths(m16_, x16_);
+    }
+    Operation();
+  }
+  if (Next(6) == 0) {
+    JumpTableEnding(name);
+  } else {
+    Emit(M_rts, A_imp);
+  }
+  near_callees_.push_back(start);
+}
+
+void Generator::Operation() {
+  // Work RAM and PPU register addresses
+  const int address = Next(2) ? 0x0200 + Next(0x1e00) : 0x2100 + Next(0x40);
+  switch (Next(24)) {
+    case 0:
+    case 1:
+      Emit(M_lda, A_imm_fm, random_());
+      break;
+    case 2:
+      Emit(M_lda, A_dir_b, NextByte());
+      break;
+    case 3:
+      Emit(M_lda, A_dir_w, address);
+      break;
+    case 4:
+      Emit(M_lda, A_dir_wx, address);
+      break;
+    case 5:
+      Emit(M_lda, A_dir_l, 0x7e0000 | (random_() & 0xffff));
+      break;
+    case 6:
+    case 7:
+      Emit(M_sta, A_dir_w, address);
+      break;
+    case 8:
+      Emit(M_sta, A_dir_b, NextByte());
+      break;
+    case 9:
+      Emit(M_stz, A_dir_w, address);
+      break;
+    case 10:
+      Emit(PM_add, A_imm_fm, random_());
+      break;
+    case 11:
+      Emit(M_cmp, A_imm_fm, random_());
+      break;
+    case 12:
+      Emit(M_and, A_imm_fm, random_());
+      break;
+    case 13:
+      Emit(M_ldx, A_imm_fx, random_());
+      break;
+    case 14:
+      Emit(M_ldy, A_imm_fx, random_());
+      break;
+    case 15:
+      Emit(M_tax, A_imp);
+      Emit(M_inx, A_imp);
+      break;
+    case 16:
+      Emit(M_asl, A_acc);
+      Emit(M_txa, A_imp);
+      Emit(M_dey, A_imp);
+      break;
+    case 17:
+      Emit(M_inc, A_dir_w, address);
+      break;
+    case 18: {
+      // Skip over one instruction
+      static constexpr Mnemonic kBranches[] = {M_bne, M_beq, M_bcc, M_bcs,
+                                               M_bpl, M_bmi};
+      const int target = snes_pos_ + 3;
+      Emit(kBranches[Next(6)], A_rel8, target, LocalLabelName(target));
+      Emit(M_inx, A_imp);
+      LocalLabel(target);
+      break;
+    }
+    case 19: {
+      // Count down a loop
+      Emit(M_ldx, A_imm_fx, 1 + Next(100));
+      const int loop = snes_pos_;
+      LocalLabel(loop);
+      Emit(M_dex, A_imp);
+      Emit(M_bne, A_rel8, loop, LocalLabelName(loop));
+      break;
+    }
+    case 20:
+    case 21:
+      if (!near_callees_.empty()) {
+        Emit(M_jsr, A_dir_w,
+             near_callees_[Next(near_callees_.size())] & 0xffff);
+        // Callees leave the register widths as they please.
+        SetWidths(m16_, x16_);
+      }
+      break;
+    case 22:
+      if (previous_root_ >= 0) {
+        Emit(M_jsl, A_dir_l, previous_root_);
+        SetWidths(m16_, x16_);
+      }
+      break;
+    default: {
+      // A brief switch to emulation mode
+      const bool m16 = m16_;
+      const bool x16 = x16_;
+      Emit(M_sec, A_imp);
+      Emit(M_xce, A_imp);
+      m16_ = x16_ = false;
+      Emit(M_lda, A_imm_fm, NextByte());
+      Emit(M_sta, A_dir_w, 0x2100);
+      Emit(M_clc, A_imp);
+      Emit(M_xce, A_imp);
+      SetWidths(m16, x16);
+      break;
+    }
+  }
+}
+
+void Generator::JumpTableEnding(const std::string& name) {
+  const int cases = Next(2) ? 4 : 2;
+  Emit(M_lda, A_dir_b, NextByte());
+  Emit(M_and, A_imm_fm, cases - 1);
+  Emit(M_asl, A_acc);
+  Emit(M_tax, A_imp);
+  Emit(M_jmp, A_ind_wx, (snes_pos_ + 3) & 0xffff);
+
+  std::vector<std::string> case_names;
+  for (int i = 0; i < cases; ++i) {
+    case_names.push_back(absl::StrCat(name, "_case", i));
+  }
+  Line(absl::StrCat("    .DW ", absl::StrJoin(case_names, ", ")));
+  const int table = rom_pos_;
+  rom_pos_ += 2 * cases;
+  snes_pos_ += 2 * cases;
+
+  const FlagState entry_state(B_off, m16_ ? B_off : B_on, x16_ ? B_off : B_on);
+  const bool m16 = m16_;
+  const bool x16 = x16_;
+  for (int i = 0; i < cases; ++i) {
+    rom_.data[table + 2 * i] = snes_pos_;
+    rom_.data[table + 2 * i + 1] = snes_pos_ >> 8;
+    Label(case_names[i]);
+    rom_.entry_points.push_back({snes_pos_, entry_state});
+    m16_ = m16;
+    x16_ = x16;
+    for (int j = 1 + Next(4); j > 0; --j) {
+      Operation();
+    }
+    Emit(M_rts, A_imp);
+  }
+}
+
+void Generator::RegionRoot() {
+  const int start = snes_pos_;
+  Label(absl::StrCat("root_", RoutineName(start).substr(4)));
+  rom_.entry_points.push_back({start, FlagState(B_off)});
+  if (!near_callees_.empty()) {
+    Emit(M_jsr, A_dir_w, near_callees_.back() & 0xffff);
+  }
+  if (previous_root_ >= 0) {
+    Emit(M_jsl, A_dir_l, previous_root_);
+  }
+  Emit(M_rtl, A_imp);
+  previous_root_ = start;
+}
+
+void Generator::VectorHandlers() {
+  Org(snes_pos_);
+  Label("reset");
+  reset_ = snes_pos_;
+  rom_.entry_points.push_back({snes_pos_, FlagState(B_on, B_on, B_on)});
+  m16_ = x16_ = false;
+  Emit(M_sei, A_imp);
+  Emit(M_clc, A_imp);
+  Emit(M_xce, A_imp);
+  SetWidths(true, true);
+  Emit(M_ldx, A_imm_fx, 0x1fff);
+  Emit(M_txs, A_imp);
+  SetWidths(false, false);
+  if (previous_root_ >= 0) {
+    Emit(M_jsl, A_dir_l, previous_root_);
+  }
+  const int loop = snes_pos_;
+  LocalLabel(loop);
+  Emit(M_wai, A_imp);
+  Emit(M_bra, A_rel8, loop, LocalLabelName(loop));
+
+  Label("nmi");
+  nmi_ = snes_pos_;
+  rom_.entry_points.push_back({snes_pos_, FlagState(B_off)});
+  Emit(M_rti, A_imp);
+}
+
+void Generator::Run() {
+  // The region seen at $00:8000 holds the vector handlers, and is filled
+  // first.
+  const int vector_region = *SnesToROMAddress(0x008000, options_.mapping);
+  std::vector<int> regions = {vector_region};
+  for (int region = 0; region < options_.rom_size; region += kRegionSize) {
+    if (region != vector_region) {
+      regions.push_back(region);
+    }
+  }
+
+  for (int region : regions) {
+    if (options_.max_source_lines &&
+        rom_.source_lines >= options_.max_source_lines) {
+      break;
+    }
+    rom_pos_ = region;
+    snes_pos_ = (region == vector_region)
+                    ? 0x008000
+                    : *ROMToSnesAddress(region, options_.mapping);
+    if (region == vector_region) {
+      rom_pos_ += kVectorCodeSize;
+      snes_pos_ += kVectorCodeSize;
+    }
+    Org(snes_pos_);
+    near_callees_.clear();
+    const int end = region + kRegionSize - kRegionReserve;
+    while (rom_pos_ + kMaxRoutineSize < end &&
+           !(options_.max_source_lines &&
+             rom_.source_lines >= options_.max_source_lines)) {
+      Routine();
+    }
+    RegionRoot();
+  }
+
+  rom_pos_ = vector_region;
+  snes_pos_ = 0x008000;
+  VectorHandlers();
+  WriteHeader();
+}
+
+void Generator::WriteHeader() {
+  std::vector<int> headers = {*SnesToROMAddress(0x00ffb0, options_.mapping)};
+  if (options_.mapping == kExHiRom) {
+    // `LoadRomFile()` looks for ExHiRom headers in the HiRom position.
+    headers.push_back(0x00ffb0);
+  }
+  int rom_size_code = 0;
+  while ((0x400 << rom_size_code) < options_.rom_size) {
+    ++rom_size_code;
+  }
+  static constexpr uint8_t kMapModes[] = {0x20, 0x21, 0x25};
+  static constexpr char kTitle[] = "NSASM SYNTHETIC ROM  ";
+
+  for (int header : headers) {
+    uint8_t* bytes = &rom_.data[header];
+    std::copy(kTitle, kTitle + 21, bytes + kHeaderTitle);
+    bytes[kHeaderMapMode] = kMapModes[options_.mapping];
+    bytes[kHeaderRomSize] = rom_size_code;
+    bytes[kHeaderRegion] = 0x01;
+    // Placeholder checksum, whose bytes sum as the final one will
+    bytes[kHeaderComplement] = bytes[kHeaderComplement + 1] = 0xff;
+    bytes[kHeaderChecksum] = bytes[kHeaderChecksum + 1] = 0x00;
+    // Native NMI at $ffea, and emulation RESET at $fffc
+    bytes[kHeaderVectors + 0x0a] = nmi_;
+    bytes[kHeaderVectors + 0x0b] = nmi_ >> 8;
+    bytes[kHeaderVectors + 0x1c] = reset_;
+    bytes[kHeaderVectors + 0x1d] = reset_ >> 8;
+  }
+
+  uint16_t checksum = 0;
+  for (uint8_t byte : rom_.data) {
+    checksum += byte;
+  }
+  for (int header : headers) {
+    uint8_t* bytes = &rom_.data[header];
+    bytes[kHeaderComplement] = ~checksum;
+    bytes[kHeaderComplement + 1] = ~checksum >> 8;
+    bytes[kHeaderChecksum] = checksum;
+    bytes[kHeaderChecksum + 1] = checksum >> 8;
+  }
+}
+
+}  // namespace
+
+ErrorOr<SyntheticRom> GenerateSyntheticRom(const SyntheticRomOptions& options) {
+  const int size = options.rom_size;
+  if (size < 0x10000 || size > 0x800000 || size % 0x10000 != 0) {
+    return Error("ROM size must be a multiple of 64K, from 64K to 8M");
+  }
+  if ((options.mapping == kLoRom && size > 0x400000) ||
+      (options.mapping == kHiRom && size >= 0x400000) ||
+      (options.mapping == kExHiRom && (size <= 0x410000 || size > 0x7e0000))) {
+    return Error("ROM size %d is invalid for this mapping", size);
+  }
+  SyntheticRom rom;
+  rom.mapping = options.mapping;
+  rom.data.resize(size);
+  Generator(options, &rom).Run();
+  return rom;
+}
+
+}  // namespace bench
+}  // namespace nsasm
@@ -0,0 +1,59 @@
+#ifndef BENCH_SYNTHETIC_H_
+#define BENCH_SYNTHETIC_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nsasm/disassemble.h"
+#include "nsasm/error.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+namespace bench {
+
+struct SyntheticRomOptions {
+  Mapping mapping = kLoRom;
+  // Image size in bytes, a multiple of 64K.  LoRom images may be from 64K to
+  // 4MB; HiRom images from 64K to $3f0000 bytes; and ExHiRom images from
+  // $420000 to $7e0000 bytes.  These ranges let `LoadRomFile()` detect each
+  // mapping.
+  int rom_size = 0x100000;
+  // If nonzero, stop generating code once the source reaches about this many
+  // lines, leaving the rest of the image empty.
+  int max_source_lines = 0;
+  uint32_t seed = 1;
+};
+
+// A generated ROM image, and nsasm source for its code.
+struct SyntheticRom {
+  Mapping mapping;
+  std::vector<uint8_t> data;
+  // Source for every instruction and jump table in `data`, as a sequence of
+  // `.org` blocks.  Calls and jumps are written with numeric addresses, since
+  // the assembler cannot yet size label arguments.
+  std::string source;
+  int source_lines = 0;
+  int instruction_count = 0;
+  // Every subroutine, jump table case and vector handler, with the state it is
+  // entered in.
+  std::vector<EntryPoint> entry_points;
+};
+
+// Generates a deterministic ROM image full of reachable code.
+//
+// The image has a valid header (with a checksum that passes the header checks
+// in `LoadRomFile()`), and RESET and NMI vectors.  The reset handler switches
+// to native mode and calls into a tree of subroutines that covers the whole
+// image.  Each subroutine sets its register widths with REP and SEP, then
+// runs a random mix of loads, stores, arithmetic, branches and loops, calls to
+// other subroutines, and brief switches to emulation mode with XCE.  Some end
+// in a jump table of cases dispatched with `JMP ($xxxx, X)`.
+//
+// The same options always produce the same image and source.
+ErrorOr<SyntheticRom> GenerateSyntheticRom(const SyntheticRomOptions& options);
+
+}  // namespace bench
+}  // namespace nsasm
+
+#endif  // BENCH_SYNTHETIC_H_
@@ -0,0 +1,103 @@
+#include "bench/synthetic.h"
+
+#include <cstdio>
+#include <string>
+
+#include "absl/strings/str_split.h"
+#include "gtest/gtest.h"
+#include "nsasm/assemble.h"
+#include "nsasm/token.h"
+
+namespace nsasm {
+namespace bench {
+namespace {
+
+ErrorOr<Rom> WriteAndLoad(const SyntheticRom& synthetic,
+                          const std::string& name) {
+  const std::string path = testing::TempDir() + "/" + name;
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  EXPECT_NE(file, nullptr);
+  std::fwrite(synthetic.data.data(), 1, synthetic.data.size(), file);
+  std::fclose(file);
+  return LoadRomFile(path);
+}
+
+void CheckSyntheticRom(Mapping mapping, int rom_size) {
+  SyntheticRomOptions options;
+  options.mapping = mapping;
+  options.rom_size = rom_size;
+  options.max_source_lines = 20000;
+  auto synthetic = GenerateSyntheticRom(options);
+  NSASM_ASSERT_OK(synthetic);
+  EXPECT_EQ(synthetic->data.size(), rom_size);
+
+  // The header is found, and the mapping detected
+  auto rom = WriteAndLoad(*synthetic, "synthetic.sfc");
+  NSASM_ASSERT_OK(rom);
+  EXPECT_EQ(rom->mapping_mode(), mapping);
+  ASSERT_EQ(rom->Vectors().size(), 2);
+
+  // The vectors reach every subroutine, and together with the jump table
+  // cases, every instruction.
+  auto disassembly = DisassembleAll(*rom, synthetic->entry_points);
+  NSASM_ASSERT_OK(disassembly);
+  EXPECT_EQ(disassembly->size(), synthetic->instruction_count);
+  EXPECT_GT(synthetic->instruction_count, 15000);
+
+  // Every source line assembles
+  int lines = 0;
+  for (absl::string_view line : absl::StrSplit(synthetic->source, '\n')) {
+    if (line.empty()) {
+      continue;
+    }
+    ++lines;
+    auto tokens = Tokenize(line, Location());
+    NSASM_ASSERT_OK(tokens);
+    auto assembled = Assemble(*tokens);
+    ASSERT_TRUE(assembled.ok()) << line;
+  }
+  EXPECT_EQ(lines, synthetic->source_lines);
+}
+
+TEST(SyntheticRom, lorom) { CheckSyntheticRom(kLoRom, 0x80000); }
+
+TEST(SyntheticRom, hirom) { CheckSyntheticRom(kHiRom, 0x80000); }
+
+TEST(SyntheticRom, exhirom) { CheckSyntheticRom(kExHiRom, 0x420000); }
+
+TEST(SyntheticRom, deterministic) {
+  SyntheticRomOptions options;
+  options.rom_size = 0x20000;
+  auto first = GenerateSyntheticRom(options);
+  auto second = GenerateSyntheticRom(options);
+  NSASM_ASSERT_OK(first);
+  NSASM_ASSERT_OK(second);
+  EXPECT_EQ(first->data, second->data);
+  EXPECT_EQ(first->source, second->source);
+
+  options.seed = 2;
+  auto reseeded = GenerateSyntheticRom(options);
+  NSASM_ASSERT_OK(reseeded);
+  EXPECT_NE(first->data, reseeded->data);
+}
+
+TEST(SyntheticRom, source_lines) {
+  SyntheticRomOptions options;
+  options.rom_size = 0x100000;
+  options.max_source_lines = 1000;
+  auto synthetic = GenerateSyntheticRom(options);
+  NSASM_ASSERT_OK(synthetic);
+  EXPECT_GE(synthetic->source_lines, 1000);
+  EXPECT_LT(synthetic->source_lines, 1500);
+
+  options.max_source_lines = 0;
+  options.rom_size = 0x10000;
+  options.mapping = kHiRom;
+  EXPECT_TRUE(GenerateSyntheticRom(options).ok());
+  options.rom_size = 0x400000;
+  EXPECT_FALSE(GenerateSyntheticRom(options).ok());
+}
+
+}  // namespace
+}  // namespace bench
+}  // namespace nsasm
@@ -1,92 +1,102 @@
 #include "nsasm/addressing_mode.h"
 
 #include "absl/strings/str_format.h"
+#include "nsasm/stats.h"
 
 namespace nsasm {
 
-std::string ArgsToString(AddressingMode addressing_mode, const Expression& arg1,
-                         const Expression& arg2) {
+namespace {
+
+// How the arguments of an addressing mode are printed: the text before and
+// after the argument, and the type it is printed as.  For A_mov, the same
+// format applies to each of the two arguments, which are separated by a comma.
+struct ArgsFormat {
+  const char* before;
+  const char* after;
+  NumericType type;
+};
+
+ArgsFormat FormatFor(AddressingMode addressing_mode) {
   switch (addressing_mode) {
     case A_imp:
     case A_acc:
-    default: {
-      return "";
-    }
-    case A_imm_b: {
-      return absl::StrFormat(" #%s", arg1.ToString(T_byte));
-    }
-    case A_imm_w: {
-      return absl::StrFormat(" #%s", arg1.ToString(T_word));
-    }
-    case A_dir_b: {
-      return absl::StrFormat(" %s", arg1.ToString(T_byte));
-    }
-    case A_dir_w: {
-      return absl::StrFormat(" %s", arg1.ToString(T_word));
-    }
-    case A_dir_l: {
-      return absl::StrFormat(" %s", arg1.ToString(T_long));
-    }
-    case A_dir_bx: {
-      return absl::StrFormat(" %s, X", arg1.ToString(T_byte));
-    }
-    case A_dir_by: {
-      return absl::StrFormat(" %s, Y", arg1.ToString(T_byte));
-    }
-    case A_dir_wx: {
-      return absl::StrFormat(" %s, X", arg1.ToString(T_word));
-    }
-    case A_dir_wy: {
-      return absl::StrFormat(" %s, Y", arg1.ToString(T_word));
-    }
-    case A_dir_lx: {
-      return absl::StrFormat(" %s, X", arg1.ToString(T_long));
-    }
-    case A_ind_b: {
-      return absl::StrFormat(" (%s)", arg1.ToString(T_byte));
-    }
-    case A_ind_w: {
-      return absl::StrFormat(" (%s)", arg1.ToString(T_word));
-    }
-    case A_ind_bx: {
-      return absl::StrFormat(" (%s, X)", arg1.ToString(T_byte));
-    }
-    case A_ind_by: {
-      return absl::StrFormat(" (%s), Y", arg1.ToString(T_byte));
-    }
-    case A_ind_wx: {
-      return absl::StrFormat(" (%s, X)", arg1.ToString(T_word));
-    }
-    case A_lng_b: {
-      return absl::StrFormat(" [%s]", arg1.ToString(T_byte));
-    }
-    case A_lng_w: {
-      return absl::StrFormat(" [%s]", arg1.ToString(T_word));
-    }
-    case A_lng_by: {
-      return absl::StrFormat(" [%s], Y", arg1.ToString(T_byte));
-    }
-    case A_stk: {
-      return absl::StrFormat(" %s, S", arg1.ToString(T_byte));
-    }
-    case A_stk_y: {
-      return absl::StrFormat(" (%s, S), Y", arg1.ToString(T_byte));
-    }
-    case A_mov: {
-      return absl::StrFormat(" #%s, #%s", arg1.ToString(T_byte),
-                             arg2.ToString(T_byte));
-    }
+    default:
+      return {nullptr, nullptr, T_unknown};
+    case A_imm_b:
+      return {" #", "", T_byte};
+    case A_imm_w:
+      return {" #", "", T_word};
+    case A_dir_b:
+      return {" ", "", T_byte};
+    case A_dir_w:
+      return {" ", "", T_word};
+    case A_dir_l:
+      return {" ", "", T_long};
+    case A_dir_bx:
+      return {" ", ", X", T_byte};
+    case A_dir_by:
+      return {" ", ", Y", T_byte};
+    case A_dir_wx:
+      return {" ", ", X", T_word};
+    case A_dir_wy:
+      return {" ", ", Y", T_word};
+    case A_dir_lx:
+      return {" ", ", X", T_long};
+    case A_ind_b:
+      return {" (", ")", T_byte};
+    case A_ind_w:
+      return {" (", ")", T_word};
+    case A_ind_bx:
+      return {" (", ", X)", T_byte};
+    case A_ind_by:
+      return {" (", "), Y", T_byte};
+    case A_ind_wx:
+      return {" (", ", X)", T_word};
+    case A_lng_b:
+      return {" [", "]", T_byte};
+    case A_lng_w:
+      return {" [", "]", T_word};
+    case A_lng_by:
+      return {" [", "], Y", T_byte};
+    case A_stk:
+      return {" ", ", S", T_byte};
+    case A_stk_y:
+      return {" (", ", S), Y", T_byte};
+    case A_mov:
+      return {" #", "", T_byte};
     case A_rel8:
-    case A_rel16: {
-      return absl::StrFormat(" %s", arg1.ToString());
-    }
+    case A_rel16:
+      return {" ", "", T_unknown};
     case A_imm_fm:
-    case A_imm_fx: {
-      return absl::StrFormat(" #%s", arg1.ToString());
-    }
+    case A_imm_fx:
+      return {" #", "", T_unknown};
   }
 }
 
+}  // namespace
+
+void AppendArgs(AddressingMode addressing_mode, const Expression& arg1,
+                const Expression& arg2, std::string* output) {
+  const ArgsFormat format = FormatFor(addressing_mode);
+  if (!format.before) {
+    return;
+  }
+  output->append(format.before);
+  arg1.AppendTo(output, format.type);
+  if (addressing_mode == A_mov) {
+    output->append(", #");
+    arg2.AppendTo(output, format.type);
+  }
+  output->append(format.after);
+}
+
+std::string ArgsToString(AddressingMode addressing_mode, const Expression& arg1,
+                         const Expression& arg2) {
+  std::string result;
+  AppendArgs(addressing_mode, arg1, arg2, &result);
+  return result;
+}
+
 namespace {
 
 ErrorOr<AddressingMode> SwitchByteWordLong(const Expression& arg,
@@ -202,6 +212,7 @@ ErrorOr<AddressingMode> ForceLong(const Expression& arg, Mnemonic mnemonic,
 ErrorOr<AddressingMode> DeduceMode(Mnemonic m, SyntacticAddressingMode smode,
                                    const Expression& arg1,
                                    const Expression& arg2) {
+  NSASM_STATS_TIMER(SP_deduce_mode);
   // Relative addressing is a special case.
   if (m == M_bcc || m == M_bcs || m == M_beq || m == M_bmi || m == M_bne ||
       m == M_bpl || m == M_bra || m == M_brl || m == M_bvc || m == M_bvs ||
@@ -64,6 +64,10 @@ enum SyntacticAddressingMode {
 std::string ArgsToString(AddressingMode a, const Expression& arg1,
                          const Expression& arg2);
 
+// As above, but appends the argument list to `*output`.
+void AppendArgs(AddressingMode a, const Expression& arg1,
+                const Expression& arg2, std::string* output);
+
 // Given a syntactic addressing form and arguments, returns the actual
 // addressing mode if one can be inferred.  Will return A_imm_fm and A_imm_fx
 // for status-flag-dependent immediate arguments.
@@ -0,0 +1,141 @@
+// Replacement global operator new and delete that charge every heap
+// allocation to the current stats phase (see nsasm/stats.h).
+//
+// Linking this file in is what turns allocation tracking on; it has no other
+// interface.  Each block carries a small header recording its size and the
+// phase that allocated it, so that frees are credited back to the right phase
+// and per-phase peaks can be kept.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "nsasm/stats.h"
+
+namespace nsasm {
+namespace {
+
+// Stored immediately before each block handed out.
+struct BlockHeader {
+  int64_t size;
+  // Bytes from the start of the underlying allocation to the block.
+  int32_t offset;
+  StatPhase phase;
+};
+
+// Header space for blocks with default alignment.  This keeps blocks aligned
+// as malloc() would.
+constexpr size_t kHeaderSize = 16;
+static_assert(sizeof(BlockHeader) <= kHeaderSize, "header too large");
+
+BlockHeader* HeaderOf(void* block) {
+  return reinterpret_cast<BlockHeader*>(static_cast<char*>(block) -
+                                        sizeof(BlockHeader));
+}
+
+void* Allocate(size_t size, size_t alignment) {
+  const size_t offset = alignment > kHeaderSize ? alignment : kHeaderSize;
+  void* raw;
+  if (alignment > alignof(std::max_align_t)) {
+    // aligned_alloc() requires the size to be a multiple of the alignment.
+    const size_t total = offset + size + alignment - 1;
+    raw = std::aligned_alloc(alignment, total - total % alignment);
+  } else {
+    raw = std::malloc(offset + size);
+  }
+  if (!raw) {
+    return nullptr;
+  }
+  void* block = static_cast<char*>(raw) + offset;
+  BlockHeader* header = HeaderOf(block);
+  header->size = size;
+  header->offset = offset;
+  header->phase = internal::RecordAllocation(size);
+  return block;
+}
+
+void* AllocateOrThrow(size_t size, size_t alignment) {
+  void* block = Allocate(size, alignment);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void Free(void* block) {
+  if (!block) {
+    return;
+  }
+  BlockHeader* header = HeaderOf(block);
+  internal::RecordDeallocation(header->phase, header->size);
+  std::free(static_cast<char*>(block) - header->offset);
+}
+
+struct Register {
+  Register() {
+    internal::allocation_tracking_linked.store(true,
+                                               std::memory_order_relaxed);
+  }
+} register_tracking;
+
+}  // namespace
+}  // namespace nsasm
+
+using nsasm::Allocate;
+using nsasm::AllocateOrThrow;
+using nsasm::Free;
+
+void* operator new(size_t size) {
+  return AllocateOrThrow(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size) {
+  return AllocateOrThrow(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return Allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block) noexcept { Free(block); }
+void operator delete[](void* block) noexcept { Free(block); }
+void operator delete(void* block, size_t) noexcept { Free(block); }
+void operator delete[](void* block, size_t) noexcept { Free(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+  Free(block);
+}
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+  Free(block);
+}
+void operator delete(void* block, std::align_val_t) noexcept { Free(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { Free(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept {
+  Free(block);
+}
+void operator delete[](void* block, size_t, std::align_val_t) noexcept {
+  Free(block);
+}
+void operator delete(void* block, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  Free(block);
+}
+void operator delete[](void* block, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  Free(block);
+}
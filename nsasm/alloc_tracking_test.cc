@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+#include "nsasm/decode.h"
+#include "nsasm/stats.h"
+
+namespace nsasm {
+namespace {
+
+TEST(AllocTracking, charges_innermost_phase) {
+  ASSERT_TRUE(AllocationTrackingEnabled());
+  ResetStats();
+  std::unique_ptr<std::vector<char>> kept;
+  {
+    ScopedPhaseTimer outer(SP_parse);
+    auto temporary = absl::make_unique<char[]>(1000);
+    {
+      ScopedPhaseTimer inner(SP_tokenize);
+      kept = absl::make_unique<std::vector<char>>(5000);
+    }
+  }
+  Stats stats = GetStats();
+  EXPECT_EQ(stats.phases[SP_parse].allocations, 1);
+  EXPECT_EQ(stats.phases[SP_parse].allocated_bytes, 1000);
+  EXPECT_EQ(stats.phases[SP_parse].peak_live_bytes, 1000);
+  // The vector object and its buffer.
+  EXPECT_EQ(stats.phases[SP_tokenize].allocations, 2);
+  EXPECT_EQ(stats.phases[SP_tokenize].allocated_bytes,
+            5000 + sizeof(std::vector<char>));
+
+  // Freeing outside a phase credits the phase that allocated.  Peaks restart
+  // from the bytes still live.
+  kept.reset();
+  ResetStats();
+  stats = GetStats();
+  EXPECT_EQ(stats.phases[SP_tokenize].peak_live_bytes, 0);
+  EXPECT_EQ(stats.phases[SP_parse].peak_live_bytes, 0);
+}
+
+TEST(AllocTracking, decode_allocations) {
+  // Decoding allocates one expression node per argument, and nothing else.
+  const std::vector<uint8_t> lda_immediate = {0xa9, 0x12};
+  const std::vector<uint8_t> mvn = {0x54, 0x7e, 0x7f};
+  const std::vector<uint8_t> nop = {0xea};
+  const FlagState state(B_off, B_on, B_on);
+  ResetStats();
+  {
+    ScopedPhaseTimer timer(SP_decode);
+    NSASM_ASSERT_OK(Decode(lda_immediate, state));
+  }
+  EXPECT_EQ(GetStats().phases[SP_decode].allocations, 1);
+  ResetStats();
+  {
+    ScopedPhaseTimer timer(SP_decode);
+    NSASM_ASSERT_OK(Decode(mvn, state));
+  }
+  EXPECT_EQ(GetStats().phases[SP_decode].allocations, 2);
+  ResetStats();
+  {
+    ScopedPhaseTimer timer(SP_decode);
+    NSASM_ASSERT_OK(Decode(nop, state));
+  }
+  EXPECT_EQ(GetStats().phases[SP_decode].allocations, 0);
+}
+
+}  // namespace
+}  // namespace nsasm
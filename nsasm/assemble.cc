@@ -4,6 +4,7 @@
 
 #include "nsasm/expression.h"
 #include "nsasm/opcode_map.h"
+#include "nsasm/stats.h"
 
 namespace nsasm {
 namespace {
@@ -355,6 +356,10 @@ ErrorOr<Directive> ParseDirective(TokenSpan* pos) {
       NSASM_RETURN_IF_ERROR(ConfirmAtEnd(pos, "after flag state"));
       return std::move(directive);
     }
+    case DT_no_arg: {
+      NSASM_RETURN_IF_ERROR(ConfirmAtEnd(pos, "after directive"));
+      return std::move(directive);
+    }
   }
 }
 
@@ -362,6 +367,7 @@ ErrorOr<Directive> ParseDirective(TokenSpan* pos) {
 
 ErrorOr<std::vector<absl::variant<Instruction, Directive, std::string>>>
 Assemble(absl::Span<const Token> tokens) {
+  NSASM_STATS_TIMER(SP_parse);
   std::vector<absl::variant<Instruction, Directive, std::string>> result_vector;
 
   while (!tokens.empty()) {
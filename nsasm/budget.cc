@@ -0,0 +1,503 @@
+#include "nsasm/budget.h"
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
+#include "nsasm/cycles.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+namespace {
+
+// An instruction or directive, in source order.
+struct Step {
+  int line;
+  const Statement* statement;
+  const Instruction* instruction;  // null for directives
+  const Directive* directive;      // null for instructions
+};
+
+// The steps in [begin, end), which a path may visit.
+struct Region {
+  int begin;
+  int end;
+};
+
+bool IsReturn(Mnemonic m) {
+  return m == M_rts || m == M_rtl || m == M_rti || m == M_stp;
+}
+
+bool IsCall(Mnemonic m) { return m == M_jsr || m == M_jsl; }
+
+bool IsJump(Mnemonic m) { return m == M_jmp || m == M_bra || m == M_brl; }
+
+bool IsConditionalBranch(const Instruction& instruction) {
+  return instruction.addressing_mode == A_rel8 &&
+         instruction.mnemonic != M_bra;
+}
+
+class BudgetChecker {
+ public:
+  BudgetChecker(const std::string& path,
+                const std::vector<std::vector<Statement>>& lines);
+
+  std::vector<Error> Check();
+
+ private:
+  // The worst path from one step, in one flag state.
+  struct Node {
+    bool done = false;
+    // Cycles from this step to the end of the path.
+    int cycles = 0;
+    // Cycles of this step alone, and of the subroutine it calls, if any.
+    int step_cycles = 0;
+    int call_cycles = 0;
+    std::string callee;
+    // The next step along the path, or -1 if the path leaves the region.
+    int next = -1;
+    FlagState next_state;
+  };
+  // Region begin and end, step, and packed flag state.
+  using Key = std::tuple<int, int, int, uint16_t>;
+
+  // A walk from a step that the worst path from the step depends on: the
+  // walk through a subroutine it calls, or from one of its successors.
+  struct Child {
+    Region region;
+    int step;
+    FlagState state;
+  };
+
+  // A step whose worst path is being found, waiting on its children.
+  struct Frame {
+    Key key;
+    Node node;
+    // The call's walk, if any, comes first.
+    bool calls = false;
+    Child children[3];
+    int child_count = 0;
+    // The next child to walk.
+    int next = 0;
+    // The most cycles from any successor walked so far.
+    int worst = -1;
+
+    // Adds the cycles of the worst path of the next child to the node.
+    void Add(int cycles);
+  };
+
+  // Checks the budget opened at step `begin` and closed at step `end`.
+  absl::optional<Error> CheckBudget(int begin, int end);
+
+  // Returns the cycles of the worst path from `step` in `state` until it
+  // leaves `region`, memoized.
+  //
+  // Paths are walked depth first, but with an explicit stack of frames, so
+  // that a long path cannot overflow the call stack.  The steps on the stack
+  // are memoized as not done, which finds unbounded loops.
+  ErrorOr<int> Walk(const Region& region, int step, const FlagState& state);
+
+  // Returns the cycles of the worst path from `step`, if known; otherwise,
+  // pushes a frame to find it on `*stack` and returns nullopt.
+  ErrorOr<absl::optional<int>> Start(const Child& child,
+                                     std::vector<Frame>* stack);
+
+  // Returns a frame for `step`, with its own cycles and its children.
+  ErrorOr<Frame> Enter(const Region& region, int step, const FlagState& state);
+
+  // Returns the state the subroutine at `step` returns in, entered in
+  // `state`: the merged state at each return reachable from it, memoized.
+  // Returns a state with unknown `m` and `x` bits if it cannot be followed
+  // to its returns.
+  FlagState ReturnState(int step, const FlagState& state);
+
+  // Returns the step labelled by the target of a branch, jump or call, if
+  // any.
+  absl::optional<int> Target(const Instruction& instruction) const;
+
+  // Describes the worst path from `step`, as found by Walk().
+  std::string DescribePath(const Region& region, int step,
+                           FlagState state) const;
+
+  Error Failure(int step, std::string message) const {
+    return Error("%s", message).SetLocation(path_, steps_[step].line);
+  }
+
+  const std::string& path_;
+  std::vector<Step> steps_;
+  // The straight-line flag state on entry to each step.
+  std::vector<FlagState> entry_states_;
+  // Each label, mapped to the step following it.
+  absl::flat_hash_map<std::string, int> labels_;
+  absl::flat_hash_map<Key, Node> nodes_;
+  // Return states by subroutine step and packed entry state; nullopt while
+  // being found, for recursive calls.
+  absl::flat_hash_map<std::pair<int, uint16_t>, absl::optional<FlagState>>
+      return_states_;
+};
+
+BudgetChecker::BudgetChecker(const std::string& path,
+                             const std::vector<std::vector<Statement>>& lines)
+    : path_(path) {
+  FlagState state;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const int line = i + 1;
+    for (const Statement& statement : lines[i]) {
+      if (absl::holds_alternative<std::string>(statement)) {
+        labels_.emplace(absl::get<std::string>(statement), steps_.size());
+        continue;
+      }
+      steps_.push_back({line, &statement,
+                        absl::get_if<Instruction>(&statement),
+                        absl::get_if<Directive>(&statement)});
+      entry_states_.push_back(state);
+      state = StatementExitState(state, statement);
+    }
+  }
+}
+
+std::vector<Error> BudgetChecker::Check() {
+  std::vector<Error> errors;
+  absl::optional<int> open;
+  for (int step = 0; step < static_cast<int>(steps_.size()); ++step) {
+    const Directive* directive = steps_[step].directive;
+    if (!directive) {
+      continue;
+    }
+    if (directive->name == D_budget) {
+      if (open.has_value()) {
+        errors.push_back(Failure(*open, ".budget without .endbudget"));
+      }
+      open = step;
+    } else if (directive->name == D_endbudget) {
+      if (!open.has_value()) {
+        errors.push_back(Failure(step, ".endbudget without .budget"));
+        continue;
+      }
+      auto error = CheckBudget(*open, step);
+      if (error.has_value()) {
+        errors.push_back(std::move(*error));
+      }
+      open.reset();
+    }
+  }
+  if (open.has_value()) {
+    errors.push_back(Failure(*open, ".budget without .endbudget"));
+  }
+  return errors;
+}
+
+absl::optional<Error> BudgetChecker::CheckBudget(int begin, int end) {
+  auto budget = steps_[begin].directive->argument.Evaluate();
+  if (!budget.ok()) {
+    return Failure(begin, absl::StrFormat("Cycle budget must be a constant: %s",
+                                          budget.error().message()));
+  }
+  const Region region = {begin + 1, end};
+  const FlagState state = entry_states_[begin];
+  auto worst = Walk(region, begin + 1, state);
+  if (!worst.ok()) {
+    return Failure(begin,
+                   absl::StrFormat("Cycle budget of %d cannot be checked: %s",
+                                   *budget, worst.error().message()));
+  }
+  if (*worst > *budget) {
+    return Failure(begin,
+                   absl::StrFormat("Cycle budget of %d exceeded: worst case "
+                                   "is %d cycles, along %s",
+                                   *budget, *worst,
+                                   DescribePath(region, begin + 1, state)));
+  }
+  return absl::nullopt;
+}
+
+void BudgetChecker::Frame::Add(int cycles) {
+  const Child& child = children[next++];
+  if (calls && next == 1) {
+    node.call_cycles = cycles;
+    node.step_cycles = AddCycles(node.step_cycles, cycles);
+    node.cycles = node.step_cycles;
+  } else if (cycles > worst) {
+    worst = cycles;
+    node.next = child.step;
+    node.next_state = child.state;
+    node.cycles = AddCycles(node.step_cycles, cycles);
+  }
+}
+
+ErrorOr<int> BudgetChecker::Walk(const Region& region, int step,
+                                 const FlagState& state) {
+  std::vector<Frame> stack;
+  // Forgets the unfinished steps on the stack, so that a later walk through
+  // them is not mistaken for a loop.
+  auto abandon = [&](Error error) {
+    for (const Frame& frame : stack) {
+      nodes_.erase(frame.key);
+    }
+    return error;
+  };
+
+  auto known = Start({region, step, state}, &stack);
+  NSASM_RETURN_IF_ERROR(known);
+  if (known->has_value()) {
+    return **known;
+  }
+  while (true) {
+    Frame& frame = stack.back();
+    if (frame.next < frame.child_count) {
+      // Start() may grow the stack, and so invalidate `frame`.
+      const Child child = frame.children[frame.next];
+      auto cycles = Start(child, &stack);
+      if (!cycles.ok()) {
+        return abandon(cycles.error());
+      }
+      if (cycles->has_value()) {
+        stack.back().Add(**cycles);
+      }
+      continue;
+    }
+    frame.node.done = true;
+    const int cycles = frame.node.cycles;
+    nodes_[frame.key] = std::move(frame.node);
+    stack.pop_back();
+    if (stack.empty()) {
+      return cycles;
+    }
+    stack.back().Add(cycles);
+  }
+}
+
+ErrorOr<absl::optional<int>> BudgetChecker::Start(const Child& child,
+                                                  std::vector<Frame>* stack) {
+  if (child.step < child.region.begin || child.step >= child.region.end) {
+    return absl::optional<int>(0);
+  }
+  const Key key(child.region.begin, child.region.end, child.step,
+                child.state.Pack());
+  auto it = nodes_.find(key);
+  if (it != nodes_.end()) {
+    if (!it->second.done) {
+      return Error("the loop through line %d has no bound",
+                   steps_[child.step].line);
+    }
+    return absl::optional<int>(it->second.cycles);
+  }
+  auto frame = Enter(child.region, child.step, child.state);
+  NSASM_RETURN_IF_ERROR(frame);
+  frame->key = key;
+  nodes_.emplace(key, Node());
+  stack->push_back(std::move(*frame));
+  return absl::optional<int>();
+}
+
+ErrorOr<BudgetChecker::Frame> BudgetChecker::Enter(const Region& region,
+                                                   int step,
+                                                   const FlagState& state) {
+  Frame frame;
+  Node& node = frame.node;
+  // Successors are a step (outside the region if the path leaves it), and
+  // the state on entry to it.
+  auto add_child = [&](const Region& child_region, int child_step,
+                       const FlagState& child_state) {
+    frame.children[frame.child_count++] = {child_region, child_step,
+                                           child_state};
+  };
+
+  const Step& current = steps_[step];
+  if (current.directive) {
+    add_child(region, step + 1, StatementExitState(state, *current.statement));
+  } else {
+    const Instruction& instruction = *current.instruction;
+    const Mnemonic mnemonic = instruction.mnemonic;
+    node.step_cycles = InstructionCycles(0, instruction, state).max;
+    if (IsCall(mnemonic)) {
+      auto target = Target(instruction);
+      if (!target.has_value()) {
+        return Error("the call at line %d is not to a label in this file",
+                     current.line);
+      }
+      frame.calls = true;
+      node.callee = *instruction.arg1.SimpleIdentifier();
+      add_child({0, static_cast<int>(steps_.size())}, *target, state);
+      add_child(region, step + 1, ReturnState(*target, state));
+    } else if (IsJump(mnemonic) || IsConditionalBranch(instruction)) {
+      auto target = Target(instruction);
+      if (!target.has_value()) {
+        return Error("the %s at line %d is not to a label in this file",
+                     IsJump(mnemonic) ? "jump" : "branch", current.line);
+      }
+      add_child(region, *target,
+                IsJump(mnemonic) ? state.Execute(instruction)
+                                 : state.ExecuteBranch(instruction));
+      if (!IsJump(mnemonic)) {
+        add_child(region, step + 1, state.Execute(instruction));
+      }
+    } else if (!IsReturn(mnemonic)) {
+      add_child(region, step + 1, state.Execute(instruction));
+    }
+  }
+  node.cycles = node.step_cycles;
+  return frame;
+}
+
+FlagState BudgetChecker::ReturnState(int step, const FlagState& state) {
+  const FlagState unknown(state.EBit(), B_unknown, B_unknown);
+  const std::pair<int, uint16_t> key(step, state.Pack());
+  auto it = return_states_.find(key);
+  if (it != return_states_.end()) {
+    // A recursive call's return state is unknown until the walk is done.
+    return it->second.value_or(unknown);
+  }
+  return_states_.emplace(key, absl::nullopt);
+
+  // Flag states are merged over every path from `step`, as in
+  // EliminateRedundantModeSwitches().
+  absl::optional<FlagState> result;
+  std::vector<absl::optional<FlagState>> states(steps_.size());
+  std::vector<int> worklist;
+  auto merge = [&](int next, const FlagState& next_state) {
+    if (next >= static_cast<int>(steps_.size())) {
+      return;
+    }
+    absl::optional<FlagState>& entry = states[next];
+    const FlagState merged = entry.has_value() ? (*entry | next_state)
+                                               : next_state;
+    if (!entry.has_value() || *entry != merged) {
+      entry = merged;
+      worklist.push_back(next);
+    }
+  };
+  merge(step, state);
+  while (!worklist.empty()) {
+    const int current = worklist.back();
+    worklist.pop_back();
+    const FlagState current_state = *states[current];
+    const Step& current_step = steps_[current];
+    if (current_step.directive) {
+      merge(current + 1,
+            StatementExitState(current_state, *current_step.statement));
+      continue;
+    }
+    const Instruction& instruction = *current_step.instruction;
+    const Mnemonic mnemonic = instruction.mnemonic;
+    if (IsReturn(mnemonic)) {
+      if (mnemonic != M_stp) {
+        result = result.has_value() ? (*result | current_state)
+                                    : current_state;
+      }
+      continue;
+    }
+    auto target = Target(instruction);
+    if (IsCall(mnemonic)) {
+      merge(current + 1, target.has_value()
+                             ? ReturnState(*target, current_state)
+                             : FlagState(current_state.EBit(), B_unknown,
+                                         B_unknown));
+      continue;
+    }
+    if (IsJump(mnemonic) || IsConditionalBranch(instruction)) {
+      if (!target.has_value()) {
+        // Control goes somewhere unknown, and may return from there.
+        result = unknown;
+        break;
+      }
+      merge(*target, IsJump(mnemonic) ? current_state.Execute(instruction)
+                                      : current_state.ExecuteBranch(
+                                            instruction));
+      if (IsJump(mnemonic)) {
+        continue;
+      }
+    }
+    merge(current + 1, current_state.Execute(instruction));
+  }
+
+  const FlagState return_state = result.value_or(unknown);
+  return_states_[key] = return_state;
+  return return_state;
+}
+
+absl::optional<int> BudgetChecker::Target(
+    const Instruction& instruction) const {
+  auto label = instruction.arg1.SimpleIdentifier();
+  if (!label.has_value()) {
+    return absl::nullopt;
+  }
+  auto it = labels_.find(*label);
+  if (it == labels_.end()) {
+    return absl::nullopt;
+  }
+  return it->second;
+}
+
+std::string BudgetChecker::DescribePath(const Region& region, int step,
+                                        FlagState state) const {
+  // Runs of consecutive steps, and the cycles of each.
+  std::vector<std::pair<int, int>> runs;
+  std::vector<int> run_cycles;
+  std::string calls;
+  while (step >= region.begin && step < region.end) {
+    const Node& node =
+        nodes_.at(Key(region.begin, region.end, step, state.Pack()));
+    if (runs.empty() || step != runs.back().second + 1) {
+      runs.push_back({step, step});
+      run_cycles.push_back(0);
+    }
+    runs.back().second = step;
+    run_cycles.back() = AddCycles(run_cycles.back(), node.step_cycles);
+    if (!node.callee.empty()) {
+      absl::StrAppendFormat(&calls, ", calling %s at line %d (%d cycles)",
+                            node.callee, steps_[step].line, node.call_cycles);
+    }
+    step = node.next;
+    state = node.next_state;
+  }
+
+  std::string result = runs.size() == 1 && steps_[runs[0].first].line ==
+                                               steps_[runs[0].second].line
+                           ? "line "
+                           : "lines ";
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const int first_line = steps_[runs[i].first].line;
+    const int last_line = steps_[runs[i].second].line;
+    if (i > 0) {
+      result.append(", ");
+    }
+    if (first_line == last_line) {
+      absl::StrAppendFormat(&result, "%d", first_line);
+    } else {
+      absl::StrAppendFormat(&result, "%d-%d", first_line, last_line);
+    }
+    absl::StrAppendFormat(&result, " (%d cycles)", run_cycles[i]);
+  }
+  result.append(calls);
+  return result;
+}
+
+}  // namespace
+
+std::vector<Error> CheckCycleBudgets(
+    const std::string& path,
+    const std::vector<std::vector<Statement>>& lines) {
+  // Most sources assert no budgets; skip the analysis for them.
+  bool has_budgets = false;
+  for (const auto& line : lines) {
+    for (const Statement& statement : line) {
+      if (absl::holds_alternative<Directive>(statement)) {
+        const DirectiveName name = absl::get<Directive>(statement).name;
+        has_budgets |= (name == D_budget || name == D_endbudget);
+      }
+    }
+  }
+  if (!has_budgets) {
+    return {};
+  }
+  return BudgetChecker(path, lines).Check();
+}
+
+}  // namespace nsasm
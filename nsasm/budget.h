@@ -0,0 +1,46 @@
+#ifndef NSASM_BUDGET_H_
+#define NSASM_BUDGET_H_
+
+#include <string>
+#include <vector>
+
+#include "nsasm/error.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+// Checks the cycle budgets asserted in assembly source.
+//
+// A budget brackets a region of source, and asserts that no path through it
+// takes more than the given number of cycles:
+//
+//   .budget 2000
+//   nmi:  REP #$20
+//         ...
+//   .endbudget
+//
+// A path starts at the `.budget` directive, in the flag state inferred there
+// from straight-line code (see StatementExitState()), and ends when it reaches
+// `.endbudget`, returns, or branches or jumps to a label outside the region.
+// Flag states are followed along each path, so a `REP #$20` prices the
+// instructions after it as 16-bit.  Calls (JSR and JSL) to labels in the same
+// source add the worst case of the called subroutine, up to its return, and
+// the path goes on in the merged state of the subroutine's returns; so a
+// subroutine that returns in 16-bit mode prices its caller as 16-bit, too.
+// Instructions are priced with the upper bound of InstructionCycles().
+//
+// `lines` holds the statements of each line, with `lines[i]` holding line
+// i + 1.  Returns an error, located at the `.budget` line, for each budget
+// that is exceeded, giving the lines of the most expensive path; and for
+// each budget that cannot be checked, because a path through it loops, or
+// calls a subroutine, or branches or jumps to an address, not labelled in
+// `lines`.  An indirect jump, such as a jump table dispatch, thus makes a
+// budget unchecked rather than ending the path.  Returns an error for each
+// unmatched `.budget` or `.endbudget`, too.
+std::vector<Error> CheckCycleBudgets(
+    const std::string& path,
+    const std::vector<std::vector<Statement>>& lines);
+
+}  // namespace nsasm
+
+#endif  // NSASM_BUDGET_H_
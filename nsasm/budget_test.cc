@@ -0,0 +1,158 @@
+#include "nsasm/budget.h"
+
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nsasm/workspace.h"
+
+using ::testing::HasSubstr;
+
+namespace nsasm {
+namespace {
+
+// Returns the error messages from assembling `text`, one per line.
+std::string Errors(const std::string& text) {
+  SourceFile source = ParseSource("test.s", text);
+  std::string result;
+  for (const Error& error : source.errors) {
+    absl::StrAppendFormat(&result, "%d: %s\n", error.location().offset,
+                          error.message());
+  }
+  return result;
+}
+
+TEST(CheckCycleBudgets, width_changes_are_priced) {
+  const std::string prefix =
+      ".mode m8x8\n"
+      ".budget 12\n"
+      "nmi: LDA $1234\n"
+      "  STA $2100\n";
+  EXPECT_EQ(Errors(prefix + ".endbudget\n"), "");
+  EXPECT_EQ(Errors(prefix +
+                   "  REP #$20\n"
+                   "  LDA $1234\n"
+                   ".endbudget\n"),
+            "2: Cycle budget of 12 exceeded: worst case is 16 cycles, along "
+            "lines 3-6 (16 cycles)\n");
+}
+
+TEST(CheckCycleBudgets, worst_path) {
+  EXPECT_EQ(Errors(".mode m8x8\n"
+                   ".budget 12\n"
+                   "  BEQ slow\n"
+                   "  RTS\n"
+                   "slow: REP #$20\n"
+                   "  LDA $1234\n"
+                   "  RTS\n"
+                   ".endbudget\n"),
+            "2: Cycle budget of 12 exceeded: worst case is 17 cycles, along "
+            "lines 3 (3 cycles), 5-7 (14 cycles)\n");
+
+  // Branches out of the region end the path.
+  EXPECT_EQ(Errors(".mode m8x8\n"
+                   ".budget 3\n"
+                   "  BEQ elsewhere\n"
+                   ".endbudget\n"
+                   "elsewhere: LDA $1234\n"),
+            "");
+}
+
+// Returns the errors from checking the budgets in `text`, with a call to the
+// subroutine `wait` added to its (otherwise empty) line 3.
+std::string CallErrors(const std::string& text) {
+  SourceFile source = ParseSource("test.s", text);
+  EXPECT_TRUE(source.errors.empty());
+  // The assembler requires an explicitly sized address, so it cannot take
+  // `JSR wait` yet; add the call by hand.
+  source.lines[2].push_back(Instruction{
+      M_jsr, A_dir_w, ExpressionOrNull(absl::make_unique<Identifier>("wait")),
+      ExpressionOrNull()});
+  std::string result;
+  for (const Error& error : CheckCycleBudgets("test.s", source.lines)) {
+    absl::StrAppendFormat(&result, "%d: %s\n", error.location().offset,
+                          error.message());
+  }
+  return result;
+}
+
+TEST(CheckCycleBudgets, calls) {
+  auto nop_call = [](const std::string& budget) {
+    return CallErrors(".mode m8x8\n"
+                      ".budget " + budget + "\n"
+                      "\n"
+                      "  NOP\n"
+                      ".endbudget\n"
+                      "  RTS\n"
+                      "wait: NOP\n"
+                      "  RTS\n");
+  };
+  EXPECT_EQ(nop_call("16"), "");
+  EXPECT_EQ(nop_call("15"),
+            "2: Cycle budget of 15 exceeded: worst case is 16 cycles, along "
+            "lines 3-4 (16 cycles), calling wait at line 3 (8 cycles)\n");
+
+  // The caller goes on in the state the subroutine returns in.
+  EXPECT_EQ(CallErrors(".mode m8x8\n"
+                       ".budget 19\n"
+                       "\n"
+                       "  LDA $1234\n"
+                       ".endbudget\n"
+                       "  RTS\n"
+                       "wait: REP #$20\n"
+                       "  RTS\n"),
+            "2: Cycle budget of 19 exceeded: worst case is 20 cycles, along "
+            "lines 3-4 (20 cycles), calling wait at line 3 (9 cycles)\n");
+
+  EXPECT_THAT(Errors(".budget 100\n"
+                     "  JSL $808000\n"
+                     ".endbudget\n"),
+              HasSubstr("1: Cycle budget of 100 cannot be checked: the call "
+                        "at line 2 is not to a label in this file"));
+}
+
+TEST(CheckCycleBudgets, indirect_jumps) {
+  EXPECT_THAT(Errors(".mode m8x8\n"
+                     ".budget 100\n"
+                     "  JMP ($1234,X)\n"
+                     ".endbudget\n"),
+              HasSubstr("2: Cycle budget of 100 cannot be checked: the jump "
+                        "at line 3 is not to a label in this file"));
+}
+
+TEST(CheckCycleBudgets, long_regions) {
+  std::string nops;
+  for (int i = 0; i < 50000; ++i) {
+    nops.append("  NOP\n");
+  }
+  EXPECT_EQ(Errors(".mode m8x8\n"
+                   ".budget 99999\n" +
+                   nops + ".endbudget\n"),
+            "2: Cycle budget of 99999 exceeded: worst case is 100000 cycles, "
+            "along lines 3-50002 (100000 cycles)\n");
+}
+
+TEST(CheckCycleBudgets, unchecked_budgets) {
+  EXPECT_EQ(Errors(".mode m8x8\n"
+                   ".budget 100\n"
+                   "loop: DEX\n"
+                   "  BNE loop\n"
+                   ".endbudget\n"),
+            "2: Cycle budget of 100 cannot be checked: the loop through line "
+            "3 has no bound\n");
+
+  EXPECT_EQ(Errors(".budget 10\n"
+                   "  NOP\n"
+                   ".budget 10\n"
+                   ".endbudget\n"
+                   ".endbudget\n"),
+            "1: .budget without .endbudget\n"
+            "5: .endbudget without .budget\n");
+  EXPECT_THAT(Errors(".budget label\n.endbudget\n"),
+              HasSubstr("1: Cycle budget must be a constant"));
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,354 @@
+#include "nsasm/cfg.h"
+
+#include <algorithm>
+#include <set>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/optional.h"
+
+namespace nsasm {
+
+ControlFlowGraph ControlFlowGraph::Build(
+    const Rom& rom, const Disassembly& disassembly,
+    const std::vector<EntryPoint>& entry_points) {
+  ControlFlowGraph graph;
+
+  // Find every edge out of every instruction, and count the edges into each.
+  std::vector<std::vector<ControlEdge>> edges;
+  edges.reserve(disassembly.size());
+  absl::flat_hash_map<int, int> incoming;
+  for (const auto& node : disassembly) {
+    edges.push_back(ControlEdges(rom, node.first, node.second.instruction));
+    for (const ControlEdge& edge : edges.back()) {
+      ++incoming[edge.target];
+    }
+  }
+  absl::flat_hash_map<int, bool> is_entry;
+  for (const EntryPoint& entry_point : entry_points) {
+    is_entry[entry_point.address] = true;
+  }
+
+  // An instruction continues the block before it only if it is reached by
+  // nothing but a fallthrough from the instruction just before it, and that
+  // instruction can go nowhere else.
+  std::vector<bool> starts_block;
+  starts_block.reserve(disassembly.size());
+  {
+    int index = 0;
+    for (const auto& node : disassembly) {
+      const int pc = node.first;
+      bool continues = index > 0 && !is_entry.count(pc) &&
+                       incoming[pc] == 1 && edges[index - 1].size() == 1 &&
+                       edges[index - 1][0].kind == E_fallthrough &&
+                       edges[index - 1][0].target == pc;
+      starts_block.push_back(!continues);
+      ++index;
+    }
+  }
+
+  // Form the blocks, and record each block's transfer instructions.
+  absl::flat_hash_map<int, int> block_at;
+  std::vector<int> last_index;  // per block, the index of its last instruction
+  graph.transfer_offsets_.push_back(0);
+  {
+    int index = 0;
+    const Instruction* previous = nullptr;
+    for (const auto& node : disassembly) {
+      if (starts_block[index]) {
+        if (previous) {
+          graph.last_instructions_.push_back(*previous);
+          graph.transfer_offsets_.push_back(
+              graph.transfer_instructions_.size());
+        }
+        block_at[node.first] = graph.blocks_.size();
+        graph.blocks_.push_back({node.first, node.first, 0});
+        last_index.push_back(index);
+      } else if (FlagState::AffectsFlagState(*previous)) {
+        graph.transfer_instructions_.push_back(*previous);
+      }
+      BasicBlock& block = graph.blocks_.back();
+      block.last_address = node.first;
+      ++block.instruction_count;
+      last_index.back() = index;
+      previous = &node.second.instruction;
+      ++index;
+    }
+    if (previous) {
+      graph.last_instructions_.push_back(*previous);
+      graph.transfer_offsets_.push_back(graph.transfer_instructions_.size());
+    }
+  }
+
+  // Edges between blocks, in compressed row form.
+  const int block_count = graph.blocks_.size();
+  std::vector<int> predecessor_counts(block_count, 0);
+  graph.successor_offsets_.push_back(0);
+  for (int block = 0; block < block_count; ++block) {
+    for (const ControlEdge& edge : edges[last_index[block]]) {
+      auto target = block_at.find(edge.target);
+      if (target == block_at.end()) {
+        continue;
+      }
+      graph.successors_.push_back({target->second, edge.kind});
+      ++predecessor_counts[target->second];
+    }
+    graph.successor_offsets_.push_back(graph.successors_.size());
+  }
+  graph.predecessor_offsets_.push_back(0);
+  for (int block = 0; block < block_count; ++block) {
+    graph.predecessor_offsets_.push_back(graph.predecessor_offsets_.back() +
+                                         predecessor_counts[block]);
+  }
+  graph.predecessors_.resize(graph.successors_.size());
+  std::vector<int> fill(graph.predecessor_offsets_.begin(),
+                        graph.predecessor_offsets_.end() - 1);
+  for (int block = 0; block < block_count; ++block) {
+    for (const BlockEdge& edge : graph.Successors(block)) {
+      graph.predecessors_[fill[edge.block]++] = {block, edge.kind};
+    }
+  }
+
+  for (const EntryPoint& entry_point : entry_points) {
+    auto block = block_at.find(entry_point.address);
+    if (block != block_at.end()) {
+      graph.entries_.emplace_back(block->second, entry_point.flag_state);
+    }
+  }
+
+  graph.ComputeReversePostorder();
+  graph.ComputeDominators();
+  graph.ComputeLoops();
+  return graph;
+}
+
+int ControlFlowGraph::BlockAt(int address) const {
+  auto it = std::lower_bound(
+      blocks_.begin(), blocks_.end(), address,
+      [](const BasicBlock& block, int a) { return block.first_address < a; });
+  if (it == blocks_.end() || it->first_address != address) {
+    return -1;
+  }
+  return it - blocks_.begin();
+}
+
+void ControlFlowGraph::ComputeReversePostorder() {
+  const int block_count = blocks_.size();
+  std::vector<bool> visited(block_count, false);
+  std::vector<int> postorder;
+  postorder.reserve(block_count);
+
+  // Iterative depth-first search.  Each stack entry is a block and the index
+  // of the next successor to visit.
+  std::vector<std::pair<int, int>> stack;
+  auto search_from = [&](int root) {
+    if (visited[root]) {
+      return;
+    }
+    visited[root] = true;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+      int block = stack.back().first;
+      int& next = stack.back().second;
+      absl::Span<const BlockEdge> successors = Successors(block);
+      if (next < int(successors.size())) {
+        int successor = successors[next++].block;
+        if (!visited[successor]) {
+          visited[successor] = true;
+          stack.emplace_back(successor, 0);
+        }
+      } else {
+        postorder.push_back(block);
+        stack.pop_back();
+      }
+    }
+  };
+  for (const auto& entry : entries_) {
+    search_from(entry.first);
+  }
+  // Blocks not reachable from the given entry points still get an order.
+  for (int block = 0; block < block_count; ++block) {
+    search_from(block);
+  }
+
+  reverse_postorder_.assign(postorder.rbegin(), postorder.rend());
+  rpo_numbers_.assign(block_count, 0);
+  for (int i = 0; i < block_count; ++i) {
+    rpo_numbers_[reverse_postorder_[i]] = i;
+  }
+}
+
+std::vector<FlagState> ControlFlowGraph::PropagateFlagStates(
+    SubroutineSummaries* summaries) const {
+  const int block_count = blocks_.size();
+  std::vector<absl::optional<FlagState>> states(block_count);
+
+  // Blocks to visit, by reverse postorder number.
+  std::set<int> worklist;
+  auto merge = [&](int block, const FlagState& state) {
+    absl::optional<FlagState>& current = states[block];
+    if (current.has_value()) {
+      FlagState merged = *current | state;
+      if (merged == *current) {
+        return;
+      }
+      current = merged;
+    } else {
+      current = state;
+    }
+    worklist.insert(rpo_numbers_[block]);
+  };
+  for (const auto& entry : entries_) {
+    merge(entry.first, entry.second);
+  }
+
+  while (!worklist.empty()) {
+    int block = reverse_postorder_[*worklist.begin()];
+    worklist.erase(worklist.begin());
+
+    FlagState state = *states[block];
+    for (int i = transfer_offsets_[block]; i < transfer_offsets_[block + 1];
+         ++i) {
+      state = state.Execute(transfer_instructions_[i]);
+    }
+    const Instruction& last = last_instructions_[block];
+    absl::Span<const BlockEdge> successors = Successors(block);
+    for (const BlockEdge& edge : successors) {
+      switch (edge.kind) {
+        case E_fallthrough:
+          merge(edge.block, state.Execute(last));
+          break;
+        case E_branch:
+          merge(edge.block, state.ExecuteBranch(last));
+          break;
+        case E_call:
+          merge(edge.block, state);
+          break;
+        case E_return: {
+          absl::optional<FlagState> return_state;
+          for (const BlockEdge& call : successors) {
+            if (call.kind == E_call && summaries) {
+              return_state = summaries->ReturnState(
+                  blocks_[call.block].first_address, state);
+            }
+          }
+          merge(edge.block, return_state.has_value() ? *return_state
+                                                     : state.Execute(last));
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<FlagState> result;
+  result.reserve(block_count);
+  for (const auto& state : states) {
+    result.push_back(state.has_value() ? *state
+                                       : FlagState(B_unknown, B_unknown,
+                                                   B_unknown));
+  }
+  return result;
+}
+
+void ControlFlowGraph::ComputeDominators() {
+  // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".  Entry
+  // blocks hang off a virtual root, numbered -1.
+  constexpr int kUndefined = -2;
+  const int block_count = blocks_.size();
+  idoms_.assign(block_count, kUndefined);
+  for (const auto& entry : entries_) {
+    idoms_[entry.first] = -1;
+  }
+  auto rpo_number = [this](int block) {
+    return block < 0 ? -1 : rpo_numbers_[block];
+  };
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (rpo_number(a) > rpo_number(b)) {
+        a = idoms_[a];
+      }
+      while (rpo_number(b) > rpo_number(a)) {
+        b = idoms_[b];
+      }
+    }
+    return a;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int block : reverse_postorder_) {
+      if (idoms_[block] == -1) {
+        continue;
+      }
+      int new_idom = kUndefined;
+      for (const BlockEdge& edge : Predecessors(block)) {
+        if (idoms_[edge.block] == kUndefined) {
+          continue;
+        }
+        new_idom = new_idom == kUndefined ? edge.block
+                                          : intersect(edge.block, new_idom);
+      }
+      if (new_idom == kUndefined) {
+        // Unreachable from the entry points.
+        new_idom = -1;
+      }
+      if (idoms_[block] != new_idom) {
+        idoms_[block] = new_idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+bool ControlFlowGraph::Dominates(int dominator, int block) const {
+  for (int b = block; b >= 0; b = idoms_[b]) {
+    if (b == dominator) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ControlFlowGraph::ComputeLoops() {
+  const int block_count = blocks_.size();
+  // The header whose loop body is being collected, per block, so the marks
+  // need no clearing between headers.
+  std::vector<int> mark(block_count, -1);
+  for (int header = 0; header < block_count; ++header) {
+    // The header is marked first, so that the walk stops there; in
+    // particular, a self-loop's back edge adds nothing to walk.
+    mark[header] = header;
+    bool has_back_edge = false;
+    std::vector<int> stack;
+    for (const BlockEdge& edge : Predecessors(header)) {
+      if (Dominates(header, edge.block)) {
+        has_back_edge = true;
+        if (mark[edge.block] != header) {
+          mark[edge.block] = header;
+          stack.push_back(edge.block);
+        }
+      }
+    }
+    if (!has_back_edge) {
+      continue;
+    }
+    Loop loop;
+    loop.header = header;
+    loop.blocks.push_back(header);
+    while (!stack.empty()) {
+      int block = stack.back();
+      stack.pop_back();
+      loop.blocks.push_back(block);
+      for (const BlockEdge& edge : Predecessors(block)) {
+        if (mark[edge.block] != header) {
+          mark[edge.block] = header;
+          stack.push_back(edge.block);
+        }
+      }
+    }
+    std::sort(loop.blocks.begin(), loop.blocks.end());
+    loops_.push_back(std::move(loop));
+  }
+}
+
+}  // namespace nsasm
@@ -0,0 +1,123 @@
+#ifndef NSASM_CFG_H_
+#define NSASM_CFG_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/instruction.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+// A maximal run of instructions with a single entry at the top and a single
+// exit at the bottom.
+struct BasicBlock {
+  // Address of the first and last instructions in the block.
+  int first_address;
+  int last_address;
+  int instruction_count;
+};
+
+// An edge between two basic blocks, identified by block index.
+struct BlockEdge {
+  int block;
+  EdgeKind kind;
+};
+
+// A natural loop: the blocks that can reach a back edge to `header` without
+// passing through `header`.
+struct Loop {
+  int header;
+  // Sorted block indices, including `header`.
+  std::vector<int> blocks;
+};
+
+// Control flow graph over the basic blocks of a disassembly.
+//
+// Blocks are numbered in address order.  Edge lists are stored contiguously,
+// and are returned as spans.
+class ControlFlowGraph {
+ public:
+  // Builds the graph for `disassembly`, which must have been disassembled from
+  // `entry_points`.
+  static ControlFlowGraph Build(const Rom& rom, const Disassembly& disassembly,
+                                const std::vector<EntryPoint>& entry_points);
+
+  int BlockCount() const { return blocks_.size(); }
+  const BasicBlock& Block(int block) const { return blocks_[block]; }
+
+  // Returns the index of the block starting at `address`, or -1 if no block
+  // starts there.
+  int BlockAt(int address) const;
+
+  absl::Span<const BlockEdge> Successors(int block) const {
+    return absl::MakeConstSpan(successors_.data() + successor_offsets_[block],
+                               successor_offsets_[block + 1] -
+                                   successor_offsets_[block]);
+  }
+  absl::Span<const BlockEdge> Predecessors(int block) const {
+    return absl::MakeConstSpan(
+        predecessors_.data() + predecessor_offsets_[block],
+        predecessor_offsets_[block + 1] - predecessor_offsets_[block]);
+  }
+
+  // The entry blocks, with their incoming flag states.
+  const std::vector<std::pair<int, FlagState>>& Entries() const {
+    return entries_;
+  }
+
+  // Blocks in reverse postorder from the entry points.
+  const std::vector<int>& ReversePostorder() const {
+    return reverse_postorder_;
+  }
+
+  // Returns the incoming flag state of every block, propagated block by block
+  // in reverse postorder.  Each block applies only its flag-affecting
+  // instructions.  Calls continue in the state given by `summaries`, as in
+  // `Disassemble()`.
+  std::vector<FlagState> PropagateFlagStates(
+      SubroutineSummaries* summaries) const;
+
+  // Returns the immediate dominator of `block`, or -1 for blocks dominated
+  // only by the (virtual) root above the entry points.
+  int ImmediateDominator(int block) const { return idoms_[block]; }
+  bool Dominates(int dominator, int block) const;
+
+  // Natural loops, sorted by header.  Loops sharing a header are merged.
+  const std::vector<Loop>& Loops() const { return loops_; }
+
+ private:
+  ControlFlowGraph() = default;
+
+  void ComputeReversePostorder();
+  void ComputeDominators();
+  void ComputeLoops();
+
+  std::vector<BasicBlock> blocks_;
+  std::vector<BlockEdge> successors_;
+  std::vector<int> successor_offsets_;
+  std::vector<BlockEdge> predecessors_;
+  std::vector<int> predecessor_offsets_;
+
+  std::vector<std::pair<int, FlagState>> entries_;
+
+  // Per block: the flag-affecting instructions, other than the last, and the
+  // last instruction (which decides the state along each outgoing edge.)
+  std::vector<Instruction> transfer_instructions_;
+  std::vector<int> transfer_offsets_;
+  std::vector<Instruction> last_instructions_;
+
+  std::vector<int> reverse_postorder_;
+  // Position of each block in `reverse_postorder_`.
+  std::vector<int> rpo_numbers_;
+  std::vector<int> idoms_;
+  std::vector<Loop> loops_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_CFG_H_
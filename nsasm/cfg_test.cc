@@ -0,0 +1,93 @@
+#include "nsasm/cfg.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+TEST(ControlFlowGraph, blocks_and_edges) {
+  Rom rom = MakeRom({
+      0xc2, 0x10,        // 8000: REP #$10       block 0
+      0xa2, 0x00, 0x01,  // 8002: LDX #$0100
+      0xca,              // 8005: DEX            block 1 (loop header)
+      0x20, 0x10, 0x80,  // 8006: JSR $8010
+      0xd0, 0xfa,        // 8009: BNE $8005      block 2
+      0x60,              // 800b: RTS            block 3
+      0, 0, 0, 0,        // 800c
+      0xe2, 0x20,        // 8010: SEP #$20       block 4
+      0x60,              // 8012: RTS
+  });
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_off, B_on)}};
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  ControlFlowGraph graph =
+      ControlFlowGraph::Build(rom, *disassembly, entry_points);
+
+  ASSERT_EQ(graph.BlockCount(), 5);
+  EXPECT_EQ(graph.Block(0).first_address, 0x8000);
+  EXPECT_EQ(graph.Block(0).last_address, 0x8002);
+  EXPECT_EQ(graph.Block(1).first_address, 0x8005);
+  EXPECT_EQ(graph.Block(1).instruction_count, 2);
+  EXPECT_EQ(graph.BlockAt(0x8009), 2);
+  EXPECT_EQ(graph.BlockAt(0x8006), -1);
+
+  auto successors = graph.Successors(1);
+  ASSERT_EQ(successors.size(), 2);
+  EXPECT_EQ(successors[0].block, 4);
+  EXPECT_EQ(successors[0].kind, E_call);
+  EXPECT_EQ(successors[1].block, 2);
+  EXPECT_EQ(successors[1].kind, E_return);
+  EXPECT_EQ(graph.Predecessors(1).size(), 2);  // fallthrough and back edge
+
+  EXPECT_EQ(graph.ReversePostorder().front(), 0);
+  EXPECT_EQ(graph.ImmediateDominator(0), -1);
+  EXPECT_EQ(graph.ImmediateDominator(2), 1);
+  EXPECT_EQ(graph.ImmediateDominator(3), 2);
+  EXPECT_TRUE(graph.Dominates(1, 3));
+  EXPECT_FALSE(graph.Dominates(2, 1));
+
+  ASSERT_EQ(graph.Loops().size(), 1);
+  EXPECT_EQ(graph.Loops()[0].header, 1);
+  EXPECT_EQ(graph.Loops()[0].blocks, std::vector<int>({1, 2}));
+
+  // Block-level propagation agrees with the disassembly.
+  SubroutineSummaries summaries(rom);
+  std::vector<FlagState> states = graph.PropagateFlagStates(&summaries);
+  ASSERT_EQ(states.size(), 5);
+  for (int block = 0; block < graph.BlockCount(); ++block) {
+    SCOPED_TRACE(block);
+    EXPECT_EQ(
+        states[block].ToString(),
+        disassembly->at(graph.Block(block).first_address)
+            .current_flag_state.ToString());
+  }
+  EXPECT_EQ(states[2].ToName(), "m8x16");
+}
+
+TEST(ControlFlowGraph, self_loop) {
+  Rom rom = MakeRom({
+      0xa2, 0x05,  // 8000: LDX #$05       block 0
+      0xca,        // 8002: DEX            block 1 (loop header)
+      0xd0, 0xfd,  // 8003: BNE $8002
+      0x60,        // 8005: RTS            block 2
+  });
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)}};
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  ControlFlowGraph graph =
+      ControlFlowGraph::Build(rom, *disassembly, entry_points);
+
+  ASSERT_EQ(graph.BlockCount(), 3);
+  ASSERT_EQ(graph.Loops().size(), 1);
+  EXPECT_EQ(graph.Loops()[0].header, 1);
+  EXPECT_EQ(graph.Loops()[0].blocks, std::vector<int>({1}));
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,236 @@
+#include "nsasm/classify.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "nsasm/addressing_mode.h"
+
+namespace nsasm {
+
+namespace {
+
+// Tuning constants.
+constexpr int kMinTableEntries = 4;  // shortest pointer table recognized
+constexpr int kMinFillRun = 16;      // shortest run of one byte taken as fill
+constexpr int kWindow = 32;          // width of the scoring window
+// Per-byte scores are log-odds in 1/16ths of a nat.
+constexpr int kNonCandidateScore = -32;
+constexpr int kCodeThreshold = 8;
+constexpr int kDataThreshold = -8;
+
+int InstructionBytes(const Instruction& instruction) {
+  int length = InstructionLength(instruction.addressing_mode);
+  if (instruction.mnemonic == PM_add || instruction.mnemonic == PM_sub) {
+    // Folded CLC instruction
+    ++length;
+  }
+  return length;
+}
+
+// Returns the ROM address of the 16-bit pointer `value`, read from ROM address
+// `rom_address` (and so in the same bank), or -1 if it does not point into
+// the same ROM bank.
+int NearPointerTarget(int rom_address, int snes_address, int value,
+                      int bank_size, int rom_size) {
+  const int bank_origin = rom_address - (snes_address & 0xffff);
+  const int bank_start = rom_address - rom_address % bank_size;
+  const int target = bank_origin + value;
+  if (target < bank_start || target >= bank_start + bank_size ||
+      target >= rom_size) {
+    return -1;
+  }
+  return target;
+}
+
+}  // namespace
+
+RomMap RomMap::Classify(const Rom& rom, const Disassembly& reached,
+                        const SupersetDisassembly& superset) {
+  const std::vector<uint8_t>& data = rom.data();
+  const int size = data.size();
+  const Mapping mapping = rom.mapping_mode();
+  const int bank_size = (mapping == kLoRom) ? 0x8000 : 0x10000;
+
+  RomMap map;
+  map.packed_.assign((size + 3) / 4, 0);
+
+  // Reached code.
+  std::vector<bool> is_reached(size, false);
+  std::array<int, 256> code_histogram;
+  code_histogram.fill(1);
+  for (const auto& node : reached) {
+    auto rom_address = SnesToROMAddress(node.first, mapping);
+    if (!rom_address.ok() || *rom_address >= size) {
+      continue;
+    }
+    ++code_histogram[data[*rom_address]];
+    const int length = InstructionBytes(node.second.instruction);
+    for (int i = 0; i < length && *rom_address + i < size; ++i) {
+      is_reached[*rom_address + i] = true;
+    }
+  }
+
+  // Opcode log-odds: how much likelier each byte value is as an opcode in
+  // reached code than as a byte anywhere in the ROM.
+  std::array<int, 256> rom_histogram;
+  rom_histogram.fill(1);
+  for (uint8_t byte : data) {
+    ++rom_histogram[byte];
+  }
+  int64_t code_total = 0;
+  int64_t rom_total = 0;
+  for (int i = 0; i < 256; ++i) {
+    code_total += code_histogram[i];
+    rom_total += rom_histogram[i];
+  }
+  std::array<int8_t, 256> opcode_score;
+  for (int i = 0; i < 256; ++i) {
+    double log_odds = std::log(double(code_histogram[i]) / code_total) -
+                      std::log(double(rom_histogram[i]) / rom_total);
+    opcode_score[i] = int8_t(std::max(-64.0, std::min(63.0, log_odds * 16)));
+  }
+
+  // The single feature sweep.  For each byte: its code score, whether a
+  // 16-bit or 24-bit pointer to a superset candidate starts there, and the
+  // length of the run of identical bytes it begins.
+  std::vector<int8_t> score(size);
+  std::vector<uint8_t> near_pointer(size, 0);
+  std::vector<uint8_t> long_pointer(size, 0);
+  std::vector<int> fill_run(size + 1, 0);
+  for (int i = size - 1; i >= 0; --i) {
+    auto snes_address = ROMToSnesAddress(i, mapping);
+    if (!snes_address.ok()) {
+      score[i] = kNonCandidateScore;
+      continue;
+    }
+    const bool candidate = superset.IsCandidate(*snes_address);
+    score[i] = candidate ? opcode_score[data[i]] : kNonCandidateScore;
+    fill_run[i] = (i + 1 < size && data[i + 1] == data[i]) ? fill_run[i + 1] + 1
+                                                           : 1;
+    if (i + 1 < size) {
+      int target = NearPointerTarget(i, *snes_address,
+                                     data[i] | (data[i + 1] << 8), bank_size,
+                                     size);
+      if (target >= 0) {
+        auto target_snes = ROMToSnesAddress(target, mapping);
+        near_pointer[i] =
+            target_snes.ok() && superset.IsCandidate(*target_snes);
+      }
+    }
+    if (i + 2 < size) {
+      const int bank = data[i + 2];
+      // Cheap check to skip most values that are not ROM addresses
+      bool maybe_rom = (data[i + 1] & 0x80) ||
+                       (mapping != kLoRom && (bank & 0x7f) >= 0x40);
+      if (bank != 0x7e && bank != 0x7f && maybe_rom) {
+        int value = data[i] | (data[i + 1] << 8) | (bank << 16);
+        long_pointer[i] = superset.IsCandidate(value);
+      }
+    }
+  }
+
+  // Combine the features, weakest evidence first.
+  std::vector<int> prefix(size + 1, 0);
+  for (int i = 0; i < size; ++i) {
+    prefix[i + 1] = prefix[i] + score[i];
+  }
+  for (int i = 0; i < size; ++i) {
+    int begin = std::max(0, i - kWindow / 2);
+    int end = std::min(size, i + kWindow / 2);
+    int mean = (prefix[end] - prefix[begin]) / (end - begin);
+    if (mean >= kCodeThreshold) {
+      map.Set(i, BC_code);
+    } else if (mean <= kDataThreshold) {
+      map.Set(i, BC_data);
+    }
+  }
+  for (int i = 0; i < size;) {
+    if (fill_run[i] >= kMinFillRun) {
+      for (int j = 0; j < fill_run[i]; ++j) {
+        map.Set(i + j, BC_data);
+      }
+      i += fill_run[i];
+    } else {
+      ++i;
+    }
+  }
+  auto mark_tables = [&](const std::vector<uint8_t>& is_pointer, int stride) {
+    // Number of consecutive pointers starting at each address
+    std::vector<int> entries(size + stride, 0);
+    for (int i = size - 1; i >= 0; --i) {
+      entries[i] = is_pointer[i] ? entries[i + stride] + 1 : 0;
+    }
+    for (int i = 0; i < size; ++i) {
+      bool table_start = entries[i] >= kMinTableEntries &&
+                         (i < stride || !is_pointer[i - stride]);
+      if (table_start) {
+        for (int j = 0; j < entries[i] * stride; ++j) {
+          map.Set(i + j, BC_pointers);
+        }
+      }
+    }
+  };
+  mark_tables(near_pointer, 2);
+  mark_tables(long_pointer, 3);
+  for (int i = 0; i < size; ++i) {
+    if (is_reached[i]) {
+      map.Set(i, BC_code);
+    }
+  }
+
+  // Runs, and seeds for unreached code.  A run's edges are only approximate,
+  // so each seed is the first superset candidate in its run.
+  bool need_seed = false;
+  for (int i = 0; i < size; ++i) {
+    ByteClass byte_class = map.ClassAt(i);
+    if (map.runs_.empty() || map.runs_.back().byte_class != byte_class) {
+      map.runs_.push_back({i, i + 1, byte_class});
+    } else {
+      map.runs_.back().end = i + 1;
+    }
+    if (byte_class != BC_code || is_reached[i]) {
+      need_seed = false;
+      continue;
+    }
+    if (i == 0 || map.ClassAt(i - 1) != BC_code || is_reached[i - 1]) {
+      need_seed = true;
+    }
+    if (!need_seed) {
+      continue;
+    }
+    auto snes_address = ROMToSnesAddress(i, mapping);
+    int widths = snes_address.ok() ? superset.ValidWidths(*snes_address) : 0;
+    for (int width = 0; width < SupersetDisassembly::kWidthCount; ++width) {
+      if (widths & (1 << width)) {
+        map.code_seeds_.push_back(
+            {*snes_address, SupersetDisassembly::WidthFlagState(width)});
+        need_seed = false;
+        break;
+      }
+    }
+  }
+  return map;
+}
+
+const RomMap::Run& RomMap::RunAt(int rom_address) const {
+  auto it = std::upper_bound(
+      runs_.begin(), runs_.end(), rom_address,
+      [](int address, const Run& run) { return address < run.end; });
+  return *it;
+}
+
+int RomMap::CountInRange(int begin, int end, ByteClass byte_class) const {
+  int count = 0;
+  for (auto it = std::upper_bound(
+           runs_.begin(), runs_.end(), begin,
+           [](int address, const Run& run) { return address < run.end; });
+       it != runs_.end() && it->begin < end; ++it) {
+    if (it->byte_class == byte_class) {
+      count += std::min(end, it->end) - std::max(begin, it->begin);
+    }
+  }
+  return count;
+}
+
+}  // namespace nsasm
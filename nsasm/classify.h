@@ -0,0 +1,82 @@
+#ifndef NSASM_CLASSIFY_H_
+#define NSASM_CLASSIFY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "nsasm/disassemble.h"
+#include "nsasm/rom.h"
+#include "nsasm/superset.h"
+
+namespace nsasm {
+
+// What a ROM byte is believed to hold.
+enum ByteClass : uint8_t {
+  BC_unknown = 0,
+  BC_code,
+  BC_data,
+  BC_pointers,  // a table of 16- or 24-bit pointers into ROM
+};
+
+// A classification of every byte of a ROM, stored at two bits per byte, and
+// as a sorted list of runs for range queries.
+class RomMap {
+ public:
+  // A maximal range [begin, end) of ROM addresses sharing one class.
+  struct Run {
+    int begin;
+    int end;
+    ByteClass byte_class;
+  };
+
+  // Classifies the bytes of `rom`.
+  //
+  // Bytes of instructions in `reached` (normally the result of disassembling
+  // from the ROM's vectors) are code.  Every other byte is classified from
+  // features computed in a single sweep over the ROM:
+  //
+  //   * runs of 16-bit or 24-bit values that are valid ROM addresses pointing
+  //     at `superset` candidates are pointer tables;
+  //   * long runs of a repeated byte are data (fill);
+  //   * otherwise, the bytes in a window around each byte are scored by how
+  //     much more common each is as an opcode in `reached` than in the ROM as
+  //     a whole, and whether it starts a `superset` candidate.  High scores
+  //     are code, low scores data, and the rest unknown.
+  static RomMap Classify(const Rom& rom, const Disassembly& reached,
+                         const SupersetDisassembly& superset);
+
+  ByteClass ClassAt(int rom_address) const {
+    return ByteClass((packed_[rom_address >> 2] >> ((rom_address & 3) * 2)) &
+                     3);
+  }
+
+  const std::vector<Run>& Runs() const { return runs_; }
+
+  // Returns the run containing `rom_address`.
+  const Run& RunAt(int rom_address) const;
+
+  // Returns the number of bytes in [begin, end) with the given class.
+  int CountInRange(int begin, int end, ByteClass byte_class) const;
+
+  // Returns entry points for code found by classification but not reached by
+  // disassembly: the start of each such run, at a width where `superset` has
+  // a candidate there.
+  const std::vector<EntryPoint>& CodeSeeds() const { return code_seeds_; }
+
+ private:
+  RomMap() = default;
+
+  void Set(int rom_address, ByteClass byte_class) {
+    uint8_t& packed = packed_[rom_address >> 2];
+    const int shift = (rom_address & 3) * 2;
+    packed = (packed & ~(3 << shift)) | (byte_class << shift);
+  }
+
+  std::vector<uint8_t> packed_;
+  std::vector<Run> runs_;
+  std::vector<EntryPoint> code_seeds_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_CLASSIFY_H_
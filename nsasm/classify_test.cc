@@ -0,0 +1,78 @@
+#include "nsasm/classify.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+// A short subroutine, used as both reached and unreached code.
+const std::vector<uint8_t> kRoutine = {
+    0xc2, 0x30,              // REP #$30
+    0xa2, 0x10, 0x00,        // LDX #$0010
+    0xbd, 0x00, 0x90,        // LDA $9000,X
+    0x9d, 0x00, 0x02,        // STA $0200,X
+    0xca,                    // DEX
+    0xca,                    // DEX
+    0x10, 0xf6,              // BPL -10
+    0xa9, 0x01, 0x00,        // LDA #$0001
+    0x8d, 0x00, 0x42,        // STA $4200
+    0x18,                    // CLC
+    0x69, 0x34, 0x12,        // ADC #$1234
+    0x8f, 0x00, 0x01, 0x7e,  // STA $7e0100
+    0xe2, 0x30,              // SEP #$30
+    0x6b,                    // RTL
+};
+
+TEST(RomMap, classify) {
+  std::vector<uint8_t> data(0x10000, 0x00);
+  // Reached code at $008000
+  std::copy(kRoutine.begin(), kRoutine.end(), data.begin());
+  // Unreached copies of the routine at $009000
+  for (int i = 0; i < 4; ++i) {
+    std::copy(kRoutine.begin(), kRoutine.end(),
+              data.begin() + 0x1000 + i * kRoutine.size());
+  }
+  // A table of pointers to the routine at $00a000
+  for (int i = 0; i < 6; ++i) {
+    data[0x2000 + 2 * i] = 0x00;
+    data[0x2001 + 2 * i] = 0x80;
+  }
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)}};
+  auto reached = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(reached);
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom);
+  RomMap map = RomMap::Classify(rom, *reached, superset);
+
+  EXPECT_EQ(map.CountInRange(0, kRoutine.size(), BC_code), kRoutine.size());
+  EXPECT_EQ(map.ClassAt(0x1000 + kRoutine.size() * 2), BC_code);
+  EXPECT_EQ(map.CountInRange(0x2000, 0x200c, BC_pointers), 12);
+  EXPECT_EQ(map.ClassAt(0x4000), BC_data);
+
+  const RomMap::Run& fill = map.RunAt(0x4000);
+  EXPECT_EQ(fill.byte_class, BC_data);
+  EXPECT_LE(fill.begin, 0x200c);
+  EXPECT_EQ(fill.end, 0x10000);
+
+  // Runs cover the ROM in order.
+  int next = 0;
+  for (const RomMap::Run& run : map.Runs()) {
+    EXPECT_EQ(run.begin, next);
+    EXPECT_LT(run.begin, run.end);
+    next = run.end;
+  }
+  EXPECT_EQ(next, 0x10000);
+
+  // Unreached code is offered as a seed for further disassembly.
+  ASSERT_FALSE(map.CodeSeeds().empty());
+  EXPECT_GE(map.CodeSeeds()[0].address, 0x9000);
+  EXPECT_LT(map.CodeSeeds()[0].address, 0x9000 + 4 * kRoutine.size());
+}
+
+}  // namespace
+}  // namespace nsasm
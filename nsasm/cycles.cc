@@ -0,0 +1,470 @@
+#include "nsasm/cycles.h"
+
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_format.h"
+#include "nsasm/opcode_map.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+namespace {
+
+// Cycles for each opcode in native mode with 8-bit registers, a page-aligned
+// direct page, no page crossings, and branches not taken.  From the WDC
+// W65C816S datasheet.
+constexpr uint8_t base_cycles[256] = {
+    7, 6, 7, 4, 5, 3, 5, 6, 3, 2, 2, 4, 6, 4, 6, 5,  // 0x00
+    2, 5, 5, 7, 5, 4, 6, 6, 2, 4, 2, 2, 6, 4, 7, 5,  // 0x10
+    6, 6, 8, 4, 3, 3, 5, 6, 4, 2, 2, 5, 4, 4, 6, 5,  // 0x20
+    2, 5, 5, 7, 4, 4, 6, 6, 2, 4, 2, 2, 4, 4, 7, 5,  // 0x30
+    6, 6, 2, 4, 7, 3, 5, 6, 3, 2, 2, 3, 3, 4, 6, 5,  // 0x40
+    2, 5, 5, 7, 7, 4, 6, 6, 2, 4, 3, 2, 4, 4, 7, 5,  // 0x50
+    6, 6, 6, 4, 3, 3, 5, 6, 4, 2, 2, 6, 5, 4, 6, 5,  // 0x60
+    2, 5, 5, 7, 4, 4, 6, 6, 2, 4, 4, 2, 6, 4, 7, 5,  // 0x70
+    3, 6, 4, 4, 3, 3, 3, 6, 2, 2, 2, 3, 4, 4, 4, 5,  // 0x80
+    2, 6, 5, 7, 4, 4, 4, 6, 2, 5, 2, 2, 4, 5, 5, 5,  // 0x90
+    2, 6, 2, 4, 3, 3, 3, 6, 2, 2, 2, 4, 4, 4, 4, 5,  // 0xa0
+    2, 5, 5, 7, 4, 4, 4, 6, 2, 4, 2, 2, 4, 4, 4, 5,  // 0xb0
+    2, 6, 3, 4, 3, 3, 5, 6, 2, 2, 2, 3, 4, 4, 6, 5,  // 0xc0
+    2, 5, 5, 7, 6, 4, 6, 6, 2, 4, 3, 3, 6, 4, 7, 5,  // 0xd0
+    2, 6, 3, 4, 3, 3, 5, 6, 2, 2, 2, 3, 4, 4, 6, 5,  // 0xe0
+    2, 5, 5, 7, 5, 4, 6, 6, 2, 4, 4, 2, 8, 4, 7, 5,  // 0xf0
+};
+
+// Adds `cycles` to `*range` if `bit` is in state `when`, or to its maximum
+// only if the state of `bit` is not known.
+void AddIfBit(BitState bit, BitState when, int cycles, CycleRange* range) {
+  if (bit == when) {
+    *range += {cycles, cycles};
+  } else if (bit != B_on && bit != B_off) {
+    range->max += cycles;
+  }
+}
+
+// Instructions whose memory or accumulator access is widened when `m` is
+// clear.
+bool UsesMWidth(Mnemonic m) {
+  switch (m) {
+    case M_adc:
+    case M_and:
+    case M_bit:
+    case M_cmp:
+    case M_eor:
+    case M_lda:
+    case M_ora:
+    case M_pha:
+    case M_pla:
+    case M_sbc:
+    case M_sta:
+    case M_stz:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Instructions that read, modify and write back a memory operand of width
+// `m` (unless addressing the accumulator).
+bool IsReadModifyWrite(Mnemonic m) {
+  switch (m) {
+    case M_asl:
+    case M_dec:
+    case M_inc:
+    case M_lsr:
+    case M_rol:
+    case M_ror:
+    case M_trb:
+    case M_tsb:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Instructions whose index register access is widened when `x` is clear.
+bool UsesXWidth(Mnemonic m) {
+  switch (m) {
+    case M_cpx:
+    case M_cpy:
+    case M_ldx:
+    case M_ldy:
+    case M_phx:
+    case M_phy:
+    case M_plx:
+    case M_ply:
+    case M_stx:
+    case M_sty:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Instructions that only read their operand.  Indexed reads take an extra
+// cycle when indexing crosses a page, or uses 16-bit index registers; writes
+// and read-modify-writes always take it, and it is in their base count.
+bool IsRead(Mnemonic m) {
+  switch (m) {
+    case M_adc:
+    case M_and:
+    case M_bit:
+    case M_cmp:
+    case M_eor:
+    case M_lda:
+    case M_ldx:
+    case M_ldy:
+    case M_ora:
+    case M_sbc:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsConditionalBranch(Mnemonic m) {
+  switch (m) {
+    case M_bcc:
+    case M_bcs:
+    case M_beq:
+    case M_bmi:
+    case M_bne:
+    case M_bpl:
+    case M_bvc:
+    case M_bvs:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsDirectPage(AddressingMode a) {
+  switch (a) {
+    case A_dir_b:
+    case A_dir_bx:
+    case A_dir_by:
+    case A_ind_b:
+    case A_ind_bx:
+    case A_ind_by:
+    case A_lng_b:
+    case A_lng_by:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns false if the branch at `pc` is known not to cross a page when taken.
+bool MayCrossPage(int pc, const Instruction& instruction) {
+  auto offset = instruction.arg1.Evaluate();
+  if (!offset.ok()) {
+    return true;
+  }
+  const int next_pc =
+      AddToPC(pc, InstructionLength(instruction.addressing_mode));
+  return ((next_pc ^ AddToPC(next_pc, *offset)) & 0xff00) != 0;
+}
+
+}  // namespace
+
+std::string CycleRange::ToString() const {
+  std::string result;
+  AppendTo(&result);
+  return result;
+}
+
+void CycleRange::AppendTo(std::string* output) const {
+  if (min == kUnboundedCycles) {
+    output->append("unbounded");
+  } else if (!Bounded()) {
+    absl::StrAppendFormat(output, "%d+", min);
+  } else if (min == max) {
+    absl::StrAppendFormat(output, "%d", min);
+  } else {
+    absl::StrAppendFormat(output, "%d-%d", min, max);
+  }
+}
+
+CycleRange InstructionCycles(int pc, const Instruction& instruction,
+                             const FlagState& flag_state) {
+  CycleRange cycles;
+  Mnemonic mnemonic = instruction.mnemonic;
+  if (mnemonic == PM_add || mnemonic == PM_sub) {
+    // Folded CLC
+    cycles += {2, 2};
+    mnemonic = (mnemonic == PM_add) ? M_adc : M_sbc;
+  }
+  const AddressingMode mode = instruction.addressing_mode;
+  auto opcode = EncodeOpcode(mnemonic, mode);
+  if (!opcode.has_value()) {
+    return CycleRange();
+  }
+  cycles += {base_cycles[*opcode], base_cycles[*opcode]};
+
+  if (UsesMWidth(mnemonic)) {
+    AddIfBit(flag_state.MBit(), B_off, 1, &cycles);
+  } else if (IsReadModifyWrite(mnemonic) && mode != A_acc) {
+    AddIfBit(flag_state.MBit(), B_off, 2, &cycles);
+  } else if (UsesXWidth(mnemonic)) {
+    AddIfBit(flag_state.XBit(), B_off, 1, &cycles);
+  }
+
+  if (IsDirectPage(mode)) {
+    cycles.max += 1;
+  }
+
+  if (IsRead(mnemonic) &&
+      (mode == A_dir_wx || mode == A_dir_wy || mode == A_ind_by)) {
+    if (flag_state.XBit() == B_off) {
+      cycles += {1, 1};
+    } else {
+      cycles.max += 1;
+    }
+  }
+
+  if (IsConditionalBranch(mnemonic)) {
+    // Taken
+    cycles.max += 1;
+    if (flag_state.EBit() != B_off && MayCrossPage(pc, instruction)) {
+      cycles.max += 1;
+    }
+  } else if (mnemonic == M_bra && flag_state.EBit() != B_off &&
+             MayCrossPage(pc, instruction)) {
+    if (flag_state.EBit() == B_on && instruction.arg1.Evaluate().ok()) {
+      cycles += {1, 1};
+    } else {
+      cycles.max += 1;
+    }
+  }
+
+  if (mnemonic == M_brk || mnemonic == M_cop || mnemonic == M_rti) {
+    AddIfBit(flag_state.EBit(), B_off, 1, &cycles);
+  }
+  return cycles;
+}
+
+namespace {
+
+// Computes subroutine costs over a control flow graph, memoized by entry
+// block.
+//
+// A recursive call to a subroutine still being costed counts as
+// {0, kUnboundedCycles}.  A cost that depended on such a stand-in is only
+// right in the context of the caller being costed, so it is memoized only
+// once the recursion has unwound to the outermost subroutine of the cycle.
+class SubroutineCoster {
+ public:
+  SubroutineCoster(const ControlFlowGraph& graph,
+                   const std::vector<CycleRange>& block_cycles)
+      : graph_(graph), block_cycles_(block_cycles) {}
+
+  CycleRange Cost(int entry);
+
+ private:
+  enum State { kNotStarted, kInProgress, kDone };
+
+  struct Memo {
+    State state = kNotStarted;
+    // While in progress, the number of subroutines being costed outside this
+    // one.
+    int depth = 0;
+    CycleRange cost;
+  };
+
+  const ControlFlowGraph& graph_;
+  const std::vector<CycleRange>& block_cycles_;
+  absl::flat_hash_map<int, Memo> memo_;
+  // The number of subroutines being costed.
+  int depth_ = 0;
+  // The smallest depth of an in-progress subroutine reached by a recursive
+  // call while costing the current one.
+  int recursion_depth_ = INT_MAX;
+};
+
+CycleRange SubroutineCoster::Cost(int entry) {
+  Memo& memo = memo_[entry];
+  if (memo.state == kDone) {
+    return memo.cost;
+  }
+  if (memo.state == kInProgress) {
+    // Recursion
+    recursion_depth_ = std::min(recursion_depth_, memo.depth);
+    return {0, kUnboundedCycles};
+  }
+  memo.state = kInProgress;
+  memo.depth = depth_++;
+  const int outer_recursion_depth = recursion_depth_;
+  recursion_depth_ = INT_MAX;
+
+  // The blocks of the subroutine: those reachable from the entry without
+  // following calls.
+  std::vector<int> region = {entry};
+  absl::flat_hash_map<int, CycleRange> costs;
+  costs[entry] = CycleRange();
+  for (size_t i = 0; i < region.size(); ++i) {
+    for (const BlockEdge& edge : graph_.Successors(region[i])) {
+      if (edge.kind != E_call &&
+          costs.emplace(edge.block, CycleRange()).second) {
+        region.push_back(edge.block);
+      }
+    }
+  }
+
+  // Each block's cost includes the subroutines it calls.
+  for (int block : region) {
+    CycleRange cost = block_cycles_[block];
+    for (const BlockEdge& edge : graph_.Successors(block)) {
+      if (edge.kind == E_call) {
+        cost += Cost(edge.block);
+      }
+    }
+    costs[block] = cost;
+  }
+
+  auto leaves = [this](int block) {
+    for (const BlockEdge& edge : graph_.Successors(block)) {
+      if (edge.kind != E_call) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // Cheapest path to an exit, from each block: Dijkstra's algorithm, run
+  // backwards from the exits.
+  absl::flat_hash_map<int, int> min_to_exit;
+  using QueueEntry = std::pair<int, int>;  // distance, block
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      queue;
+  for (int block : region) {
+    if (leaves(block) && costs[block].min != kUnboundedCycles) {
+      queue.push({costs[block].min, block});
+    }
+  }
+  while (!queue.empty()) {
+    const QueueEntry top = queue.top();
+    queue.pop();
+    if (!min_to_exit.emplace(top.second, top.first).second) {
+      continue;
+    }
+    for (const BlockEdge& edge : graph_.Predecessors(top.second)) {
+      auto cost = costs.find(edge.block);
+      if (edge.kind == E_call || cost == costs.end() ||
+          min_to_exit.count(edge.block)) {
+        continue;
+      }
+      const int path = AddCycles(cost->second.min, top.first);
+      if (path != kUnboundedCycles) {
+        queue.push({path, edge.block});
+      }
+    }
+  }
+
+  CycleRange result = {kUnboundedCycles, kUnboundedCycles};
+  if (min_to_exit.count(entry)) {
+    // Most expensive path to an exit, over the blocks that can reach one, by
+    // depth-first search.  A cycle among them makes it unbounded.
+    result.min = min_to_exit[entry];
+    absl::flat_hash_map<int, int> max_to_exit;  // absent: not yet visited
+    constexpr int kOnStack = -1;
+    bool cyclic = false;
+    std::vector<std::pair<int, int>> stack = {{entry, 0}};  // block, next edge
+    max_to_exit[entry] = kOnStack;
+    while (!stack.empty() && !cyclic) {
+      const int block = stack.back().first;
+      auto successors = graph_.Successors(block);
+      int& next = stack.back().second;
+      if (next < static_cast<int>(successors.size())) {
+        const BlockEdge& edge = successors[next++];
+        if (edge.kind == E_call || !min_to_exit.count(edge.block)) {
+          continue;
+        }
+        auto it = max_to_exit.find(edge.block);
+        if (it == max_to_exit.end()) {
+          max_to_exit[edge.block] = kOnStack;
+          stack.push_back({edge.block, 0});
+        } else if (it->second == kOnStack) {
+          cyclic = true;
+        }
+        continue;
+      }
+      // All successors are done.
+      int longest = 0;
+      for (const BlockEdge& edge : successors) {
+        auto it = max_to_exit.find(edge.block);
+        if (edge.kind != E_call && it != max_to_exit.end()) {
+          longest = std::max(longest, it->second);
+        }
+      }
+      max_to_exit[block] = AddCycles(costs[block].max, longest);
+      stack.pop_back();
+    }
+    result.max = cyclic ? kUnboundedCycles : max_to_exit[entry];
+  }
+
+  // `memo` may have moved as callees were added.
+  Memo& done = memo_[entry];
+  --depth_;
+  if (recursion_depth_ < done.depth) {
+    // Depends on a caller still in progress; cost it again next time.
+    done.state = kNotStarted;
+    recursion_depth_ = std::min(outer_recursion_depth, recursion_depth_);
+  } else {
+    done.state = kDone;
+    done.cost = result;
+    recursion_depth_ = outer_recursion_depth;
+  }
+  return result;
+}
+
+}  // namespace
+
+CycleEstimate CycleEstimate::Compute(const ControlFlowGraph& graph,
+                                     const Disassembly& disassembly) {
+  CycleEstimate estimate;
+  estimate.block_cycles_.reserve(graph.BlockCount());
+  for (int block = 0; block < graph.BlockCount(); ++block) {
+    CycleRange cycles;
+    const BasicBlock& basic_block = graph.Block(block);
+    for (auto it = disassembly.find(basic_block.first_address);
+         it != disassembly.end() && it->first <= basic_block.last_address;
+         ++it) {
+      cycles += InstructionCycles(it->first, it->second.instruction,
+                                  it->second.current_flag_state);
+    }
+    estimate.block_cycles_.push_back(cycles);
+  }
+
+  SubroutineCoster coster(graph, estimate.block_cycles_);
+  auto add_subroutine = [&](int block) {
+    const int address = graph.Block(block).first_address;
+    if (!estimate.subroutines_.count(address)) {
+      estimate.subroutines_[address] = coster.Cost(block);
+    }
+  };
+  for (const auto& entry : graph.Entries()) {
+    add_subroutine(entry.first);
+  }
+  for (int block = 0; block < graph.BlockCount(); ++block) {
+    for (const BlockEdge& edge : graph.Successors(block)) {
+      if (edge.kind == E_call) {
+        add_subroutine(edge.block);
+      }
+    }
+  }
+  return estimate;
+}
+
+absl::optional<CycleRange> CycleEstimate::SubroutineCycles(int address) const {
+  auto it = subroutines_.find(address);
+  if (it == subroutines_.end()) {
+    return absl::nullopt;
+  }
+  return it->second;
+}
+
+}  // namespace nsasm
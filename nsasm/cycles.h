@@ -0,0 +1,125 @@
+#ifndef NSASM_CYCLES_H_
+#define NSASM_CYCLES_H_
+
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "nsasm/cfg.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/instruction.h"
+
+namespace nsasm {
+
+// Static estimates of 65816 execution time, in CPU cycles.
+//
+// Counts are cycles, not master clocks: on the SNES, a cycle's length also
+// depends on the memory region it accesses, which is not modeled here.
+
+// Stands for an unknown upper bound, such as the time spent in a loop.
+constexpr int kUnboundedCycles = INT_MAX;
+
+// Returns `a + b`, or kUnboundedCycles if either is unbounded.
+inline int AddCycles(int a, int b) {
+  return (a > kUnboundedCycles - b) ? kUnboundedCycles : a + b;
+}
+
+// The range of cycle counts that a piece of code can take.
+struct CycleRange {
+  int min = 0;
+  int max = 0;
+
+  bool Bounded() const { return max != kUnboundedCycles; }
+
+  // Adds the counts of code run one after the other.
+  CycleRange& operator+=(const CycleRange& rhs) {
+    min = AddCycles(min, rhs.min);
+    max = AddCycles(max, rhs.max);
+    return *this;
+  }
+  friend CycleRange operator+(CycleRange lhs, const CycleRange& rhs) {
+    return lhs += rhs;
+  }
+
+  // Merges the counts of alternative paths.
+  friend CycleRange operator|(const CycleRange& lhs, const CycleRange& rhs) {
+    return {std::min(lhs.min, rhs.min), std::max(lhs.max, rhs.max)};
+  }
+
+  bool operator==(const CycleRange& rhs) const {
+    return min == rhs.min && max == rhs.max;
+  }
+  bool operator!=(const CycleRange& rhs) const { return !(*this == rhs); }
+
+  // Returns the range as "3", "3-4", or "12+" when there is no upper bound.
+  std::string ToString() const;
+  // As above, but appends the text to `*output`.
+  void AppendTo(std::string* output) const;
+};
+
+// Returns the cycles taken by one execution of `instruction` at `pc`,
+// entered in `flag_state`.
+//
+// The count starts from the WDC datasheet's figure for each opcode with 8-bit
+// registers, and adds:
+//
+//   * 1 cycle for 16-bit memory or accumulator access when `m` is clear (2
+//     for read-modify-write instructions), and 1 for 16-bit index register
+//     access when `x` is clear;
+//   * 0-1 cycles for direct page addressing, which is slower when the low
+//     byte of the D register is nonzero (not tracked);
+//   * for indexed reads, 1 cycle with 16-bit index registers, or else 0-1
+//     depending on whether indexing crosses a page (not tracked);
+//   * for conditional branches, 1 cycle if taken, and 1 more if the taken
+//     branch crosses a page in emulation mode;
+//   * 1 cycle for BRK, COP and RTI in native mode.
+//
+// Unknown flag bits widen the range to cover both settings.  MVN and MVP
+// count the cycles to move one byte.  ADD and SUB count their folded CLC.
+// Returns {0, 0} for instructions with no opcode.
+CycleRange InstructionCycles(int pc, const Instruction& instruction,
+                             const FlagState& flag_state);
+
+// Cycle estimates for the blocks and subroutines of a disassembly.
+//
+// A block costs the sum of its instructions' cycles, in the flag states found
+// by disassembly.  A subroutine (an entry block of the control flow graph, or
+// a block called by JSR or JSL) costs the cheapest and most expensive paths
+// from its entry to a block with no successors, such as a return; calls made
+// along the way add the callee's cost.  Paths through a loop, or a recursive
+// call, have no upper bound.  A subroutine from which no path leaves costs
+// kUnboundedCycles at minimum, too.
+class CycleEstimate {
+ public:
+  static CycleEstimate Compute(const ControlFlowGraph& graph,
+                               const Disassembly& disassembly);
+
+  // Returns the cycles spent in `block` itself, not counting calls.
+  const CycleRange& BlockCycles(int block) const {
+    return block_cycles_[block];
+  }
+
+  // Returns the cycles spent by a call to the subroutine entered at
+  // `address`, including the subroutines it calls, or nullopt if no
+  // subroutine is entered there.
+  absl::optional<CycleRange> SubroutineCycles(int address) const;
+
+  // Every subroutine's cycles, by entry address.
+  const std::map<int, CycleRange>& Subroutines() const {
+    return subroutines_;
+  }
+
+ private:
+  CycleEstimate() = default;
+
+  std::vector<CycleRange> block_cycles_;
+  std::map<int, CycleRange> subroutines_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_CYCLES_H_
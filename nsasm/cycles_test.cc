@@ -0,0 +1,167 @@
+#include "nsasm/cycles.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "gtest/gtest.h"
+#include "nsasm/decode.h"
+#include "nsasm/listing.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+// Returns the cycles of the instruction encoded in `bytes` at `pc`.
+std::string Cycles(const std::vector<uint8_t>& bytes, const FlagState& state,
+                   int pc = 0x8000) {
+  auto instruction = Decode(bytes, state);
+  EXPECT_TRUE(instruction.ok());
+  if (!instruction.ok()) {
+    return "";
+  }
+  return InstructionCycles(pc, *instruction, state).ToString();
+}
+
+TEST(InstructionCycles, register_widths) {
+  const FlagState m8x8(B_off, B_on, B_on);
+  const FlagState m16x16(B_off, B_off, B_off);
+  const FlagState m_unknown(B_off, B_unknown, B_on);
+
+  EXPECT_EQ(Cycles({0xa9, 0x00}, m8x8), "2");          // LDA #$00
+  EXPECT_EQ(Cycles({0xa9, 0x00, 0x00}, m16x16), "3");  // LDA #$0000
+  EXPECT_EQ(Cycles({0xad, 0x34, 0x12}, m8x8), "4");    // LDA $1234
+  EXPECT_EQ(Cycles({0xad, 0x34, 0x12}, m_unknown), "4-5");
+
+  // Read-modify-write instructions pay twice for a 16-bit accumulator, but
+  // not when they modify the accumulator itself.
+  EXPECT_EQ(Cycles({0xee, 0x34, 0x12}, m8x8), "6");    // INC $1234
+  EXPECT_EQ(Cycles({0xee, 0x34, 0x12}, m16x16), "8");
+  EXPECT_EQ(Cycles({0x1a}, m16x16), "2");              // INC A
+
+  EXPECT_EQ(Cycles({0xa2, 0x00, 0x00}, m16x16), "3");  // LDX #$0000
+  EXPECT_EQ(Cycles({0xda}, m16x16), "4");              // PHX
+}
+
+TEST(InstructionCycles, addressing_penalties) {
+  const FlagState m8x8(B_off, B_on, B_on);
+  const FlagState m8x16(B_off, B_on, B_off);
+
+  // The low byte of D is not tracked.
+  EXPECT_EQ(Cycles({0xa5, 0x12}, m8x8), "3-4");  // LDA $12
+
+  // Indexed reads cross a page, or take the extra cycle with 16-bit index
+  // registers.  Writes always take it.
+  EXPECT_EQ(Cycles({0xbd, 0x34, 0x12}, m8x8), "4-5");  // LDA $1234,X
+  EXPECT_EQ(Cycles({0xbd, 0x34, 0x12}, m8x16), "5");
+  EXPECT_EQ(Cycles({0x9d, 0x34, 0x12}, m8x8), "5");    // STA $1234,X
+}
+
+TEST(InstructionCycles, branches) {
+  const FlagState native(B_off, B_on, B_on);
+  const FlagState emulation(B_on, B_on, B_on);
+
+  EXPECT_EQ(Cycles({0xd0, 0x10}, native), "2-3");         // BNE
+  EXPECT_EQ(Cycles({0xd0, 0x10}, emulation), "2-3");
+  EXPECT_EQ(Cycles({0xd0, 0x10}, emulation, 0x80f0), "2-4");
+  EXPECT_EQ(Cycles({0x80, 0x10}, native, 0x80f0), "3");   // BRA
+  EXPECT_EQ(Cycles({0x80, 0x10}, emulation, 0x80f0), "4");
+  EXPECT_EQ(Cycles({0x00, 0x00}, native), "8");           // BRK
+  EXPECT_EQ(Cycles({0x00, 0x00}, emulation), "7");
+}
+
+TEST(CycleEstimate, subroutines) {
+  Rom rom = MakeRom({
+      0xc2, 0x10,        // 8000: REP #$10       block 0: 3 + 3
+      0xa2, 0x00, 0x01,  // 8002: LDX #$0100
+      0xca,              // 8005: DEX            block 1: 2 + 6
+      0x20, 0x10, 0x80,  // 8006: JSR $8010
+      0xd0, 0xfa,        // 8009: BNE $8005      block 2: 2-3
+      0x60,              // 800b: RTS            block 3: 6
+      0, 0, 0, 0,        // 800c
+      0xe2, 0x20,        // 8010: SEP #$20       block 4: 3 + 6
+      0x20, 0x20, 0x80,  // 8012: JSR $8020
+      0x60,              // 8015: RTS            block 5: 6
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 8016
+      0xea,              // 8020: NOP            block 6: 2 + 6
+      0x60,              // 8021: RTS
+  });
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_off, B_on)}};
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  ControlFlowGraph graph =
+      ControlFlowGraph::Build(rom, *disassembly, entry_points);
+  ASSERT_EQ(graph.BlockCount(), 7);
+
+  const CycleEstimate estimate = CycleEstimate::Compute(graph, *disassembly);
+  EXPECT_EQ(estimate.BlockCycles(0).ToString(), "6");
+  EXPECT_EQ(estimate.BlockCycles(2).ToString(), "2-3");
+  EXPECT_EQ(estimate.BlockCycles(4).ToString(), "9");
+
+  EXPECT_EQ(estimate.Subroutines().size(), 3);
+  EXPECT_FALSE(estimate.SubroutineCycles(0x8005).has_value());
+  ASSERT_TRUE(estimate.SubroutineCycles(0x8020).has_value());
+  EXPECT_EQ(estimate.SubroutineCycles(0x8020)->ToString(), "8");
+  // Calls add the callee's cost.
+  EXPECT_EQ(estimate.SubroutineCycles(0x8010)->ToString(), "23");
+  // The loop leaves no upper bound: one pass is 6 + (8 + 23) + 2 + 6.
+  EXPECT_EQ(estimate.SubroutineCycles(0x8000)->ToString(), "45+");
+
+  std::string listing;
+  {
+    ListingWriter writer(&listing);
+    writer.WriteDisassemblyWithCycles(*disassembly, graph, estimate);
+  }
+  EXPECT_TRUE(absl::StartsWith(listing,
+                               "; subroutine: 45+ cycles\n"
+                               "; block: 6 cycles\n"
+                               "008000          REP #$10"));
+  EXPECT_TRUE(absl::StrContains(listing, "; block: 2-3 cycles\n008009"));
+  EXPECT_TRUE(absl::StrContains(listing, "; subroutine: 8 cycles\n"));
+  EXPECT_TRUE(absl::StrContains(listing, ";m8x16 [6]\n"));
+}
+
+TEST(CycleEstimate, recursion) {
+  Rom rom = MakeRom({
+      0xea,              // 8000: NOP            block 0: 2 + 2-3
+      0xf0, 0x03,        // 8001: BEQ $8006
+      0x20, 0x10, 0x80,  // 8003: JSR $8010      block 1: 6
+      0x60,              // 8006: RTS            block 2: 6
+      0, 0, 0, 0, 0, 0, 0, 0, 0,  // 8007
+      0xea,              // 8010: NOP            block 3: 2 + 6
+      0x20, 0x00, 0x80,  // 8011: JSR $8000
+      0x60,              // 8014: RTS            block 4: 6
+  });
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)}};
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  ControlFlowGraph graph =
+      ControlFlowGraph::Build(rom, *disassembly, entry_points);
+  const CycleEstimate estimate = CycleEstimate::Compute(graph, *disassembly);
+  EXPECT_EQ(estimate.SubroutineCycles(0x8000)->ToString(), "10+");
+  // Costed first as part of $8000, where the recursive call stands in as
+  // zero cycles; that cost must not be reused for calls from elsewhere.
+  EXPECT_EQ(estimate.SubroutineCycles(0x8010)->ToString(), "24+");
+}
+
+TEST(CycleEstimate, no_exit) {
+  Rom rom = MakeRom({
+      0xea,              // 8000: NOP
+      0x80, 0xfd,        // 8001: BRA $8000
+  });
+  const std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)}};
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  ControlFlowGraph graph =
+      ControlFlowGraph::Build(rom, *disassembly, entry_points);
+  const CycleEstimate estimate = CycleEstimate::Compute(graph, *disassembly);
+  EXPECT_EQ(estimate.BlockCycles(0).ToString(), "5");
+  EXPECT_EQ(estimate.SubroutineCycles(0x8000)->ToString(), "unbounded");
+}
+
+}  // namespace
+}  // namespace nsasm
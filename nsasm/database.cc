@@ -0,0 +1,304 @@
+#include "nsasm/database.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace nsasm {
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'S', 'D', 'B'};
+constexpr uint32_t kVersion = 1;
+
+// Header layout: magic, version, ROM hash, then one record count per section.
+constexpr int kHashOffset = 8;
+constexpr int kCountsOffset = 16;
+constexpr int kHeaderSize = 32;
+
+// Sections, in file order.  Every record is 8 bytes.
+enum Section {
+  kInstructions,
+  kLabels,
+  kEntries,
+  kModeHints,
+  kSectionCount,
+};
+constexpr int kRecordSize = 8;
+
+uint16_t Get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+uint32_t Get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t Get64(const uint8_t* p) {
+  return Get32(p) | (uint64_t(Get32(p + 4)) << 32);
+}
+
+void Put16(uint16_t v, std::vector<uint8_t>* out) {
+  out->push_back(v & 0xff);
+  out->push_back(v >> 8);
+}
+
+void Put32(uint32_t v, std::vector<uint8_t>* out) {
+  Put16(v & 0xffff, out);
+  Put16(v >> 16, out);
+}
+
+void Put64(uint64_t v, std::vector<uint8_t>* out) {
+  Put32(v & 0xffffffff, out);
+  Put32(v >> 32, out);
+}
+
+// Returns the index of the record in a section sorted by address whose address
+// is `address`, or -1 if there is none.
+int FindRecord(const uint8_t* records, uint32_t count, int address) {
+  uint32_t low = 0;
+  uint32_t high = count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    uint32_t mid_address = Get32(records + mid * kRecordSize);
+    if (mid_address == uint32_t(address)) {
+      return mid;
+    } else if (mid_address < uint32_t(address)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+ErrorOr<std::unique_ptr<Database>> Database::Open(const std::string& path,
+                                                  const Rom& rom) {
+  std::unique_ptr<Database> database(new Database(path, rom));
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    // No database yet.
+    database->Store({}, {}, {}, {});
+    return std::move(database);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return Error("Failed to read database").SetLocation(path);
+  }
+  size_t size = file_stat.st_size;
+  if (size < kHeaderSize) {
+    close(fd);
+    return Error("Database file truncated").SetLocation(path);
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return Error("Failed to map database").SetLocation(path);
+  }
+  database->mapping_ = mapping;
+  database->mapping_size_ = size;
+  database->data_ = static_cast<const uint8_t*>(mapping);
+  database->size_ = size;
+
+  const uint8_t* data = database->data_;
+  if (!std::equal(kMagic, kMagic + 4, data) || Get32(data + 4) != kVersion) {
+    return Error("Not an nsasm database, or unsupported version")
+        .SetLocation(path);
+  }
+  uint64_t expected_size = kHeaderSize;
+  for (int section = 0; section < kSectionCount; ++section) {
+    expected_size += uint64_t(database->Count(section)) * kRecordSize;
+  }
+  if (expected_size != size) {
+    return Error("Database file has the wrong size").SetLocation(path);
+  }
+  if (Get64(data + kHashOffset) != rom.ContentHash()) {
+    // Written for different ROM contents; start over.
+    database->Store({}, {}, {}, {});
+  }
+  return std::move(database);
+}
+
+Database::~Database() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
+uint32_t Database::Count(int section) const {
+  return Get32(data_ + kCountsOffset + 4 * section);
+}
+
+const uint8_t* Database::Section(int section) const {
+  const uint8_t* p = data_ + kHeaderSize;
+  for (int i = 0; i < section; ++i) {
+    p += Count(i) * kRecordSize;
+  }
+  return p;
+}
+
+int Database::InstructionCount() const { return Count(kInstructions); }
+
+absl::optional<FlagState> Database::StateAt(int address) const {
+  const uint8_t* records = Section(kInstructions);
+  int index = FindRecord(records, Count(kInstructions), address);
+  if (index < 0) {
+    return absl::nullopt;
+  }
+  return FlagState::Unpack(Get16(records + index * kRecordSize + 4));
+}
+
+int Database::LabelAt(int address) const {
+  const uint8_t* records = Section(kLabels);
+  int index = FindRecord(records, Count(kLabels), address);
+  if (index < 0) {
+    return 0;
+  }
+  return Get32(records + index * kRecordSize + 4);
+}
+
+std::vector<EntryPoint> Database::EntryPoints() const {
+  std::vector<EntryPoint> entry_points;
+  const uint8_t* p = Section(kEntries);
+  for (uint32_t i = 0; i < Count(kEntries); ++i, p += kRecordSize) {
+    entry_points.push_back(
+        {int(Get32(p)), FlagState::Unpack(Get16(p + 4))});
+  }
+  return entry_points;
+}
+
+std::map<int, FlagState> Database::ModeHints() const {
+  std::map<int, FlagState> mode_hints;
+  const uint8_t* p = Section(kModeHints);
+  for (uint32_t i = 0; i < Count(kModeHints); ++i, p += kRecordSize) {
+    mode_hints.emplace(Get32(p), FlagState::Unpack(Get16(p + 4)));
+  }
+  return mode_hints;
+}
+
+std::vector<InstructionStates> Database::States() const {
+  std::vector<InstructionStates> states;
+  states.reserve(Count(kInstructions));
+  const uint8_t* p = Section(kInstructions);
+  for (uint32_t i = 0; i < Count(kInstructions); ++i, p += kRecordSize) {
+    states.push_back({int(Get32(p)), FlagState::Unpack(Get16(p + 4)),
+                      FlagState::Unpack(Get16(p + 6))});
+  }
+  return states;
+}
+
+ErrorOr<Disassembly> Database::Disassemble() const {
+  std::vector<InstructionStates> states = States();
+  return ExtendDisassembly(rom_, {}, ModeHints(), &states);
+}
+
+ErrorOr<Disassembly> Database::AddEntryPoints(
+    const std::vector<EntryPoint>& entry_points) {
+  std::vector<InstructionStates> states = States();
+  std::map<int, FlagState> mode_hints = ModeHints();
+  auto disassembly =
+      ExtendDisassembly(rom_, entry_points, mode_hints, &states);
+  NSASM_RETURN_IF_ERROR(disassembly);
+  std::vector<EntryPoint> all_entry_points = EntryPoints();
+  all_entry_points.insert(all_entry_points.end(), entry_points.begin(),
+                          entry_points.end());
+  Store(states, *disassembly, all_entry_points, mode_hints);
+  return disassembly;
+}
+
+ErrorOr<Disassembly> Database::SetModeHint(int address,
+                                           const FlagState& flag_state) {
+  IncrementalDisassembly incremental(rom_);
+  std::vector<EntryPoint> entry_points = EntryPoints();
+  auto restored = incremental.Restore(entry_points, ModeHints(), States());
+  NSASM_RETURN_IF_ERROR(restored);
+  auto visits = incremental.SetModeHint(address, flag_state);
+  NSASM_RETURN_IF_ERROR(visits);
+  Disassembly disassembly = incremental.Result();
+  Store(incremental.States(), disassembly, entry_points,
+        incremental.ModeHints());
+  return disassembly;
+}
+
+void Database::Store(const std::vector<InstructionStates>& states,
+                     const Disassembly& disassembly,
+                     const std::vector<EntryPoint>& entry_points,
+                     const std::map<int, FlagState>& mode_hints) {
+  uint32_t label_count = 0;
+  for (const auto& node : disassembly) {
+    if (node.second.label_id) {
+      ++label_count;
+    }
+  }
+
+  std::vector<uint8_t> image;
+  image.reserve(kHeaderSize + kRecordSize * (states.size() + label_count +
+                                             entry_points.size() +
+                                             mode_hints.size()));
+  image.insert(image.end(), kMagic, kMagic + 4);
+  Put32(kVersion, &image);
+  Put64(rom_.ContentHash(), &image);
+  Put32(states.size(), &image);
+  Put32(label_count, &image);
+  Put32(entry_points.size(), &image);
+  Put32(mode_hints.size(), &image);
+
+  for (const InstructionStates& state : states) {
+    Put32(state.address, &image);
+    Put16(state.current_flag_state.Pack(), &image);
+    Put16(state.next_flag_state.Pack(), &image);
+  }
+  for (const auto& node : disassembly) {
+    if (node.second.label_id) {
+      Put32(node.first, &image);
+      Put32(node.second.label_id, &image);
+    }
+  }
+  for (const EntryPoint& entry_point : entry_points) {
+    Put32(entry_point.address, &image);
+    Put16(entry_point.flag_state.Pack(), &image);
+    Put16(0, &image);
+  }
+  for (const auto& hint : mode_hints) {
+    Put32(hint.first, &image);
+    Put16(hint.second.Pack(), &image);
+    Put16(0, &image);
+  }
+
+  owned_ = std::move(image);
+  data_ = owned_.data();
+  size_ = owned_.size();
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+}
+
+ErrorOr<int> Database::Save() const {
+  // Write to a temporary file and rename it into place, so that a failed write
+  // never leaves a corrupt database behind (and so that any mapping of the old
+  // file stays valid.)
+  std::string temp_path = path_ + ".tmp";
+  FILE* f = fopen(temp_path.c_str(), "wb");
+  if (!f) {
+    return Error("Failed to open file for writing").SetLocation(temp_path);
+  }
+  size_t written = fwrite(data_, 1, size_, f);
+  if (fclose(f) != 0 || written != size_) {
+    remove(temp_path.c_str());
+    return Error("Failed to write database").SetLocation(temp_path);
+  }
+  if (rename(temp_path.c_str(), path_.c_str()) != 0) {
+    remove(temp_path.c_str());
+    return Error("Failed to replace database").SetLocation(path_);
+  }
+  return int(size_);
+}
+
+}  // namespace nsasm
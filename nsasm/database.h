@@ -0,0 +1,106 @@
+#ifndef NSASM_DATABASE_H_
+#define NSASM_DATABASE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/error.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+// A persistent record of the disassembly of one ROM, so that reopening a ROM
+// does not require analyzing it again.
+//
+// The database stores the instruction starts and flag states found by
+// disassembly, the labels assigned, and user hints: extra entry points (as
+// `.entry` gives) and forced flag states (as `.mode` gives.)  It is keyed by a
+// hash of the ROM contents; a database written for different ROM contents
+// opens empty.
+//
+// The file is a header followed by flat arrays of fixed-size little-endian
+// records, so that it can be mapped into memory and queried without parsing:
+//
+//   header:       "NSDB", u32 version, u64 ROM hash,
+//                 u32 instruction, label, entry and mode hint counts
+//   instructions: {u32 address, u16 incoming state, u16 outgoing state}
+//   labels:       {u32 address, u32 label id}
+//   entries:      {u32 address, u16 flag state, u16 zero}
+//   mode hints:   {u32 address, u16 flag state, u16 zero}
+//
+// Flag states are stored as `FlagState::Pack()` values.  All arrays but
+// entries are sorted by address.
+class Database {
+ public:
+  // Opens the database at `path` for `rom`.  If the file does not exist, or
+  // was written for a ROM with different contents, the database starts out
+  // empty.  Returns an error if the file exists but is not a valid database.
+  static ErrorOr<std::unique_ptr<Database>> Open(const std::string& path,
+                                                 const Rom& rom);
+
+  ~Database();
+  Database(const Database&) = delete;
+  Database& operator=(const Database&) = delete;
+
+  // Queries on the stored analysis.  These read the file image directly.
+  int InstructionCount() const;
+  // Returns the incoming flag state of the instruction starting at `address`,
+  // or nullopt if no known instruction starts there.
+  absl::optional<FlagState> StateAt(int address) const;
+  // Returns the label id assigned to `address`, or 0 if it has no label.
+  int LabelAt(int address) const;
+  std::vector<EntryPoint> EntryPoints() const;
+  std::map<int, FlagState> ModeHints() const;
+
+  // Returns the disassembly described by the stored analysis.
+  ErrorOr<Disassembly> Disassemble() const;
+
+  // Adds entry points, and extends the stored analysis to cover the code they
+  // reach.  Only code whose flag states change is decoded again.
+  ErrorOr<Disassembly> AddEntryPoints(
+      const std::vector<EntryPoint>& entry_points);
+
+  // Forces the incoming flag state at `address`.  Only the code reachable from
+  // `address` is analyzed again; see `IncrementalDisassembly`.
+  ErrorOr<Disassembly> SetModeHint(int address, const FlagState& flag_state);
+
+  // Writes the database back to its path.  Returns the number of bytes
+  // written.
+  ErrorOr<int> Save() const;
+
+ private:
+  Database(std::string path, const Rom& rom)
+      : path_(std::move(path)), rom_(rom) {}
+
+  // Replaces the file image with one holding the given analysis.
+  void Store(const std::vector<InstructionStates>& states,
+             const Disassembly& disassembly,
+             const std::vector<EntryPoint>& entry_points,
+             const std::map<int, FlagState>& mode_hints);
+
+  std::vector<InstructionStates> States() const;
+
+  uint32_t Count(int section) const;
+  const uint8_t* Section(int section) const;
+
+  std::string path_;
+  const Rom& rom_;
+
+  // The file image: either a read-only mapping of the file, or (once the
+  // database has been modified) `owned_`.
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  std::vector<uint8_t> owned_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_DATABASE_H_
@@ -0,0 +1,127 @@
+#include "nsasm/database.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+const std::vector<uint8_t> kCode = {
+    0xe2, 0x30,        // 8000: SEP #$30
+    0xa9, 0x01,        // 8002: LDA #$01
+    0x80, 0x04,        // 8004: BRA $800a
+    0xc2, 0x20,        // 8006: REP #$20      (second entry point)
+    0xa9, 0x00, 0x00,  // 8008: LDA #$0000    (overlaps first BRA target)
+    0xea,              // 800b: NOP
+    0xd0, 0xf2,        // 800c: BNE $8000
+    0x60,              // 800e: RTS
+};
+
+TEST(Database, reopen_and_extend) {
+  const std::string path = testing::TempDir() + "/reopen_and_extend.nsdb";
+  std::remove(path.c_str());
+  Rom rom = MakeRom(kCode);
+  const EntryPoint first = {0x8000, FlagState(B_off, B_on, B_on)};
+  const EntryPoint second = {0x8006, FlagState(B_off, B_on, B_on)};
+
+  {
+    auto database = Database::Open(path, rom);
+    NSASM_ASSERT_OK(database);
+    EXPECT_EQ((*database)->InstructionCount(), 0);
+    auto disassembly = (*database)->AddEntryPoints({first});
+    NSASM_ASSERT_OK(disassembly);
+    NSASM_ASSERT_OK((*database)->Save());
+  }
+
+  auto database = Database::Open(path, rom);
+  NSASM_ASSERT_OK(database);
+  auto expected_first = DisassembleAll(rom, {first});
+  NSASM_ASSERT_OK(expected_first);
+  EXPECT_EQ((*database)->InstructionCount(), expected_first->size());
+  EXPECT_EQ((*database)->StateAt(0x8002)->ToName(), "m8x8");
+  EXPECT_FALSE((*database)->StateAt(0x8003).has_value());
+  EXPECT_EQ((*database)->LabelAt(0x800a), 2);
+  ASSERT_EQ((*database)->EntryPoints().size(), 1);
+
+  auto reopened = (*database)->Disassemble();
+  NSASM_ASSERT_OK(reopened);
+  EXPECT_EQ(RenderDisassembly(*reopened), RenderDisassembly(*expected_first));
+
+  // A new entry point extends the stored analysis.
+  auto extended = (*database)->AddEntryPoints({second});
+  NSASM_ASSERT_OK(extended);
+  auto expected_both = DisassembleAll(rom, {first, second});
+  NSASM_ASSERT_OK(expected_both);
+  EXPECT_EQ(RenderDisassembly(*extended), RenderDisassembly(*expected_both));
+  EXPECT_EQ((*database)->EntryPoints().size(), 2);
+  std::remove(path.c_str());
+}
+
+TEST(Database, mode_hints) {
+  const std::string path = testing::TempDir() + "/mode_hints.nsdb";
+  std::remove(path.c_str());
+  Rom rom = MakeRom({
+      0x22, 0x00, 0x00, 0x7e,  // 8000: JSL $7e0000  -- RAM routine sets m16
+      0xa9, 0x60, 0x60,        // 8004: LDA #$6060
+      0x60,                    // 8007: RTS
+  });
+  auto database = Database::Open(path, rom);
+  NSASM_ASSERT_OK(database);
+  // Without the hint, the call is assumed to preserve m8.
+  auto disassembly =
+      (*database)->AddEntryPoints({{0x8000, FlagState(B_off, B_on, B_on)}});
+  NSASM_ASSERT_OK(disassembly);
+  EXPECT_EQ(disassembly->at(0x8004).instruction.ToString(), "LDA #$60");
+
+  disassembly = (*database)->SetModeHint(0x8004, FlagState(B_off, B_off, B_on));
+  NSASM_ASSERT_OK(disassembly);
+  EXPECT_EQ(disassembly->at(0x8004).instruction.ToString(), "LDA #$6060");
+  EXPECT_EQ(disassembly->count(0x8006), 0);
+  EXPECT_EQ(disassembly->count(0x8007), 1);
+  NSASM_ASSERT_OK((*database)->Save());
+
+  auto reopened = Database::Open(path, rom);
+  NSASM_ASSERT_OK(reopened);
+  ASSERT_EQ((*reopened)->ModeHints().size(), 1);
+  EXPECT_EQ((*reopened)->StateAt(0x8004)->ToName(), "m16x8");
+  std::remove(path.c_str());
+}
+
+TEST(Database, keyed_by_rom_contents) {
+  const std::string path = testing::TempDir() + "/keyed.nsdb";
+  std::remove(path.c_str());
+  Rom rom = MakeRom(kCode);
+  {
+    auto database = Database::Open(path, rom);
+    NSASM_ASSERT_OK(database);
+    NSASM_ASSERT_OK((*database)->AddEntryPoints(
+        {{0x8000, FlagState(B_off, B_on, B_on)}}));
+    NSASM_ASSERT_OK((*database)->Save());
+  }
+  Rom other_rom = MakeRom({0x60});
+  EXPECT_NE(rom.ContentHash(), other_rom.ContentHash());
+  auto database = Database::Open(path, other_rom);
+  NSASM_ASSERT_OK(database);
+  EXPECT_EQ((*database)->InstructionCount(), 0);
+  EXPECT_TRUE((*database)->EntryPoints().empty());
+  std::remove(path.c_str());
+}
+
+TEST(Database, rejects_corrupt_files) {
+  const std::string path = testing::TempDir() + "/corrupt.nsdb";
+  FILE* f = fopen(path.c_str(), "wb");
+  ASSERT_NE(f, nullptr);
+  fputs("this is not a database, but it is long enough", f);
+  fclose(f);
+  Rom rom = MakeRom(kCode);
+  EXPECT_FALSE(Database::Open(path, rom).ok());
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace nsasm
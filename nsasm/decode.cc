@@ -3,11 +3,14 @@
 #include "absl/memory/memory.h"
 #include "nsasm/expression.h"
 #include "nsasm/opcode_map.h"
+#include "nsasm/stats.h"
 
 namespace nsasm {
 
 ErrorOr<Instruction> Decode(absl::Span<const uint8_t> bytes,
                             const FlagState& state) {
+  NSASM_STATS_TIMER(SP_decode);
+  NSASM_STATS_INCREMENT(SC_instructions_decoded);
   if (bytes.empty()) {
     return Error("Not enough bytes to decode");
   }
@@ -2,20 +2,20 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/ascii.h"
-#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 
 namespace nsasm {
 namespace {
 
 constexpr absl::string_view directive_names[] = {
-    ".DB", ".DL", ".DW", ".ENTRY", ".EQU", ".MODE", ".ORG",
+    ".BUDGET", ".DB", ".DL", ".DW", ".ENDBUDGET", ".ENTRY", ".EQU", ".MODE",
+    ".ORG",
 };
 
 }  // namespace
 
 absl::string_view ToString(DirectiveName d) {
-  if (d < D_db || d > D_org) {
+  if (d < D_budget || d > D_org) {
     return "";
   }
   return directive_names[d];
@@ -24,9 +24,11 @@ absl::string_view ToString(DirectiveName d) {
 absl::optional<DirectiveName> ToDirectiveName(std::string s) {
   static auto lookup =
       new absl::flat_hash_map<absl::string_view, DirectiveName>{
-          {".DB", D_db},       {".DL", D_dl},   {".DW", D_dw},
-          {".ENTRY", D_entry}, {".EQU", D_equ}, {".MODE", D_mode},
-          {".ORG", D_org},
+          {".BUDGET", D_budget}, {".DB", D_db},
+          {".DL", D_dl},         {".DW", D_dw},
+          {".ENDBUDGET", D_endbudget},
+          {".ENTRY", D_entry},   {".EQU", D_equ},
+          {".MODE", D_mode},     {".ORG", D_org},
       };
   absl::AsciiStrToUpper(&s);
   auto iter = lookup->find(s);
@@ -38,8 +40,10 @@ absl::optional<DirectiveName> ToDirectiveName(std::string s) {
 
 DirectiveType DirectiveTypeByName(DirectiveName d) {
   static auto lookup = new absl::flat_hash_map<DirectiveName, DirectiveType>{
-      {D_db, DT_list_arg},    {D_dl, DT_list_arg},    {D_dw, DT_list_arg},
-      {D_entry, DT_flag_arg}, {D_equ, DT_single_arg}, {D_mode, DT_flag_arg},
+      {D_budget, DT_single_arg}, {D_db, DT_list_arg},
+      {D_dl, DT_list_arg},       {D_dw, DT_list_arg},
+      {D_endbudget, DT_no_arg},  {D_entry, DT_flag_arg},
+      {D_equ, DT_single_arg},    {D_mode, DT_flag_arg},
       {D_org, DT_single_arg},
   };
   auto iter = lookup->find(d);
@@ -50,20 +54,36 @@ DirectiveType DirectiveTypeByName(DirectiveName d) {
 }
 
 std::string Directive::ToString() const {
-  DirectiveType type = DirectiveTypeByName(name);
+  std::string result;
+  AppendTo(&result);
+  return result;
+}
+
+void Directive::AppendTo(std::string* output) const {
+  const absl::string_view directive_name = nsasm::ToString(name);
+  output->append(directive_name.data(), directive_name.size());
+  const DirectiveType type = DirectiveTypeByName(name);
+  if (type == DT_no_arg) {
+    return;
+  }
+  output->push_back(' ');
   switch (type) {
     case DT_single_arg:
-      return absl::StrCat(nsasm::ToString(name), " ", argument.ToString());
+      argument.AppendTo(output);
+      return;
     case DT_flag_arg:
-      return absl::StrCat(nsasm::ToString(name), " ",
-                          flag_state_argument.ToName());
+      flag_state_argument.AppendName(output);
+      return;
     case DT_list_arg:
-      return absl::StrCat(
-          nsasm::ToString(name), " ",
-          absl::StrJoin(list_argument, ", ",
-                        [](std::string* out, const ExpressionOrNull& v) {
-                          out->append(v.ToString());
-                        }));
+      for (size_t i = 0; i < list_argument.size(); ++i) {
+        if (i > 0) {
+          output->append(", ");
+        }
+        list_argument[i].AppendTo(output);
+      }
+      return;
+    case DT_no_arg:
+      return;
   }
 }
 
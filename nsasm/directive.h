@@ -10,9 +10,11 @@ namespace nsasm {
 
 // All assembler directives understood by nsasm
 enum DirectiveName {
+  D_budget,
   D_db,
   D_dl,
   D_dw,
+  D_endbudget,
   D_entry,
   D_equ,
   D_mode,
@@ -24,6 +26,7 @@ enum DirectiveType {
   DT_single_arg,
   DT_flag_arg,
   DT_list_arg,
+  DT_no_arg,
 };
 
 // Conversions between DirectiveName values, and the matching strings.
@@ -40,6 +43,8 @@ struct Directive {
   std::vector<ExpressionOrNull> list_argument;
 
   std::string ToString() const;
+  // As above, but appends the text to `*output`.
+  void AppendTo(std::string* output) const;
 };
 
 
@@ -62,6 +67,9 @@ inline void PrintTo(DirectiveType t, std::ostream* out) {
     case DT_list_arg:
       *out << "DT_list_arg";
       return;
+    case DT_no_arg:
+      *out << "DT_no_arg";
+      return;
     default:
       *out << "???";
       return;
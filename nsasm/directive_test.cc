@@ -23,9 +23,11 @@ void CheckToString(DirectiveName d, std::string s) {
 #define CHECK_DIRECTIVE_NAME(name) CheckToString(D_##name, "." #name)
 
 TEST(Directive, directive_names) {
+  CHECK_DIRECTIVE_NAME(budget);
   CHECK_DIRECTIVE_NAME(db);
   CHECK_DIRECTIVE_NAME(dw);
   CHECK_DIRECTIVE_NAME(dl);
+  CHECK_DIRECTIVE_NAME(endbudget);
   CHECK_DIRECTIVE_NAME(entry);
   CHECK_DIRECTIVE_NAME(equ);
   CHECK_DIRECTIVE_NAME(mode);
@@ -38,7 +40,7 @@ TEST(Directive, directive_names) {
 
 TEST(Directive, directive_types) {
   // Directives that take single values
-  for (DirectiveName name : {D_equ, D_org}) {
+  for (DirectiveName name : {D_budget, D_equ, D_org}) {
     SCOPED_TRACE(ToString(name));
     EXPECT_EQ(DirectiveTypeByName(name), DT_single_arg);
   }
@@ -54,6 +56,9 @@ TEST(Directive, directive_types) {
     SCOPED_TRACE(ToString(name));
     EXPECT_EQ(DirectiveTypeByName(name), DT_flag_arg);
   }
+
+  // Directives that take no argument
+  EXPECT_EQ(DirectiveTypeByName(D_endbudget), DT_no_arg);
 }
 
 }  // namespace
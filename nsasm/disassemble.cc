@@ -1,70 +1,174 @@
 #include "nsasm/disassemble.h"
 
-#include <string>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <utility>
+#include <vector>
 
-#include "absl/container/flat_hash_map.h"
-#include "absl/strings/str_cat.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
 #include "nsasm/decode.h"
 #include "nsasm/error.h"
 #include "nsasm/opcode_map.h"
+#include "nsasm/parallel.h"
+#include "nsasm/stats.h"
+#include "nsasm/trace.h"
 
 namespace nsasm {
 
 namespace {
 
-// Returns true if executing this instruction means control does not contine to
-// the next.
-bool IsExitInstruction(const Instruction& ins) {
-  Mnemonic mnemonic = ins.mnemonic;
-  return mnemonic == M_jmp || mnemonic == M_rtl || mnemonic == M_rts ||
-         mnemonic == M_rti || mnemonic == M_stp || mnemonic == M_bra;
-};
+// Returns true if this instruction is relatively addressed (and so has a
+// branch target.)
+bool IsBranch(const Instruction& ins) {
+  return ins.addressing_mode == A_rel8 || ins.addressing_mode == A_rel16;
+}
 
-}  // namespace
+// Returns the branch target of a relatively addressed instruction at `pc`.
+int BranchTarget(int pc, const Instruction& ins) {
+  int next_pc = AddToPC(pc, InstructionLength(ins.addressing_mode));
+  return AddToPC(next_pc, *ins.arg1.Evaluate());
+}
 
-ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
-                                 const FlagState& initial_flag_state) {
-  // Mapping of instruction addresses to decoded instructions
-  Disassembly result;
+// Decodes the instruction at `pc`, assuming the given processor state.
+ErrorOr<Instruction> DecodeAt(const Rom& rom, int pc,
+                              const FlagState& flag_state) {
+  auto instruction_data = rom.Read(pc, 4);
+  NSASM_RETURN_IF_ERROR_WITH_LOCATION(instruction_data, rom.path(), pc);
+  auto instruction = Decode(*instruction_data, flag_state);
+  NSASM_RETURN_IF_ERROR_WITH_LOCATION(instruction, rom.path(), pc);
+  return instruction;
+}
 
-  // label generator
-  int gensym_count = 0;
-  auto gensym = [&gensym_count]() {
-    return absl::StrCat("gensym", ++gensym_count);
-  };
+// Returns true if this instruction is a subroutine call to a fixed address.
+bool IsCall(const Instruction& ins) {
+  return (ins.mnemonic == M_jsr && ins.addressing_mode == A_dir_w) ||
+         (ins.mnemonic == M_jsl && ins.addressing_mode == A_dir_l);
+}
 
-  // Mapping of instruction addresses to jump target label name
-  std::map<int, std::string> label_names;
-  auto get_label = [&label_names, &gensym](int address) {
-    auto it = label_names.find(address);
-    if (it == label_names.end()) {
-      return label_names[address] = gensym();
-    } else {
-      return it->second;
+// Returns the target of a subroutine call at `pc`.  JSR calls stay within the
+// current program bank.
+int CallTarget(int pc, const Instruction& ins) {
+  int value = *ins.arg1.Evaluate();
+  if (ins.mnemonic == M_jsl) {
+    return value;
+  }
+  return (pc & 0xff0000) | (value & 0xffff);
+}
+
+// Returns true if `address` points into ROM, so that code there can be
+// disassembled.  (Calls into RAM are not followed.)
+bool InRom(const Rom& rom, int address) { return rom.Read(address, 1).ok(); }
+
+// Returns the flag state after executing `instruction` at `pc` and continuing
+// to the instruction that follows.  For subroutine calls, this is the state in
+// which the subroutine returns, if a summary for it can be computed.
+FlagState NextFlagState(int pc, const Instruction& instruction,
+                        const FlagState& flag_state,
+                        SubroutineSummaries* summaries) {
+  if (IsCall(instruction) && summaries) {
+    int target = CallTarget(pc, instruction);
+    if (InRom(summaries->rom(), target)) {
+      auto return_state = summaries->ReturnState(target, flag_state);
+      if (return_state.has_value()) {
+        return *return_state;
+      }
     }
-  };
+  }
+  return flag_state.Execute(instruction);
+}
+
+// Calls `visit(address, flag_state)` for each location control can reach
+// after executing `instruction` at `pc` in `flag_state`.
+//
+// If `summaries` is provided, subroutine calls continue in the state their
+// callee returns in, and the callee itself is visited too.
+template <typename Visitor>
+void ForEachSuccessor(int pc, const Instruction& instruction,
+                      const FlagState& flag_state,
+                      SubroutineSummaries* summaries, Visitor visit) {
+  if (IsBranch(instruction)) {
+    visit(BranchTarget(pc, instruction),
+          flag_state.ExecuteBranch(instruction));
+  }
+  if (IsCall(instruction) && summaries) {
+    int target = CallTarget(pc, instruction);
+    if (InRom(summaries->rom(), target)) {
+      visit(target, flag_state);
+    }
+  }
+  if (!IsExitInstruction(instruction)) {
+    int instruction_bytes = InstructionLength(instruction.addressing_mode);
+    visit(AddToPC(pc, instruction_bytes),
+          NextFlagState(pc, instruction, flag_state, summaries));
+  }
+}
+
+// Records the label target of `instruction` at `pc`, if it has one.
+void AddJump(int pc, const Instruction& instruction, const Rom& rom,
+             std::vector<std::pair<int, int>>* jumps) {
+  if (IsBranch(instruction)) {
+    jumps->emplace_back(pc, BranchTarget(pc, instruction));
+  } else if (IsCall(instruction)) {
+    int target = CallTarget(pc, instruction);
+    if (InRom(rom, target)) {
+      jumps->emplace_back(pc, target);
+    }
+  }
+}
 
-  // The flag_state when execution reaches a given address
-  std::map<int, FlagState> entry_state;
+// Decoded instructions, before labels are applied and pseudo-ops are folded.
+struct DecodedCode {
+  Disassembly instructions;
+
+  // Addresses of branch and call instructions, paired with their targets.
+  std::vector<std::pair<int, int>> jumps;
+};
+
+// Single-threaded flag state propagation.
+//
+// Instructions are decoded the first time they are reached.  When an address is
+// reached again with a different flag state, its incoming state is weakened to
+// cover both, and the change is propagated forward.
+//
+// `code` holds instructions already known to be reached, with their states.
+// These are treated as visited, so only changes caused by `entry_points` are
+// propagated.  Control reaching an address in `mode_overrides` enters it in the
+// given state instead of the state it was reached in.
+ErrorOr<DecodedCode> Propagate(const Rom& rom,
+                               const std::vector<EntryPoint>& entry_points,
+                               const std::map<int, FlagState>& mode_overrides,
+                               DecodedCode code) {
+  NSASM_STATS_TIMER(SP_propagate);
+  SubroutineSummaries summaries(rom, mode_overrides);
+  Disassembly& result = code.instructions;
 
   // Map of locations to consider next, and the flag state to use
   // when considering it.
   std::map<int, FlagState> decode_stack;
-  auto add_to_decode_stack = [&decode_stack](int address,
-                                             const FlagState& state) {
+  auto add_to_decode_stack = [&decode_stack, &mode_overrides](
+                                 int address, const FlagState& state) {
+    auto override_iter = mode_overrides.find(address);
+    const FlagState& incoming_state =
+        override_iter == mode_overrides.end() ? state : override_iter->second;
     auto it = decode_stack.find(address);
     if (it == decode_stack.end()) {
-      decode_stack[address] = state;
+      decode_stack[address] = incoming_state;
     } else {
-      it->second |= state;
+      NSASM_STATS_INCREMENT(SC_flag_merges);
+      it->second |= incoming_state;
     }
   };
-  decode_stack[starting_address] = initial_flag_state;
+  for (const EntryPoint& entry_point : entry_points) {
+    add_to_decode_stack(entry_point.address, entry_point.flag_state);
+  }
 
   while (!decode_stack.empty()) {
     // service the lowest instruction we haven't considered
     auto next = *decode_stack.begin();
     decode_stack.erase(decode_stack.begin());
+    NSASM_STATS_INCREMENT(SC_worklist_visits);
 
     int pc = next.first;
     const FlagState& current_flag_state = next.second;
@@ -73,50 +177,30 @@ ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
     if (existing_instruction_iter == result.end()) {
       // This is the first time we've seen this address.  Try to disassemble
       // it.
-      auto instruction_data = rom.Read(pc, 4);
-      NSASM_RETURN_IF_ERROR_WITH_LOCATION(instruction_data, rom.path(), pc);
-      auto instruction = Decode(*instruction_data, current_flag_state);
-      NSASM_RETURN_IF_ERROR_WITH_LOCATION(instruction, rom.path(), pc);
-
-      int instruction_bytes = InstructionLength(instruction->addressing_mode);
-
-      int next_pc = AddToPC(pc, instruction_bytes);
-      const FlagState next_flag_state =
-          current_flag_state.Execute(*instruction);
-
-      // If this instruction is relatively addressed, we need a label, and
-      // need to add that address to code we should try to disassemble.
-      if (instruction->addressing_mode == A_rel8 ||
-          instruction->addressing_mode == A_rel16) {
-        int value = *instruction->arg1.Evaluate();
-        int target = AddToPC(next_pc, value);
-        instruction->arg1.ApplyLabel(get_label(target));
-        const FlagState branch_flag_state =
-            current_flag_state.ExecuteBranch(*instruction);
-        add_to_decode_stack(target, branch_flag_state);
-      }
+      auto instruction = DecodeAt(rom, pc, current_flag_state);
+      NSASM_RETURN_IF_ERROR(instruction);
+
+      AddJump(pc, *instruction, rom, &code.jumps);
+      ForEachSuccessor(pc, *instruction, current_flag_state, &summaries,
+                       add_to_decode_stack);
 
       // We've decoded an instruction!  Store it.
-      DisassembledInstruction di;
+      DisassembledInstruction& di = result[pc];
+      di.next_flag_state =
+          NextFlagState(pc, *instruction, current_flag_state, &summaries);
       di.instruction = std::move(*instruction);
       di.current_flag_state = current_flag_state;
-      di.next_flag_state = next_flag_state;
-      result[pc] = std::move(di);
-
-      // If this instruction doesn't terminate the subroutine, we need to
-      // execute the next line as well.
-      if (!IsExitInstruction(di.instruction)) {
-        add_to_decode_stack(next_pc, next_flag_state);
-      }
     } else {
       // We've been here before.  Weaken the incoming state bits for this
       // instruction to allow for the new input flag state.  If this represents
       // a change, check that the resulting state is still consistent, and
       // propagate the changed flag state bits forward.
       DisassembledInstruction& di = existing_instruction_iter->second;
+      NSASM_STATS_INCREMENT(SC_flag_merges);
       FlagState combined_flag_state =
           current_flag_state | di.current_flag_state;
       if (combined_flag_state != di.current_flag_state) {
+        NSASM_STATS_INCREMENT(SC_weakening_revisits);
         if (!IsConsistent(di.instruction, combined_flag_state)) {
           return Error(
                      "Instruction %s can be reached with inconsistent status "
@@ -125,41 +209,220 @@ ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
               .SetLocation(rom.path(), pc);
         }
         di.current_flag_state = combined_flag_state;
-        di.next_flag_state = combined_flag_state.Execute(di.instruction);
-        int instruction_bytes =
-            InstructionLength(di.instruction.addressing_mode);
-        int next_pc = AddToPC(pc, instruction_bytes);
-        add_to_decode_stack(next_pc, di.next_flag_state);
-        if (di.instruction.addressing_mode == A_rel8 ||
-            di.instruction.addressing_mode == A_rel16) {
-          int value = *di.instruction.arg1.Evaluate();
-          int target = AddToPC(next_pc, value);
-          add_to_decode_stack(
-              target, combined_flag_state.ExecuteBranch(di.instruction));
-        }
+        di.next_flag_state = NextFlagState(pc, di.instruction,
+                                           combined_flag_state, &summaries);
+        ForEachSuccessor(pc, di.instruction, combined_flag_state, &summaries,
+                         add_to_decode_stack);
       }
     }
   }
+  return code;
+}
+
+// Table of incoming flag states for every address in the SNES address space,
+// safe for concurrent use.
+//
+// Each slot holds a packed FlagState, plus bits recording whether the address
+// has been reached and whether it is waiting to be (re)visited.  Merging a new
+// state into a slot only ever weakens it, so merges are done with
+// compare-and-swap, and the final contents do not depend on the order in which
+// merges happen.
+class ConcurrentStateTable {
+ public:
+  static constexpr uint16_t kReached = 0x8000;
+  static constexpr uint16_t kPending = 0x4000;
+  static constexpr uint16_t kStateMask = 0x0fff;
 
-  // Currently all labels are "gensym#"; change them to "label#" in order of
-  // appearance.
-  int i = 0;
-  absl::flat_hash_map<std::string, std::string> label_rewrite;
-  for (auto& node : label_names) {
-    std::string new_label = absl::StrCat("label", ++i);
-    label_rewrite[node.second] = new_label;
-    node.second = new_label;
+  ConcurrentStateTable() {
+    for (auto& bank : banks_) {
+      bank.store(nullptr, std::memory_order_relaxed);
+    }
   }
-  for (auto& node : result) {
-    ExpressionOrNull& arg1 = node.second.instruction.arg1;
-    if (arg1.IsLabel()) {
-      arg1.ApplyLabel(label_rewrite[arg1.ToString()]);
+  ~ConcurrentStateTable() {
+    for (auto& bank : banks_) {
+      delete[] bank.load(std::memory_order_relaxed);
     }
   }
+  ConcurrentStateTable(const ConcurrentStateTable&) = delete;
+  ConcurrentStateTable& operator=(const ConcurrentStateTable&) = delete;
 
-  // Now add labels to all our disassembled instructions.
-  for (const auto& label_name : label_names) {
-    result[label_name.first].label = label_name.second;
+  // Merges `state` into the incoming state for `address`.  Sets
+  // `*first_visit` if the address had not been reached before.  Returns true
+  // if the caller should schedule a visit to `address`: that is, if the
+  // state changed, and no visit was already pending.
+  bool Merge(int address, const FlagState& state, bool* first_visit) {
+    std::atomic<uint16_t>& slot = Slot(address);
+    uint16_t old_value = slot.load(std::memory_order_acquire);
+    while (true) {
+      uint16_t new_value;
+      if (old_value & kReached) {
+        NSASM_STATS_INCREMENT(SC_flag_merges);
+        FlagState merged =
+            FlagState::Unpack(old_value & kStateMask) | state;
+        new_value = (old_value & ~kStateMask) | merged.Pack();
+      } else {
+        new_value = kReached | state.Pack();
+      }
+      if (new_value == old_value) {
+        *first_visit = false;
+        return false;
+      }
+      new_value |= kPending;
+      if (slot.compare_exchange_weak(old_value, new_value,
+                                     std::memory_order_acq_rel)) {
+        *first_visit = !(old_value & kReached);
+        return !(old_value & kPending);
+      }
+    }
+  }
+
+  // Clears the pending bit for `address`, and returns its current state.
+  FlagState BeginVisit(int address) {
+    uint16_t value =
+        Slot(address).fetch_and(~kPending, std::memory_order_acq_rel);
+    return FlagState::Unpack(value & kStateMask);
+  }
+
+  // Returns the state for an address known to be reached.  Not safe to call
+  // while merges are ongoing.
+  FlagState Get(int address) {
+    return FlagState::Unpack(Slot(address).load(std::memory_order_relaxed) &
+                             kStateMask);
+  }
+
+ private:
+  std::atomic<uint16_t>& Slot(int address) {
+    std::atomic<std::atomic<uint16_t>*>& bank_ptr = banks_[address >> 16];
+    std::atomic<uint16_t>* bank = bank_ptr.load(std::memory_order_acquire);
+    if (!bank) {
+      // Zero-initialized: every address starts unreached.
+      auto* fresh = new std::atomic<uint16_t>[0x10000]();
+      if (bank_ptr.compare_exchange_strong(bank, fresh,
+                                           std::memory_order_acq_rel)) {
+        bank = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return bank[address & 0xffff];
+  }
+
+  std::atomic<std::atomic<uint16_t>*> banks_[0x100];
+};
+
+// Multithreaded flag state propagation.
+//
+// Workers visit addresses whose incoming state changed, decode the instruction
+// there, and merge successor states into a shared ConcurrentStateTable.  Since
+// merges are monotone, the fixpoint reached is the same one the sequential
+// algorithm finds.  Instructions are decoded a final time, in address order,
+// once the table is stable.
+//
+// Returns nullopt if any address could not be decoded consistently.  The
+// caller is expected to fall back to `Propagate()` in that case, so that the
+// error reported is deterministic.
+absl::optional<DecodedCode> ParallelPropagate(
+    const Rom& rom, const std::vector<EntryPoint>& entry_points,
+    int num_threads) {
+  NSASM_STATS_TIMER(SP_propagate);
+  if (num_threads <= 0) {
+    num_threads = DefaultThreadCount();
+  }
+  auto table = absl::make_unique<ConcurrentStateTable>();
+  SubroutineSummaries summaries(rom);
+  std::atomic<bool> failed(false);
+
+  // Addresses reached, recorded by the thread that first reached them.
+  std::vector<std::vector<int>> reached(num_threads + 1);
+
+  std::vector<int> initial_tasks;
+  for (const EntryPoint& entry_point : entry_points) {
+    bool first_visit;
+    if (table->Merge(entry_point.address, entry_point.flag_state,
+                     &first_visit)) {
+      initial_tasks.push_back(entry_point.address);
+    }
+    if (first_visit) {
+      reached[num_threads].push_back(entry_point.address);
+    }
+  }
+
+  RunWorkStealing(
+      num_threads, initial_tasks, [&](int worker, int pc, auto push) {
+        if (failed.load(std::memory_order_relaxed)) {
+          return;
+        }
+        NSASM_STATS_INCREMENT(SC_worklist_visits);
+        FlagState flag_state = table->BeginVisit(pc);
+        auto instruction = DecodeAt(rom, pc, flag_state);
+        if (!instruction.ok()) {
+          failed.store(true, std::memory_order_relaxed);
+          return;
+        }
+        ForEachSuccessor(
+            pc, *instruction, flag_state, &summaries,
+            [&](int address, const FlagState& successor_state) {
+              bool first_visit;
+              if (table->Merge(address, successor_state, &first_visit)) {
+                if (!first_visit) {
+                  NSASM_STATS_INCREMENT(SC_weakening_revisits);
+                }
+                push(address);
+              }
+              if (first_visit) {
+                reached[worker].push_back(address);
+              }
+            });
+      });
+  if (failed) {
+    return absl::nullopt;
+  }
+
+  std::vector<int> addresses;
+  for (const auto& worker_reached : reached) {
+    addresses.insert(addresses.end(), worker_reached.begin(),
+                     worker_reached.end());
+  }
+  std::sort(addresses.begin(), addresses.end());
+
+  DecodedCode code;
+  for (int pc : addresses) {
+    FlagState flag_state = table->Get(pc);
+    auto instruction = DecodeAt(rom, pc, flag_state);
+    if (!instruction.ok()) {
+      return absl::nullopt;
+    }
+    AddJump(pc, *instruction, rom, &code.jumps);
+    DisassembledInstruction& di =
+        code.instructions.emplace_hint(code.instructions.end(), pc,
+                                       DisassembledInstruction())
+            ->second;
+    di.next_flag_state =
+        NextFlagState(pc, *instruction, flag_state, &summaries);
+    di.instruction = std::move(*instruction);
+    di.current_flag_state = flag_state;
+  }
+  return code;
+}
+
+// Applies labels to decoded code, and folds pseudo-ops.
+Disassembly Finish(DecodedCode code) {
+  TraceSpan span("finish_disassembly");
+  Disassembly& result = code.instructions;
+
+  // Number the branch and call targets in address order, and point each
+  // jump instruction at the label of its target.
+  std::map<int, int> label_ids;
+  for (const auto& jump : code.jumps) {
+    label_ids[jump.second] = 0;
+  }
+  int next_label_id = 0;
+  for (auto& node : label_ids) {
+    node.second = ++next_label_id;
+    result[node.first].label_id = node.second;
+  }
+  for (const auto& jump : code.jumps) {
+    result[jump.first].instruction.arg1.ApplyLabelId(label_ids[jump.second]);
   }
 
   // Pseudo-op folding.  Merge CLC/ADC and CLC/SBC into ADD and SUB,
@@ -172,7 +435,7 @@ ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
     }
     if (iter->second.instruction.mnemonic == M_clc &&
         next_iter->second.instruction.mnemonic == M_adc &&
-        next_iter->second.label.empty()) {
+        next_iter->second.label_id == 0) {
       iter->second.instruction = std::move(next_iter->second.instruction);
       iter->second.instruction.mnemonic = PM_add;
       iter->second.next_flag_state = next_iter->second.next_flag_state;
@@ -181,7 +444,7 @@ ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
     }
     if (iter->second.instruction.mnemonic == M_clc &&
         next_iter->second.instruction.mnemonic == M_sbc &&
-        next_iter->second.label.empty()) {
+        next_iter->second.label_id == 0) {
       iter->second.instruction = std::move(next_iter->second.instruction);
       iter->second.instruction.mnemonic = PM_sub;
       iter->second.next_flag_state = next_iter->second.next_flag_state;
@@ -191,7 +454,551 @@ ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
     iter = next_iter;
   }
 
+  return std::move(result);
+}
+
+}  // namespace
+
+std::vector<ControlEdge> ControlEdges(const Rom& rom, int pc,
+                                      const Instruction& instruction) {
+  std::vector<ControlEdge> edges;
+  if (IsBranch(instruction)) {
+    edges.push_back({BranchTarget(pc, instruction), E_branch});
+  }
+  const bool is_call = IsCall(instruction);
+  if (is_call) {
+    int target = CallTarget(pc, instruction);
+    if (InRom(rom, target)) {
+      edges.push_back({target, E_call});
+    }
+  }
+  if (!IsExitInstruction(instruction)) {
+    int instruction_bytes = InstructionLength(instruction.addressing_mode);
+    if (instruction.mnemonic == PM_add || instruction.mnemonic == PM_sub) {
+      // Folded CLC instruction
+      ++instruction_bytes;
+    }
+    edges.push_back({AddToPC(pc, instruction_bytes),
+                     is_call ? E_return : E_fallthrough});
+  }
+  return edges;
+}
+
+absl::optional<FlagState> SubroutineSummaries::ReturnState(
+    int address, const FlagState& entry_state) {
+  std::vector<Frame> call_stack;
+  return Summarize(address, entry_state, &call_stack);
+}
+
+absl::optional<FlagState> SubroutineSummaries::Summarize(
+    int address, const FlagState& entry_state, std::vector<Frame>* call_stack) {
+  const uint64_t key = (uint64_t(address) << 16) | entry_state.Pack();
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      return it->second;
+    }
+  }
+
+  // A recursive call.  Every subroutine in the cycle is given the default
+  // summary, regardless of where the cycle was entered.
+  for (size_t i = 0; i < call_stack->size(); ++i) {
+    if ((*call_stack)[i].key == key) {
+      for (size_t j = i; j < call_stack->size(); ++j) {
+        (*call_stack)[j].recursive = true;
+      }
+      return absl::nullopt;
+    }
+  }
+
+  call_stack->push_back({key, false});
+  std::map<int, FlagState> states;
+  absl::optional<FlagState> result =
+      Analyze(address, entry_state, call_stack, &states);
+  bool recursive = call_stack->back().recursive;
+  call_stack->pop_back();
+  absl::MutexLock lock(&mu_);
+  // Recorded even if not cached, since the callers' summaries depend on it.
+  for (const auto& node : states) {
+    visited_.insert(node.first);
+  }
+  if (recursive) {
+    // Not cached: whether the cycle is detected depends on the call stack.
+    return absl::nullopt;
+  }
+  cache_.emplace(key, result);
   return result;
 }
 
+bool SubroutineSummaries::SetModeOverrides(
+    std::map<int, FlagState> mode_overrides) {
+  std::vector<int> changed;
+  for (const auto& node : mode_overrides_) {
+    auto it = mode_overrides.find(node.first);
+    if (it == mode_overrides.end() || it->second != node.second) {
+      changed.push_back(node.first);
+    }
+  }
+  for (const auto& node : mode_overrides) {
+    if (!mode_overrides_.count(node.first)) {
+      changed.push_back(node.first);
+    }
+  }
+  mode_overrides_ = std::move(mode_overrides);
+
+  absl::MutexLock lock(&mu_);
+  for (int address : changed) {
+    if (visited_.count(address)) {
+      cache_.clear();
+      visited_.clear();
+      return true;
+    }
+  }
+  return false;
+}
+
+FlagState SubroutineSummaries::Incoming(int address,
+                                        const FlagState& flag_state) const {
+  auto it = mode_overrides_.find(address);
+  return it == mode_overrides_.end() ? flag_state : it->second;
+}
+
+absl::optional<FlagState> SubroutineSummaries::Analyze(
+    int address, const FlagState& entry_state, std::vector<Frame>* call_stack,
+    std::map<int, FlagState>* states) {
+  // This is the same propagation as `Propagate()`, restricted to the body of
+  // one subroutine; calls it makes are summarized rather than followed.
+  std::map<int, FlagState> worklist;
+  worklist[address] = Incoming(address, entry_state);
+  absl::optional<FlagState> exit_state;
+  int visits = 0;
+
+  while (!worklist.empty()) {
+    int pc = worklist.begin()->first;
+    FlagState flag_state = worklist.begin()->second;
+    worklist.erase(worklist.begin());
+    NSASM_STATS_INCREMENT(SC_worklist_visits);
+
+    auto it = states->find(pc);
+    if (it != states->end()) {
+      NSASM_STATS_INCREMENT(SC_flag_merges);
+      FlagState combined = it->second | flag_state;
+      if (combined == it->second) {
+        continue;
+      }
+      NSASM_STATS_INCREMENT(SC_weakening_revisits);
+      flag_state = combined;
+    }
+    (*states)[pc] = flag_state;
+    if (++visits > kMaxVisits) {
+      return absl::nullopt;
+    }
+
+    auto instruction = DecodeAt(rom_, pc, flag_state);
+    if (!instruction.ok()) {
+      return absl::nullopt;
+    }
+    if (instruction->mnemonic == M_rts || instruction->mnemonic == M_rtl) {
+      exit_state = exit_state.has_value() ? (*exit_state | flag_state)
+                                          : flag_state;
+      continue;
+    }
+    auto add_to_worklist = [this, &worklist](int successor,
+                                             const FlagState& successor_state) {
+      const FlagState incoming_state = Incoming(successor, successor_state);
+      auto it = worklist.find(successor);
+      if (it == worklist.end()) {
+        worklist[successor] = incoming_state;
+      } else {
+        NSASM_STATS_INCREMENT(SC_flag_merges);
+        it->second |= incoming_state;
+      }
+    };
+    if (IsBranch(*instruction)) {
+      add_to_worklist(BranchTarget(pc, *instruction),
+                      flag_state.ExecuteBranch(*instruction));
+    }
+    if (!IsExitInstruction(*instruction)) {
+      FlagState next_state = flag_state.Execute(*instruction);
+      if (IsCall(*instruction)) {
+        int target = CallTarget(pc, *instruction);
+        if (InRom(rom_, target)) {
+          auto return_state = Summarize(target, flag_state, call_stack);
+          if (return_state.has_value()) {
+            next_state = *return_state;
+          }
+        }
+      }
+      add_to_worklist(
+          AddToPC(pc, InstructionLength(instruction->addressing_mode)),
+          next_state);
+    }
+  }
+  return exit_state;
+}
+
+ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
+                                 const FlagState& initial_flag_state) {
+  TraceSpan span("disassemble", "entry_point", starting_address);
+  auto code = Propagate(rom, {{starting_address, initial_flag_state}}, {},
+                        DecodedCode());
+  NSASM_RETURN_IF_ERROR(code);
+  return Finish(std::move(*code));
+}
+
+std::vector<EntryPoint> VectorEntryPoints(const Rom& rom) {
+  std::vector<EntryPoint> entry_points;
+  for (const InterruptVector& vector : rom.Vectors()) {
+    entry_points.push_back({vector.target, vector.flag_state});
+  }
+  return entry_points;
+}
+
+ErrorOr<Disassembly> DisassembleAll(const Rom& rom,
+                                    const std::vector<EntryPoint>& entry_points,
+                                    int num_threads) {
+  TraceSpan span("disassemble_all", "entry_points", entry_points.size());
+  if (num_threads != 1) {
+    auto code = ParallelPropagate(rom, entry_points, num_threads);
+    if (code.has_value()) {
+      return Finish(std::move(*code));
+    }
+  }
+  auto code = Propagate(rom, entry_points, {}, DecodedCode());
+  NSASM_RETURN_IF_ERROR(code);
+  return Finish(std::move(*code));
+}
+
+ErrorOr<Disassembly> ExtendDisassembly(
+    const Rom& rom, const std::vector<EntryPoint>& entry_points,
+    const std::map<int, FlagState>& mode_overrides,
+    std::vector<InstructionStates>* states) {
+  // Rebuild the decoded code from the stored states.  No propagation is
+  // needed: the stored states are already a fixpoint.
+  DecodedCode known;
+  for (const InstructionStates& stored : *states) {
+    auto instruction = DecodeAt(rom, stored.address, stored.current_flag_state);
+    NSASM_RETURN_IF_ERROR(instruction);
+    AddJump(stored.address, *instruction, rom, &known.jumps);
+    DisassembledInstruction& di =
+        known.instructions
+            .emplace_hint(known.instructions.end(), stored.address,
+                          DisassembledInstruction())
+            ->second;
+    di.instruction = std::move(*instruction);
+    di.current_flag_state = stored.current_flag_state;
+    di.next_flag_state = stored.next_flag_state;
+  }
+
+  auto code = Propagate(rom, entry_points, mode_overrides, std::move(known));
+  NSASM_RETURN_IF_ERROR(code);
+  states->clear();
+  for (const auto& node : code->instructions) {
+    states->push_back({node.first, node.second.current_flag_state,
+                       node.second.next_flag_state});
+  }
+  return Finish(std::move(*code));
+}
+
+ErrorOr<int> IncrementalDisassembly::Restore(
+    const std::vector<EntryPoint>& entry_points,
+    const std::map<int, FlagState>& mode_hints,
+    const std::vector<InstructionStates>& states) {
+  entry_points_.clear();
+  for (const EntryPoint& entry_point : entry_points) {
+    auto it = entry_points_.find(entry_point.address);
+    if (it == entry_points_.end()) {
+      entry_points_.emplace(entry_point.address, entry_point.flag_state);
+    } else {
+      it->second |= entry_point.flag_state;
+    }
+  }
+  mode_hints_ = mode_hints;
+  summaries_.SetModeOverrides(mode_hints_);
+  instructions_.clear();
+  predecessors_.clear();
+  worklist_.clear();
+
+  for (const InstructionStates& stored : states) {
+    auto instruction = DecodeAt(rom_, stored.address, stored.current_flag_state);
+    NSASM_RETURN_IF_ERROR(instruction);
+    DisassembledInstruction& di = instructions_[stored.address];
+    di.instruction = std::move(*instruction);
+    di.current_flag_state = stored.current_flag_state;
+    di.next_flag_state = stored.next_flag_state;
+  }
+  for (const auto& node : instructions_) {
+    ForEachSuccessor(node.first, node.second.instruction,
+                     node.second.current_flag_state, &summaries_,
+                     [&](int address, const FlagState&) {
+                       predecessors_[address].push_back(node.first);
+                     });
+  }
+  return int(states.size());
+}
+
+ErrorOr<int> IncrementalDisassembly::SetEntryPoint(
+    const EntryPoint& entry_point) {
+  TraceSpan span("set_entry_point", "address", entry_point.address);
+  const int address = entry_point.address;
+  auto it = entry_points_.find(address);
+  if (it == entry_points_.end()) {
+    entry_points_.emplace(address, entry_point.flag_state);
+    Enqueue(address, entry_point.flag_state);
+    auto visits = Run();
+    if (!visits.ok()) {
+      entry_points_.erase(address);
+      Rebuild();
+    }
+    return visits;
+  }
+
+  const FlagState old_state = it->second;
+  it->second = entry_point.flag_state;
+  ErrorOr<int> visits = 0;
+  if ((old_state | entry_point.flag_state) == entry_point.flag_state) {
+    // Weakening only; propagate forward.
+    Enqueue(address, entry_point.flag_state);
+    visits = Run();
+  } else {
+    visits = Recompute(address);
+  }
+  if (!visits.ok()) {
+    entry_points_[address] = old_state;
+    Rebuild();
+  }
+  return visits;
+}
+
+ErrorOr<int> IncrementalDisassembly::SetModeHint(int address,
+                                                 const FlagState& flag_state) {
+  absl::optional<FlagState> old_hint;
+  auto hint_iter = mode_hints_.find(address);
+  if (hint_iter != mode_hints_.end()) {
+    old_hint = hint_iter->second;
+  }
+  mode_hints_[address] = flag_state;
+
+  auto node = instructions_.find(address);
+  ErrorOr<int> visits = 0;
+  if (summaries_.SetModeOverrides(mode_hints_)) {
+    // The hint is inside a subroutine, and may change the state its callers
+    // continue in, anywhere.
+    visits = Rebuild();
+  } else if (node == instructions_.end()) {
+    // Not reached yet; the hint applies if it ever is.
+    return 0;
+  } else if ((node->second.current_flag_state | flag_state) == flag_state) {
+    // Weakening only; propagate forward.
+    Enqueue(address, flag_state);
+    visits = Run();
+  } else {
+    visits = Recompute(address);
+  }
+  if (!visits.ok()) {
+    if (old_hint.has_value()) {
+      mode_hints_[address] = *old_hint;
+    } else {
+      mode_hints_.erase(address);
+    }
+    summaries_.SetModeOverrides(mode_hints_);
+    Rebuild();
+  }
+  return visits;
+}
+
+ErrorOr<int> IncrementalDisassembly::ClearModeHint(int address) {
+  auto hint_iter = mode_hints_.find(address);
+  if (hint_iter == mode_hints_.end()) {
+    return 0;
+  }
+  const FlagState old_hint = hint_iter->second;
+  mode_hints_.erase(hint_iter);
+  auto visits = summaries_.SetModeOverrides(mode_hints_) ? Rebuild()
+                                                         : Recompute(address);
+  if (!visits.ok()) {
+    mode_hints_[address] = old_hint;
+    summaries_.SetModeOverrides(mode_hints_);
+    Rebuild();
+  }
+  return visits;
+}
+
+std::vector<EntryPoint> IncrementalDisassembly::EntryPoints() const {
+  std::vector<EntryPoint> entry_points;
+  for (const auto& entry_point : entry_points_) {
+    entry_points.push_back({entry_point.first, entry_point.second});
+  }
+  return entry_points;
+}
+
+std::vector<InstructionStates> IncrementalDisassembly::States() const {
+  std::vector<InstructionStates> states;
+  states.reserve(instructions_.size());
+  for (const auto& node : instructions_) {
+    states.push_back({node.first, node.second.current_flag_state,
+                      node.second.next_flag_state});
+  }
+  return states;
+}
+
+Disassembly IncrementalDisassembly::Result() const {
+  DecodedCode code;
+  code.instructions = instructions_;
+  for (const auto& node : instructions_) {
+    AddJump(node.first, node.second.instruction, rom_, &code.jumps);
+  }
+  return Finish(std::move(code));
+}
+
+void IncrementalDisassembly::Enqueue(int address,
+                                     const FlagState& flag_state) {
+  auto hint_iter = mode_hints_.find(address);
+  const FlagState& incoming_state =
+      hint_iter == mode_hints_.end() ? flag_state : hint_iter->second;
+  auto it = worklist_.find(address);
+  if (it == worklist_.end()) {
+    worklist_.emplace(address, incoming_state);
+  } else {
+    NSASM_STATS_INCREMENT(SC_flag_merges);
+    it->second |= incoming_state;
+  }
+}
+
+ErrorOr<int> IncrementalDisassembly::Run() {
+  // This is `Propagate()`, with predecessors recorded as instructions are
+  // decoded.
+  NSASM_STATS_TIMER(SP_propagate);
+  int visits = 0;
+  while (!worklist_.empty()) {
+    int pc = worklist_.begin()->first;
+    FlagState flag_state = worklist_.begin()->second;
+    worklist_.erase(worklist_.begin());
+    ++visits;
+    NSASM_STATS_INCREMENT(SC_worklist_visits);
+
+    auto existing = instructions_.find(pc);
+    if (existing == instructions_.end()) {
+      auto instruction = DecodeAt(rom_, pc, flag_state);
+      if (!instruction.ok()) {
+        worklist_.clear();
+        return instruction.error();
+      }
+      DisassembledInstruction& di = instructions_[pc];
+      di.instruction = std::move(*instruction);
+      di.current_flag_state = flag_state;
+      di.next_flag_state =
+          NextFlagState(pc, di.instruction, flag_state, &summaries_);
+      ForEachSuccessor(pc, di.instruction, flag_state, &summaries_,
+                       [&](int address, const FlagState& successor_state) {
+                         predecessors_[address].push_back(pc);
+                         Enqueue(address, successor_state);
+                       });
+      continue;
+    }
+
+    DisassembledInstruction& di = existing->second;
+    NSASM_STATS_INCREMENT(SC_flag_merges);
+    FlagState combined_flag_state = flag_state | di.current_flag_state;
+    if (combined_flag_state == di.current_flag_state) {
+      continue;
+    }
+    NSASM_STATS_INCREMENT(SC_weakening_revisits);
+    if (!IsConsistent(di.instruction, combined_flag_state)) {
+      worklist_.clear();
+      return Error(
+                 "Instruction %s can be reached with inconsistent status "
+                 "bits, and cannot be consistently decoded.",
+                 di.instruction.ToString())
+          .SetLocation(rom_.path(), pc);
+    }
+    di.current_flag_state = combined_flag_state;
+    di.next_flag_state =
+        NextFlagState(pc, di.instruction, combined_flag_state, &summaries_);
+    ForEachSuccessor(pc, di.instruction, combined_flag_state, &summaries_,
+                     [&](int address, const FlagState& successor_state) {
+                       Enqueue(address, successor_state);
+                     });
+  }
+  return visits;
+}
+
+ErrorOr<int> IncrementalDisassembly::Recompute(int address) {
+  if (!instructions_.count(address)) {
+    auto entry_point = entry_points_.find(address);
+    if (entry_point != entry_points_.end()) {
+      Enqueue(address, entry_point->second);
+    }
+    return Run();
+  }
+
+  // Find the region whose states may depend on the state at `address`: the
+  // code reachable from it.
+  absl::flat_hash_set<int> region = {address};
+  std::vector<int> stack = {address};
+  while (!stack.empty()) {
+    int pc = stack.back();
+    stack.pop_back();
+    const DisassembledInstruction& di = instructions_.at(pc);
+    ForEachSuccessor(pc, di.instruction, di.current_flag_state, &summaries_,
+                     [&](int successor, const FlagState&) {
+                       if (region.insert(successor).second) {
+                         stack.push_back(successor);
+                       }
+                     });
+  }
+
+  // Collect the states flowing into the region from outside it.  Edges from
+  // inside the region are dropped; they are recorded again as the region is
+  // decoded again.
+  std::vector<std::pair<int, FlagState>> seeds;
+  for (int pc : region) {
+    auto preds_iter = predecessors_.find(pc);
+    if (preds_iter == predecessors_.end()) {
+      continue;
+    }
+    std::vector<int>& preds = preds_iter->second;
+    preds.erase(std::remove_if(preds.begin(), preds.end(),
+                               [&region](int pred) {
+                                 return region.count(pred) > 0;
+                               }),
+                preds.end());
+    for (int pred : preds) {
+      const DisassembledInstruction& di = instructions_.at(pred);
+      ForEachSuccessor(pred, di.instruction, di.current_flag_state,
+                       &summaries_,
+                       [&](int successor, const FlagState& successor_state) {
+                         if (successor == pc) {
+                           seeds.emplace_back(pc, successor_state);
+                         }
+                       });
+    }
+  }
+
+  for (int pc : region) {
+    instructions_.erase(pc);
+    auto entry_point = entry_points_.find(pc);
+    if (entry_point != entry_points_.end()) {
+      seeds.emplace_back(pc, entry_point->second);
+    }
+  }
+  for (const auto& seed : seeds) {
+    Enqueue(seed.first, seed.second);
+  }
+  auto visits = Run();
+  NSASM_RETURN_IF_ERROR(visits);
+  return *visits + int(region.size());
+}
+
+ErrorOr<int> IncrementalDisassembly::Rebuild() {
+  instructions_.clear();
+  predecessors_.clear();
+  worklist_.clear();
+  for (const auto& entry_point : entry_points_) {
+    Enqueue(entry_point.first, entry_point.second);
+  }
+  return Run();
+}
+
 }  // namespace nsasm
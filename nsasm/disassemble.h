@@ -1,9 +1,16 @@
 #ifndef NSASM_DISASSEMBLE_H_
 #define NSASM_DISASSEMBLE_H_
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "nsasm/error.h"
 #include "nsasm/flag_state.h"
 #include "nsasm/instruction.h"
@@ -12,7 +19,9 @@
 namespace nsasm {
 
 struct DisassembledInstruction {
-  std::string label;
+  // Nonzero if this instruction is a branch target.  Label ids are assigned
+  // in address order, starting at 1; see `NumberedLabelName()` for printing.
+  int label_id = 0;
   Instruction instruction;
   FlagState current_flag_state;
   FlagState next_flag_state;
@@ -20,9 +29,215 @@ struct DisassembledInstruction {
 
 using Disassembly = std::map<int, DisassembledInstruction>;
 
+// An address where execution can begin, and the processor state on arrival.
+struct EntryPoint {
+  int address;
+  FlagState flag_state;
+};
+
+// Kinds of control flow out of an instruction.
+enum EdgeKind {
+  E_fallthrough,  // to the next instruction
+  E_branch,       // to the target of a relative branch
+  E_call,         // to a subroutine called by JSR or JSL
+  E_return,       // from a subroutine call to the instruction after it
+};
+
+struct ControlEdge {
+  int target;
+  EdgeKind kind;
+};
+
+// Returns the places control can go after the instruction at `pc`, as followed
+// by disassembly.  A call to a subroutine in ROM yields both an E_call edge to
+// the callee, and an E_return edge for the callee's return.
+//
+// Accepts the ADD and SUB pseudo-ops produced by disassembly.
+std::vector<ControlEdge> ControlEdges(const Rom& rom, int pc,
+                                      const Instruction& instruction);
+
+// Memoized summaries of how subroutines change the processor state.
+//
+// A summary maps the flag state on entry to a subroutine to the flag state it
+// returns with (the merged state at each RTS or RTL reachable from its entry.)
+// Summaries are computed on demand, once per (entry address, entry state), so
+// a subroutine shared by many callers is only analyzed once per distinct entry
+// state.  Safe for concurrent use, except for SetModeOverrides().
+//
+// Control reaching an address in the mode overrides, within a subroutine,
+// enters it in the given state, as with `.mode` hints; so a hint inside a
+// subroutine reaches the state its callers continue in.
+class SubroutineSummaries {
+ public:
+  explicit SubroutineSummaries(const Rom& rom,
+                               std::map<int, FlagState> mode_overrides = {})
+      : rom_(rom), mode_overrides_(std::move(mode_overrides)) {}
+  SubroutineSummaries(const SubroutineSummaries&) = delete;
+  SubroutineSummaries& operator=(const SubroutineSummaries&) = delete;
+
+  // Returns the state in which the subroutine at `address` returns when
+  // entered in `entry_state`.
+  //
+  // Returns nullopt if no summary can be computed: the subroutine never
+  // returns, is (mutually) recursive, or cannot be decoded.  Callers should
+  // then assume the subroutine preserves `m` and `x`, as
+  // `FlagState::Execute()` does.
+  absl::optional<FlagState> ReturnState(int address,
+                                        const FlagState& entry_state);
+
+  // Replaces the mode overrides.  If a summary computed so far visited an
+  // address whose override changed, discards all summaries and returns true;
+  // the states their callers continue in may then have changed.
+  bool SetModeOverrides(std::map<int, FlagState> mode_overrides);
+
+  const Rom& rom() const { return rom_; }
+
+ private:
+  // Upper bound on instruction visits when analyzing one subroutine.
+  static constexpr int kMaxVisits = 0x10000;
+
+  struct Frame {
+    uint64_t key;
+    bool recursive;
+  };
+
+  absl::optional<FlagState> Summarize(int address, const FlagState& entry_state,
+                                      std::vector<Frame>* call_stack);
+  // Finds the return state of one subroutine, recording the incoming state
+  // of each address visited in `*states`.
+  absl::optional<FlagState> Analyze(int address, const FlagState& entry_state,
+                                    std::vector<Frame>* call_stack,
+                                    std::map<int, FlagState>* states);
+
+  // Returns the state control enters `address` in, when it reaches it in
+  // `flag_state`.
+  FlagState Incoming(int address, const FlagState& flag_state) const;
+
+  const Rom& rom_;
+  std::map<int, FlagState> mode_overrides_;
+  absl::Mutex mu_;
+  absl::flat_hash_map<uint64_t, absl::optional<FlagState>> cache_
+      ABSL_GUARDED_BY(mu_);
+  // The addresses visited by any summary in `cache_`.
+  absl::flat_hash_set<int> visited_ ABSL_GUARDED_BY(mu_);
+};
+
+// Disassembles the code reachable from `starting_address`.
+//
+// Branches and subroutine calls (JSR and JSL to fixed addresses) are followed.
+// The instruction after a call continues in the state the callee returns in,
+// per `SubroutineSummaries`.
 ErrorOr<Disassembly> Disassemble(const Rom& rom, int starting_address,
                                  const FlagState& initial_flag_state);
 
+// Returns an entry point for each vector in the ROM header, suitable for
+// disassembling a whole ROM with `DisassembleAll()`.
+std::vector<EntryPoint> VectorEntryPoints(const Rom& rom);
+
+// Disassembles all code reachable from any of the given entry points.
+//
+// Entry points are explored concurrently by `num_threads` workers (zero means
+// one per hardware thread.)  The result does not depend on the number of
+// threads used, and matches what a single-threaded traversal would produce.
+ErrorOr<Disassembly> DisassembleAll(const Rom& rom,
+                                    const std::vector<EntryPoint>& entry_points,
+                                    int num_threads = 0);
+
+// Incoming and outgoing flag states of one instruction, as found by flag state
+// propagation.  (This is the analysis underlying a disassembly, before labels
+// and pseudo-ops are applied, and is what `Database` persists.)
+struct InstructionStates {
+  int address;
+  FlagState current_flag_state;
+  FlagState next_flag_state;
+};
+
+// Disassembles code reachable from `entry_points`, resuming from an earlier
+// analysis.
+//
+// `*states` holds the result of an earlier call (or is empty), sorted by
+// address.  Those instructions are treated as already visited, so work is only
+// done where the new entry points change flag states.  Control reaching an
+// address in `mode_overrides` enters it in the given state, as with `.mode`
+// hints; this must be the same set used to compute `*states`.
+//
+// On success, `*states` is replaced with the extended analysis.
+ErrorOr<Disassembly> ExtendDisassembly(
+    const Rom& rom, const std::vector<EntryPoint>& entry_points,
+    const std::map<int, FlagState>& mode_overrides,
+    std::vector<InstructionStates>* states);
+
+// A disassembly that is updated in place as entry points and mode hints
+// change, for interactive use.
+//
+// Each change only revisits the instructions whose flag states it affects.  A
+// change that only weakens the incoming state at an address is propagated
+// forward until states stop changing, as in `Disassemble()`.  Any other change
+// discards the analysis of the code reachable from that address, and recomputes
+// it from the states flowing in from outside that region; immediate operands
+// are re-decoded at their new widths, and instruction starts that are no longer
+// reached are dropped.  A hint inside a summarized subroutine can change the
+// state its callers continue in, so it discards the whole analysis instead.
+//
+// The result is always the same as disassembling from scratch with the current
+// entry points and hints.
+class IncrementalDisassembly {
+ public:
+  explicit IncrementalDisassembly(const Rom& rom)
+      : rom_(rom), summaries_(rom) {}
+  IncrementalDisassembly(const IncrementalDisassembly&) = delete;
+  IncrementalDisassembly& operator=(const IncrementalDisassembly&) = delete;
+
+  // Restores a previous analysis, as saved by `States()`.
+  ErrorOr<int> Restore(const std::vector<EntryPoint>& entry_points,
+                       const std::map<int, FlagState>& mode_hints,
+                       const std::vector<InstructionStates>& states);
+
+  // Adds an entry point, or replaces the flag state of the entry point at the
+  // same address.
+  ErrorOr<int> SetEntryPoint(const EntryPoint& entry_point);
+
+  // Forces the incoming flag state at `address`, or stops forcing it.
+  ErrorOr<int> SetModeHint(int address, const FlagState& flag_state);
+  ErrorOr<int> ClearModeHint(int address);
+
+  // Each of the above returns the number of instructions visited to apply the
+  // change.  If the change cannot be applied (because it leaves an instruction
+  // reachable with inconsistent status bits), it is undone, and the error is
+  // returned.
+
+  std::vector<EntryPoint> EntryPoints() const;
+  const std::map<int, FlagState>& ModeHints() const { return mode_hints_; }
+  std::vector<InstructionStates> States() const;
+
+  // Returns the current disassembly, with labels and pseudo-ops applied.
+  Disassembly Result() const;
+
+ private:
+  // Queues a visit to `address` in `flag_state` (or in the forced state, if
+  // there is a mode hint there.)
+  void Enqueue(int address, const FlagState& flag_state);
+
+  // Visits queued addresses until flag states stop changing.
+  ErrorOr<int> Run();
+
+  // Recomputes the analysis of the code reachable from `address`.
+  ErrorOr<int> Recompute(int address);
+
+  // Recomputes the analysis from scratch.
+  ErrorOr<int> Rebuild();
+
+  const Rom& rom_;
+  SubroutineSummaries summaries_;
+  std::map<int, FlagState> entry_points_;
+  std::map<int, FlagState> mode_hints_;
+  // Decoded instructions, without labels applied.
+  Disassembly instructions_;
+  // The instructions that can transfer control to each address.
+  absl::flat_hash_map<int, std::vector<int>> predecessors_;
+  std::map<int, FlagState> worklist_;
 };
 
+}  // namespace nsasm
+
 #endif  // NSASM_DISASSEMBLE_H_
@@ -0,0 +1,288 @@
+#include "nsasm/disassemble.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nsasm/expression.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+TEST(Disassemble, labels_numbered_in_address_order) {
+  Rom rom = MakeRom({
+      0xe2, 0x30,  // 8000: SEP #$30
+      0xa9, 0x01,  // 8002: LDA #$01
+      0xf0, 0x05,  // 8004: BEQ $800b
+      0xa2, 0x05,  // 8006: LDX #$05
+      0xca,        // 8008: DEX
+      0xd0, 0xfd,  // 8009: BNE $8008
+      0x60,        // 800b: RTS
+  });
+  auto disassembly = Disassemble(rom, 0x008000, FlagState());
+  NSASM_ASSERT_OK(disassembly);
+  ASSERT_EQ(disassembly->size(), 7);
+
+  // $800b is discovered first, but labels are numbered by address.
+  EXPECT_EQ(disassembly->at(0x8008).label_id, 1);
+  EXPECT_EQ(disassembly->at(0x800b).label_id, 2);
+  for (int pc : {0x8000, 0x8002, 0x8004, 0x8006, 0x8009}) {
+    EXPECT_EQ(disassembly->at(pc).label_id, 0);
+  }
+
+  EXPECT_EQ(disassembly->at(0x8004).instruction.ToString(), "BEQ label2");
+  EXPECT_EQ(disassembly->at(0x8009).instruction.ToString(), "BNE label1");
+  EXPECT_EQ(disassembly->at(0x8009).instruction.arg1.LabelId(), 1);
+  // Labels still evaluate to the original branch offset
+  EXPECT_EQ(*disassembly->at(0x8009).instruction.arg1.Evaluate(), -3);
+}
+
+TEST(Disassemble, flag_state_and_pseudo_ops) {
+  Rom rom = MakeRom({
+      0xc2, 0x20,        // 8000: REP #$20
+      0x18,              // 8002: CLC
+      0x69, 0x34, 0x12,  // 8003: ADC #$1234
+      0x6b,              // 8006: RTL
+  });
+  auto disassembly =
+      Disassemble(rom, 0x008000, FlagState(B_off, B_on, B_on));
+  NSASM_ASSERT_OK(disassembly);
+  ASSERT_EQ(disassembly->size(), 3);
+  EXPECT_EQ(disassembly->at(0x8002).instruction.ToString(), "ADD #$1234");
+  EXPECT_EQ(disassembly->at(0x8002).current_flag_state.ToName(), "m16x8");
+  EXPECT_EQ(disassembly->at(0x8006).instruction.ToString(), "RTL");
+}
+
+TEST(Disassemble, inconsistent_state) {
+  Rom rom = MakeRom({
+      0xf0, 0x02,  // 8000: BEQ $8004
+      0xc2, 0x20,  // 8002: REP #$20
+      0xa9, 0x00,  // 8004: LDA #$00 -- reachable in m8 or m16
+      0x00, 0x60,
+  });
+  auto disassembly = Disassemble(rom, 0x008000, FlagState(B_off, B_on, B_on));
+  EXPECT_FALSE(disassembly.ok());
+}
+
+TEST(Disassemble, disassemble_all) {
+  Rom rom = MakeRom({
+      0xe2, 0x30,        // 8000: SEP #$30
+      0xa9, 0x01,        // 8002: LDA #$01
+      0x80, 0x04,        // 8004: BRA $800a
+      0xc2, 0x20,        // 8006: REP #$20      (second entry point)
+      0xa9, 0x00, 0x00,  // 8008: LDA #$0000    (overlaps first BRA target)
+      0xea,              // 800b: NOP
+      0xd0, 0xf2,        // 800c: BNE $8000
+      0x60,              // 800e: RTS
+  });
+  std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)},
+      {0x8006, FlagState(B_off, B_on, B_on)},
+  };
+
+  auto sequential = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(sequential);
+  EXPECT_EQ(sequential->count(0x800a), 1);
+  EXPECT_EQ(sequential->count(0x8008), 1);
+  for (int threads : {2, 3, 8}) {
+    SCOPED_TRACE(threads);
+    for (int run = 0; run < 10; ++run) {
+      auto parallel = DisassembleAll(rom, entry_points, threads);
+      NSASM_ASSERT_OK(parallel);
+      EXPECT_EQ(RenderDisassembly(*parallel), RenderDisassembly(*sequential));
+    }
+  }
+
+  // A single entry point matches Disassemble().
+  auto single = Disassemble(rom, 0x8000, entry_points[0].flag_state);
+  NSASM_ASSERT_OK(single);
+  auto single_all = DisassembleAll(rom, {entry_points[0]}, 4);
+  NSASM_ASSERT_OK(single_all);
+  EXPECT_EQ(RenderDisassembly(*single_all), RenderDisassembly(*single));
+}
+
+TEST(Disassemble, disassemble_all_error) {
+  Rom rom = MakeRom({
+      0xa9, 0x00,  // 8000: LDA #$00, reachable in m8 and m16
+      0x60,        // 8002: RTS
+  });
+  std::vector<EntryPoint> entry_points = {
+      {0x8000, FlagState(B_off, B_on, B_on)},
+      {0x8000, FlagState(B_off, B_off, B_on)},
+  };
+  auto sequential = DisassembleAll(rom, entry_points, 1);
+  ASSERT_FALSE(sequential.ok());
+  for (int threads : {2, 4}) {
+    auto parallel = DisassembleAll(rom, entry_points, threads);
+    ASSERT_FALSE(parallel.ok());
+    EXPECT_EQ(parallel.error().ToString(), sequential.error().ToString());
+  }
+}
+
+TEST(Disassemble, subroutine_summaries) {
+  Rom rom = MakeRom({
+      0x20, 0x10, 0x80,  // 8000: JSR $8010
+      0xa9, 0x34, 0x12,  // 8003: LDA #$1234  -- m16 after the call
+      0x20, 0x10, 0x80,  // 8006: JSR $8010
+      0x60,              // 8009: RTS
+      0, 0, 0, 0, 0, 0,  // 800a
+      0xc2, 0x20,        // 8010: REP #$20
+      0x60,              // 8012: RTS
+  });
+  auto disassembly = Disassemble(rom, 0x8000, FlagState(B_off, B_on, B_on));
+  NSASM_ASSERT_OK(disassembly);
+  ASSERT_EQ(disassembly->size(), 6);
+  EXPECT_EQ(disassembly->at(0x8000).next_flag_state.ToName(), "m16x8");
+  EXPECT_EQ(disassembly->at(0x8003).instruction.ToString(), "LDA #$1234");
+  EXPECT_EQ(disassembly->at(0x8010).label_id, 1);
+  EXPECT_EQ(disassembly->at(0x8000).instruction.ToString(), "JSR label1");
+  EXPECT_EQ(disassembly->at(0x8006).instruction.ToString(), "JSR label1");
+
+  // The subroutine is entered in both m8 and m16.
+  EXPECT_EQ(disassembly->at(0x8010).current_flag_state.ToString(),
+            FlagState(B_off, B_unknown, B_on).ToString());
+
+  auto parallel = DisassembleAll(rom, {{0x8000, FlagState(B_off, B_on, B_on)}},
+                                 4);
+  NSASM_ASSERT_OK(parallel);
+  EXPECT_EQ(RenderDisassembly(*parallel), RenderDisassembly(*disassembly));
+}
+
+TEST(Disassemble, subroutine_summary_fallbacks) {
+  Rom rom = MakeRom({
+      0x20, 0x00, 0x80,        // 8000: JSR $8000  -- recursive
+      0x60,                    // 8003: RTS
+      0x80, 0xfe,              // 8004: BRA $8004  -- never returns
+      0x22, 0x00, 0x00, 0x7e,  // 8006: JSL $7e0000  -- into RAM
+      0x60,                    // 800a: RTS
+  });
+  const FlagState m8(B_off, B_on, B_on);
+  SubroutineSummaries summaries(rom);
+  EXPECT_FALSE(summaries.ReturnState(0x8000, m8).has_value());
+  EXPECT_FALSE(summaries.ReturnState(0x8004, m8).has_value());
+  auto return_state = summaries.ReturnState(0x8006, m8);
+  ASSERT_TRUE(return_state.has_value());
+  EXPECT_EQ(return_state->ToString(), m8.ToString());
+
+  // Calls without a summary assume the callee preserves the state.
+  auto disassembly = Disassemble(rom, 0x8000, m8);
+  NSASM_ASSERT_OK(disassembly);
+  EXPECT_EQ(disassembly->at(0x8000).next_flag_state.ToString(), m8.ToString());
+}
+
+TEST(IncrementalDisassembly, mode_hints) {
+  Rom rom = MakeRom({
+      0xe2, 0x30,              // 8000: SEP #$30
+      0x22, 0x00, 0x00, 0x7e,  // 8002: JSL $7e0000  -- RAM routine sets m16
+      0xa9, 0x60, 0x60,        // 8006: LDA #$6060
+      0x60,                    // 8009: RTS
+      0xea, 0xea, 0xea, 0xea,  // 800a: unrelated code
+      0x80, 0xf2,              // 800e: BRA $8002
+  });
+  const FlagState m8(B_off, B_on, B_on);
+  const FlagState m16(B_off, B_off, B_on);
+
+  IncrementalDisassembly incremental(rom);
+  NSASM_ASSERT_OK(incremental.SetEntryPoint({0x8000, FlagState()}));
+  NSASM_ASSERT_OK(incremental.SetEntryPoint({0x800a, m8}));
+  const std::string before = RenderDisassembly(incremental.Result());
+  EXPECT_EQ(incremental.Result().at(0x8006).instruction.ToString(),
+            "LDA #$60");
+  EXPECT_EQ(incremental.Result().count(0x8008), 1);
+
+  // Only the code reachable from the hint is visited.
+  auto visits = incremental.SetModeHint(0x8006, m16);
+  NSASM_ASSERT_OK(visits);
+  EXPECT_LE(*visits, 6);
+  Disassembly after = incremental.Result();
+  EXPECT_EQ(after.at(0x8006).instruction.ToString(), "LDA #$6060");
+  EXPECT_EQ(after.count(0x8008), 0);  // stale instruction start
+  EXPECT_EQ(after.count(0x8009), 1);
+
+  // Same as applying the hint before any propagation.
+  IncrementalDisassembly from_scratch(rom);
+  NSASM_ASSERT_OK(from_scratch.SetModeHint(0x8006, m16));
+  NSASM_ASSERT_OK(from_scratch.SetEntryPoint({0x8000, FlagState()}));
+  NSASM_ASSERT_OK(from_scratch.SetEntryPoint({0x800a, m8}));
+  EXPECT_EQ(RenderDisassembly(from_scratch.Result()), RenderDisassembly(after));
+
+  NSASM_ASSERT_OK(incremental.ClearModeHint(0x8006));
+  EXPECT_EQ(RenderDisassembly(incremental.Result()), before);
+}
+
+TEST(IncrementalDisassembly, mode_hints_in_callees) {
+  Rom rom = MakeRom({
+      0x20, 0x10, 0x80,  // 8000: JSR $8010
+      0xa9, 0x34, 0x12,  // 8003: LDA #$1234, or LDA #$34; ORA ($60)
+      0x60,              // 8006: RTS
+      0x60,              // 8007: RTS
+      0, 0, 0, 0, 0, 0, 0, 0,  // 8008
+      0xea,              // 8010: NOP
+      0x60,              // 8011: RTS
+  });
+  const FlagState m8(B_off, B_on, B_on);
+  const FlagState m16(B_off, B_off, B_on);
+
+  IncrementalDisassembly incremental(rom);
+  NSASM_ASSERT_OK(incremental.SetEntryPoint({0x8000, m8}));
+  const std::string before = RenderDisassembly(incremental.Result());
+  EXPECT_EQ(incremental.Result().at(0x8003).instruction.ToString(),
+            "LDA #$34");
+
+  // The hint reaches the caller through the callee's summary.
+  NSASM_ASSERT_OK(incremental.SetModeHint(0x8011, m16));
+  Disassembly after = incremental.Result();
+  EXPECT_EQ(after.at(0x8003).instruction.ToString(), "LDA #$1234");
+  EXPECT_EQ(after.at(0x8003).current_flag_state.ToName(), "m16x8");
+
+  IncrementalDisassembly from_scratch(rom);
+  NSASM_ASSERT_OK(from_scratch.SetModeHint(0x8011, m16));
+  NSASM_ASSERT_OK(from_scratch.SetEntryPoint({0x8000, m8}));
+  EXPECT_EQ(RenderDisassembly(from_scratch.Result()),
+            RenderDisassembly(after));
+
+  std::vector<InstructionStates> states;
+  auto extended = ExtendDisassembly(rom, {{0x8000, m8}},
+                                    incremental.ModeHints(), &states);
+  NSASM_ASSERT_OK(extended);
+  EXPECT_EQ(RenderDisassembly(*extended), RenderDisassembly(after));
+
+  NSASM_ASSERT_OK(incremental.ClearModeHint(0x8011));
+  EXPECT_EQ(RenderDisassembly(incremental.Result()), before);
+}
+
+TEST(IncrementalDisassembly, entry_points) {
+  Rom rom = MakeRom({
+      0xa2, 0x01,  // 8000: LDX #$01
+      0xca,        // 8002: DEX
+      0xd0, 0xfd,  // 8003: BNE $8002
+      0x60,        // 8005: RTS
+  });
+  const FlagState x8(B_off, B_on, B_on);
+  const FlagState x16(B_off, B_on, B_off);
+  IncrementalDisassembly incremental(rom);
+  NSASM_ASSERT_OK(incremental.SetEntryPoint({0x8000, x8}));
+  EXPECT_EQ(incremental.Result().at(0x8002).current_flag_state.ToName(),
+            "m8x8");
+
+  // Replacing the entry state re-decodes the immediate operand.
+  NSASM_ASSERT_OK(incremental.SetEntryPoint({0x8000, x16}));
+  auto expected = Disassemble(rom, 0x8000, x16);
+  NSASM_ASSERT_OK(expected);
+  EXPECT_EQ(RenderDisassembly(incremental.Result()),
+            RenderDisassembly(*expected));
+
+  // Weakening to an inconsistent state fails, and leaves the disassembly as it
+  // was.
+  const std::string before = RenderDisassembly(incremental.Result());
+  EXPECT_FALSE(
+      incremental.SetEntryPoint({0x8000, FlagState(B_off, B_on, B_unknown)})
+          .ok());
+  EXPECT_EQ(RenderDisassembly(incremental.Result()), before);
+  EXPECT_EQ(incremental.EntryPoints()[0].flag_state.ToName(), "m8x16");
+}
+
+}  // namespace
+}  // namespace nsasm
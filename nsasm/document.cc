@@ -0,0 +1,203 @@
+#include "nsasm/document.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+namespace {
+
+// Matches the identifier characters accepted by Tokenize().
+bool IsWordChar(char ch) {
+  return absl::ascii_isalnum(ch) || ch == '_' || ch == '.';
+}
+
+}  // namespace
+
+SourceDocument::SourceDocument(std::string path, absl::string_view text)
+    : path_(std::move(path)) {
+  SetText(text);
+}
+
+void SourceDocument::SetText(absl::string_view text) {
+  ReplaceLines(0, lines_.size(), text);
+}
+
+void SourceDocument::Edit(Position start, Position end,
+                          absl::string_view text) {
+  const int last_line = lines_.size() - 1;
+  auto clamp = [this, last_line](Position* position) {
+    if (position->line > last_line) {
+      position->line = last_line;
+      position->column = lines_[last_line]->text.size();
+    }
+    position->line = std::max(position->line, 0);
+    position->column =
+        std::min<int>(std::max(position->column, 0),
+                      lines_[position->line]->text.size());
+  };
+  clamp(&start);
+  clamp(&end);
+  if (std::tie(end.line, end.column) < std::tie(start.line, start.column)) {
+    end = start;
+  }
+
+  std::string replacement = lines_[start.line]->text.substr(0, start.column);
+  replacement.append(text.data(), text.size());
+  replacement.append(lines_[end.line]->text, end.column, std::string::npos);
+  ReplaceLines(start.line, end.line + 1, replacement);
+}
+
+std::string SourceDocument::Text() const {
+  std::string text;
+  for (const auto& line : lines_) {
+    if (line->number > 0) {
+      text.push_back('\n');
+    }
+    text.append(line->text);
+  }
+  return text;
+}
+
+std::vector<int> SourceDocument::ErrorLines() const {
+  std::vector<int> result;
+  for (const Line* line : error_lines_) {
+    result.push_back(line->number);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+std::vector<int> SourceDocument::Definitions(absl::string_view label) const {
+  std::vector<int> result;
+  auto it = labels_.find(label);
+  if (it != labels_.end()) {
+    for (const Line* line : it->second) {
+      result.push_back(line->number);
+    }
+    std::sort(result.begin(), result.end());
+  }
+  return result;
+}
+
+absl::string_view SourceDocument::WordAt(Position position) const {
+  if (position.line < 0 || position.line >= LineCount()) {
+    return "";
+  }
+  absl::string_view text = lines_[position.line]->text;
+  size_t begin = std::min<size_t>(std::max(position.column, 0), text.size());
+  size_t end = begin;
+  while (begin > 0 && IsWordChar(text[begin - 1])) {
+    --begin;
+  }
+  while (end < text.size() && IsWordChar(text[end])) {
+    ++end;
+  }
+  return text.substr(begin, end - begin);
+}
+
+void SourceDocument::ReplaceLines(int begin, int end,
+                                  absl::string_view text) {
+  for (int i = begin; i < end; ++i) {
+    RemoveFromIndex(lines_[i].get());
+  }
+
+  std::vector<std::unique_ptr<Line>> replacements;
+  int number = begin;
+  for (absl::string_view line_text : absl::StrSplit(text, '\n')) {
+    replacements.push_back(AssembleLine(std::string(line_text), number++));
+  }
+  const int count = replacements.size();
+
+  // Overwrite the replaced lines in place, and insert or erase the
+  // difference.
+  const int overlap = std::min(count, end - begin);
+  std::move(replacements.begin(), replacements.begin() + overlap,
+            lines_.begin() + begin);
+  if (count > overlap) {
+    lines_.insert(lines_.begin() + end,
+                  std::make_move_iterator(replacements.begin() + overlap),
+                  std::make_move_iterator(replacements.end()));
+  } else if (end - begin > overlap) {
+    lines_.erase(lines_.begin() + begin + overlap, lines_.begin() + end);
+  }
+  if (count != end - begin) {
+    for (int i = begin + count; i < LineCount(); ++i) {
+      lines_[i]->number = i;
+    }
+  }
+
+  for (int i = begin; i < begin + count; ++i) {
+    AddToIndex(lines_[i].get());
+  }
+  PropagateFlagStates(begin, begin + count);
+}
+
+std::unique_ptr<SourceDocument::Line> SourceDocument::AssembleLine(
+    std::string text, int number) {
+  ++lines_assembled_;
+  auto line = absl::make_unique<Line>();
+  line->text = std::move(text);
+  line->number = number;
+  // Clients may send CRLF line endings.
+  auto statements = nsasm::AssembleLine(
+      absl::StripSuffix(line->text, "\r"), Location{path_, number + 1});
+  if (statements.ok()) {
+    line->statements = std::move(*statements);
+  } else {
+    line->error = statements.error();
+  }
+  return line;
+}
+
+void SourceDocument::AddToIndex(const Line* line) {
+  if (line->error.has_value()) {
+    error_lines_.insert(line);
+  }
+  for (const Statement& statement : line->statements) {
+    if (absl::holds_alternative<std::string>(statement)) {
+      labels_[absl::get<std::string>(statement)].push_back(line);
+    }
+  }
+}
+
+void SourceDocument::RemoveFromIndex(const Line* line) {
+  error_lines_.erase(line);
+  for (const Statement& statement : line->statements) {
+    if (absl::holds_alternative<std::string>(statement)) {
+      auto it = labels_.find(absl::get<std::string>(statement));
+      if (it == labels_.end()) {
+        continue;
+      }
+      auto& lines = it->second;
+      lines.erase(std::remove(lines.begin(), lines.end(), line), lines.end());
+      if (lines.empty()) {
+        labels_.erase(it);
+      }
+    }
+  }
+}
+
+void SourceDocument::PropagateFlagStates(int begin, int end) {
+  FlagState state = begin == 0 ? FlagState()
+                               : StatementsExitState(
+                                     lines_[begin - 1]->entry_state,
+                                     lines_[begin - 1]->statements);
+  for (int i = begin; i < LineCount(); ++i) {
+    Line& line = *lines_[i];
+    if (i >= end && line.entry_state == state) {
+      break;
+    }
+    ++flag_states_computed_;
+    line.entry_state = state;
+    state = StatementsExitState(state, line.statements);
+  }
+}
+
+}  // namespace nsasm
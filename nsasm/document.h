@@ -0,0 +1,126 @@
+#ifndef NSASM_DOCUMENT_H_
+#define NSASM_DOCUMENT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "nsasm/error.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/workspace.h"
+
+namespace nsasm {
+
+// A source file being edited, kept assembled line by line.
+//
+// Since Tokenize() and Assemble() see one line at a time, an edit only
+// reassembles the lines it touches.  The label table is updated from the
+// labels of the replaced and replacing lines, and inferred flag states are
+// recomputed from the first edited line forward, stopping at the first
+// unedited line whose incoming state is unchanged.
+//
+// Flag states are inferred from straight-line code: each line starts in the
+// state the previous line left, as changed by its instructions (see
+// FlagState::Execute()) and `.mode` and `.entry` directives.  The line after
+// an unconditional jump or return starts in an unknown state.  Branches into
+// a line are not considered.
+//
+// Lines and columns are numbered from zero.  Columns count bytes.
+class SourceDocument {
+ public:
+  struct Position {
+    int line = 0;
+    int column = 0;
+  };
+
+  explicit SourceDocument(std::string path, absl::string_view text = "");
+
+  SourceDocument(const SourceDocument&) = delete;
+  SourceDocument& operator=(const SourceDocument&) = delete;
+
+  // Replaces the whole document.
+  void SetText(absl::string_view text);
+
+  // Replaces the text from `start` up to `end` with `text`.  Positions past
+  // the end of a line, or of the document, are clamped.
+  void Edit(Position start, Position end, absl::string_view text);
+
+  // Returns the document's full text.
+  std::string Text() const;
+
+  const std::string& path() const { return path_; }
+  int LineCount() const { return lines_.size(); }
+  const std::string& LineText(int line) const { return lines_[line]->text; }
+
+  // Returns the statements on `line`; empty if it failed to assemble.
+  const std::vector<Statement>& LineStatements(int line) const {
+    return lines_[line]->statements;
+  }
+
+  // Returns the error assembling `line`, if any.
+  const absl::optional<Error>& LineError(int line) const {
+    return lines_[line]->error;
+  }
+
+  // Returns the lines with errors, in order.
+  std::vector<int> ErrorLines() const;
+
+  // Returns the lines defining `label`, in order.
+  std::vector<int> Definitions(absl::string_view label) const;
+
+  // Returns the flag state inferred on entry to `line`.
+  const FlagState& FlagStateAt(int line) const {
+    return lines_[line]->entry_state;
+  }
+
+  // Returns the identifier (label name) under `position`, or an empty string.
+  absl::string_view WordAt(Position position) const;
+
+  // Running totals, for checking that edits are incremental.
+  int64_t lines_assembled() const { return lines_assembled_; }
+  int64_t flag_states_computed() const { return flag_states_computed_; }
+
+ private:
+  struct Line {
+    std::string text;
+    int number = 0;
+    std::vector<Statement> statements;
+    absl::optional<Error> error;
+    FlagState entry_state;
+  };
+
+  // Replaces lines [begin, end) with the lines of `text`, and brings labels,
+  // line numbers and flag states up to date.
+  void ReplaceLines(int begin, int end, absl::string_view text);
+
+  std::unique_ptr<Line> AssembleLine(std::string text, int number);
+
+  // Add or remove a line's entries in `labels_` and `error_lines_`.
+  void AddToIndex(const Line* line);
+  void RemoveFromIndex(const Line* line);
+
+  // Recomputes entry states from line `begin`.  Lines before `end` are
+  // always updated.
+  void PropagateFlagStates(int begin, int end);
+
+  std::string path_;
+  // Line pointers are stable across edits, so the label table can refer to
+  // them.
+  std::vector<std::unique_ptr<Line>> lines_;
+  absl::flat_hash_map<std::string, std::vector<const Line*>> labels_;
+  // Lines that failed to assemble; usually few, so diagnostics need not scan
+  // the whole document.
+  absl::flat_hash_set<const Line*> error_lines_;
+  int64_t lines_assembled_ = 0;
+  int64_t flag_states_computed_ = 0;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_DOCUMENT_H_
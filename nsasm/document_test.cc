@@ -0,0 +1,119 @@
+#include "nsasm/document.h"
+
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace nsasm {
+namespace {
+
+constexpr char kSource[] =
+    "start: .entry m8x8\n"
+    "  REP #$30\n"
+    "loop: LDA #$1234\n"
+    "  BRA loop\n"
+    "other:\n"
+    "  SEP #$20\n"
+    "  NOP";
+
+TEST(SourceDocument, assembles_lines) {
+  SourceDocument document("test.s", kSource);
+  ASSERT_EQ(document.LineCount(), 7);
+  EXPECT_EQ(document.Text(), kSource);
+  EXPECT_EQ(document.LineStatements(2).size(), 2);
+  EXPECT_THAT(document.ErrorLines(), IsEmpty());
+  EXPECT_THAT(document.Definitions("loop"), ElementsAre(2));
+  EXPECT_THAT(document.Definitions("missing"), IsEmpty());
+  EXPECT_EQ(document.WordAt({3, 8}), "loop");
+  EXPECT_EQ(document.WordAt({3, 2}), "BRA");
+  EXPECT_EQ(document.WordAt({4, 6}), "");
+}
+
+TEST(SourceDocument, flag_states) {
+  SourceDocument document("test.s", kSource);
+  EXPECT_EQ(document.FlagStateAt(0), FlagState());
+  EXPECT_EQ(document.FlagStateAt(1).ToName(), "m8x8");
+  EXPECT_EQ(document.FlagStateAt(2).ToName(), "m16x16");
+  // After BRA, the state is unknown.
+  EXPECT_EQ(document.FlagStateAt(4).ToName(), "unk");
+  EXPECT_EQ(document.FlagStateAt(6).MBit(), B_on);
+}
+
+TEST(SourceDocument, edits) {
+  SourceDocument document("test.s", kSource);
+  // Rename a label.
+  document.Edit({2, 0}, {2, 4}, "top");
+  EXPECT_EQ(document.LineText(2), "top: LDA #$1234");
+  EXPECT_THAT(document.Definitions("loop"), IsEmpty());
+  EXPECT_THAT(document.Definitions("top"), ElementsAre(2));
+
+  // Insert two lines, one of them bad.
+  document.Edit({1, 0}, {1, 0}, "extra: LDA (\n  SEP #$10\n");
+  ASSERT_EQ(document.LineCount(), 9);
+  EXPECT_THAT(document.ErrorLines(), ElementsAre(1));
+  EXPECT_TRUE(document.LineError(1).has_value());
+  EXPECT_THAT(document.Definitions("top"), ElementsAre(4));
+  EXPECT_THAT(document.Definitions("other"), ElementsAre(6));
+  EXPECT_THAT(document.Definitions("extra"), IsEmpty());
+
+  // Join lines across a newline.
+  document.Edit({1, 12}, {2, 0}, "");
+  EXPECT_EQ(document.LineText(1), "extra: LDA (  SEP #$10");
+  EXPECT_EQ(document.LineCount(), 8);
+  EXPECT_THAT(document.Definitions("other"), ElementsAre(5));
+
+  // Delete the bad line.
+  document.Edit({1, 0}, {2, 0}, "");
+  EXPECT_EQ(document.Text(),
+            "start: .entry m8x8\n"
+            "  REP #$30\n"
+            "top: LDA #$1234\n"
+            "  BRA loop\n"
+            "other:\n"
+            "  SEP #$20\n"
+            "  NOP");
+  EXPECT_THAT(document.ErrorLines(), IsEmpty());
+
+  // Positions past the end are clamped.
+  document.Edit({100, 0}, {200, 0}, "\nend:");
+  EXPECT_THAT(document.Definitions("end"), ElementsAre(7));
+
+  document.SetText("");
+  EXPECT_EQ(document.LineCount(), 1);
+  EXPECT_THAT(document.Definitions("top"), IsEmpty());
+}
+
+TEST(SourceDocument, incremental) {
+  std::string text;
+  constexpr int kLines = 10000;
+  for (int i = 0; i < kLines; ++i) {
+    absl::StrAppendFormat(&text, "label%d: LDA #$12\n", i);
+  }
+  SourceDocument document("test.s", text);
+  EXPECT_EQ(document.lines_assembled(), kLines + 1);
+  const int64_t assembled = document.lines_assembled();
+  const int64_t computed = document.flag_states_computed();
+
+  // An edit that does not change flag states touches one line.
+  document.Edit({5000, 0}, {5000, 0}, "x");
+  EXPECT_EQ(document.lines_assembled(), assembled + 1);
+  EXPECT_EQ(document.flag_states_computed(), computed + 1);
+  EXPECT_THAT(document.Definitions("xlabel5000"), ElementsAre(5000));
+
+  // One that does propagates to the end of the file.
+  document.Edit({5000, 0}, {5000, 0}, "SEP #$20 : ");
+  EXPECT_EQ(document.LineText(5000), "SEP #$20 : xlabel5000: LDA #$12");
+  EXPECT_EQ(document.FlagStateAt(kLines - 1).MBit(), B_on);
+
+  // Inserting a line renumbers the labels after it.
+  document.Edit({10, 0}, {10, 0}, "\n");
+  EXPECT_THAT(document.Definitions("label9999"), ElementsAre(10000));
+}
+
+}  // namespace
+}  // namespace nsasm
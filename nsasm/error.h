@@ -43,6 +43,10 @@ class Error {
 
   std::string ToString() const;
 
+  // The message and location, separately.
+  const std::string& message() const { return message_; }
+  const Location& location() const { return location_; }
+
   bool operator==(const Error& rhs) const {
     return message_ == rhs.message_;
   }
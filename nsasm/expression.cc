@@ -1,21 +1,26 @@
 #include "nsasm/expression.h"
 
-#include "absl/strings/str_format.h"
-
 namespace nsasm {
 
-std::string Literal::ToString(NumericType type = T_unknown) const {
+void Literal::AppendTo(std::string* output, NumericType type) const {
   NumericType output_type = (type == T_unknown) ? type_ : type;
   int output_value = CastTo(output_type, value_);
   switch (output_type) {
     case T_byte:
-      return absl::StrFormat("$%02x", output_value);
+      output->push_back('$');
+      AppendHex(output_value, 2, output);
+      return;
     case T_word:
-      return absl::StrFormat("$%04x", output_value);
+      output->push_back('$');
+      AppendHex(output_value, 4, output);
+      return;
     case T_long:
-      return absl::StrFormat("$%06x", output_value);
+      output->push_back('$');
+      AppendHex(output_value, 6, output);
+      return;
     default:
-      return absl::StrFormat("%d", output_value);
+      AppendDecimal(output_value, output);
+      return;
   }
 }
 
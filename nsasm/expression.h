@@ -2,7 +2,9 @@
 #define NSASM_VALUE_H_
 
 #include "nsasm/error.h"
+#include "nsasm/format.h"
 #include "nsasm/numeric_type.h"
+#include "nsasm/stats.h"
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
@@ -55,14 +57,23 @@ class Expression {
     return absl::nullopt;
   }
 
-  // Returns a human-readable stringized represenation of this argument, coerced
-  // to the requested type if provided.
-  virtual std::string ToString(NumericType type = T_unknown) const = 0;
+  // Appends a human-readable represenation of this argument to `*output`,
+  // coerced to the requested type if provided.
+  virtual void AppendTo(std::string* output,
+                        NumericType type = T_unknown) const = 0;
+
+  // As above, but returns the representation as a new string.
+  std::string ToString(NumericType type = T_unknown) const {
+    std::string result;
+    AppendTo(&result, type);
+    return result;
+  }
 
  protected:
   // Returns a copy of this expression.
   friend class ExpressionOrNull;
   friend class Label;
+  friend class NumberedLabel;
   virtual std::unique_ptr<Expression> Copy() const = 0;
 };
 
@@ -108,13 +119,22 @@ class ExpressionOrNull : public Expression {
     return absl::nullopt;
   }
 
-  std::string ToString(NumericType type = T_unknown) const override {
-    return expr_ ? expr_->ToString(type) : "<NULL>";
+  void AppendTo(std::string* output,
+                NumericType type = T_unknown) const override {
+    if (expr_) {
+      expr_->AppendTo(output, type);
+    } else {
+      output->append("<NULL>");
+    }
   }
 
   bool IsLabel() const;
   void ApplyLabel(const std::string label);
 
+  // As above, but for labels identified by number (see `NumberedLabel`).
+  absl::optional<int> LabelId() const;
+  void ApplyLabelId(int id);
+
  private:
   friend class BinaryExpression;
   friend class UnaryExpression;
@@ -134,11 +154,15 @@ class ExpressionOrNull : public Expression {
 class Literal : public Expression {
  public:
   explicit Literal(int value, NumericType type = T_unknown)
-      : value_(CastTo(type, value)), type_(type) {}
+      : value_(CastTo(type, value)), type_(type) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
 
   ErrorOr<int> Evaluate(Location loc) const override { return value_; }
   NumericType Type() const override { return type_; }
-  std::string ToString(NumericType type) const override;
+  void AppendTo(std::string* output, NumericType type) const override;
+
+  int Value() const { return value_; }
 
  private:
   std::unique_ptr<Expression> Copy() const override {
@@ -153,13 +177,17 @@ class Literal : public Expression {
 class Identifier : public Expression {
  public:
   explicit Identifier(std::string identifier)
-      : identifier_(std::move(identifier)) {}
+      : identifier_(std::move(identifier)) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
 
   ErrorOr<int> Evaluate(Location loc) const override {
     return Error("can't resolve identifier %s", identifier_);
   }
   NumericType Type() const override { return T_unknown; }
-  std::string ToString(NumericType type) const override { return identifier_; }
+  void AppendTo(std::string* output, NumericType type) const override {
+    output->append(identifier_);
+  }
   absl::optional<std::string> SimpleIdentifier() const override {
     return identifier_;
   }
@@ -175,7 +203,9 @@ class Identifier : public Expression {
 class BinaryExpression : public Expression {
  public:
   BinaryExpression(ExpressionOrNull lhs, ExpressionOrNull rhs, BinaryOp op)
-      : lhs_(std::move(lhs)), rhs_(std::move(rhs)), op_(op) {}
+      : lhs_(std::move(lhs)), rhs_(std::move(rhs)), op_(op) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
 
   ErrorOr<int> Evaluate(Location loc) const override {
     auto lhs_v = lhs_.Evaluate(loc);
@@ -187,9 +217,14 @@ class BinaryExpression : public Expression {
   NumericType Type() const override {
     return ArtihmeticConversion(lhs_.Type(), rhs_.Type());
   }
-  std::string ToString(NumericType type) const override {
-    return absl::StrFormat("op%c(%s, %s)", op_.symbol, lhs_.ToString(type),
-                           rhs_.ToString(type));
+  void AppendTo(std::string* output, NumericType type) const override {
+    output->append("op");
+    output->push_back(op_.symbol);
+    output->push_back('(');
+    lhs_.AppendTo(output, type);
+    output->append(", ");
+    rhs_.AppendTo(output, type);
+    output->push_back(')');
   }
 
  private:
@@ -204,15 +239,21 @@ class BinaryExpression : public Expression {
 class UnaryExpression : public Expression {
  public:
   UnaryExpression(ExpressionOrNull arg, UnaryOp op)
-      : arg_(std::move(arg)), op_(op) {}
+      : arg_(std::move(arg)), op_(op) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
   ErrorOr<int> Evaluate(Location loc) const override {
     auto value = arg_.Evaluate(loc);
     NSASM_RETURN_IF_ERROR(value);
     return op_.function(*value);
   }
   NumericType Type() const override { return Signed(arg_.Type()); }
-  std::string ToString(NumericType type) const override {
-    return absl::StrFormat("op%c(%s)", op_.symbol, arg_.ToString(type));
+  void AppendTo(std::string* output, NumericType type) const override {
+    output->append("op");
+    output->push_back(op_.symbol);
+    output->push_back('(');
+    arg_.AppendTo(output, type);
+    output->push_back(')');
   }
 
  private:
@@ -227,13 +268,17 @@ class UnaryExpression : public Expression {
 class Label : public Expression {
  public:
   explicit Label(std::string label, std::unique_ptr<Expression>&& expr)
-      : label_(std::move(label)), held_value_(std::move(expr)) {}
+      : label_(std::move(label)), held_value_(std::move(expr)) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
 
   ErrorOr<int> Evaluate(Location loc) const override {
     return held_value_->Evaluate(loc);
   }
   NumericType Type() const override { return held_value_->Type(); }
-  std::string ToString(NumericType type) const override { return label_; }
+  void AppendTo(std::string* output, NumericType type) const override {
+    output->append(label_);
+  }
 
  private:
   friend class ExpressionOrNull;
@@ -246,8 +291,52 @@ class Label : public Expression {
   std::unique_ptr<Expression> held_value_;
 };
 
+// Returns the name of the numbered label with the given id.
+inline std::string NumberedLabelName(int id) {
+  return absl::StrCat("label", id);
+}
+
+// As above, but appends the name to `*output`.
+inline void AppendNumberedLabelName(int id, std::string* output) {
+  output->append("label");
+  AppendDecimal(id, output);
+}
+
+// Label identified by a number rather than a name.
+//
+// The disassembler generates labels in bulk; giving them integer ids means the
+// name is only formatted when the label is actually printed.
+class NumberedLabel : public Expression {
+ public:
+  explicit NumberedLabel(int id, std::unique_ptr<Expression>&& expr)
+      : id_(id), held_value_(std::move(expr)) {
+    NSASM_STATS_INCREMENT(SC_expression_nodes);
+  }
+
+  ErrorOr<int> Evaluate(Location loc) const override {
+    return held_value_->Evaluate(loc);
+  }
+  NumericType Type() const override { return held_value_->Type(); }
+  void AppendTo(std::string* output, NumericType type) const override {
+    AppendNumberedLabelName(id_, output);
+  }
+
+  int Id() const { return id_; }
+
+ private:
+  friend class ExpressionOrNull;
+
+  std::unique_ptr<Expression> Copy() const override {
+    return absl::make_unique<NumberedLabel>(id_, held_value_->Copy());
+  }
+
+  int id_;
+  std::unique_ptr<Expression> held_value_;
+};
+
 inline bool ExpressionOrNull::IsLabel() const {
-  return dynamic_cast<Label*>(expr_.get());
+  return dynamic_cast<Label*>(expr_.get()) ||
+         dynamic_cast<NumberedLabel*>(expr_.get());
 }
 
 inline void ExpressionOrNull::ApplyLabel(const std::string label) {
@@ -262,6 +351,24 @@ inline void ExpressionOrNull::ApplyLabel(const std::string label) {
   }
 }
 
+inline absl::optional<int> ExpressionOrNull::LabelId() const {
+  NumberedLabel* raw_label = dynamic_cast<NumberedLabel*>(expr_.get());
+  if (raw_label) {
+    return raw_label->id_;
+  }
+  return absl::nullopt;
+}
+
+inline void ExpressionOrNull::ApplyLabelId(int id) {
+  NumberedLabel* raw_label = dynamic_cast<NumberedLabel*>(expr_.get());
+  if (raw_label) {
+    raw_label->id_ = id;
+  } else {
+    auto new_expr = absl::make_unique<NumberedLabel>(id, std::move(expr_));
+    expr_ = std::move(new_expr);
+  }
+}
+
 }  // namespace nsasm
 
 #endif  // NSASM_VALUE_H_
\ No newline at end of file
@@ -1,7 +1,6 @@
 #include "nsasm/flag_state.h"
 
 #include "absl/strings/ascii.h"
-#include "absl/strings/str_cat.h"
 
 namespace nsasm {
 
@@ -39,24 +38,36 @@ bool ConsumeByte(absl::string_view* sv, char ch) {
 }  // namespace
 
 std::string FlagState::ToName() const {
+  std::string result;
+  AppendName(&result);
+  return result;
+}
+
+void FlagState::AppendName(std::string* output) const {
   if (!Known(e_bit_)) {
-    return "unk";
+    output->append("unk");
   } else if (e_bit_ == B_on) {
-    return "emu";
+    output->append("emu");
   } else {
-    absl::string_view m_str = !Known(m_bit_) ? "" : (m_bit_ == B_off) ? "m16" : "m8";
-    absl::string_view x_str = !Known(x_bit_) ? "" : (x_bit_ == B_off) ? "x16" : "x8";
-    if (m_str.empty() && x_str.empty()) {
-      return "native";
+    const char* m_str = !Known(m_bit_) ? "" : (m_bit_ == B_off) ? "m16" : "m8";
+    const char* x_str = !Known(x_bit_) ? "" : (x_bit_ == B_off) ? "x16" : "x8";
+    if (!*m_str && !*x_str) {
+      output->append("native");
+    } else {
+      output->append(m_str).append(x_str);
     }
-    return absl::StrCat(m_str, x_str);
   }
 }
 
 std::string FlagState::ToString() const {
-  const char* c_bit_str =
-      (c_bit_ == B_on) ? ", c=1" : (c_bit_ == B_off) ? ", c=0" : "";
-  return absl::StrCat(ToName(), c_bit_str);
+  std::string result;
+  AppendTo(&result);
+  return result;
+}
+
+void FlagState::AppendTo(std::string* output) const {
+  AppendName(output);
+  output->append((c_bit_ == B_on) ? ", c=1" : (c_bit_ == B_off) ? ", c=0" : "");
 }
 
 absl::optional<FlagState> FlagState::FromName(absl::string_view name) {
@@ -159,9 +170,11 @@ FlagState FlagState::Execute(const Instruction& i) const {
     return new_state;
   } else if (m == M_plp) {
     new_state.m_bit_ = ConstrainedForEBit(pushed_m_bit_, e_bit_);
-    new_state.x_bit_ = ConstrainedForEBit(pushed_m_bit_, e_bit_);
+    new_state.x_bit_ = ConstrainedForEBit(pushed_x_bit_, e_bit_);
     new_state.pushed_m_bit_ = B_unknown;
     new_state.pushed_x_bit_ = B_unknown;
+    // The carry bit is pulled too, and its pushed value isn't tracked.
+    new_state.c_bit_ = B_unknown;
     return new_state;
   }
 
@@ -196,6 +209,17 @@ FlagState FlagState::Execute(const Instruction& i) const {
   return new_state;
 }
 
+bool FlagState::AffectsFlagState(const Instruction& i) {
+  // This must agree with the cases handled by Execute() above.
+  Mnemonic m = i.mnemonic;
+  return m == M_sec || m == M_bcc || m == M_clc || m == M_bcs || m == M_rep ||
+         m == M_sep || m == M_php || m == M_plp || m == M_xce || m == M_adc ||
+         m == M_sbc || m == PM_add || m == PM_sub || m == M_cmp ||
+         m == M_cpx || m == M_cpy || m == M_asl || m == M_lsr || m == M_rol ||
+         m == M_ror || m == M_jmp || m == M_jsl || m == M_jsr || m == M_brk ||
+         m == M_cop;
+}
+
 FlagState FlagState::ExecuteBranch(const Instruction& i) const {
   FlagState new_state = Execute(i);
   Mnemonic m = i.mnemonic;
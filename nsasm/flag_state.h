@@ -105,12 +105,17 @@ class FlagState {
   BitState EBit() const { return e_bit_; }
   BitState MBit() const { return m_bit_; }
   BitState XBit() const { return x_bit_; }
+  BitState CBit() const { return c_bit_; }
 
   // Returns the name of this flag state.
   std::string ToName() const;
+  // As above, but appends the name to `*output`.
+  void AppendName(std::string* output) const;
 
   // Returns a human-readable representation of this flag state.
   std::string ToString() const;
+  // As above, but appends the representation to `*output`.
+  void AppendTo(std::string* output) const;
 
   // The | operator merges two FlagStates into the superposition of their
   // states.  This is used to reflect all possible values for these bits
@@ -137,6 +142,21 @@ class FlagState {
 
   bool operator!=(const FlagState& rhs) const { return !(*this == rhs); }
 
+  // Packs this state into the low 12 bits of an integer, two bits per tracked
+  // status bit.  Packed states are cheap to hash, store, and compare-and-swap.
+  constexpr uint16_t Pack() const {
+    return e_bit_ | (m_bit_ << 2) | (x_bit_ << 4) | (pushed_m_bit_ << 6) |
+           (pushed_x_bit_ << 8) | (c_bit_ << 10);
+  }
+
+  // Inverse of Pack().
+  static constexpr FlagState Unpack(uint16_t packed) {
+    return FlagState(
+        BitState(packed & 3), BitState((packed >> 2) & 3),
+        BitState((packed >> 4) & 3), BitState((packed >> 6) & 3),
+        BitState((packed >> 8) & 3), BitState((packed >> 10) & 3));
+  }
+
   // Returns the new state that results from executing the given instruction
   // from the current state.
   ABSL_MUST_USE_RESULT FlagState Execute(const Instruction& i) const;
@@ -149,6 +169,11 @@ class FlagState {
   // clear if set.
   ABSL_MUST_USE_RESULT FlagState ExecuteBranch(const Instruction& i) const;
 
+  // Returns false if `Execute(i)` returns its input unchanged, whatever the
+  // input.  Straight-line code can skip such instructions when computing flag
+  // states.
+  static bool AffectsFlagState(const Instruction& i);
+
  private:
   BitState e_bit_;
   BitState m_bit_;
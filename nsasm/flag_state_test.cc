@@ -1,6 +1,7 @@
 #include "nsasm/flag_state.h"
 
 #include "gtest/gtest.h"
+#include "nsasm/expression.h"
 
 namespace nsasm {
 
@@ -51,5 +52,25 @@ TEST(FlagState, Names) {
   EXPECT_EQ(e_unknown_mx_known.ToName(), "unk");
 }
 
+TEST(FlagState, PushAndPull) {
+  const Instruction php = {M_php, A_imp, ExpressionOrNull(),
+                           ExpressionOrNull()};
+  const Instruction plp = {M_plp, A_imp, ExpressionOrNull(),
+                           ExpressionOrNull()};
+  const Instruction rep = {M_rep, A_imm_b,
+                           ExpressionOrNull(Literal(0x30, T_byte)),
+                           ExpressionOrNull()};
+  const Instruction sec = {M_sec, A_imp, ExpressionOrNull(),
+                           ExpressionOrNull()};
+
+  // PLP restores `m` and `x` each from its own pushed value.
+  FlagState state = FlagState(B_off, B_on, B_off).Execute(php);
+  state = state.Execute(rep).Execute(sec).Execute(plp);
+  EXPECT_EQ(state.MBit(), B_on);
+  EXPECT_EQ(state.XBit(), B_off);
+  // The pulled carry bit is not tracked.
+  EXPECT_EQ(state.CBit(), B_unknown);
+}
+
 }  // namespace
 }  // namespace nsasm
\ No newline at end of file
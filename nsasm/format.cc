@@ -0,0 +1,70 @@
+#include "nsasm/format.h"
+
+namespace nsasm {
+
+namespace {
+
+// Two-character hex and decimal representations of every byte value, and of
+// 0 through 99, so that each table lookup formats two digits.
+struct DigitTables {
+  char hex[256][2];
+  char decimal[100][2];
+
+  constexpr DigitTables() : hex(), decimal() {
+    constexpr char kHexDigits[] = "0123456789abcdef";
+    for (int i = 0; i < 256; ++i) {
+      hex[i][0] = kHexDigits[i >> 4];
+      hex[i][1] = kHexDigits[i & 0xf];
+    }
+    for (int i = 0; i < 100; ++i) {
+      decimal[i][0] = '0' + i / 10;
+      decimal[i][1] = '0' + i % 10;
+    }
+  }
+};
+
+constexpr DigitTables kDigitTables;
+
+}  // namespace
+
+void AppendHex(unsigned value, int digits, std::string* output) {
+  char buffer[8];
+  int i = digits;
+  for (; i >= 2; i -= 2) {
+    const char* pair = kDigitTables.hex[value & 0xff];
+    buffer[i - 2] = pair[0];
+    buffer[i - 1] = pair[1];
+    value >>= 8;
+  }
+  if (i == 1) {
+    buffer[0] = kDigitTables.hex[value & 0xf][1];
+  }
+  output->append(buffer, digits);
+}
+
+void AppendDecimal(int value, std::string* output) {
+  // Work in unsigned arithmetic, so that INT_MIN can be negated.
+  unsigned magnitude = value;
+  if (value < 0) {
+    output->push_back('-');
+    magnitude = 0u - magnitude;
+  }
+  char buffer[10];
+  char* end = buffer + sizeof(buffer);
+  char* p = end;
+  while (magnitude >= 100) {
+    const char* pair = kDigitTables.decimal[magnitude % 100];
+    *--p = pair[1];
+    *--p = pair[0];
+    magnitude /= 100;
+  }
+  if (magnitude >= 10) {
+    *--p = kDigitTables.decimal[magnitude][1];
+    *--p = kDigitTables.decimal[magnitude][0];
+  } else {
+    *--p = '0' + magnitude;
+  }
+  output->append(p, end - p);
+}
+
+}  // namespace nsasm
@@ -0,0 +1,22 @@
+#ifndef NSASM_FORMAT_H_
+#define NSASM_FORMAT_H_
+
+#include <string>
+
+namespace nsasm {
+
+// Allocation-free number formatting, for building text into reused buffers.
+//
+// These append to `*output` rather than returning a new string; once the
+// output buffer has grown to fit, formatting costs no allocations.
+
+// Appends the low `digits` hex digits of `value` (at most 8), in lowercase and
+// zero padded, as in "%02x".
+void AppendHex(unsigned value, int digits, std::string* output);
+
+// Appends `value` in decimal, as in "%d".
+void AppendDecimal(int value, std::string* output);
+
+}  // namespace nsasm
+
+#endif  // NSASM_FORMAT_H_
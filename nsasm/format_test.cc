@@ -0,0 +1,35 @@
+#include "nsasm/format.h"
+
+#include <climits>
+#include <string>
+
+#include "absl/strings/str_format.h"
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+TEST(Format, hex) {
+  for (int digits = 1; digits <= 8; ++digits) {
+    for (unsigned value : {0u, 0x5u, 0x12u, 0xabcu, 0x1234u, 0x7e8000u,
+                           0xffffffu, 0xdeadbeefu}) {
+      const unsigned mask =
+          (digits == 8) ? 0xffffffffu : (1u << (4 * digits)) - 1;
+      std::string output = "$";
+      AppendHex(value, digits, &output);
+      EXPECT_EQ(output, absl::StrFormat("$%0*x", digits, value & mask));
+    }
+  }
+}
+
+TEST(Format, decimal) {
+  for (int value : {0, 1, 9, 10, 99, 100, 101, 12345, -1, -10, -128, -32768,
+                    INT_MAX, INT_MIN}) {
+    std::string output = "x";
+    AppendDecimal(value, &output);
+    EXPECT_EQ(output, absl::StrFormat("x%d", value));
+  }
+}
+
+}  // namespace
+}  // namespace nsasm
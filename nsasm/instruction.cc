@@ -1,12 +1,23 @@
 #include "nsasm/instruction.h"
 
-#include "absl/strings/str_format.h"
-
 namespace nsasm {
 
 std::string Instruction::ToString() const {
-  return absl::StrFormat("%s%s", nsasm::ToString(mnemonic),
-                         ArgsToString(addressing_mode, arg1, arg2));
+  std::string result;
+  AppendTo(&result);
+  return result;
+}
+
+void Instruction::AppendTo(std::string* output) const {
+  const absl::string_view name = nsasm::ToString(mnemonic);
+  output->append(name.data(), name.size());
+  AppendArgs(addressing_mode, arg1, arg2, output);
+}
+
+bool IsExitInstruction(const Instruction& ins) {
+  Mnemonic mnemonic = ins.mnemonic;
+  return mnemonic == M_jmp || mnemonic == M_rtl || mnemonic == M_rts ||
+         mnemonic == M_rti || mnemonic == M_stp || mnemonic == M_bra;
 }
 
 }  // namespace nsasm
@@ -14,8 +14,14 @@ struct Instruction {
   ExpressionOrNull arg2;
 
   std::string ToString() const;
+  // As above, but appends the text to `*output`.
+  void AppendTo(std::string* output) const;
 };
 
+// Returns true if executing this instruction means control does not contine to
+// the next.
+bool IsExitInstruction(const Instruction& ins);
+
 }  // namespace nsasm
 
 #endif  // NSASM_INSTRUCTION_H_
@@ -0,0 +1,418 @@
+#include "nsasm/json.h"
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_format.h"
+
+namespace nsasm {
+
+namespace {
+
+// Nesting deeper than this is rejected, rather than risking the stack.
+constexpr int kMaxDepth = 256;
+
+void AppendUtf8(uint32_t code_point, std::string* output) {
+  if (code_point < 0x80) {
+    output->push_back(code_point);
+  } else if (code_point < 0x800) {
+    output->push_back(0xc0 | (code_point >> 6));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    output->push_back(0xe0 | (code_point >> 12));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else {
+    output->push_back(0xf0 | (code_point >> 18));
+    output->push_back(0x80 | ((code_point >> 12) & 0x3f));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  }
+}
+
+void AppendQuoted(absl::string_view text, std::string* output) {
+  output->push_back('"');
+  for (char ch : text) {
+    switch (ch) {
+      case '"':
+        output->append("\\\"");
+        break;
+      case '\\':
+        output->append("\\\\");
+        break;
+      case '\n':
+        output->append("\\n");
+        break;
+      case '\r':
+        output->append("\\r");
+        break;
+      case '\t':
+        output->append("\\t");
+        break;
+      default:
+        if (static_cast<uint8_t>(ch) < 0x20) {
+          absl::StrAppendFormat(output, "\\u%04x", ch);
+        } else {
+          output->push_back(ch);
+        }
+    }
+  }
+  output->push_back('"');
+}
+
+class Parser {
+ public:
+  explicit Parser(absl::string_view text) : text_(text) {}
+
+  ErrorOr<JsonValue> ParseDocument() {
+    auto value = ParseValue(0);
+    NSASM_RETURN_IF_ERROR(value);
+    SkipWhitespace();
+    if (pos_ != text_.size()) {
+      return Failure("Unexpected text after JSON value");
+    }
+    return value;
+  }
+
+ private:
+  Error Failure(const char* message) const {
+    return Error("%s", message).SetLocation("json", pos_);
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size() && absl::ascii_isspace(text_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(absl::string_view literal) {
+    if (text_.substr(pos_, literal.size()) != literal) {
+      return false;
+    }
+    pos_ += literal.size();
+    return true;
+  }
+
+  ErrorOr<JsonValue> ParseValue(int depth) {
+    if (depth > kMaxDepth) {
+      return Failure("JSON nested too deeply");
+    }
+    SkipWhitespace();
+    if (pos_ == text_.size()) {
+      return Failure("Unexpected end of JSON");
+    }
+    const char ch = text_[pos_];
+    if (ch == '{') {
+      return ParseObject(depth);
+    }
+    if (ch == '[') {
+      return ParseArray(depth);
+    }
+    if (ch == '"') {
+      auto s = ParseString();
+      NSASM_RETURN_IF_ERROR(s);
+      return JsonValue(std::move(*s));
+    }
+    if (Consume("true")) {
+      return JsonValue(true);
+    }
+    if (Consume("false")) {
+      return JsonValue(false);
+    }
+    if (Consume("null")) {
+      return JsonValue();
+    }
+    return ParseNumber();
+  }
+
+  ErrorOr<JsonValue> ParseObject(int depth) {
+    ++pos_;  // {
+    JsonValue object = JsonValue::Object();
+    SkipWhitespace();
+    if (Consume("}")) {
+      return object;
+    }
+    while (true) {
+      SkipWhitespace();
+      if (pos_ == text_.size() || text_[pos_] != '"') {
+        return Failure("Expected string key in JSON object");
+      }
+      auto key = ParseString();
+      NSASM_RETURN_IF_ERROR(key);
+      SkipWhitespace();
+      if (!Consume(":")) {
+        return Failure("Expected ':' in JSON object");
+      }
+      auto value = ParseValue(depth + 1);
+      NSASM_RETURN_IF_ERROR(value);
+      object.Set(*key, std::move(*value));
+      SkipWhitespace();
+      if (Consume("}")) {
+        return object;
+      }
+      if (!Consume(",")) {
+        return Failure("Expected ',' or '}' in JSON object");
+      }
+    }
+  }
+
+  ErrorOr<JsonValue> ParseArray(int depth) {
+    ++pos_;  // [
+    JsonValue array = JsonValue::Array();
+    SkipWhitespace();
+    if (Consume("]")) {
+      return array;
+    }
+    while (true) {
+      auto value = ParseValue(depth + 1);
+      NSASM_RETURN_IF_ERROR(value);
+      array.Append(std::move(*value));
+      SkipWhitespace();
+      if (Consume("]")) {
+        return array;
+      }
+      if (!Consume(",")) {
+        return Failure("Expected ',' or ']' in JSON array");
+      }
+    }
+  }
+
+  ErrorOr<uint32_t> ParseHex4() {
+    if (pos_ + 4 > text_.size()) {
+      return Failure("Truncated \\u escape in JSON string");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char ch = text_[pos_++];
+      if (!absl::ascii_isxdigit(ch)) {
+        return Failure("Bad \\u escape in JSON string");
+      }
+      value = value * 16 + (absl::ascii_isdigit(ch)
+                                ? ch - '0'
+                                : absl::ascii_tolower(ch) - 'a' + 10);
+    }
+    return value;
+  }
+
+  ErrorOr<std::string> ParseString() {
+    ++pos_;  // "
+    std::string result;
+    while (true) {
+      // Copy runs of plain characters in one go.
+      const size_t run_end = text_.find_first_of("\"\\", pos_);
+      if (run_end == absl::string_view::npos) {
+        return Failure("Unterminated JSON string");
+      }
+      result.append(text_.data() + pos_, run_end - pos_);
+      pos_ = run_end;
+      if (text_[pos_++] == '"') {
+        return result;
+      }
+      if (pos_ == text_.size()) {
+        return Failure("Unterminated JSON string");
+      }
+      const char escape = text_[pos_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          result.push_back(escape);
+          break;
+        case 'b':
+          result.push_back('\b');
+          break;
+        case 'f':
+          result.push_back('\f');
+          break;
+        case 'n':
+          result.push_back('\n');
+          break;
+        case 'r':
+          result.push_back('\r');
+          break;
+        case 't':
+          result.push_back('\t');
+          break;
+        case 'u': {
+          auto code_point = ParseHex4();
+          NSASM_RETURN_IF_ERROR(code_point);
+          uint32_t value = *code_point;
+          // A UTF-16 surrogate pair encodes one code point.
+          if (value >= 0xd800 && value < 0xdc00 && Consume("\\u")) {
+            auto low = ParseHex4();
+            NSASM_RETURN_IF_ERROR(low);
+            if (*low < 0xdc00 || *low >= 0xe000) {
+              return Failure("Bad surrogate pair in JSON string");
+            }
+            value = 0x10000 + ((value - 0xd800) << 10) + (*low - 0xdc00);
+          }
+          AppendUtf8(value, &result);
+          break;
+        }
+        default:
+          return Failure("Bad escape in JSON string");
+      }
+    }
+  }
+
+  ErrorOr<JsonValue> ParseNumber() {
+    // strtod accepts a superset of JSON numbers; check the first character so
+    // that words like "nan" are rejected.
+    const char ch = text_[pos_];
+    if (ch != '-' && !absl::ascii_isdigit(ch)) {
+      return Failure("Unexpected character in JSON");
+    }
+    const size_t end = text_.find_first_not_of("+-0123456789.eE", pos_);
+    const std::string number(
+        text_.substr(pos_, end == absl::string_view::npos ? end : end - pos_));
+    char* parse_end;
+    const double value = std::strtod(number.c_str(), &parse_end);
+    if (parse_end != number.c_str() + number.size()) {
+      return Failure("Bad JSON number");
+    }
+    pos_ += number.size();
+    return JsonValue(value);
+  }
+
+  absl::string_view text_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+ErrorOr<JsonValue> JsonValue::Parse(absl::string_view text) {
+  return Parser(text).ParseDocument();
+}
+
+int JsonValue::AsInt() const {
+  const double number = AsNumber();
+  if (std::isnan(number)) {
+    return 0;
+  }
+  if (number <= INT_MIN) {
+    return INT_MIN;
+  }
+  if (number >= INT_MAX) {
+    return INT_MAX;
+  }
+  return static_cast<int>(number);
+}
+
+const std::string& JsonValue::AsString() const {
+  static const std::string* empty = new std::string;
+  return type_ == J_string ? string_ : *empty;
+}
+
+const JsonValue* JsonValue::Find(absl::string_view key) const {
+  for (const auto& member : members_) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+const JsonValue& JsonValue::operator[](absl::string_view key) const {
+  static const JsonValue* null_value = new JsonValue;
+  const JsonValue* value = Find(key);
+  return value ? *value : *null_value;
+}
+
+JsonValue& JsonValue::Set(absl::string_view key, JsonValue value) & {
+  for (auto& member : members_) {
+    if (member.first == key) {
+      member.second = std::move(value);
+      return *this;
+    }
+  }
+  members_.emplace_back(std::string(key), std::move(value));
+  return *this;
+}
+
+JsonValue& JsonValue::Append(JsonValue value) & {
+  elements_.push_back(std::move(value));
+  return *this;
+}
+
+std::string JsonValue::ToString() const {
+  std::string result;
+  AppendTo(&result);
+  return result;
+}
+
+void JsonValue::AppendTo(std::string* output) const {
+  switch (type_) {
+    case J_null:
+      output->append("null");
+      return;
+    case J_bool:
+      output->append(bool_ ? "true" : "false");
+      return;
+    case J_number:
+      // Integers, which are all the protocol uses, print without a fraction.
+      if (std::nearbyint(number_) == number_ && std::abs(number_) < 1e15) {
+        absl::StrAppendFormat(output, "%d", static_cast<int64_t>(number_));
+      } else if (std::isfinite(number_)) {
+        absl::StrAppendFormat(output, "%.17g", number_);
+      } else {
+        output->append("null");
+      }
+      return;
+    case J_string:
+      AppendQuoted(string_, output);
+      return;
+    case J_array: {
+      output->push_back('[');
+      bool first = true;
+      for (const JsonValue& element : elements_) {
+        if (!first) {
+          output->push_back(',');
+        }
+        first = false;
+        element.AppendTo(output);
+      }
+      output->push_back(']');
+      return;
+    }
+    case J_object: {
+      output->push_back('{');
+      bool first = true;
+      for (const auto& member : members_) {
+        if (!first) {
+          output->push_back(',');
+        }
+        first = false;
+        AppendQuoted(member.first, output);
+        output->push_back(':');
+        member.second.AppendTo(output);
+      }
+      output->push_back('}');
+      return;
+    }
+  }
+}
+
+bool JsonValue::operator==(const JsonValue& rhs) const {
+  if (type_ != rhs.type_) {
+    return false;
+  }
+  switch (type_) {
+    case J_null:
+      return true;
+    case J_bool:
+      return bool_ == rhs.bool_;
+    case J_number:
+      return number_ == rhs.number_;
+    case J_string:
+      return string_ == rhs.string_;
+    case J_array:
+      return elements_ == rhs.elements_;
+    case J_object:
+      return members_ == rhs.members_;
+  }
+  return false;
+}
+
+}  // namespace nsasm
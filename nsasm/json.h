@@ -0,0 +1,95 @@
+#ifndef NSASM_JSON_H_
+#define NSASM_JSON_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "nsasm/error.h"
+
+namespace nsasm {
+
+// A JSON value, as exchanged with language server clients.
+//
+// Objects keep their members in insertion order, and are searched linearly;
+// the messages this is used for are small.
+class JsonValue {
+ public:
+  enum Type {
+    J_null,
+    J_bool,
+    J_number,
+    J_string,
+    J_array,
+    J_object,
+  };
+
+  JsonValue() : type_(J_null) {}
+  JsonValue(bool value) : type_(J_bool), bool_(value) {}
+  JsonValue(int value) : type_(J_number), number_(value) {}
+  JsonValue(int64_t value) : type_(J_number), number_(value) {}
+  JsonValue(double value) : type_(J_number), number_(value) {}
+  JsonValue(const char* value) : type_(J_string), string_(value) {}
+  JsonValue(absl::string_view value)
+      : type_(J_string), string_(value.data(), value.size()) {}
+  JsonValue(std::string value) : type_(J_string), string_(std::move(value)) {}
+
+  static JsonValue Array() { return JsonValue(J_array); }
+  static JsonValue Object() { return JsonValue(J_object); }
+
+  // Parses a JSON document.
+  static ErrorOr<JsonValue> Parse(absl::string_view text);
+
+  Type type() const { return type_; }
+  bool IsNull() const { return type_ == J_null; }
+
+  // Accessors.  Each returns a zero value if this value is of another type.
+  bool AsBool() const { return type_ == J_bool && bool_; }
+  double AsNumber() const { return type_ == J_number ? number_ : 0; }
+  // AsInt() truncates toward zero, clamping to the range of int.
+  int AsInt() const;
+  const std::string& AsString() const;
+  const std::vector<JsonValue>& Elements() const { return elements_; }
+
+  // Returns the member named `key` of an object, or nullptr if there is none.
+  const JsonValue* Find(absl::string_view key) const;
+  // As above, but returns a null value if there is no such member.
+  const JsonValue& operator[](absl::string_view key) const;
+
+  // Adds or replaces a member of an object.
+  JsonValue& Set(absl::string_view key, JsonValue value) &;
+  // Appends an element to an array.
+  JsonValue& Append(JsonValue value) &;
+
+  // As above, for building values in a single expression without copying
+  // them, as in `JsonValue::Object().Set("a", 1).Set("b", 2)`.
+  JsonValue&& Set(absl::string_view key, JsonValue value) && {
+    return std::move(Set(key, std::move(value)));
+  }
+  JsonValue&& Append(JsonValue value) && {
+    return std::move(Append(std::move(value)));
+  }
+
+  std::string ToString() const;
+  // As above, but appends the text to `*output`.
+  void AppendTo(std::string* output) const;
+
+  bool operator==(const JsonValue& rhs) const;
+  bool operator!=(const JsonValue& rhs) const { return !(*this == rhs); }
+
+ private:
+  explicit JsonValue(Type type) : type_(type) {}
+
+  Type type_;
+  bool bool_ = false;
+  double number_ = 0;
+  std::string string_;
+  std::vector<JsonValue> elements_;
+  std::vector<std::pair<std::string, JsonValue>> members_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_JSON_H_
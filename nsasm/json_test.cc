@@ -0,0 +1,63 @@
+#include "nsasm/json.h"
+
+#include <climits>
+
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+TEST(Json, parse_and_print) {
+  const std::string text =
+      R"({"a":[1,-2.5,true,false,null],"b":{"c":"x\"y\n"},"d":[]})";
+  auto value = JsonValue::Parse(text);
+  NSASM_ASSERT_OK(value);
+  EXPECT_EQ(value->ToString(), text);
+  EXPECT_EQ((*value)["a"].Elements().size(), 5);
+  EXPECT_EQ((*value)["a"].Elements()[1].AsNumber(), -2.5);
+  EXPECT_EQ((*value)["b"]["c"].AsString(), "x\"y\n");
+  EXPECT_TRUE((*value)["missing"]["deeper"].IsNull());
+  EXPECT_EQ((*value)["b"].AsString(), "");
+
+  // Whitespace is insignificant.
+  auto spaced = JsonValue::Parse(
+      " { \"a\" : [ 1 , -2.5 , true , false , null ] ,\n"
+      "   \"b\" : { \"c\" : \"x\\\"y\\n\" } , \"d\" : [ ] } ");
+  NSASM_ASSERT_OK(spaced);
+  EXPECT_EQ(*spaced, *value);
+}
+
+TEST(Json, unicode_escapes) {
+  auto value = JsonValue::Parse(R"("\u0041\u00e9\u20ac\ud83d\ude00\/")");
+  NSASM_ASSERT_OK(value);
+  EXPECT_EQ(value->AsString(), "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80/");
+  EXPECT_EQ(JsonValue("\x01").ToString(), R"("\u0001")");
+}
+
+TEST(Json, build) {
+  JsonValue value = JsonValue::Object();
+  value.Set("id", 7).Set("name", "nsasm").Set("list", JsonValue::Array());
+  value.Set("id", 8);
+  EXPECT_EQ(value.ToString(), R"({"id":8,"name":"nsasm","list":[]})");
+  EXPECT_EQ(value["id"].AsInt(), 8);
+}
+
+TEST(Json, integers) {
+  EXPECT_EQ(JsonValue(2.9).AsInt(), 2);
+  EXPECT_EQ(JsonValue(-2.9).AsInt(), -2);
+  EXPECT_EQ(JsonValue(1e300).AsInt(), INT_MAX);
+  EXPECT_EQ(JsonValue(-1e300).AsInt(), INT_MIN);
+  EXPECT_EQ(JsonValue("7").AsInt(), 0);
+}
+
+TEST(Json, errors) {
+  for (const char* text :
+       {"", "{", "[1,]", "{\"a\" 1}", "\"abc", "nan", "1 2", "\"\\q\"",
+        "\"\\u12\"", "{1:2}", "[1 2]"}) {
+    EXPECT_FALSE(JsonValue::Parse(text).ok()) << text;
+  }
+  EXPECT_FALSE(JsonValue::Parse(std::string(1000, '[')).ok());
+}
+
+}  // namespace
+}  // namespace nsasm
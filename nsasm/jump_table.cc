@@ -0,0 +1,261 @@
+#include "nsasm/jump_table.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <tuple>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "absl/numeric/bits.h"
+#include "nsasm/parallel.h"
+#include "nsasm/trace.h"
+
+namespace nsasm {
+
+namespace {
+
+// Returns a mask with bit k set if `bytes[k]` has bit `bit` set, for k in
+// [0, 64).  `bytes` must have 64 readable bytes; see `TailBits()` otherwise.
+uint64_t Bits(const uint8_t* bytes, int bit) {
+#if defined(__SSE2__)
+  // Move the bit of interest to the top of each byte, where movemask reads it.
+  // (Shifting 16-bit lanes is fine; bits shifted across bytes are ignored.)
+  const __m128i shift = _mm_cvtsi32_si128(7 - bit);
+  uint64_t result = 0;
+  for (int k = 0; k < 4; ++k) {
+    __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 16 * k));
+    chunk = _mm_sll_epi16(chunk, shift);
+    result |= uint64_t(uint16_t(_mm_movemask_epi8(chunk))) << (16 * k);
+  }
+  return result;
+#else
+  uint64_t result = 0;
+  for (int k = 0; k < 64; ++k) {
+    result |= uint64_t((bytes[k] >> bit) & 1) << k;
+  }
+  return result;
+#endif
+}
+
+// As `Bits()`, for the `count` bytes at the end of a ROM.
+uint64_t TailBits(const uint8_t* bytes, int count, int bit) {
+  uint64_t result = 0;
+  for (int k = 0; k < count && k < 64; ++k) {
+    result |= uint64_t((bytes[k] >> bit) & 1) << k;
+  }
+  return result;
+}
+
+// Every mapping maps each half of a SNES bank to contiguous ROM, so the ROM
+// address of a 24-bit pointer is a table lookup plus its low 15 bits.  The
+// table holds the ROM address of the start of each half, indexed by the high
+// bit of the address and then the bank, or -1 for halves not mapped to ROM.
+using LongBankTable = std::array<std::array<int, 256>, 2>;
+
+LongBankTable MakeLongBankTable(const Rom& rom) {
+  LongBankTable table;
+  for (int half = 0; half < 2; ++half) {
+    for (int bank = 0; bank < 256; ++bank) {
+      const int half_start = (bank << 16) | (half ? 0x8000 : 0);
+      auto rom_address = SnesToROMAddress(half_start, rom.mapping_mode());
+      table[half][bank] = rom_address.ok() ? *rom_address : -1;
+    }
+  }
+  return table;
+}
+
+// Per-bank state shared by the near and long pointer checks.
+class BankScanner {
+ public:
+  BankScanner(const Rom& rom, const SupersetDisassembly& superset,
+              const LongBankTable& long_bases, int bank, int bank_size)
+      : rom_(rom),
+        data_(rom.data()),
+        superset_(superset),
+        long_bases_(long_bases),
+        bank_start_(bank * bank_size),
+        bank_end_(std::min<int>(bank_start_ + bank_size, data_.size())) {
+    const int snes_start = *ROMToSnesAddress(bank_start_, rom.mapping_mode());
+    snes_bank_ = snes_start & 0xff0000;
+    bank_origin_ = bank_start_ - (snes_start & 0xffff);
+  }
+
+  // Appends the tables found in this bank to `*tables`.
+  void Scan(int min_entries, std::vector<JumpTable>* tables) {
+    const int size = bank_end_ - bank_start_;
+    std::vector<uint8_t> is_near(size, 0);
+    std::vector<uint8_t> is_long(size, 0);
+    // LoRom only maps ROM to the upper half of each bank, so there a pointer
+    // must have the high bit of its second byte set.  HiRom and ExHiRom also
+    // map the lower half of banks $40-$7d and $c0-$ff, so a 24-bit pointer
+    // there may instead have bit 6 of its bank set.
+    const bool lorom = rom_.mapping_mode() == kLoRom;
+    const uint64_t near_filter = lorom ? 0 : ~uint64_t(0);
+
+    for (int chunk = 0; chunk < size; chunk += 64) {
+      const int rom_address = bank_start_ + chunk;
+      // Bit k of each mask describes the entry starting at `rom_address + k`.
+      uint64_t high;
+      uint64_t bank_bit6 = 0;
+      if (rom_address + 66 <= int(data_.size())) {
+        high = Bits(data_.data() + rom_address + 1, 7);
+        if (!lorom) {
+          bank_bit6 = Bits(data_.data() + rom_address + 2, 6);
+        }
+      } else {
+        const int remaining = data_.size() - rom_address;
+        high = TailBits(data_.data() + rom_address + 1, remaining - 1, 7);
+        if (!lorom) {
+          bank_bit6 =
+              TailBits(data_.data() + rom_address + 2, remaining - 2, 6);
+        }
+      }
+      for (uint64_t mask = high | near_filter; mask; mask &= mask - 1) {
+        const int k = absl::countr_zero(mask);
+        if (chunk + k + 2 > size) {
+          break;
+        }
+        is_near[chunk + k] = NearTarget(rom_address + k) >= 0;
+      }
+      for (uint64_t mask = high | bank_bit6; mask; mask &= mask - 1) {
+        const int k = absl::countr_zero(mask);
+        if (chunk + k + 3 > size) {
+          break;
+        }
+        is_long[chunk + k] = LongTarget(rom_address + k) >= 0;
+      }
+    }
+
+    FindRuns(is_near, 2, min_entries, tables);
+    FindRuns(is_long, 3, min_entries, tables);
+  }
+
+ private:
+  int Read(int rom_address, int entry_size) const {
+    int value = data_[rom_address] | (data_[rom_address + 1] << 8);
+    if (entry_size == 3) {
+      value |= data_[rom_address + 2] << 16;
+    }
+    return value;
+  }
+
+  // Returns the SNES address pointed to by the 16-bit pointer at
+  // `rom_address`, or -1 if it is not a superset candidate in this bank.
+  int NearTarget(int rom_address) const {
+    const int value = Read(rom_address, 2);
+    const int target = bank_origin_ + value;
+    if (target < bank_start_ || target >= bank_end_ ||
+        !superset_.ValidWidthsAtRomAddress(target)) {
+      return -1;
+    }
+    return snes_bank_ | value;
+  }
+
+  // Returns the SNES address pointed to by the 24-bit pointer at
+  // `rom_address`, or -1 if it is not a superset candidate.
+  int LongTarget(int rom_address) const {
+    const int value = Read(rom_address, 3);
+    const int base = long_bases_[(value >> 15) & 1][value >> 16];
+    if (base < 0) {
+      return -1;
+    }
+    const int target = base + (value & 0x7fff);
+    if (target >= int(data_.size()) ||
+        !superset_.ValidWidthsAtRomAddress(target)) {
+      return -1;
+    }
+    return value;
+  }
+
+  void FindRuns(const std::vector<uint8_t>& is_pointer, int stride,
+                int min_entries, std::vector<JumpTable>* tables) const {
+    const int size = is_pointer.size();
+    for (int i = 0; i < size; ++i) {
+      if (!is_pointer[i] || (i >= stride && is_pointer[i - stride])) {
+        continue;
+      }
+      int count = 0;
+      while (i + count * stride < size && is_pointer[i + count * stride]) {
+        ++count;
+      }
+      if (count < min_entries) {
+        continue;
+      }
+      JumpTable table;
+      table.address = *ROMToSnesAddress(bank_start_ + i, rom_.mapping_mode());
+      table.entry_size = stride;
+      for (int entry = 0; entry < count; ++entry) {
+        const int rom_address = bank_start_ + i + entry * stride;
+        table.targets.push_back(stride == 2 ? NearTarget(rom_address)
+                                            : LongTarget(rom_address));
+      }
+      tables->push_back(std::move(table));
+    }
+  }
+
+  const Rom& rom_;
+  const std::vector<uint8_t>& data_;
+  const SupersetDisassembly& superset_;
+  const LongBankTable& long_bases_;
+  const int bank_start_;
+  const int bank_end_;
+  int snes_bank_;
+  int bank_origin_;
+};
+
+}  // namespace
+
+std::vector<JumpTable> FindJumpTables(const Rom& rom,
+                                      const SupersetDisassembly& superset,
+                                      int min_entries, int num_threads) {
+  const int bank_size = (rom.mapping_mode() == kLoRom) ? 0x8000 : 0x10000;
+  const int bank_count = (rom.data().size() + bank_size - 1) / bank_size;
+  const LongBankTable long_bases = MakeLongBankTable(rom);
+  std::vector<std::vector<JumpTable>> bank_tables(bank_count);
+  ParallelFor(num_threads, bank_count, [&](int bank) {
+    TraceSpan span("find_jump_tables_bank", "bank", bank);
+    BankScanner(rom, superset, long_bases, bank, bank_size)
+        .Scan(min_entries, &bank_tables[bank]);
+  });
+
+  std::vector<JumpTable> tables;
+  for (auto& bank : bank_tables) {
+    std::move(bank.begin(), bank.end(), std::back_inserter(tables));
+  }
+  std::sort(tables.begin(), tables.end(),
+            [](const JumpTable& lhs, const JumpTable& rhs) {
+              return std::tie(lhs.address, lhs.entry_size) <
+                     std::tie(rhs.address, rhs.entry_size);
+            });
+  return tables;
+}
+
+std::vector<EntryPoint> JumpTableEntryPoints(
+    const SupersetDisassembly& superset, const std::vector<JumpTable>& tables) {
+  std::vector<int> targets;
+  for (const JumpTable& table : tables) {
+    targets.insert(targets.end(), table.targets.begin(), table.targets.end());
+  }
+  std::sort(targets.begin(), targets.end());
+  targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+  std::vector<EntryPoint> entry_points;
+  for (int target : targets) {
+    const int widths = superset.ValidWidths(target);
+    for (int width = 0; width < SupersetDisassembly::kWidthCount; ++width) {
+      if (widths & (1 << width)) {
+        entry_points.push_back(
+            {target, SupersetDisassembly::WidthFlagState(width)});
+        break;
+      }
+    }
+  }
+  return entry_points;
+}
+
+}  // namespace nsasm
@@ -0,0 +1,45 @@
+#ifndef NSASM_JUMP_TABLE_H_
+#define NSASM_JUMP_TABLE_H_
+
+#include <vector>
+
+#include "nsasm/disassemble.h"
+#include "nsasm/rom.h"
+#include "nsasm/superset.h"
+
+namespace nsasm {
+
+// A run of little-endian pointers in ROM that look like the targets of an
+// indexed jump, such as `JMP ($8000,X)` or `JML [$8000]`.
+struct JumpTable {
+  int address;     // SNES address of the first entry
+  int entry_size;  // 2 for 16-bit pointers, 3 for 24-bit pointers
+  // SNES addresses pointed to by each entry, in order.
+  std::vector<int> targets;
+};
+
+// Scans all of `rom` for candidate jump tables.
+//
+// A 16-bit pointer is plausible if it points to a `superset` candidate in the
+// bank it is stored in (as for `JMP (abs,X)` and `JSR (abs,X)`, which read the
+// table from, and jump within, the program bank.)  A 24-bit pointer is
+// plausible if it points to a `superset` candidate anywhere in ROM.  Runs of
+// at least `min_entries` consecutive plausible pointers are reported, ordered
+// by address and then entry size.
+//
+// Banks are scanned in parallel on `num_threads` threads (or a default number,
+// if zero.)
+std::vector<JumpTable> FindJumpTables(const Rom& rom,
+                                      const SupersetDisassembly& superset,
+                                      int min_entries = 4,
+                                      int num_threads = 0);
+
+// Returns an entry point for each distinct target of `tables`, sorted by
+// address, suitable for `DisassembleAll()`.  The flag state is the narrowest
+// width at which `superset` has a candidate at the target.
+std::vector<EntryPoint> JumpTableEntryPoints(
+    const SupersetDisassembly& superset, const std::vector<JumpTable>& tables);
+
+}  // namespace nsasm
+
+#endif  // NSASM_JUMP_TABLE_H_
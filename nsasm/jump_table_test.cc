@@ -0,0 +1,71 @@
+#include "nsasm/jump_table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+TEST(JumpTable, find_and_follow) {
+  std::vector<uint8_t> data(0x10000, 0x00);
+  // Dispatch through a table of 16-bit pointers at $00c000.
+  const std::vector<uint8_t> dispatch = {
+      0xe2, 0x30,              // SEP #$30
+      0x0a,                    // ASL
+      0xaa,                    // TAX
+      0x7c, 0x00, 0xc0,        // JMP ($c000,X)
+  };
+  std::copy(dispatch.begin(), dispatch.end(), data.begin());
+  // Handlers at $009000, $009010, ...; each is `INX; RTS`.
+  for (int i = 0; i < 5; ++i) {
+    data[0x1000 + 0x10 * i] = 0xe8;
+    data[0x1001 + 0x10 * i] = 0x60;
+    data[0x4000 + 2 * i] = 0x10 * i;
+    data[0x4001 + 2 * i] = 0x90;
+  }
+  // A table of 24-bit pointers at $01a000 to the same handlers.
+  for (int i = 0; i < 4; ++i) {
+    data[0xa000 + 3 * i] = 0x10 * i;
+    data[0xa001 + 3 * i] = 0x90;
+    data[0xa002 + 3 * i] = 0x00;
+  }
+  // Too short to be a table.
+  data[0x6000] = 0x00;
+  data[0x6001] = 0x90;
+  data[0x6002] = 0x10;
+  data[0x6003] = 0x90;
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom);
+
+  std::vector<JumpTable> tables = FindJumpTables(rom, superset);
+  ASSERT_EQ(tables.size(), 2);
+  EXPECT_EQ(tables[0].address, 0x00c000);
+  EXPECT_EQ(tables[0].entry_size, 2);
+  EXPECT_EQ(tables[0].targets,
+            std::vector<int>({0x9000, 0x9010, 0x9020, 0x9030, 0x9040}));
+  EXPECT_EQ(tables[1].address, 0x01a000);
+  EXPECT_EQ(tables[1].entry_size, 3);
+  EXPECT_EQ(tables[1].targets,
+            std::vector<int>({0x9000, 0x9010, 0x9020, 0x9030}));
+
+  // A higher threshold drops the shorter table.
+  EXPECT_EQ(FindJumpTables(rom, superset, 5).size(), 1);
+
+  // The targets make usable entry points.
+  std::vector<EntryPoint> entry_points =
+      JumpTableEntryPoints(superset, tables);
+  ASSERT_EQ(entry_points.size(), 5);
+  EXPECT_EQ(entry_points[0].address, 0x9000);
+  entry_points.push_back({0x8000, FlagState(B_off, B_on, B_on)});
+  auto disassembly = DisassembleAll(rom, entry_points, 1);
+  NSASM_ASSERT_OK(disassembly);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(disassembly->count(0x9000 + 0x10 * i), 1);
+    EXPECT_EQ(disassembly->count(0x9001 + 0x10 * i), 1);
+  }
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,256 @@
+#include "nsasm/listing.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+#include "nsasm/format.h"
+#include "nsasm/parallel.h"
+#include "nsasm/stats.h"
+#include "nsasm/trace.h"
+
+namespace nsasm {
+
+namespace {
+
+// Pads the text appended since `start` with spaces to `width` characters, as
+// "%-*s" would.
+void AppendPadding(size_t start, size_t width, std::string* output) {
+  const size_t used = output->size() - start;
+  if (used < width) {
+    output->append(width - used, ' ');
+  }
+}
+
+// Number of instructions formatted per chunk by WriteDisassemblyParallel().
+constexpr int kChunkInstructions = 4096;
+
+// Writes all of `chunks` to `fd`, using as few system calls as possible.
+bool WriteVectored(int fd, const std::vector<std::string>& chunks) {
+  std::vector<iovec> iovecs;
+  iovecs.reserve(chunks.size());
+  for (const std::string& chunk : chunks) {
+    if (!chunk.empty()) {
+      iovecs.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+    }
+  }
+  size_t next = 0;
+  while (next < iovecs.size()) {
+    const int count = std::min<size_t>(iovecs.size() - next, IOV_MAX);
+    const ssize_t written = writev(fd, &iovecs[next], count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // Skip past what was written, which may end partway into an iovec.
+    size_t remaining = written;
+    while (next < iovecs.size() && remaining >= iovecs[next].iov_len) {
+      remaining -= iovecs[next].iov_len;
+      ++next;
+    }
+    if (remaining > 0) {
+      iovecs[next].iov_base =
+          static_cast<char*>(iovecs[next].iov_base) + remaining;
+      iovecs[next].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+ListingWriter::ListingWriter(std::FILE* file) : file_(file) {
+  buffer_.reserve(kBufferSize + 256);
+}
+
+ListingWriter::ListingWriter(std::string* output) : output_(output) {
+  buffer_.reserve(kBufferSize + 256);
+}
+
+ListingWriter::~ListingWriter() { Flush(); }
+
+void ListingWriter::WriteLine(absl::string_view text) {
+  buffer_.append(text.data(), text.size());
+  buffer_.push_back('\n');
+  MaybeFlush();
+}
+
+void ListingWriter::WriteInstruction(
+    int pc, const DisassembledInstruction& instruction) {
+  AppendInstructionLine(pc, instruction, &buffer_);
+  MaybeFlush();
+}
+
+void ListingWriter::WriteDisassembly(const Disassembly& disassembly,
+                                     int begin, int end) {
+  NSASM_STATS_TIMER(SP_listing);
+  for (auto it = disassembly.lower_bound(begin);
+       it != disassembly.end() && it->first < end; ++it) {
+    AppendInstructionLine(it->first, it->second, &buffer_);
+    MaybeFlush();
+  }
+}
+
+void ListingWriter::WriteDisassemblyWithCycles(
+    const Disassembly& disassembly, const ControlFlowGraph& graph,
+    const CycleEstimate& cycles) {
+  NSASM_STATS_TIMER(SP_listing);
+  for (const auto& entry : disassembly) {
+    const int pc = entry.first;
+    auto subroutine = cycles.SubroutineCycles(pc);
+    if (subroutine.has_value()) {
+      buffer_.append("; subroutine: ");
+      subroutine->AppendTo(&buffer_);
+      buffer_.append(" cycles\n");
+    }
+    const int block = graph.BlockAt(pc);
+    if (block >= 0) {
+      buffer_.append("; block: ");
+      cycles.BlockCycles(block).AppendTo(&buffer_);
+      buffer_.append(" cycles\n");
+    }
+    AppendInstructionLine(pc, entry.second, &buffer_);
+    buffer_.pop_back();  // newline
+    buffer_.append(" [");
+    InstructionCycles(pc, entry.second.instruction,
+                      entry.second.current_flag_state)
+        .AppendTo(&buffer_);
+    buffer_.append("]\n");
+    MaybeFlush();
+  }
+}
+
+void ListingWriter::WriteDisassemblyParallel(const Disassembly& disassembly,
+                                             int num_threads) {
+  NSASM_STATS_TIMER(SP_listing);
+  // Find the first instruction of each chunk.  Walking the map is cheap next
+  // to formatting it.
+  std::vector<Disassembly::const_iterator> starts;
+  int count = 0;
+  for (auto it = disassembly.begin(); it != disassembly.end(); ++it) {
+    if (count++ % kChunkInstructions == 0) {
+      starts.push_back(it);
+    }
+  }
+  starts.push_back(disassembly.end());
+
+  std::vector<std::string> chunks(starts.size() - 1);
+  ParallelFor(num_threads, chunks.size(), [&](int i) {
+    TraceSpan span("format_listing_chunk", "address", starts[i]->first);
+    for (auto it = starts[i]; it != starts[i + 1]; ++it) {
+      AppendInstructionLine(it->first, it->second, &chunks[i]);
+    }
+  });
+  TraceSpan span("write_listing_chunks", "chunks", chunks.size());
+  WriteChunks(chunks);
+}
+
+void ListingWriter::WriteChunks(const std::vector<std::string>& chunks) {
+  Flush();
+  if (error_.has_value()) {
+    return;
+  }
+  int64_t size = 0;
+  for (const std::string& chunk : chunks) {
+    size += chunk.size();
+  }
+  if (output_) {
+    output_->reserve(output_->size() + size);
+    for (const std::string& chunk : chunks) {
+      output_->append(chunk);
+    }
+  } else if (!WriteVectored(fileno(file_), chunks)) {
+    error_ = Error("Failed to write listing");
+    return;
+  }
+  bytes_written_ += size;
+}
+
+ErrorOr<int64_t> ListingWriter::Flush() {
+  if (error_.has_value()) {
+    buffer_.clear();
+    return *error_;
+  }
+  if (output_) {
+    output_->append(buffer_);
+  } else if (!buffer_.empty() &&
+             (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) !=
+                  buffer_.size() ||
+              std::fflush(file_) != 0)) {
+    error_ = Error("Failed to write listing");
+    buffer_.clear();
+    return *error_;
+  }
+  bytes_written_ += buffer_.size();
+  buffer_.clear();
+  return bytes_written_;
+}
+
+void ListingWriter::AppendInstructionLine(
+    int pc, const DisassembledInstruction& instruction, std::string* output) {
+  // Matches "%-30s ;%s\n", where the first field is "%06x %-8s %s".
+  const size_t start = output->size();
+  AppendHex(pc, 6, output);
+  output->push_back(' ');
+  const size_t label_start = output->size();
+  if (instruction.label_id) {
+    AppendNumberedLabelName(instruction.label_id, output);
+  }
+  AppendPadding(label_start, 8, output);
+  output->push_back(' ');
+  instruction.instruction.AppendTo(output);
+  AppendPadding(start, 30, output);
+  output->append(" ;");
+  instruction.next_flag_state.AppendTo(output);
+  output->push_back('\n');
+}
+
+ErrorOr<int64_t> WriteBankListings(const Disassembly& disassembly,
+                                   const std::string& path_prefix,
+                                   int num_threads) {
+  NSASM_STATS_TIMER(SP_listing);
+  std::vector<int> banks;
+  for (auto it = disassembly.begin(); it != disassembly.end();
+       it = disassembly.lower_bound((it->first & 0xff0000) + 0x10000)) {
+    banks.push_back(it->first >> 16);
+  }
+
+  std::vector<ErrorOr<int64_t>> results(banks.size(), int64_t{0});
+  ParallelFor(num_threads, banks.size(), [&](int i) {
+    TraceSpan span("write_bank_listing", "bank", banks[i]);
+    std::string path = path_prefix;
+    AppendHex(banks[i], 2, &path);
+    path.append(".lst");
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+      results[i] = Error("Failed to open file for writing").SetLocation(path);
+      return;
+    }
+    ErrorOr<int64_t> written = int64_t{0};
+    {
+      ListingWriter writer(file);
+      writer.WriteDisassembly(disassembly, banks[i] << 16,
+                              (banks[i] + 1) << 16);
+      written = writer.Flush();
+    }
+    if (std::fclose(file) != 0 || !written.ok()) {
+      results[i] = Error("Failed to write listing").SetLocation(path);
+      return;
+    }
+    results[i] = written;
+  });
+
+  int64_t total = 0;
+  for (const auto& result : results) {
+    NSASM_RETURN_IF_ERROR(result);
+    total += *result;
+  }
+  return total;
+}
+
+}  // namespace nsasm
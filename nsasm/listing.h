@@ -0,0 +1,110 @@
+#ifndef NSASM_LISTING_H_
+#define NSASM_LISTING_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "nsasm/cfg.h"
+#include "nsasm/cycles.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/error.h"
+
+namespace nsasm {
+
+// Buffered writer for disassembly listings.
+//
+// Lines are formatted straight into a reusable buffer, which is written out
+// in large chunks.  Each instruction line has the form
+//
+//   808000 label1   LDA #$00             ;m8x8
+//
+// giving the address, label (if any), instruction, and the flag state after
+// the instruction.
+//
+// Instructions may be written one at a time, or a range at a time, so that a
+// listing can be streamed in address order as parts of a disassembly are
+// finished.
+class ListingWriter {
+ public:
+  // Writes to `file`, which is not closed.
+  explicit ListingWriter(std::FILE* file);
+  // Appends to `*output`.
+  explicit ListingWriter(std::string* output);
+
+  ListingWriter(const ListingWriter&) = delete;
+  ListingWriter& operator=(const ListingWriter&) = delete;
+
+  // Flushes any buffered output.  Call `Flush()` first to see errors.
+  ~ListingWriter();
+
+  // Writes `text`, followed by a newline.
+  void WriteLine(absl::string_view text);
+
+  // Writes the listing line for `instruction` at address `pc`.
+  void WriteInstruction(int pc, const DisassembledInstruction& instruction);
+
+  // Writes the instructions of `disassembly` in [begin, end), or all of them.
+  void WriteDisassembly(const Disassembly& disassembly, int begin = 0,
+                        int end = 0x1000000);
+
+  // As above, but annotates the listing with the cycle estimates in
+  // `cycles`, computed over `graph`.  Each instruction line ends with its
+  // cycle range, as in "[3-4]"; each basic block is preceded by a comment
+  // giving its cycles, and each subroutine entry by one giving the cycles of
+  // a call to it.
+  void WriteDisassemblyWithCycles(const Disassembly& disassembly,
+                                  const ControlFlowGraph& graph,
+                                  const CycleEstimate& cycles);
+
+  // As above, but formats the listing in chunks on `num_threads` threads (or
+  // the default number, if zero).  The output is identical.  Chunks are
+  // written to a file with vectored writes, rather than copied into one
+  // buffer first.
+  void WriteDisassemblyParallel(const Disassembly& disassembly,
+                                int num_threads = 0);
+
+  // Writes out all buffered output.  Returns the total number of bytes
+  // written so far, or the first write error.  After an error, further
+  // output is discarded.
+  ErrorOr<int64_t> Flush();
+
+  // Appends the listing line for `instruction` at address `pc` to `*output`.
+  static void AppendInstructionLine(int pc,
+                                    const DisassembledInstruction& instruction,
+                                    std::string* output);
+
+ private:
+  // Writes out `chunks`, after any buffered output.
+  void WriteChunks(const std::vector<std::string>& chunks);
+
+  void MaybeFlush() {
+    if (buffer_.size() >= kBufferSize) {
+      Flush();
+    }
+  }
+
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  std::FILE* file_ = nullptr;
+  std::string* output_ = nullptr;
+  std::string buffer_;
+  int64_t bytes_written_ = 0;
+  absl::optional<Error> error_;
+};
+
+// Writes the listing of each bank of `disassembly` to its own file, named
+// `path_prefix` followed by the bank number in hex and ".lst" (for example
+// "game_80.lst").  Banks are written concurrently, on `num_threads` threads
+// (or the default number, if zero).  Returns the total number of bytes
+// written, or the error for the lowest failing bank.
+ErrorOr<int64_t> WriteBankListings(const Disassembly& disassembly,
+                                   const std::string& path_prefix,
+                                   int num_threads = 0);
+
+}  // namespace nsasm
+
+#endif  // NSASM_LISTING_H_
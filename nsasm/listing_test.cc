@@ -0,0 +1,198 @@
+#include "nsasm/listing.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+// The listing format, printed the slow way.
+std::string ReferenceListing(const Disassembly& disassembly) {
+  std::string listing;
+  for (const auto& value : disassembly) {
+    std::string label = value.second.label_id
+                            ? NumberedLabelName(value.second.label_id)
+                            : "";
+    std::string text = absl::StrFormat("%06x %-8s %s", value.first, label,
+                                       value.second.instruction.ToString());
+    absl::StrAppendFormat(&listing, "%-30s ;%s\n", text,
+                          value.second.next_flag_state.ToString());
+  }
+  return listing;
+}
+
+Disassembly TestDisassembly() {
+  std::vector<uint8_t> data(0x10000, 0x00);
+  const std::vector<uint8_t> code = {
+      0x18,                    // $808000: CLC
+      0xc2, 0x30,              // $808001: REP #$30
+      0xa9, 0x34, 0x12,        // $808003: LDA #$1234
+      0xa2, 0x00, 0x10,        // $808006: LDX #$1000
+      0xbf, 0x56, 0x34, 0x12,  // $808009: LDA $123456, X
+      0x91, 0x12,              // $80800d: STA ($12), Y
+      0xb7, 0x34,              // $80800f: LDA [$34], Y
+      0x83, 0x03,              // $808011: STA $03, S
+      0xb3, 0x05,              // $808013: LDA ($05, S), Y
+      0x54, 0x7e, 0x7f,        // $808015: MVN #$7e, #$7f
+      0xe2, 0x20,              // $808018: SEP #$20
+      0x69, 0x01,              // $80801a: ADC #$01
+      0xf0, 0xe2,              // $80801c: BEQ $808000
+      0x82, 0x00, 0x00,        // $80801e: BRL $808021
+      0x6c, 0x00, 0x90,        // $808021: JMP ($9000)
+  };
+  std::copy(code.begin(), code.end(), data.begin());
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+  auto disassembly =
+      Disassemble(rom, 0x808000, FlagState(B_off, B_on, B_on));
+  EXPECT_TRUE(disassembly.ok());
+  return *disassembly;
+}
+
+TEST(ListingWriter, matches_reference_format) {
+  const Disassembly disassembly = TestDisassembly();
+  std::string listing;
+  {
+    ListingWriter writer(&listing);
+    writer.WriteDisassembly(disassembly);
+  }
+  EXPECT_EQ(listing, ReferenceListing(disassembly));
+  EXPECT_NE(listing.find("808015          MVN #$7e, #$7f"), std::string::npos);
+}
+
+TEST(ListingWriter, ranges_and_lines) {
+  const Disassembly disassembly = TestDisassembly();
+  std::string listing;
+  ListingWriter writer(&listing);
+  writer.WriteLine("; header");
+  writer.WriteDisassembly(disassembly, 0x808000, 0x808003);
+  writer.WriteInstruction(0x808003, disassembly.at(0x808003));
+  auto written = writer.Flush();
+  NSASM_ASSERT_OK(written);
+  EXPECT_EQ(listing,
+            "; header\n"
+            "808000 label1   CLC            ;m8, c=0\n"
+            "808001          REP #$30       ;m16x16, c=0\n"
+            "808003          LDA #$1234     ;m16x16, c=0\n");
+  EXPECT_EQ(*written, static_cast<int64_t>(listing.size()));
+}
+
+TEST(ListingWriter, file_output) {
+  const Disassembly disassembly = TestDisassembly();
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  {
+    ListingWriter writer(file);
+    // Enough lines to overflow the buffer several times.
+    for (int i = 0; i < 2000; ++i) {
+      writer.WriteDisassembly(disassembly);
+    }
+    auto written = writer.Flush();
+    NSASM_ASSERT_OK(written);
+  }
+  std::string expected;
+  const std::string once = ReferenceListing(disassembly);
+  for (int i = 0; i < 2000; ++i) {
+    expected += once;
+  }
+  std::string actual(expected.size() + 1, '\0');
+  std::rewind(file);
+  actual.resize(std::fread(&actual[0], 1, actual.size(), file));
+  std::fclose(file);
+  EXPECT_EQ(actual, expected);
+}
+
+// A disassembly of one long run of code in each of banks $80 and $81.
+Disassembly LargeDisassembly() {
+  std::vector<uint8_t> data(0x20000, 0xea);  // NOP
+  for (int bank_start : {0, 0x8000}) {
+    data[bank_start + 0x7000] = 0x80;  // BRA *
+    data[bank_start + 0x7001] = 0xfe;
+  }
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+  const FlagState state(B_off, B_on, B_on);
+  auto disassembly =
+      DisassembleAll(rom, {{0x808000, state}, {0x818000, state}});
+  EXPECT_TRUE(disassembly.ok());
+  return *disassembly;
+}
+
+TEST(ListingWriter, parallel_matches_sequential) {
+  const Disassembly disassembly = LargeDisassembly();
+  ASSERT_GT(disassembly.size(), 50000u);
+  std::string sequential;
+  std::string parallel;
+  {
+    ListingWriter writer(&sequential);
+    writer.WriteLine("; header");
+    writer.WriteDisassembly(disassembly);
+  }
+  {
+    ListingWriter writer(&parallel);
+    writer.WriteLine("; header");
+    writer.WriteDisassemblyParallel(disassembly, 4);
+  }
+  EXPECT_EQ(parallel, sequential);
+
+  // Vectored file output
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  {
+    ListingWriter writer(file);
+    writer.WriteLine("; header");
+    writer.WriteDisassemblyParallel(disassembly, 4);
+    auto written = writer.Flush();
+    NSASM_ASSERT_OK(written);
+    EXPECT_EQ(*written, static_cast<int64_t>(sequential.size()));
+  }
+  std::string actual(sequential.size() + 1, '\0');
+  std::rewind(file);
+  actual.resize(std::fread(&actual[0], 1, actual.size(), file));
+  std::fclose(file);
+  EXPECT_EQ(actual, sequential);
+}
+
+std::string ReadFile(const std::string& path) {
+  std::string contents;
+  std::FILE* file = std::fopen(path.c_str(), "r");
+  if (!file) {
+    return contents;
+  }
+  char buffer[4096];
+  size_t n;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, n);
+  }
+  std::fclose(file);
+  return contents;
+}
+
+TEST(WriteBankListings, one_file_per_bank) {
+  const Disassembly disassembly = LargeDisassembly();
+  const std::string prefix = testing::TempDir() + "/banks_";
+  auto written = WriteBankListings(disassembly, prefix, 2);
+  NSASM_ASSERT_OK(written);
+
+  std::string bank_80;
+  std::string bank_81;
+  {
+    ListingWriter writer(&bank_80);
+    writer.WriteDisassembly(disassembly, 0x800000, 0x810000);
+  }
+  {
+    ListingWriter writer(&bank_81);
+    writer.WriteDisassembly(disassembly, 0x810000, 0x820000);
+  }
+  EXPECT_EQ(ReadFile(prefix + "80.lst"), bank_80);
+  EXPECT_EQ(ReadFile(prefix + "81.lst"), bank_81);
+  EXPECT_EQ(*written, static_cast<int64_t>(bank_80.size() + bank_81.size()));
+
+  auto failed = WriteBankListings(disassembly, "/nonexistent/dir/banks_");
+  EXPECT_FALSE(failed.ok());
+}
+
+}  // namespace
+}  // namespace nsasm
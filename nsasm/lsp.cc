@@ -0,0 +1,271 @@
+#include "nsasm/lsp.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
+
+namespace nsasm {
+
+namespace {
+
+// JSON-RPC error codes
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+
+constexpr int kSeverityError = 1;
+constexpr int kSyncIncremental = 2;
+
+JsonValue Message() { return JsonValue::Object().Set("jsonrpc", "2.0"); }
+
+JsonValue ErrorResponse(const JsonValue& id, int code,
+                        const std::string& message) {
+  return Message().Set("id", id).Set(
+      "error",
+      JsonValue::Object().Set("code", code).Set("message", message));
+}
+
+JsonValue Position(int line, int column) {
+  return JsonValue::Object().Set("line", line).Set("character", column);
+}
+
+// Returns the UTF-16 code units in the UTF-8 sequence led by `lead`, or 0 if
+// `lead` continues a sequence.
+int Utf16Units(char lead) {
+  const uint8_t byte = lead;
+  if ((byte & 0xc0) == 0x80) {
+    return 0;
+  }
+  return byte >= 0xf0 ? 2 : 1;
+}
+
+// Converts a column of `text` counted in UTF-16 code units to bytes.  Columns
+// past the end of the text are clamped to it.
+int Utf16ToByteColumn(absl::string_view text, int column) {
+  int units = 0;
+  size_t byte = 0;
+  while (byte < text.size() && units < column) {
+    units += Utf16Units(text[byte++]);
+    while (byte < text.size() && Utf16Units(text[byte]) == 0) {
+      ++byte;
+    }
+  }
+  return byte;
+}
+
+// The inverse of Utf16ToByteColumn().
+int ByteToUtf16Column(absl::string_view text, int column) {
+  int units = 0;
+  for (char ch : text.substr(0, std::max(column, 0))) {
+    units += Utf16Units(ch);
+  }
+  return units;
+}
+
+}  // namespace
+
+const SourceDocument* LanguageServer::FindDocument(
+    const std::string& uri) const {
+  auto it = documents_.find(uri);
+  return it == documents_.end() ? nullptr : it->second.get();
+}
+
+std::vector<JsonValue> LanguageServer::HandleMessage(const JsonValue& message) {
+  std::vector<JsonValue> output;
+  const std::string& method = message["method"].AsString();
+  const JsonValue* id = message.Find("id");
+  if (id) {
+    if (method.empty()) {
+      // A response to a request of ours; we send none.
+      return output;
+    }
+    output.push_back(HandleRequest(method, message["params"], *id));
+  } else {
+    HandleNotification(method, message["params"], &output);
+  }
+  return output;
+}
+
+JsonValue LanguageServer::HandleRequest(const std::string& method,
+                                        const JsonValue& params,
+                                        const JsonValue& id) {
+  if (shutdown_requested_) {
+    return ErrorResponse(id, kInvalidRequest, "Server is shutting down");
+  }
+  JsonValue result;
+  if (method == "initialize") {
+    utf8_positions_ = false;
+    for (const JsonValue& encoding :
+         params["capabilities"]["general"]["positionEncodings"].Elements()) {
+      if (encoding.AsString() == "utf-8") {
+        utf8_positions_ = true;
+      }
+    }
+    result = JsonValue::Object()
+                 .Set("capabilities",
+                      JsonValue::Object()
+                          .Set("positionEncoding",
+                               utf8_positions_ ? "utf-8" : "utf-16")
+                          .Set("textDocumentSync",
+                               JsonValue::Object()
+                                   .Set("openClose", true)
+                                   .Set("change", kSyncIncremental))
+                          .Set("definitionProvider", true)
+                          .Set("hoverProvider", true))
+                 .Set("serverInfo", JsonValue::Object().Set("name", "nsasm"));
+  } else if (method == "shutdown") {
+    shutdown_requested_ = true;
+  } else if (method == "textDocument/definition") {
+    result = Definition(params);
+  } else if (method == "textDocument/hover") {
+    result = Hover(params);
+  } else {
+    return ErrorResponse(id, kMethodNotFound,
+                         absl::StrFormat("Unknown method '%s'", method));
+  }
+  return Message().Set("id", id).Set("result", std::move(result));
+}
+
+void LanguageServer::HandleNotification(const std::string& method,
+                                        const JsonValue& params,
+                                        std::vector<JsonValue>* output) {
+  if (method == "exit") {
+    exited_ = true;
+    return;
+  }
+  const std::string& uri = params["textDocument"]["uri"].AsString();
+  if (method == "textDocument/didOpen") {
+    absl::string_view path = uri;
+    absl::ConsumePrefix(&path, "file://");
+    auto& document = documents_[uri];
+    document = absl::make_unique<SourceDocument>(
+        std::string(path), params["textDocument"]["text"].AsString());
+    output->push_back(Diagnostics(uri, *document));
+  } else if (method == "textDocument/didChange") {
+    auto it = documents_.find(uri);
+    if (it == documents_.end()) {
+      return;
+    }
+    SourceDocument& document = *it->second;
+    for (const JsonValue& change : params["contentChanges"].Elements()) {
+      const JsonValue* range = change.Find("range");
+      if (range) {
+        document.Edit(ToPosition(document, (*range)["start"]),
+                      ToPosition(document, (*range)["end"]),
+                      change["text"].AsString());
+      } else {
+        document.SetText(change["text"].AsString());
+      }
+    }
+    output->push_back(Diagnostics(uri, document));
+  } else if (method == "textDocument/didClose") {
+    if (documents_.erase(uri)) {
+      // Clear the closed document's diagnostics.
+      output->push_back(Message()
+                            .Set("method", "textDocument/publishDiagnostics")
+                            .Set("params", JsonValue::Object()
+                                               .Set("uri", uri)
+                                               .Set("diagnostics",
+                                                    JsonValue::Array())));
+    }
+  }
+}
+
+JsonValue LanguageServer::Definition(const JsonValue& params) const {
+  JsonValue locations = JsonValue::Array();
+  const std::string& uri = params["textDocument"]["uri"].AsString();
+  const SourceDocument* document = FindDocument(uri);
+  if (!document) {
+    return locations;
+  }
+  const absl::string_view word =
+      document->WordAt(ToPosition(*document, params["position"]));
+  if (word.empty()) {
+    return locations;
+  }
+  for (int line : document->Definitions(word)) {
+    // Point at the label itself, where the line spells it out.
+    const std::string& text = document->LineText(line);
+    size_t begin = text.find(word.data(), 0, word.size());
+    size_t end = begin + word.size();
+    if (begin == std::string::npos) {
+      begin = 0;
+      end = text.size();
+    }
+    locations.Append(
+        JsonValue::Object().Set("uri", uri).Set(
+            "range", Range(*document, line, begin, end)));
+  }
+  return locations;
+}
+
+JsonValue LanguageServer::Hover(const JsonValue& params) const {
+  const SourceDocument* document =
+      FindDocument(params["textDocument"]["uri"].AsString());
+  const int line = params["position"]["line"].AsInt();
+  if (!document || line < 0 || line >= document->LineCount()) {
+    return JsonValue();
+  }
+  const FlagState& state = document->FlagStateAt(line);
+  std::string text = "Flag state: ";
+  state.AppendName(&text);
+  text.append(" (");
+  state.AppendTo(&text);
+  text.push_back(')');
+  return JsonValue::Object().Set(
+      "contents",
+      JsonValue::Object().Set("kind", "plaintext").Set("value", text));
+}
+
+JsonValue LanguageServer::Diagnostics(const std::string& uri,
+                                      const SourceDocument& document) const {
+  JsonValue diagnostics = JsonValue::Array();
+  for (int line : document.ErrorLines()) {
+    diagnostics.Append(
+        JsonValue::Object()
+            .Set("range", Range(document, line, 0,
+                                document.LineText(line).size()))
+            .Set("severity", kSeverityError)
+            .Set("source", "nsasm")
+            .Set("message", document.LineError(line)->message()));
+  }
+  return Message()
+      .Set("method", "textDocument/publishDiagnostics")
+      .Set("params", JsonValue::Object()
+                         .Set("uri", uri)
+                         .Set("diagnostics", std::move(diagnostics)));
+}
+
+SourceDocument::Position LanguageServer::ToPosition(
+    const SourceDocument& document, const JsonValue& position) const {
+  SourceDocument::Position result;
+  result.line = position["line"].AsInt();
+  result.column = position["character"].AsInt();
+  if (!utf8_positions_ && result.line >= 0 &&
+      result.line < document.LineCount()) {
+    result.column =
+        Utf16ToByteColumn(document.LineText(result.line), result.column);
+  }
+  return result;
+}
+
+JsonValue LanguageServer::Range(const SourceDocument& document, int line,
+                                int begin, int end) const {
+  if (!utf8_positions_) {
+    const std::string& text = document.LineText(line);
+    begin = ByteToUtf16Column(text, begin);
+    end = ByteToUtf16Column(text, end);
+  }
+  return JsonValue::Object()
+      .Set("start", Position(line, begin))
+      .Set("end", Position(line, end));
+}
+
+std::string FrameMessage(const JsonValue& message) {
+  std::string body = message.ToString();
+  return absl::StrFormat("Content-Length: %d\r\n\r\n%s", body.size(), body);
+}
+
+}  // namespace nsasm
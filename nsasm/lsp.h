@@ -0,0 +1,83 @@
+#ifndef NSASM_LSP_H_
+#define NSASM_LSP_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "nsasm/document.h"
+#include "nsasm/json.h"
+
+namespace nsasm {
+
+// A Language Server Protocol server for nsasm source files.
+//
+// Open documents are kept as SourceDocuments, and updated with incremental
+// edits (text document sync kind 2), so a keystroke reassembles only the
+// lines it touches.  The server provides:
+//
+//   * diagnostics, from lines that fail to tokenize or assemble, published
+//     after every change;
+//   * go to definition, for labels;
+//   * hover, showing the flag state inferred on entry to the hovered line.
+//
+// Columns are exchanged in UTF-8 bytes if the client offers that encoding at
+// initialization, and otherwise in UTF-16 code units, as the protocol
+// requires by default.
+//
+// Transport framing is left to the caller; see util/nsasm_lsp.cc.
+class LanguageServer {
+ public:
+  LanguageServer() = default;
+
+  LanguageServer(const LanguageServer&) = delete;
+  LanguageServer& operator=(const LanguageServer&) = delete;
+
+  // Handles one JSON-RPC message from the client, and returns the messages
+  // to send back: a response, if the message was a request, and any
+  // notifications.
+  std::vector<JsonValue> HandleMessage(const JsonValue& message);
+
+  // True once the client has sent the `exit` notification.
+  bool exited() const { return exited_; }
+  // The process exit status the protocol calls for after `exit`.
+  int exit_code() const { return shutdown_requested_ ? 0 : 1; }
+
+  // Returns the open document with the given URI, or nullptr.
+  const SourceDocument* FindDocument(const std::string& uri) const;
+
+ private:
+  // Returns the result for a request, or an error response.
+  JsonValue HandleRequest(const std::string& method, const JsonValue& params,
+                          const JsonValue& id);
+  void HandleNotification(const std::string& method, const JsonValue& params,
+                          std::vector<JsonValue>* output);
+
+  JsonValue Definition(const JsonValue& params) const;
+  JsonValue Hover(const JsonValue& params) const;
+
+  JsonValue Diagnostics(const std::string& uri,
+                        const SourceDocument& document) const;
+
+  // Converts between the client's positions and the byte columns of
+  // `document`.
+  SourceDocument::Position ToPosition(const SourceDocument& document,
+                                      const JsonValue& position) const;
+  JsonValue Range(const SourceDocument& document, int line, int begin,
+                  int end) const;
+
+  absl::flat_hash_map<std::string, std::unique_ptr<SourceDocument>> documents_;
+  // Whether the client counts columns in UTF-8 bytes, rather than the
+  // protocol's default of UTF-16 code units.
+  bool utf8_positions_ = false;
+  bool shutdown_requested_ = false;
+  bool exited_ = false;
+};
+
+// Returns `message` with the LSP base protocol header.
+std::string FrameMessage(const JsonValue& message);
+
+}  // namespace nsasm
+
+#endif  // NSASM_LSP_H_
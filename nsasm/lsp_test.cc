@@ -0,0 +1,158 @@
+#include "nsasm/lsp.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::HasSubstr;
+
+namespace nsasm {
+namespace {
+
+constexpr char kUri[] = "file:///tmp/test.s";
+
+// Sends `text` to `server`, and returns its replies.
+std::vector<JsonValue> Send(LanguageServer* server, const std::string& text) {
+  auto message = JsonValue::Parse(text);
+  EXPECT_TRUE(message.ok()) << text;
+  return server->HandleMessage(*message);
+}
+
+TEST(LanguageServer, session) {
+  LanguageServer server;
+  auto replies = Send(&server, R"({"jsonrpc":"2.0","id":1,
+      "method":"initialize","params":{}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_EQ(replies[0]["id"].AsInt(), 1);
+  EXPECT_EQ(replies[0]["result"]["capabilities"]["textDocumentSync"]["change"]
+                .AsInt(),
+            2);
+  EXPECT_TRUE(Send(&server, R"({"jsonrpc":"2.0","method":"initialized",
+      "params":{}})").empty());
+
+  // Opening a document publishes its diagnostics.
+  replies = Send(&server, R"({"jsonrpc":"2.0",
+      "method":"textDocument/didOpen","params":{"textDocument":{
+      "uri":"file:///tmp/test.s","languageId":"nsasm","version":1,
+      "text":"start: .entry m8x8\n  REP #$30\n  LDA (\n  BRA start\n"}}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_EQ(replies[0]["method"].AsString(), "textDocument/publishDiagnostics");
+  const JsonValue& params = replies[0]["params"];
+  EXPECT_EQ(params["uri"].AsString(), kUri);
+  ASSERT_EQ(params["diagnostics"].Elements().size(), 1);
+  const JsonValue& diagnostic = params["diagnostics"].Elements()[0];
+  EXPECT_EQ(diagnostic["range"]["start"]["line"].AsInt(), 2);
+  EXPECT_EQ(diagnostic["range"]["end"]["character"].AsInt(), 7);
+  EXPECT_FALSE(diagnostic["message"].AsString().empty());
+
+  // Fixing the bad line clears it.
+  replies = Send(&server, R"({"jsonrpc":"2.0",
+      "method":"textDocument/didChange","params":{"textDocument":{
+      "uri":"file:///tmp/test.s","version":2},"contentChanges":[
+      {"range":{"start":{"line":2,"character":6},
+                "end":{"line":2,"character":7}},"text":"#$1234"}]}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_TRUE(replies[0]["params"]["diagnostics"].Elements().empty());
+  EXPECT_EQ(server.FindDocument(kUri)->LineText(2), "  LDA #$1234");
+
+  // Go to definition of `start` on line 3.
+  replies = Send(&server, R"({"jsonrpc":"2.0","id":2,
+      "method":"textDocument/definition","params":{
+      "textDocument":{"uri":"file:///tmp/test.s"},
+      "position":{"line":3,"character":8}}})");
+  ASSERT_EQ(replies.size(), 1);
+  ASSERT_EQ(replies[0]["result"].Elements().size(), 1);
+  const JsonValue& location = replies[0]["result"].Elements()[0];
+  EXPECT_EQ(location["uri"].AsString(), kUri);
+  EXPECT_EQ(location["range"]["start"]["line"].AsInt(), 0);
+  EXPECT_EQ(location["range"]["start"]["character"].AsInt(), 0);
+  EXPECT_EQ(location["range"]["end"]["character"].AsInt(), 5);
+
+  // Hover shows the flag state.
+  replies = Send(&server, R"({"jsonrpc":"2.0","id":3,
+      "method":"textDocument/hover","params":{
+      "textDocument":{"uri":"file:///tmp/test.s"},
+      "position":{"line":2,"character":3}}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_THAT(replies[0]["result"]["contents"]["value"].AsString(),
+              HasSubstr("m16x16"));
+
+  replies = Send(&server, R"({"jsonrpc":"2.0","id":4,"method":"bogus"})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_EQ(replies[0]["error"]["code"].AsInt(), -32601);
+
+  // Closing clears diagnostics.
+  replies = Send(&server, R"({"jsonrpc":"2.0",
+      "method":"textDocument/didClose","params":{
+      "textDocument":{"uri":"file:///tmp/test.s"}}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_TRUE(replies[0]["params"]["diagnostics"].Elements().empty());
+  EXPECT_EQ(server.FindDocument(kUri), nullptr);
+
+  replies = Send(&server, R"({"jsonrpc":"2.0","id":5,"method":"shutdown"})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_TRUE(replies[0]["result"].IsNull());
+  EXPECT_FALSE(server.exited());
+  Send(&server, R"({"jsonrpc":"2.0","method":"exit"})");
+  EXPECT_TRUE(server.exited());
+  EXPECT_EQ(server.exit_code(), 0);
+}
+
+TEST(LanguageServer, position_encodings) {
+  // "é" is one UTF-16 code unit, and two bytes; the emoji is two code units,
+  // and four bytes.
+  constexpr char kOpen[] = R"({"jsonrpc":"2.0",
+      "method":"textDocument/didOpen","params":{"textDocument":{
+      "uri":"file:///tmp/test.s","languageId":"nsasm","version":1,
+      "text":"  LDA ( ; \u00e9\ud83d\ude00\n"}}})";
+
+  // Without an offer of UTF-8, columns count UTF-16 code units.
+  LanguageServer server;
+  auto replies = Send(&server, R"({"jsonrpc":"2.0","id":1,
+      "method":"initialize","params":{}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_EQ(
+      replies[0]["result"]["capabilities"]["positionEncoding"].AsString(),
+      "utf-16");
+  replies = Send(&server, kOpen);
+  ASSERT_EQ(replies.size(), 1);
+  ASSERT_EQ(replies[0]["params"]["diagnostics"].Elements().size(), 1);
+  EXPECT_EQ(replies[0]["params"]["diagnostics"].Elements()[0]["range"]["end"]
+                   ["character"]
+                       .AsInt(),
+            13);
+  Send(&server, R"({"jsonrpc":"2.0",
+      "method":"textDocument/didChange","params":{"textDocument":{
+      "uri":"file:///tmp/test.s","version":2},"contentChanges":[
+      {"range":{"start":{"line":0,"character":11},
+                "end":{"line":0,"character":11}},"text":"x"}]}})");
+  EXPECT_EQ(server.FindDocument(kUri)->LineText(0),
+            "  LDA ( ; \xc3\xa9x\xf0\x9f\x98\x80");
+
+  // With it, columns count bytes.
+  LanguageServer utf8_server;
+  replies = Send(&utf8_server, R"({"jsonrpc":"2.0","id":1,
+      "method":"initialize","params":{"capabilities":{
+      "general":{"positionEncodings":["utf-16","utf-8"]}}}})");
+  ASSERT_EQ(replies.size(), 1);
+  EXPECT_EQ(
+      replies[0]["result"]["capabilities"]["positionEncoding"].AsString(),
+      "utf-8");
+  replies = Send(&utf8_server, kOpen);
+  ASSERT_EQ(replies.size(), 1);
+  ASSERT_EQ(replies[0]["params"]["diagnostics"].Elements().size(), 1);
+  EXPECT_EQ(replies[0]["params"]["diagnostics"].Elements()[0]["range"]["end"]
+                   ["character"]
+                       .AsInt(),
+            16);
+}
+
+TEST(LanguageServer, frame_message) {
+  EXPECT_EQ(FrameMessage(JsonValue::Object().Set("id", 1)),
+            "Content-Length: 8\r\n\r\n{\"id\":1}");
+}
+
+}  // namespace
+}  // namespace nsasm
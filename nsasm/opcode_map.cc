@@ -301,6 +301,14 @@ Instruction DecodeOpcode(uint8_t opcode) {
   return ins;
 }
 
+absl::optional<uint8_t> EncodeOpcode(Mnemonic m, AddressingMode a) {
+  auto it = ReverseOpcodeMap().find(std::make_pair(m, a));
+  if (it == ReverseOpcodeMap().end()) {
+    return absl::nullopt;
+  }
+  return it->second;
+}
+
 bool ImmediateArgumentUsesMBit(Mnemonic m) {
   DecodeMapEntry e(m, A_imm_fm);
   return ReverseOpcodeMap().contains(e) || m == PM_add || m == PM_sub;
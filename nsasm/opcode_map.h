@@ -3,6 +3,7 @@
 
 #include <cstdint>
 
+#include "absl/types/optional.h"
 #include "nsasm/flag_state.h"
 #include "nsasm/instruction.h"
 
@@ -10,6 +11,11 @@ namespace nsasm {
 
 Instruction DecodeOpcode(uint8_t opcode);
 
+// Returns the opcode for the given mnemonic and addressing mode, or nullopt if
+// there is none.  Immediate modes may be given as A_imm_b or A_imm_w, as well
+// as the A_imm_fm and A_imm_fx sentinels.
+absl::optional<uint8_t> EncodeOpcode(Mnemonic m, AddressingMode a);
+
 // Returns true iff the given mnemonic takes an immediate argument whose size is
 // controlled by the M status bit.
 bool ImmediateArgumentUsesMBit(Mnemonic m);
@@ -0,0 +1,167 @@
+#include "nsasm/optimize.h"
+
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
+#include "nsasm/expression.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+namespace {
+
+// The position of an instruction or directive in the source.
+struct Step {
+  int line;       // index into the lines
+  int statement;  // index into the line's statements
+};
+
+// Returns the bits of `arg` that REP (if `target` is B_off) or SEP (if B_on)
+// would leave unchanged, entered in `state`.
+int RedundantBits(const FlagState& state, BitState target, int arg) {
+  int redundant = 0;
+  auto check = [&](int mask, BitState bit, BitState result) {
+    if ((arg & mask) && (bit == B_on || bit == B_off) && bit == result) {
+      redundant |= mask;
+    }
+  };
+  check(0x01, state.CBit(), target);
+  check(0x10, state.XBit(), ConstrainedForEBit(target, state.EBit()));
+  check(0x20, state.MBit(), ConstrainedForEBit(target, state.EBit()));
+  return redundant;
+}
+
+}  // namespace
+
+std::string Rewrite::ToString() const {
+  if (after.empty()) {
+    return absl::StrFormat("line %d: removed %s (%s)", line, before,
+                           state.ToString());
+  }
+  return absl::StrFormat("line %d: narrowed %s to %s (%s)", line, before,
+                         after, state.ToString());
+}
+
+std::vector<Rewrite> EliminateRedundantModeSwitches(
+    std::vector<std::vector<Statement>>* lines) {
+  std::vector<Step> steps;
+  // Each label, mapped to the step following it.
+  absl::flat_hash_map<std::string, int> labels;
+  for (size_t i = 0; i < lines->size(); ++i) {
+    const std::vector<Statement>& line = (*lines)[i];
+    for (size_t j = 0; j < line.size(); ++j) {
+      if (absl::holds_alternative<std::string>(line[j])) {
+        labels.emplace(absl::get<std::string>(line[j]), steps.size());
+      } else {
+        steps.push_back({static_cast<int>(i), static_cast<int>(j)});
+      }
+    }
+  }
+  auto statement = [&](int step) -> Statement& {
+    return (*lines)[steps[step].line][steps[step].statement];
+  };
+  auto target = [&](const Instruction& instruction) -> absl::optional<int> {
+    auto label = instruction.arg1.SimpleIdentifier();
+    if (!label.has_value()) {
+      return absl::nullopt;
+    }
+    auto it = labels.find(*label);
+    if (it == labels.end()) {
+      return absl::nullopt;
+    }
+    return it->second;
+  };
+
+  // The merged state on entry to each step; nullopt if no path reaches it.
+  std::vector<absl::optional<FlagState>> states(steps.size());
+  std::vector<int> worklist;
+  auto merge = [&](int step, const FlagState& state) {
+    if (step >= static_cast<int>(steps.size())) {
+      return;
+    }
+    absl::optional<FlagState>& entry = states[step];
+    const FlagState merged = entry.has_value() ? (*entry | state) : state;
+    if (!entry.has_value() || *entry != merged) {
+      entry = merged;
+      worklist.push_back(step);
+    }
+  };
+  merge(0, FlagState());
+  while (!worklist.empty()) {
+    const int step = worklist.back();
+    worklist.pop_back();
+    const FlagState state = *states[step];
+    const Statement& current = statement(step);
+    // The state on entry to the next step, along straight-line code.
+    FlagState next = StatementExitState(state, current);
+    const Instruction* instruction = absl::get_if<Instruction>(&current);
+    if (instruction) {
+      const Mnemonic mnemonic = instruction->mnemonic;
+      auto jump_target = target(*instruction);
+      if (instruction->addressing_mode == A_rel8 && mnemonic != M_bra) {
+        if (jump_target.has_value()) {
+          merge(*jump_target, state.ExecuteBranch(*instruction));
+        }
+      } else if (mnemonic == M_jmp || mnemonic == M_bra || mnemonic == M_brl) {
+        if (jump_target.has_value()) {
+          merge(*jump_target, state.Execute(*instruction));
+        }
+        // The code after a jump is entered from elsewhere.  This holds for
+        // BRL, too, which StatementExitState() leaves to the caller.
+        next = FlagState(B_unknown, B_unknown, B_unknown);
+      } else if (mnemonic == M_jsr || mnemonic == M_jsl) {
+        if (jump_target.has_value()) {
+          merge(*jump_target, state.Execute(*instruction));
+        }
+        // The callee may return with any `m`, `x` and carry bits; only the
+        // `e` bit is assumed to survive the call.
+        next = FlagState(state.EBit(), B_unknown, B_unknown);
+      }
+    }
+    merge(step + 1, next);
+  }
+
+  std::vector<Rewrite> rewrites;
+  // Removals wait until the scan is done, and go last first, so that the
+  // positions in `steps` stay valid.
+  std::vector<Step> removals;
+  for (int step = 0; step < static_cast<int>(steps.size()); ++step) {
+    Instruction* instruction = absl::get_if<Instruction>(&statement(step));
+    if (!states[step].has_value() || !instruction ||
+        (instruction->mnemonic != M_rep && instruction->mnemonic != M_sep)) {
+      continue;
+    }
+    auto arg = instruction->arg1.Evaluate();
+    if (!arg.ok()) {
+      continue;
+    }
+    const BitState target_bit = instruction->mnemonic == M_rep ? B_off : B_on;
+    const int redundant = RedundantBits(*states[step], target_bit, *arg);
+    if (redundant == 0) {
+      continue;
+    }
+    Rewrite rewrite;
+    rewrite.line = steps[step].line + 1;
+    rewrite.before = instruction->ToString();
+    rewrite.state = *states[step];
+    const int remaining = *arg & ~redundant;
+    if (remaining != 0) {
+      instruction->arg1 =
+          ExpressionOrNull(absl::make_unique<Literal>(remaining, T_byte));
+      rewrite.after = instruction->ToString();
+    } else {
+      removals.push_back(steps[step]);
+    }
+    rewrites.push_back(std::move(rewrite));
+  }
+  for (auto it = removals.rbegin(); it != removals.rend(); ++it) {
+    std::vector<Statement>& line = (*lines)[it->line];
+    line.erase(line.begin() + it->statement);
+  }
+  return rewrites;
+}
+
+}  // namespace nsasm
@@ -0,0 +1,58 @@
+#ifndef NSASM_OPTIMIZE_H_
+#define NSASM_OPTIMIZE_H_
+
+#include <string>
+#include <vector>
+
+#include "nsasm/flag_state.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+// A change made by an optimization pass.
+struct Rewrite {
+  // The line changed, numbered from one.
+  int line = 0;
+  // The instruction before and after the change; `after` is empty if the
+  // instruction was removed.
+  std::string before;
+  std::string after;
+  // The flag state on entry to the instruction, which justifies the change.
+  FlagState state;
+
+  // Returns a description, such as "line 7: removed SEP #$20 (m8x8)".
+  std::string ToString() const;
+};
+
+// Removes REP and SEP instructions that change no status bit, and narrows
+// those that change only some of the bits they name.
+//
+// Flag states are found by dataflow over the whole source: along straight-
+// line code (see StatementExitState()), and along branches, jumps and calls
+// to labels in the source, merging the states of every path into a label.
+// The source is entered at its first line, in the default FlagState; code
+// after a return or jump is assumed to be entered from elsewhere, in an
+// unknown state.  A JSR or JSL may return with any `m`, `x` and carry bits,
+// so only the `e` bit is carried past one, and a mode switch after a call is
+// kept unless a `.mode` directive asserts the state the callee returns in.
+// `.mode` and `.entry` directives set the state, as assertions of how the
+// code is entered.  Code entered from elsewhere other than after a return or
+// jump, such as a label called from another source, needs one of these
+// directives to be analyzed soundly.
+//
+// A bit named by REP or SEP is redundant if it is known to hold the value the
+// instruction would give it on every path into the instruction.  Only the
+// `m`, `x` and carry bits are tracked, so the other bits are never dropped.
+// An instruction with only redundant bits is removed, saving 3 cycles and 2
+// bytes; one with some is narrowed to the rest, with its cost unchanged.
+// Instructions whose argument is not a constant, and unreachable code, are
+// left alone.
+//
+// `lines` holds the statements of each line, with `lines[i]` holding line
+// i + 1.  Returns the rewrites made, in line order.
+std::vector<Rewrite> EliminateRedundantModeSwitches(
+    std::vector<std::vector<Statement>>* lines);
+
+}  // namespace nsasm
+
+#endif  // NSASM_OPTIMIZE_H_
@@ -0,0 +1,168 @@
+#include "nsasm/optimize.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+#include "nsasm/workspace.h"
+
+namespace nsasm {
+namespace {
+
+// Returns the rewrites made to `source`, then the rewritten listing.
+std::string Optimize(SourceFile source) {
+  std::string result;
+  for (const Rewrite& rewrite :
+       EliminateRedundantModeSwitches(&source.lines)) {
+    result.append(rewrite.ToString()).push_back('\n');
+  }
+  return result + "--\n" + SourceListing(source.lines);
+}
+
+std::string Optimize(const std::string& text) {
+  SourceFile source = ParseSource("test.s", text);
+  EXPECT_TRUE(source.errors.empty());
+  return Optimize(std::move(source));
+}
+
+TEST(EliminateRedundantModeSwitches, straight_line) {
+  EXPECT_EQ(Optimize(".mode m8x8\n"
+                     "  SEP #$20\n"
+                     "  LDA #$12\n"
+                     "  REP #$20\n"
+                     "  REP #$20\n"
+                     "  SEP #$30\n"
+                     "  SEP #$28\n"),
+            "line 2: removed SEP #$20 (m8x8)\n"
+            "line 5: removed REP #$20 (m16x8)\n"
+            "line 6: narrowed SEP #$30 to SEP #$20 (m16x8)\n"
+            "line 7: narrowed SEP #$28 to SEP #$08 (m8x8)\n"
+            "--\n"
+            "    .MODE m8x8\n"
+            "    LDA #$12\n"
+            "    REP #$20\n"
+            "    SEP #$20\n"
+            "    SEP #$08\n");
+
+  // In emulation mode, `m` and `x` are always set.
+  EXPECT_EQ(Optimize(".mode emu\n"
+                     "  REP #$30\n"
+                     "  SEP #$10\n"),
+            "line 2: removed REP #$30 (emu)\n"
+            "line 3: removed SEP #$10 (emu)\n"
+            "--\n"
+            "    .MODE emu\n");
+}
+
+TEST(EliminateRedundantModeSwitches, every_path) {
+  EXPECT_EQ(Optimize(".mode m8x8\n"
+                     "  BEQ skip\n"
+                     "  REP #$20\n"
+                     "skip: SEP #$20\n"
+                     "  SEP #$20\n"
+                     "  RTS\n"
+                     "  SEP #$20\n"
+                     ".mode m8x8\n"
+                     "  SEP #$20\n"),
+            "line 5: removed SEP #$20 (m8x8)\n"
+            "line 9: removed SEP #$20 (m8x8)\n"
+            "--\n"
+            "    .MODE m8x8\n"
+            "    BEQ skip\n"
+            "    REP #$20\n"
+            "skip:\n"
+            "    SEP #$20\n"
+            "    RTS\n"
+            "    SEP #$20\n"
+            "    .MODE m8x8\n");
+
+  // The back edge of a loop is a path in, too.
+  EXPECT_EQ(Optimize(".mode m16x16\n"
+                     "loop: SEP #$20\n"
+                     "  REP #$20\n"
+                     "  DEX\n"
+                     "  BNE loop\n"),
+            "--\n"
+            "    .MODE m16x16\n"
+            "loop:\n"
+            "    SEP #$20\n"
+            "    REP #$20\n"
+            "    DEX\n"
+            "    BNE loop\n");
+}
+
+TEST(EliminateRedundantModeSwitches, calls) {
+  // A callee may return in any mode.
+  EXPECT_EQ(Optimize(".mode m8x8\n"
+                     "  SEP #$20\n"
+                     "  JSL $018000\n"
+                     "  SEP #$20\n"
+                     "  LDA #$12\n"),
+            "line 2: removed SEP #$20 (m8x8)\n"
+            "--\n"
+            "    .MODE m8x8\n"
+            "    JSL $018000\n"
+            "    SEP #$20\n"
+            "    LDA #$12\n");
+
+  // Unless a `.mode` directive says otherwise.
+  EXPECT_EQ(Optimize(".mode m8x8\n"
+                     "  JSL $018000\n"
+                     ".mode m8x8\n"
+                     "  SEP #$20\n"),
+            "line 4: removed SEP #$20 (m8x8)\n"
+            "--\n"
+            "    .MODE m8x8\n"
+            "    JSL $018000\n"
+            "    .MODE m8x8\n");
+}
+
+TEST(EliminateRedundantModeSwitches, called_labels) {
+  // `helper` is fallen into in m16x16, but called in m8x8.
+  SourceFile source = ParseSource("test.s",
+                                  ".mode m8x8\n"
+                                  "\n"
+                                  "  RTS\n"
+                                  ".mode m16x16\n"
+                                  "  NOP\n"
+                                  "helper: REP #$20\n"
+                                  "  RTS\n");
+  ASSERT_TRUE(source.errors.empty());
+  // The assembler requires an explicitly sized address, so it cannot take
+  // `JSR helper` yet; add the call by hand.
+  source.lines[1].push_back(
+      Instruction{M_jsr, A_dir_w,
+                  ExpressionOrNull(absl::make_unique<Identifier>("helper")),
+                  ExpressionOrNull()});
+  EXPECT_EQ(Optimize(std::move(source)),
+            "--\n"
+            "    .MODE m8x8\n"
+            "    JSR helper\n"
+            "    RTS\n"
+            "    .MODE m16x16\n"
+            "    NOP\n"
+            "helper:\n"
+            "    REP #$20\n"
+            "    RTS\n");
+}
+
+TEST(EliminateRedundantModeSwitches, pushed_state) {
+  EXPECT_EQ(Optimize(".mode m8x16\n"
+                     "  PHP\n"
+                     "  REP #$30\n"
+                     "  PLP\n"
+                     "  SEP #$20\n"
+                     "  REP #$10\n"),
+            "line 3: narrowed REP #$30 to REP #$20 (m8x16)\n"
+            "line 5: removed SEP #$20 (m8x16)\n"
+            "line 6: removed REP #$10 (m8x16)\n"
+            "--\n"
+            "    .MODE m8x16\n"
+            "    PHP\n"
+            "    REP #$20\n"
+            "    PLP\n");
+}
+
+}  // namespace
+}  // namespace nsasm
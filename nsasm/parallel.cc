@@ -0,0 +1,12 @@
+#include "nsasm/parallel.h"
+
+#include <thread>
+
+namespace nsasm {
+
+int DefaultThreadCount() {
+  int count = std::thread::hardware_concurrency();
+  return count > 0 ? count : 1;
+}
+
+}  // namespace nsasm
@@ -0,0 +1,143 @@
+#ifndef NSASM_PARALLEL_H_
+#define NSASM_PARALLEL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "nsasm/trace.h"
+
+namespace nsasm {
+
+// Returns the number of worker threads to use when a caller asks for the
+// default (zero) thread count.
+int DefaultThreadCount();
+
+namespace internal {
+
+// A double-ended task queue owned by one worker.  The owner pushes and pops at
+// the back; idle workers steal from the front.
+class TaskDeque {
+ public:
+  void Push(int task) {
+    absl::MutexLock lock(&mu_);
+    tasks_.push_back(task);
+  }
+
+  bool Pop(int* task) {
+    absl::MutexLock lock(&mu_);
+    if (tasks_.empty()) {
+      return false;
+    }
+    *task = tasks_.back();
+    tasks_.pop_back();
+    return true;
+  }
+
+  bool Steal(int* task) {
+    absl::MutexLock lock(&mu_);
+    if (tasks_.empty()) {
+      return false;
+    }
+    *task = tasks_.front();
+    tasks_.pop_front();
+    return true;
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::deque<int> tasks_;
+};
+
+}  // namespace internal
+
+// Runs integer-identified tasks on a pool of `num_threads` work-stealing
+// workers, returning once every task has finished.
+//
+// `fn` is invoked as `fn(worker_index, task, push)`, where `push(int)` schedules
+// another task on the calling worker's queue.  Tasks may run in any order and
+// on any worker; callers needing deterministic output must make the combined
+// effect of their tasks order-independent.
+template <typename Fn>
+void RunWorkStealing(int num_threads, const std::vector<int>& initial_tasks,
+                     Fn fn) {
+  if (num_threads <= 0) {
+    num_threads = DefaultThreadCount();
+  }
+  std::vector<std::unique_ptr<internal::TaskDeque>> queues;
+  for (int i = 0; i < num_threads; ++i) {
+    queues.push_back(absl::make_unique<internal::TaskDeque>());
+  }
+  // Number of tasks pushed but not yet finished.  Workers exit when this
+  // reaches zero.
+  std::atomic<int64_t> outstanding(initial_tasks.size());
+  for (size_t i = 0; i < initial_tasks.size(); ++i) {
+    queues[i % num_threads]->Push(initial_tasks[i]);
+  }
+
+  auto worker = [&](int index) {
+    TraceSpan span("work_stealing_worker", "worker", index);
+    internal::TaskDeque& own = *queues[index];
+    auto push = [&](int task) {
+      outstanding.fetch_add(1, std::memory_order_relaxed);
+      own.Push(task);
+    };
+    while (true) {
+      int task;
+      bool found = own.Pop(&task);
+      for (int i = 1; !found && i < num_threads; ++i) {
+        found = queues[(index + i) % num_threads]->Steal(&task);
+      }
+      if (!found) {
+        if (outstanding.load(std::memory_order_acquire) == 0) {
+          return;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      fn(index, task, push);
+      outstanding.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Calls `fn(i)` for every `i` in [0, n), spread across `num_threads` threads.
+template <typename Fn>
+void ParallelFor(int num_threads, int n, Fn fn) {
+  if (num_threads <= 0) {
+    num_threads = DefaultThreadCount();
+  }
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    TraceSpan span("parallel_for_worker");
+    for (int i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+      fn(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads && i < n; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace nsasm
+
+#endif  // NSASM_PARALLEL_H_
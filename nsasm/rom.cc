@@ -9,7 +9,7 @@ ErrorOr<int> SnesToROMAddress(int snes_address, Mapping mapping) {
     return Error("Address out of range").SetLocation(snes_address);
   }
   int bank_address = snes_address & 0xffff;
-  int bank = (snes_address >> 16) % 0xff;
+  int bank = snes_address >> 16;
   if (bank == 0x7e || bank == 0x7f) {
     return Error("Address in WRAM").SetLocation(snes_address);
   }
@@ -21,7 +21,8 @@ ErrorOr<int> SnesToROMAddress(int snes_address, Mapping mapping) {
     if (bank_address < 0x8000) {
       return Error("Invalid LoRom ROM address").SetLocation(snes_address);
     };
-    return (bank_address & 0x7fff) | (bank << 15);
+    // banks $80-$ff mirror banks $00-$7f
+    return (bank_address & 0x7fff) | ((bank & 0x7f) << 15);
   } else if (mapping == kHiRom) {
     return snes_address & 0x3fffff;
   } else if (mapping == kExHiRom) {
@@ -35,6 +36,46 @@ ErrorOr<int> SnesToROMAddress(int snes_address, Mapping mapping) {
   return Error("LOGIC ERROR: Mapping mode %d unknown", mapping);
 }
 
+ErrorOr<int> ROMToSnesAddress(int rom_address, Mapping mapping) {
+  if (rom_address < 0) {
+    return Error("ROM address out of range").SetLocation(rom_address);
+  }
+  if (mapping == kLoRom) {
+    if (rom_address >= 0x400000) {
+      return Error("ROM address out of range").SetLocation(rom_address);
+    }
+    int bank = rom_address >> 15;
+    if (bank >= 0x7e) {
+      // banks $7e and $7f are WRAM; use the mirror
+      bank |= 0x80;
+    }
+    return (bank << 16) | 0x8000 | (rom_address & 0x7fff);
+  } else if (mapping == kHiRom) {
+    if (rom_address >= 0x400000) {
+      return Error("ROM address out of range").SetLocation(rom_address);
+    }
+    return 0xc00000 | rom_address;
+  } else if (mapping == kExHiRom) {
+    if (rom_address < 0x400000) {
+      return 0xc00000 | rom_address;
+    }
+    if (rom_address < 0x7e0000) {
+      return rom_address;
+    }
+    if (rom_address >= 0x800000) {
+      return Error("ROM address out of range").SetLocation(rom_address);
+    }
+    // The last 128k would fall in banks $7e and $7f, which are WRAM.  Only
+    // their upper halves are visible, mirrored in banks $3e and $3f.
+    if ((rom_address & 0xffff) < 0x8000) {
+      return Error("ROM address not visible to the SNES")
+          .SetLocation(rom_address);
+    }
+    return rom_address - 0x400000;
+  }
+  return Error("LOGIC ERROR: Mapping mode %d unknown", mapping);
+}
+
 ErrorOr<std::vector<uint8_t>> Rom::Read(int address, int length) const {
   if (length == 0) {
     return std::vector<uint8_t>();
@@ -72,6 +113,14 @@ ErrorOr<std::vector<uint8_t>> Rom::Read(int address, int length) const {
   }
 }
 
+uint64_t Rom::ContentHash() const {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (uint8_t byte : data_) {
+    hash = (hash ^ byte) * 0x100000001b3;
+  }
+  return hash;
+}
+
 ErrorOr<int> Rom::ReadWord(int address) const {
   auto read = Read(address, 2);
   NSASM_RETURN_IF_ERROR(read);
@@ -80,6 +129,42 @@ ErrorOr<int> Rom::ReadWord(int address) const {
 
 namespace {
 
+struct VectorLocation {
+  const char* name;
+  bool emulation;
+  int address;
+};
+
+constexpr VectorLocation vector_locations[] = {
+    {"COP", false, 0xffe4},  {"BRK", false, 0xffe6}, {"ABORT", false, 0xffe8},
+    {"NMI", false, 0xffea},  {"IRQ", false, 0xffee}, {"COP", true, 0xfff4},
+    {"ABORT", true, 0xfff8}, {"NMI", true, 0xfffa},  {"RESET", true, 0xfffc},
+    {"IRQ", true, 0xfffe},
+};
+
+}  // namespace
+
+std::vector<InterruptVector> Rom::ReadVectors() const {
+  std::vector<InterruptVector> vectors;
+  for (const VectorLocation& location : vector_locations) {
+    auto target = ReadWord(location.address);
+    if (!target.ok() || !Read(*target, 1).ok()) {
+      continue;
+    }
+    InterruptVector vector;
+    vector.name = location.name;
+    vector.emulation = location.emulation;
+    vector.target = *target;
+    vector.flag_state = location.emulation
+                            ? FlagState(B_on, B_on, B_on)
+                            : FlagState(B_off, B_original, B_original);
+    vectors.push_back(std::move(vector));
+  }
+  return vectors;
+}
+
+namespace {
+
 // Returns true if, heuristically, this looks like a SNES header.
 //
 // TODO: This is realy poor.
@@ -2,9 +2,11 @@
 #define NSASM_ROM_H_
 
 #include "nsasm/error.h"
+#include "nsasm/flag_state.h"
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace nsasm {
 
@@ -24,6 +26,16 @@ enum Mapping {
 // intercepted by the SNES (for work ram or memory-mapped registers, say.)
 ErrorOr<int> SnesToROMAddress(int snes_address, Mapping mapping);
 
+// Convert an offset into cartridge ROM to an address in the 24-bit SNES address
+// space.
+//
+// Most ROM bytes are visible at several SNES addresses.  This returns the one
+// code conventionally runs from: banks $00-$7d (then $fe-$ff) for LoRom, and
+// banks $c0-$ff (then $40-$7d) for HiRom and ExHiRom.
+//
+// Returns an error if `rom_address` cannot be seen by the SNES.
+ErrorOr<int> ROMToSnesAddress(int rom_address, Mapping mapping);
+
 // Add the given offset to an address.  Adds do not carry over into the bank
 // word.  (In other words, byte 2 does not carry into byte 3.  This is a weird
 // consequence of the 24 bit program counter being split between the PC and K
@@ -32,13 +44,30 @@ constexpr int AddToPC(int address, int offset) {
   return (address & 0xff0000) | ((address + offset) & 0xffff);
 }
 
+// An interrupt or reset vector from the SNES header.
+struct InterruptVector {
+  // Vector name: "COP", "BRK", "ABORT", "NMI", "RESET", or "IRQ".  (In
+  // emulation mode, BRK shares the IRQ vector.)
+  std::string name;
+  // True for vectors in the emulation mode table.
+  bool emulation;
+  // SNES address of the handler.  Handlers always run in bank $00.
+  int target;
+  // Processor state on entry to the handler.  Emulation mode handlers start
+  // in emulation mode; native mode handlers start with `m` and `x` as they
+  // were when the interrupt fired.
+  FlagState flag_state;
+};
+
 // Representation of a SNES ROM, presumably loaded from disk.
 class Rom {
  public:
   Rom(Mapping mapping_mode, std::string path, std::vector<uint8_t> data)
       : mapping_mode_(mapping_mode),
         path_(std::move(path)),
-        data_(std::move(data)) {}
+        data_(std::move(data)) {
+    vectors_ = ReadVectors();
+  }
 
   // Returns `length` bytes of program data, starting at `address`, incrementing
   // addresses with the same logic as `AddToPC()` above.
@@ -49,10 +78,29 @@ class Rom {
   ErrorOr<int> ReadWord(int address) const;
 
   const std::string& path() const { return path_; }
+
+  // The ROM contents, indexed by ROM address.
+  const std::vector<uint8_t>& data() const { return data_; }
+
+  Mapping mapping_mode() const { return mapping_mode_; }
+
+  // Returns a 64-bit FNV-1a hash of the ROM contents, for identifying ROMs
+  // across runs.
+  uint64_t ContentHash() const;
+
+  // Returns the native and emulation mode vectors from the SNES header.
+  //
+  // Vectors that do not point into ROM (unused vectors, or handlers living in
+  // RAM) are omitted.
+  const std::vector<InterruptVector>& Vectors() const { return vectors_; }
+
  private:
+  std::vector<InterruptVector> ReadVectors() const;
+
   Mapping mapping_mode_;
   std::string path_;
   std::vector<uint8_t> data_;
+  std::vector<InterruptVector> vectors_;
 };
 
 ErrorOr<Rom> LoadRomFile(const std::string& path);
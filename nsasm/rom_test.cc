@@ -0,0 +1,81 @@
+#include "nsasm/rom.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace nsasm {
+namespace {
+
+TEST(Rom, snes_to_rom_address) {
+  EXPECT_EQ(*SnesToROMAddress(0x008000, kLoRom), 0x000000);
+  EXPECT_EQ(*SnesToROMAddress(0x00ffff, kLoRom), 0x007fff);
+  EXPECT_EQ(*SnesToROMAddress(0x018000, kLoRom), 0x008000);
+  EXPECT_EQ(*SnesToROMAddress(0x808000, kLoRom), 0x000000);
+  EXPECT_EQ(*SnesToROMAddress(0xffffff, kLoRom), 0x3fffff);
+  EXPECT_FALSE(SnesToROMAddress(0x000000, kLoRom).ok());
+  EXPECT_FALSE(SnesToROMAddress(0x7e8000, kLoRom).ok());
+
+  EXPECT_EQ(*SnesToROMAddress(0x00ffc0, kHiRom), 0x00ffc0);
+  EXPECT_EQ(*SnesToROMAddress(0xc12345, kHiRom), 0x012345);
+  EXPECT_EQ(*SnesToROMAddress(0x00ffc0, kExHiRom), 0x40ffc0);
+  EXPECT_EQ(*SnesToROMAddress(0xc12345, kExHiRom), 0x012345);
+}
+
+TEST(Rom, rom_to_snes_address) {
+  EXPECT_EQ(*ROMToSnesAddress(0x000000, kLoRom), 0x008000);
+  EXPECT_EQ(*ROMToSnesAddress(0x008000, kLoRom), 0x018000);
+  EXPECT_EQ(*ROMToSnesAddress(0x3f0000, kLoRom), 0xfe8000);
+  EXPECT_EQ(*ROMToSnesAddress(0x012345, kHiRom), 0xc12345);
+  EXPECT_EQ(*ROMToSnesAddress(0x412345, kExHiRom), 0x412345);
+  EXPECT_FALSE(ROMToSnesAddress(0x400000, kLoRom).ok());
+  EXPECT_FALSE(ROMToSnesAddress(0x7e1234, kExHiRom).ok());
+
+  // Round trips
+  for (Mapping mapping : {kLoRom, kHiRom, kExHiRom}) {
+    SCOPED_TRACE(mapping);
+    const int rom_size = (mapping == kExHiRom) ? 0x800000 : 0x400000;
+    for (int rom_address = 0; rom_address < rom_size; rom_address += 0x1111) {
+      auto snes_address = ROMToSnesAddress(rom_address, mapping);
+      if (!snes_address.ok()) {
+        continue;
+      }
+      EXPECT_EQ(*SnesToROMAddress(*snes_address, mapping), rom_address);
+    }
+  }
+}
+
+TEST(Rom, vectors) {
+  std::vector<uint8_t> data(0x10000, 0x00);
+  auto set_vector = [&data](int snes_address, int target) {
+    int offset = *SnesToROMAddress(snes_address, kLoRom);
+    data[offset] = target & 0xff;
+    data[offset + 1] = target >> 8;
+  };
+  set_vector(0xffea, 0x8100);  // native NMI
+  set_vector(0xffee, 0x8200);  // native IRQ
+  set_vector(0xffe4, 0x1234);  // native COP, pointing into RAM
+  set_vector(0xfffc, 0x8000);  // emulation RESET
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+
+  const std::vector<InterruptVector>& vectors = rom.Vectors();
+  ASSERT_EQ(vectors.size(), 3);
+
+  EXPECT_EQ(vectors[0].name, "NMI");
+  EXPECT_FALSE(vectors[0].emulation);
+  EXPECT_EQ(vectors[0].target, 0x8100);
+  EXPECT_EQ(vectors[0].flag_state.ToName(), "native");
+
+  EXPECT_EQ(vectors[1].name, "IRQ");
+  EXPECT_FALSE(vectors[1].emulation);
+  EXPECT_EQ(vectors[1].target, 0x8200);
+
+  EXPECT_EQ(vectors[2].name, "RESET");
+  EXPECT_TRUE(vectors[2].emulation);
+  EXPECT_EQ(vectors[2].target, 0x8000);
+  EXPECT_EQ(vectors[2].flag_state.ToName(), "emu");
+}
+
+}  // namespace
+}  // namespace nsasm
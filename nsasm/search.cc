@@ -0,0 +1,599 @@
+#include "nsasm/search.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "absl/types/optional.h"
+#include "nsasm/addressing_mode.h"
+#include "nsasm/instruction.h"
+#include "nsasm/opcode_map.h"
+#include "nsasm/token.h"
+
+namespace nsasm {
+
+namespace {
+
+// A numeric argument in a pattern: a literal, or `*` for any value.
+struct ValuePattern {
+  bool any = true;
+  int value = 0;
+  NumericType type = T_unknown;
+
+  // Returns true if a value of `size` bytes can match this pattern.
+  bool FitsSize(int size) const {
+    if (any) {
+      return true;
+    }
+    if (type == T_unknown) {
+      return value < (1 << (8 * size));
+    }
+    return (type == T_byte && size == 1) || (type == T_word && size == 2) ||
+           (type == T_long && size == 3);
+  }
+
+  // Appends the bytes of this value at `size` bytes wide to `*operand`.
+  void AppendBytes(int size, std::vector<int>* operand) const {
+    for (int i = 0; i < size; ++i) {
+      operand->push_back(any ? -1 : (value >> (8 * i)) & 0xff);
+    }
+  }
+};
+
+// The argument of a pattern instruction.  Unused values are left as `*`.
+struct ArgumentPattern {
+  bool any = true;  // matches every addressing mode
+  SyntacticAddressingMode form = SA_imp;
+  ValuePattern arg1;
+  ValuePattern arg2;
+};
+
+// Returns the syntactic form in which an addressing mode is written.
+SyntacticAddressingMode FormOf(AddressingMode mode) {
+  switch (mode) {
+    case A_imp:
+      return SA_imp;
+    case A_acc:
+      return SA_acc;
+    case A_imm_b:
+    case A_imm_w:
+    case A_imm_fm:
+    case A_imm_fx:
+      return SA_imm;
+    case A_dir_b:
+    case A_dir_w:
+    case A_dir_l:
+    case A_rel8:
+    case A_rel16:
+      return SA_dir;
+    case A_dir_bx:
+    case A_dir_wx:
+    case A_dir_lx:
+      return SA_dir_x;
+    case A_dir_by:
+    case A_dir_wy:
+      return SA_dir_y;
+    case A_ind_b:
+    case A_ind_w:
+      return SA_ind;
+    case A_ind_bx:
+    case A_ind_wx:
+      return SA_ind_x;
+    case A_ind_by:
+      return SA_ind_y;
+    case A_lng_b:
+    case A_lng_w:
+      return SA_lng;
+    case A_lng_by:
+      return SA_lng_y;
+    case A_stk:
+      return SA_stk;
+    case A_stk_y:
+      return SA_stk_y;
+    case A_mov:
+      return SA_mov;
+  }
+  return SA_imp;
+}
+
+ErrorOr<ValuePattern> ParseValue(TokenSpan* pos) {
+  ValuePattern result;
+  if (pos->front() == '*') {
+    pos->remove_prefix(1);
+    return result;
+  }
+  auto literal = pos->front().Literal();
+  if (!literal) {
+    return Error("Expected number or `*`, found %s", pos->front().ToString());
+  }
+  result.any = false;
+  result.value = *literal;
+  result.type = pos->front().Type();
+  pos->remove_prefix(1);
+  return result;
+}
+
+struct Nothing {};
+ErrorOr<Nothing> Expect(TokenSpan* pos, char punctuation) {
+  if (pos->front() != punctuation) {
+    return Error("Expected `%c`, found %s", punctuation,
+                 pos->front().ToString());
+  }
+  pos->remove_prefix(1);
+  return Nothing();
+}
+
+// Parses the argument of a pattern instruction, following the grammar of
+// `ParseInstruction()` in assemble.cc.  Parenthesized expressions are not
+// supported, so `(` always starts an indirect argument.
+ErrorOr<ArgumentPattern> ParseArgument(TokenSpan* pos) {
+  ArgumentPattern result;
+  if (pos->front().IsEndOfLine()) {
+    return result;
+  }
+  if (pos->front() == '*' && (*pos)[1].IsEndOfLine()) {
+    pos->remove_prefix(1);
+    return result;
+  }
+  result.any = false;
+  if (pos->front() == 'A') {
+    pos->remove_prefix(1);
+    result.form = SA_acc;
+    return result;
+  }
+
+  // Parses the value, and an optional register index after a comma.
+  auto value_and_index = [&](ValuePattern* value) -> ErrorOr<char> {
+    auto parsed = ParseValue(pos);
+    NSASM_RETURN_IF_ERROR(parsed);
+    *value = *parsed;
+    if (pos->front() != ',') {
+      return char(0);
+    }
+    pos->remove_prefix(1);
+    auto reg = pos->front().Punctuation();
+    if (!reg || (*reg != 'X' && *reg != 'Y' && *reg != 'S')) {
+      return Error("Expected index register, found %s",
+                   pos->front().ToString());
+    }
+    pos->remove_prefix(1);
+    return char(*reg);
+  };
+
+  if (pos->front() == '#') {
+    pos->remove_prefix(1);
+    auto arg1 = ParseValue(pos);
+    NSASM_RETURN_IF_ERROR(arg1);
+    result.arg1 = *arg1;
+    result.form = SA_imm;
+    if (pos->front() == ',') {
+      pos->remove_prefix(1);
+      NSASM_RETURN_IF_ERROR(Expect(pos, '#'));
+      auto arg2 = ParseValue(pos);
+      NSASM_RETURN_IF_ERROR(arg2);
+      result.arg2 = *arg2;
+      result.form = SA_mov;
+    }
+    return result;
+  }
+  if (pos->front() == '[') {
+    pos->remove_prefix(1);
+    auto arg1 = ParseValue(pos);
+    NSASM_RETURN_IF_ERROR(arg1);
+    result.arg1 = *arg1;
+    NSASM_RETURN_IF_ERROR(Expect(pos, ']'));
+    result.form = SA_lng;
+    if (pos->front() == ',') {
+      pos->remove_prefix(1);
+      NSASM_RETURN_IF_ERROR(Expect(pos, 'Y'));
+      result.form = SA_lng_y;
+    }
+    return result;
+  }
+  if (pos->front() == '(') {
+    pos->remove_prefix(1);
+    auto index = value_and_index(&result.arg1);
+    NSASM_RETURN_IF_ERROR(index);
+    NSASM_RETURN_IF_ERROR(Expect(pos, ')'));
+    if (*index == 'X') {
+      result.form = SA_ind_x;
+      return result;
+    }
+    const bool indexed = pos->front() == ',';
+    if (indexed) {
+      pos->remove_prefix(1);
+      NSASM_RETURN_IF_ERROR(Expect(pos, 'Y'));
+    }
+    if (*index == 'S') {
+      if (!indexed) {
+        return Error("Expected `,Y` after stack relative indirect argument");
+      }
+      result.form = SA_stk_y;
+    } else if (*index == 0) {
+      result.form = indexed ? SA_ind_y : SA_ind;
+    } else {
+      return Error("Y register can't be used with indexed indirect mode");
+    }
+    return result;
+  }
+  auto index = value_and_index(&result.arg1);
+  NSASM_RETURN_IF_ERROR(index);
+  result.form = (*index == 'X')   ? SA_dir_x
+                : (*index == 'Y') ? SA_dir_y
+                : (*index == 'S') ? SA_stk
+                                  : SA_dir;
+  return result;
+}
+
+// Appends the encodings of `mnemonic` and `argument` with the given opcode,
+// if any, to `*alternatives`.
+template <typename Alternative>
+void AddAlternatives(uint8_t opcode, const ArgumentPattern& argument,
+                     std::vector<Alternative>* alternatives) {
+  const Instruction decoded = DecodeOpcode(opcode);
+  const AddressingMode mode = decoded.addressing_mode;
+  if (!argument.any && FormOf(mode) != argument.form) {
+    return;
+  }
+  Alternative alternative;
+  alternative.mnemonic = decoded.mnemonic;
+  if (mode == A_rel8 || mode == A_rel16) {
+    alternative.operand.assign(mode == A_rel8 ? 1 : 2, -1);
+    if (!argument.arg1.any) {
+      alternative.branch_target = argument.arg1.value;
+      alternative.branch_target_size =
+          (argument.arg1.type == T_long || argument.arg1.value > 0xffff) ? 3
+                                                                         : 2;
+    }
+    alternatives->push_back(alternative);
+    return;
+  }
+  if (mode == A_mov) {
+    if (!argument.arg1.FitsSize(1) || !argument.arg2.FitsSize(1)) {
+      return;
+    }
+    argument.arg1.AppendBytes(1, &alternative.operand);
+    argument.arg2.AppendBytes(1, &alternative.operand);
+    alternatives->push_back(alternative);
+    return;
+  }
+  if (mode == A_imm_fm || mode == A_imm_fx) {
+    // One encoding at each width.
+    for (int size = 1; size <= 2; ++size) {
+      if (!argument.arg1.FitsSize(size)) {
+        continue;
+      }
+      Alternative sized = alternative;
+      argument.arg1.AppendBytes(size, &sized.operand);
+      const BitState bit = (size == 1) ? B_on : B_off;
+      if (mode == A_imm_fm) {
+        sized.m_bit = bit;
+      } else {
+        sized.x_bit = bit;
+      }
+      alternatives->push_back(sized);
+    }
+    return;
+  }
+  const int size = InstructionLength(mode) - 1;
+  if (size > 0 && !argument.arg1.FitsSize(size)) {
+    return;
+  }
+  argument.arg1.AppendBytes(size, &alternative.operand);
+  alternatives->push_back(alternative);
+}
+
+// Returns the widths after executing an instruction, given its mnemonic and
+// first operand byte.
+void UpdateWidths(Mnemonic mnemonic, int operand, BitState* m_bit,
+                  BitState* x_bit) {
+  if (mnemonic == M_rep || mnemonic == M_sep) {
+    const BitState set = (mnemonic == M_rep) ? B_off : B_on;
+    if (operand & 0x20) {
+      *m_bit = set;
+    }
+    if (operand & 0x10) {
+      *x_bit = set;
+    }
+  } else if (mnemonic == M_plp || mnemonic == M_rti || mnemonic == M_xce) {
+    *m_bit = B_unknown;
+    *x_bit = B_unknown;
+  }
+}
+
+// Returns `required` if `bit` is compatible with it, assuming a value for
+// `bit` if it is not known, or absl::nullopt if the two conflict.
+absl::optional<BitState> Constrain(BitState bit, BitState required) {
+  if (required == B_unknown || bit == required) {
+    return bit;
+  }
+  if (bit == B_on || bit == B_off) {
+    return absl::nullopt;
+  }
+  return required;
+}
+
+// Returns the state on entry to the instruction at `address` in
+// `disassembly`, or nullopt if no instruction starts there.
+//
+// A folded ADD or SUB pseudo-op counts as the CLC and ADC or SBC it was
+// folded from, so the second half starts one byte after the pseudo-op.
+absl::optional<FlagState> StateAt(const Disassembly& disassembly,
+                                  int address) {
+  auto it = disassembly.find(address);
+  if (it != disassembly.end()) {
+    return it->second.current_flag_state;
+  }
+  it = disassembly.find((address & 0xff0000) | ((address - 1) & 0xffff));
+  if (it == disassembly.end() || (it->second.instruction.mnemonic != PM_add &&
+                                  it->second.instruction.mnemonic != PM_sub)) {
+    return absl::nullopt;
+  }
+  const Instruction clc{M_clc, A_imp, ExpressionOrNull(), ExpressionOrNull()};
+  return it->second.current_flag_state.Execute(clc);
+}
+
+}  // namespace
+
+struct InstructionPattern::MatchContext {
+  const std::vector<uint8_t>* data;
+  int start;       // ROM address of the match
+  int start_snes;  // SNES address of the match
+  int bank_end;    // ROM address of the end of the bank holding `start`
+  const Disassembly* disassembly;  // if searching a disassembly
+  std::vector<SearchMatch>* matches;
+};
+
+ErrorOr<InstructionPattern> InstructionPattern::Compile(
+    absl::string_view pattern) {
+  InstructionPattern result;
+  for (absl::string_view text : absl::StrSplit(pattern, ';')) {
+    auto tokens = Tokenize(text, Location());
+    NSASM_RETURN_IF_ERROR(tokens);
+    TokenSpan pos(*tokens);
+
+    absl::optional<Mnemonic> mnemonic;
+    if (pos.front().IsMnemonic()) {
+      mnemonic = *pos.front().Mnemonic();
+      if (*mnemonic == PM_add || *mnemonic == PM_sub) {
+        return Error("Pseudo-op %s can't be searched for",
+                     ToString(*mnemonic));
+      }
+    } else if (pos.front() != '*') {
+      return Error("Expected mnemonic or `*`, found %s",
+                   pos.front().ToString());
+    }
+    pos.remove_prefix(1);
+    auto argument = ParseArgument(&pos);
+    NSASM_RETURN_IF_ERROR(argument);
+    if (!pos.front().IsEndOfLine()) {
+      return Error("Unexpected %s in pattern", pos.front().ToString());
+    }
+
+    Element element;
+    bool matches_anything = false;
+    for (int opcode = 0; opcode < 256; ++opcode) {
+      if (mnemonic && DecodeOpcode(opcode).mnemonic != *mnemonic) {
+        continue;
+      }
+      AddAlternatives(opcode, *argument, &element[opcode]);
+      matches_anything |= !element[opcode].empty();
+    }
+    if (!matches_anything) {
+      return Error("Pattern `%s` matches no instruction",
+                   absl::StripAsciiWhitespace(text));
+    }
+    result.elements_.push_back(std::move(element));
+  }
+  result.BuildAutomaton();
+  return result;
+}
+
+void InstructionPattern::BuildAutomaton() {
+  // A trie of the fixed prefixes first...
+  transitions_.assign(256, -1);
+  outputs_.assign(1, {});
+  for (int opcode = 0; opcode < 256; ++opcode) {
+    const auto& alternatives = elements_[0][opcode];
+    for (int index = 0; index < int(alternatives.size()); ++index) {
+      std::vector<uint8_t> prefix = {uint8_t(opcode)};
+      for (int byte : alternatives[index].operand) {
+        if (byte < 0) {
+          break;
+        }
+        prefix.push_back(byte);
+      }
+      int state = 0;
+      for (uint8_t byte : prefix) {
+        int& next = transitions_[state * 256 + byte];
+        if (next < 0) {
+          next = outputs_.size();
+          outputs_.emplace_back();
+          transitions_.resize(transitions_.size() + 256, -1);
+        }
+        state = transitions_[state * 256 + byte];
+      }
+      outputs_[state].push_back(
+          {uint8_t(opcode), index, int(prefix.size())});
+    }
+  }
+
+  // ...then the failure links, breadth first, turning the trie into a full
+  // transition table and merging each state's outputs with those of its
+  // failure state.
+  std::vector<int> failure(outputs_.size(), 0);
+  std::deque<int> queue;
+  for (int byte = 0; byte < 256; ++byte) {
+    int& next = transitions_[byte];
+    if (next < 0) {
+      next = 0;
+    } else {
+      queue.push_back(next);
+    }
+  }
+  while (!queue.empty()) {
+    const int state = queue.front();
+    queue.pop_front();
+    const auto& inherited = outputs_[failure[state]];
+    outputs_[state].insert(outputs_[state].end(), inherited.begin(),
+                           inherited.end());
+    for (int byte = 0; byte < 256; ++byte) {
+      int& next = transitions_[state * 256 + byte];
+      const int fallback = transitions_[failure[state] * 256 + byte];
+      if (next < 0) {
+        next = fallback;
+      } else {
+        failure[next] = fallback;
+        queue.push_back(next);
+      }
+    }
+  }
+}
+
+void InstructionPattern::MatchFrom(const MatchContext& context, int element,
+                                   int rom_address, int snes_address,
+                                   BitState m_bit, BitState x_bit,
+                                   BitState start_m_bit,
+                                   BitState start_x_bit) const {
+  if (element == int(elements_.size())) {
+    FlagState flag_state;
+    if (context.disassembly) {
+      flag_state = *StateAt(*context.disassembly, context.start_snes);
+    } else {
+      auto unassumed = [](BitState bit) {
+        return (bit == B_original) ? B_unknown : bit;
+      };
+      flag_state =
+          FlagState(B_off, unassumed(start_m_bit), unassumed(start_x_bit));
+    }
+    context.matches->push_back(
+        {context.start_snes, rom_address - context.start, flag_state});
+    return;
+  }
+  if (rom_address >= context.bank_end) {
+    return;
+  }
+  if (context.disassembly) {
+    auto state = StateAt(*context.disassembly, snes_address);
+    if (!state.has_value()) {
+      return;
+    }
+    m_bit = state->MBit();
+    x_bit = state->XBit();
+  }
+  const uint8_t opcode = (*context.data)[rom_address];
+  for (const Alternative& alternative : elements_[element][opcode]) {
+    MatchAlternative(context, element, alternative, rom_address, snes_address,
+                     m_bit, x_bit, start_m_bit, start_x_bit);
+  }
+}
+
+void InstructionPattern::MatchAlternative(
+    const MatchContext& context, int element, const Alternative& alternative,
+    int rom_address, int snes_address, BitState m_bit, BitState x_bit,
+    BitState start_m_bit, BitState start_x_bit) const {
+  const std::vector<uint8_t>& data = *context.data;
+  const int length = 1 + alternative.operand.size();
+  if (rom_address + length > context.bank_end) {
+    return;
+  }
+  auto new_m_bit = Constrain(m_bit, alternative.m_bit);
+  auto new_x_bit = Constrain(x_bit, alternative.x_bit);
+  if (!new_m_bit || !new_x_bit) {
+    return;
+  }
+  for (int i = 0; i < int(alternative.operand.size()); ++i) {
+    const int byte = alternative.operand[i];
+    if (byte >= 0 && byte != data[rom_address + 1 + i]) {
+      return;
+    }
+  }
+  if (alternative.branch_target >= 0) {
+    int offset = data[rom_address + 1];
+    offset = (length == 2) ? int8_t(offset)
+                           : int16_t(offset | (data[rom_address + 2] << 8));
+    const int target = (snes_address & 0xff0000) |
+                       ((snes_address + length + offset) & 0xffff);
+    const bool ok = (alternative.branch_target_size == 3)
+                        ? target == alternative.branch_target
+                        : (target & 0xffff) == alternative.branch_target;
+    if (!ok) {
+      return;
+    }
+  }
+  // An assumption about a width that has not changed since the start of the
+  // match is an assumption about the start state.
+  const BitState next_start_m_bit =
+      (m_bit == B_original) ? *new_m_bit : start_m_bit;
+  const BitState next_start_x_bit =
+      (x_bit == B_original) ? *new_x_bit : start_x_bit;
+  BitState next_m_bit = *new_m_bit;
+  BitState next_x_bit = *new_x_bit;
+  UpdateWidths(alternative.mnemonic, length > 1 ? data[rom_address + 1] : 0,
+               &next_m_bit, &next_x_bit);
+  MatchFrom(context, element + 1, rom_address + length, snes_address + length,
+            next_m_bit, next_x_bit, next_start_m_bit, next_start_x_bit);
+}
+
+std::vector<SearchMatch> InstructionPattern::Search(const Rom& rom) const {
+  const std::vector<uint8_t>& data = rom.data();
+  const Mapping mapping = rom.mapping_mode();
+  const int bank_size = (mapping == kLoRom) ? 0x8000 : 0x10000;
+  std::vector<SearchMatch> matches;
+  MatchContext context{&data, 0, 0, 0, nullptr, &matches};
+
+  int state = 0;
+  for (int i = 0; i < int(data.size()); ++i) {
+    state = transitions_[state * 256 + data[i]];
+    for (const Output& output : outputs_[state]) {
+      const int start = i + 1 - output.prefix_length;
+      auto snes_address = ROMToSnesAddress(start, mapping);
+      if (!snes_address.ok()) {
+        continue;
+      }
+      context.start = start;
+      context.start_snes = *snes_address;
+      context.bank_end =
+          std::min<int>(start - start % bank_size + bank_size, data.size());
+      // Each encoding of the first instruction is tried only where its
+      // prefix was found, so each match is reported once.
+      MatchAlternative(context, 0, elements_[0][output.opcode][output.index],
+                       start, *snes_address, B_original, B_original,
+                       B_original, B_original);
+    }
+  }
+  return matches;
+}
+
+std::vector<SearchMatch> InstructionPattern::Search(
+    const Rom& rom, const Disassembly& disassembly) const {
+  const std::vector<uint8_t>& data = rom.data();
+  const Mapping mapping = rom.mapping_mode();
+  const int bank_size = (mapping == kLoRom) ? 0x8000 : 0x10000;
+  std::vector<SearchMatch> matches;
+  MatchContext context{&data, 0, 0, 0, &disassembly, &matches};
+  auto search_from = [&](int snes_address) {
+    auto rom_address = SnesToROMAddress(snes_address, mapping);
+    if (!rom_address.ok() || *rom_address >= int(data.size())) {
+      return;
+    }
+    context.start = *rom_address;
+    context.start_snes = snes_address;
+    context.bank_end = std::min<int>(
+        *rom_address - *rom_address % bank_size + bank_size, data.size());
+    MatchFrom(context, 0, *rom_address, snes_address, B_unknown, B_unknown,
+              B_unknown, B_unknown);
+  };
+  for (const auto& node : disassembly) {
+    search_from(node.first);
+    const Mnemonic mnemonic = node.second.instruction.mnemonic;
+    if (mnemonic == PM_add || mnemonic == PM_sub) {
+      // The ADC or SBC after the folded CLC.
+      search_from((node.first & 0xff0000) | ((node.first + 1) & 0xffff));
+    }
+  }
+  return matches;
+}
+
+}  // namespace nsasm
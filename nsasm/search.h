@@ -0,0 +1,105 @@
+#ifndef NSASM_SEARCH_H_
+#define NSASM_SEARCH_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/error.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+// A sequence of instructions found by `InstructionPattern::Search()`.
+struct SearchMatch {
+  int address;  // SNES address of the first instruction
+  int length;   // total length of the matched instructions, in bytes
+  // The state the match was found in.  For raw ROM searches, this records the
+  // `m` and `x` widths that had to be assumed to decode the match, and is
+  // B_unknown for widths that did not matter.
+  FlagState flag_state;
+};
+
+// A compiled pattern over instruction sequences.
+//
+// A pattern is a list of instructions separated by semicolons, each written
+// as in assembly source, except that `*` may stand for the mnemonic, or for
+// any numeric argument.  An instruction with no argument, or with `*` as its
+// whole argument, matches every addressing mode.  For example:
+//
+//   STA $2100            absolute stores to $2100 (but not `STA $002100`)
+//   LDA #*; STA $420b    an immediate load followed by a store to $420b
+//   * ($12),Y            any instruction using ($12),Y addressing
+//   BNE $8123            a branch to $8123 in the current bank
+//
+// As in assembly source, the number of hex digits of an argument selects its
+// width.  A decimal argument matches any width it fits in.
+class InstructionPattern {
+ public:
+  static ErrorOr<InstructionPattern> Compile(absl::string_view pattern);
+
+  // Searches every byte offset of `rom`.  Immediate arguments whose width
+  // depends on the `m` or `x` bits are tried at both widths, unless an earlier
+  // REP or SEP in the match fixes the width.  Matches do not cross banks.
+  std::vector<SearchMatch> Search(const Rom& rom) const;
+
+  // Searches only the instructions in `disassembly`, at the widths they were
+  // disassembled with.  Every instruction of a match must be in
+  // `disassembly`.  ADD and SUB pseudo-ops are searched as the CLC and ADC
+  // or SBC they were folded from, so these match as in a ROM search.
+  std::vector<SearchMatch> Search(const Rom& rom,
+                                  const Disassembly& disassembly) const;
+
+ private:
+  // One encoding a pattern instruction can match: its operand bytes, and the
+  // status bits that encoding requires.
+  struct Alternative {
+    Mnemonic mnemonic;
+    std::vector<int> operand;  // each a byte value, or -1 for any
+    BitState m_bit = B_unknown;
+    BitState x_bit = B_unknown;
+    // For branches, the required target (-1 for any), and its width in bytes.
+    int branch_target = -1;
+    int branch_target_size = 0;
+  };
+  // The encodings of one pattern instruction, indexed by opcode.
+  using Element = std::array<std::vector<Alternative>, 256>;
+
+  // Records matches of the pattern instructions from `element` on, starting
+  // at `rom_address`, given the current widths and those assumed so far for
+  // the start of the match.  B_original marks a width that is unknown but
+  // unchanged since the start.
+  struct MatchContext;
+  void MatchFrom(const MatchContext& context, int element, int rom_address,
+                 int snes_address, BitState m_bit, BitState x_bit,
+                 BitState start_m_bit, BitState start_x_bit) const;
+  // As above, but using only the given encoding of `element`.
+  void MatchAlternative(const MatchContext& context, int element,
+                        const Alternative& alternative, int rom_address,
+                        int snes_address, BitState m_bit, BitState x_bit,
+                        BitState start_m_bit, BitState start_x_bit) const;
+
+  // Builds the automaton recognizing the fixed prefixes of the encodings of
+  // the first pattern instruction.
+  void BuildAutomaton();
+
+  std::vector<Element> elements_;
+  // Automaton transitions, 256 per state; state 0 is the start state.
+  std::vector<int32_t> transitions_;
+  // Per state, the encodings of the first instruction whose fixed prefix
+  // ends there, as (opcode, index in `elements_[0][opcode]`) pairs.  Each
+  // prefix length is stored alongside, so the match start can be found.
+  struct Output {
+    uint8_t opcode;
+    int index;
+    int prefix_length;
+  };
+  std::vector<std::vector<Output>> outputs_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_SEARCH_H_
@@ -0,0 +1,142 @@
+#include "nsasm/search.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+std::vector<int> Addresses(const std::vector<SearchMatch>& matches) {
+  std::vector<int> result;
+  for (const SearchMatch& match : matches) {
+    result.push_back(match.address);
+  }
+  return result;
+}
+
+TEST(InstructionPattern, compile_errors) {
+  EXPECT_FALSE(InstructionPattern::Compile("").ok());
+  EXPECT_FALSE(InstructionPattern::Compile("foo $12").ok());
+  EXPECT_FALSE(InstructionPattern::Compile("LDA $12,").ok());
+  EXPECT_FALSE(InstructionPattern::Compile("LDA $12 $34").ok());
+  EXPECT_FALSE(InstructionPattern::Compile("ADD #$12").ok());
+  // Valid syntax, but no such instruction
+  EXPECT_FALSE(InstructionPattern::Compile("STA #$12").ok());
+  EXPECT_FALSE(InstructionPattern::Compile("LDA $123456,Y").ok());
+
+  NSASM_EXPECT_OK(InstructionPattern::Compile("STA $2100"));
+  NSASM_EXPECT_OK(InstructionPattern::Compile("* ($12),Y; *"));
+  NSASM_EXPECT_OK(InstructionPattern::Compile("MVN #*,#$7e"));
+}
+
+TEST(InstructionPattern, search_rom) {
+  Rom rom = MakeRom({
+      0x8d, 0x00, 0x21,        // $8000: STA $2100
+      0x8f, 0x00, 0x21, 0x00,  // $8003: STA $002100
+      0xa9, 0x01,              // $8007: LDA #$01 (m8)
+      0x8d, 0x0b, 0x42,        // $8009: STA $420b
+      0xa9, 0x01, 0x00,        // $800c: LDA #$0001 (m16)
+      0x8d, 0x0b, 0x42,        // $800f: STA $420b
+      0xc2, 0x20,              // $8012: REP #$20
+      0xa9, 0x8d, 0x0b,        // $8014: LDA #$0b8d
+      0x42,                    // $8017: WDM
+      0xd0, 0xe6,              // $8018: BNE $8000
+  });
+
+  auto sta = InstructionPattern::Compile("STA $2100");
+  NSASM_ASSERT_OK(sta);
+  EXPECT_EQ(Addresses(sta->Search(rom)), std::vector<int>({0x8000}));
+
+  auto sta_long = InstructionPattern::Compile("sta $002100");
+  NSASM_ASSERT_OK(sta_long);
+  EXPECT_EQ(Addresses(sta_long->Search(rom)), std::vector<int>({0x8003}));
+
+  // Both widths of LDA are tried, and the width assumed is reported.
+  auto dma = InstructionPattern::Compile("LDA #*; STA $420b");
+  NSASM_ASSERT_OK(dma);
+  auto matches = dma->Search(rom);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0].address, 0x8007);
+  EXPECT_EQ(matches[0].length, 5);
+  EXPECT_EQ(matches[0].flag_state.MBit(), B_on);
+  EXPECT_EQ(matches[1].address, 0x800c);
+  EXPECT_EQ(matches[1].length, 6);
+  EXPECT_EQ(matches[1].flag_state.MBit(), B_off);
+
+  // After REP #$20, LDA has a 16-bit argument, so `LDA #$8d` does not match
+  // at $8014 even though the bytes would decode that way in m8 mode.
+  auto rep = InstructionPattern::Compile("REP #$20; LDA #$8d");
+  NSASM_ASSERT_OK(rep);
+  EXPECT_TRUE(rep->Search(rom).empty());
+  auto rep16 = InstructionPattern::Compile("REP #*; LDA #$0b8d");
+  NSASM_ASSERT_OK(rep16);
+  matches = rep16->Search(rom);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].flag_state.MBit(), B_unknown);
+
+  auto bne = InstructionPattern::Compile("BNE $8000");
+  NSASM_ASSERT_OK(bne);
+  EXPECT_EQ(Addresses(bne->Search(rom)), std::vector<int>({0x8018}));
+  auto bne_other = InstructionPattern::Compile("BNE $8001");
+  NSASM_ASSERT_OK(bne_other);
+  EXPECT_TRUE(bne_other->Search(rom).empty());
+}
+
+TEST(InstructionPattern, search_disassembly) {
+  Rom rom = MakeRom({
+      0xe2, 0x20,              // $8000: SEP #$20
+      0xa9, 0x8d,              // $8002: LDA #$8d
+      0x8d, 0x0b, 0x42,        // $8004: STA $420b
+      0x8d, 0x0b, 0x42,        // $8007: STA $420b
+      0x60,                    // $800a: RTS
+      0x8d, 0x0b, 0x42,        // $800b: data
+  });
+  auto disassembly = Disassemble(rom, 0x8000, FlagState(B_off, B_off, B_off));
+  NSASM_ASSERT_OK(disassembly);
+
+  auto sta = InstructionPattern::Compile("STA $420b");
+  NSASM_ASSERT_OK(sta);
+  EXPECT_EQ(Addresses(sta->Search(rom)),
+            std::vector<int>({0x8004, 0x8007, 0x800b}));
+  EXPECT_EQ(Addresses(sta->Search(rom, *disassembly)),
+            std::vector<int>({0x8004, 0x8007}));
+
+  auto pair = InstructionPattern::Compile("LDA #*; STA *");
+  NSASM_ASSERT_OK(pair);
+  auto matches = pair->Search(rom, *disassembly);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].address, 0x8002);
+  EXPECT_EQ(matches[0].length, 5);
+  EXPECT_EQ(matches[0].flag_state.MBit(), B_on);
+}
+
+TEST(InstructionPattern, search_folded_pseudo_ops) {
+  Rom rom = MakeRom({
+      0x18,        // $8000: CLC         -- disassembled as ADD #$01
+      0x69, 0x01,  // $8001: ADC #$01
+      0x60,        // $8003: RTS
+  });
+  auto disassembly = Disassemble(rom, 0x8000, FlagState(B_off, B_on, B_on));
+  NSASM_ASSERT_OK(disassembly);
+  ASSERT_EQ(disassembly->at(0x8000).instruction.mnemonic, PM_add);
+
+  for (const char* text : {"CLC; ADC #$01", "ADC #$01; RTS", "CLC"}) {
+    SCOPED_TRACE(text);
+    auto pattern = InstructionPattern::Compile(text);
+    NSASM_ASSERT_OK(pattern);
+    EXPECT_EQ(Addresses(pattern->Search(rom, *disassembly)),
+              Addresses(pattern->Search(rom)));
+  }
+  auto adc = InstructionPattern::Compile("ADC #$01");
+  NSASM_ASSERT_OK(adc);
+  auto matches = adc->Search(rom, *disassembly);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].address, 0x8001);
+  EXPECT_EQ(matches[0].flag_state.MBit(), B_on);
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,145 @@
+#include "nsasm/server.h"
+
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "nsasm/optimize.h"
+
+namespace nsasm {
+
+namespace {
+
+std::string Respond(absl::string_view status, absl::string_view body) {
+  return absl::StrFormat("%s %d\n%s", status, body.size(), body);
+}
+
+std::string Ok(absl::string_view body) { return Respond("ok", body); }
+
+std::string Failed(const Error& error) {
+  return Respond("error", error.ToString() + "\n");
+}
+
+std::string HandleAssemble(const std::string& path, Workspace* workspace) {
+  auto source = workspace->Source(path);
+  if (!source.ok()) {
+    return Failed(source.error());
+  }
+  if (!(*source)->errors.empty()) {
+    std::string messages;
+    for (const Error& error : (*source)->errors) {
+      messages.append(error.ToString()).push_back('\n');
+    }
+    return Respond("error", messages);
+  }
+  return Ok((*source)->listing);
+}
+
+std::string HandleOptimize(const std::string& path, Workspace* workspace) {
+  auto source = workspace->Source(path);
+  if (!source.ok()) {
+    return Failed(source.error());
+  }
+  if (!(*source)->errors.empty()) {
+    return HandleAssemble(path, workspace);
+  }
+  std::vector<std::vector<Statement>> lines = (*source)->lines;
+  std::string body;
+  int removed = 0;
+  for (const Rewrite& rewrite : EliminateRedundantModeSwitches(&lines)) {
+    body.append(rewrite.ToString()).push_back('\n');
+    removed += rewrite.after.empty();
+  }
+  absl::StrAppendFormat(&body, "%d cycles and %d bytes saved\n\n",
+                        3 * removed, 2 * removed);
+  body.append(SourceListing(lines));
+  return Ok(body);
+}
+
+std::string HandleSymbols(const std::string& path, Workspace* workspace) {
+  auto source = workspace->Source(path);
+  if (!source.ok()) {
+    return Failed(source.error());
+  }
+  std::string body;
+  for (const auto& symbol : (*source)->symbols) {
+    absl::StrAppendFormat(&body, "%s %d\n", symbol.first, symbol.second);
+  }
+  return Ok(body);
+}
+
+std::string HandleDisassemble(const std::vector<std::string>& words,
+                              Workspace* workspace) {
+  absl::optional<EntryPoint> entry_point;
+  if (words.size() > 2) {
+    int address;
+    if (!absl::SimpleHexAtoi(words[2], &address)) {
+      return Failed(Error("Bad address '%s'", words[2]));
+    }
+    // Default to native mode, with one-byte A and X/Y.
+    FlagState flag_state(B_off, B_on, B_on);
+    if (words.size() > 3) {
+      auto parsed = FlagState::FromName(words[3]);
+      if (!parsed) {
+        return Failed(Error("%s does not name a processor mode", words[3]));
+      }
+      flag_state = *parsed;
+    }
+    entry_point = EntryPoint{address, flag_state};
+  }
+  auto listing = workspace->DisassemblyListing(words[1], entry_point);
+  if (!listing.ok()) {
+    return Failed(listing.error());
+  }
+  return Ok(**listing);
+}
+
+std::string HandleStats(const Workspace& workspace) {
+  std::string body;
+  auto append = [&body](absl::string_view name,
+                        const Workspace::CacheStats& stats) {
+    absl::StrAppendFormat(&body, "%s: %d hits, %d revalidated, %d loads\n",
+                          name, stats.hits, stats.revalidated, stats.loads);
+  };
+  append("sources", workspace.source_stats());
+  append("roms", workspace.rom_stats());
+  append("listings", workspace.listing_stats());
+  return Ok(body);
+}
+
+}  // namespace
+
+std::string HandleRequest(absl::string_view request, Workspace* workspace,
+                          bool* shutdown) {
+  request = absl::StripAsciiWhitespace(request);
+  std::vector<std::string> words =
+      absl::StrSplit(request, ' ', absl::SkipEmpty());
+  if (words.empty()) {
+    return Failed(Error("Empty request"));
+  }
+  const std::string& command = words[0];
+  if (command == "assemble" && words.size() == 2) {
+    return HandleAssemble(words[1], workspace);
+  }
+  if (command == "optimize" && words.size() == 2) {
+    return HandleOptimize(words[1], workspace);
+  }
+  if (command == "symbols" && words.size() == 2) {
+    return HandleSymbols(words[1], workspace);
+  }
+  if (command == "disassemble" && words.size() >= 2 && words.size() <= 4) {
+    return HandleDisassemble(words, workspace);
+  }
+  if (command == "stats" && words.size() == 1) {
+    return HandleStats(*workspace);
+  }
+  if (command == "shutdown" && words.size() == 1) {
+    *shutdown = true;
+    return Ok("");
+  }
+  return Failed(Error("Bad request '%s'", request));
+}
+
+}  // namespace nsasm
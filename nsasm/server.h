@@ -0,0 +1,37 @@
+#ifndef NSASM_SERVER_H_
+#define NSASM_SERVER_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "nsasm/workspace.h"
+
+namespace nsasm {
+
+// Request handling for nsasmd, the long-lived assembler daemon.
+//
+// Each request is one line of space-separated words:
+//
+//   assemble <source-path>       the assembled statements of a source file
+//   symbols <source-path>        each label defined, with its line number
+//   optimize <source-path>       the assembled statements, with redundant REP
+//                                and SEP instructions removed or narrowed,
+//                                after a report of each change
+//   disassemble <rom-path> [<hex-address> [<mode name>]]
+//                                a disassembly listing, from the given address
+//                                (in native m8x8 mode by default), or from
+//                                every vector in the ROM header
+//   stats                        cache hit counts
+//   shutdown                     stops the daemon
+//
+// Each response is a status line, "ok <n>" or "error <n>", followed by an n
+// byte body: the requested text, or an error message.
+//
+// Results come from `workspace`, so repeated requests for unchanged files are
+// answered from memory.  Sets `*shutdown` if the daemon should stop.
+std::string HandleRequest(absl::string_view request, Workspace* workspace,
+                          bool* shutdown);
+
+}  // namespace nsasm
+
+#endif  // NSASM_SERVER_H_
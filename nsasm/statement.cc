@@ -0,0 +1,30 @@
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+FlagState StatementExitState(FlagState state, const Statement& statement) {
+  if (absl::holds_alternative<Instruction>(statement)) {
+    const Instruction& instruction = absl::get<Instruction>(statement);
+    if (IsExitInstruction(instruction)) {
+      return FlagState(B_unknown, B_unknown, B_unknown);
+    }
+    return state.Execute(instruction);
+  }
+  if (absl::holds_alternative<Directive>(statement)) {
+    const Directive& directive = absl::get<Directive>(statement);
+    if (directive.name == D_mode || directive.name == D_entry) {
+      return directive.flag_state_argument;
+    }
+  }
+  return state;
+}
+
+FlagState StatementsExitState(FlagState state,
+                              const std::vector<Statement>& statements) {
+  for (const Statement& statement : statements) {
+    state = StatementExitState(state, statement);
+  }
+  return state;
+}
+
+}  // namespace nsasm
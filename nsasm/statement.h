@@ -0,0 +1,32 @@
+#ifndef NSASM_STATEMENT_H_
+#define NSASM_STATEMENT_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/types/variant.h"
+#include "nsasm/directive.h"
+#include "nsasm/flag_state.h"
+#include "nsasm/instruction.h"
+
+namespace nsasm {
+
+// One statement of assembly source: an instruction, a directive, or a label.
+using Statement = absl::variant<Instruction, Directive, std::string>;
+
+// Returns the flag state after `statement`, entered in `state`, along
+// straight-line code.
+//
+// Instructions change the state as by FlagState::Execute(), except that the
+// code after a return or jump is entered from elsewhere, in an unknown state.
+// `.mode` and `.entry` directives set the state to their argument.  Labels
+// and other directives leave it unchanged.
+FlagState StatementExitState(FlagState state, const Statement& statement);
+
+// As above, but for a sequence of statements, such as those of a line.
+FlagState StatementsExitState(FlagState state,
+                              const std::vector<Statement>& statements);
+
+}  // namespace nsasm
+
+#endif  // NSASM_STATEMENT_H_
@@ -0,0 +1,204 @@
+#include "nsasm/stats.h"
+
+#include <cstring>
+
+#include "absl/strings/str_format.h"
+
+namespace nsasm {
+
+namespace internal {
+
+std::atomic<int64_t> stat_counters[SC_count] = {};
+AtomicPhaseStats stat_phases[SP_count] = {};
+std::atomic<bool> allocation_tracking_linked(false);
+
+}  // namespace internal
+
+namespace {
+
+// The innermost running timer on this thread.
+thread_local ScopedPhaseTimer* current_timer = nullptr;
+
+}  // namespace
+
+absl::string_view ToString(StatCounter counter) {
+  switch (counter) {
+    case SC_instructions_decoded:
+      return "instructions decoded";
+    case SC_worklist_visits:
+      return "worklist visits";
+    case SC_flag_merges:
+      return "flag merges";
+    case SC_weakening_revisits:
+      return "revisits from weakening";
+    case SC_expression_nodes:
+      return "expression nodes";
+    default:
+      return "<unknown>";
+  }
+}
+
+absl::string_view ToString(StatPhase phase) {
+  switch (phase) {
+    case SP_tokenize:
+      return "tokenize";
+    case SP_parse:
+      return "parse";
+    case SP_deduce_mode:
+      return "deduce mode";
+    case SP_decode:
+      return "decode";
+    case SP_propagate:
+      return "propagate";
+    case SP_listing:
+      return "listing";
+    case SP_none:
+      return "(no phase)";
+    default:
+      return "<unknown>";
+  }
+}
+
+Stats GetStats() {
+  Stats stats;
+  for (int i = 0; i < SC_count; ++i) {
+    stats.counters[i] =
+        internal::stat_counters[i].load(std::memory_order_relaxed);
+  }
+  for (int i = 0; i < SP_count; ++i) {
+    const internal::AtomicPhaseStats& phase = internal::stat_phases[i];
+    stats.phases[i].calls = phase.calls.load(std::memory_order_relaxed);
+    stats.phases[i].total_nanos =
+        phase.total_nanos.load(std::memory_order_relaxed);
+    stats.phases[i].self_nanos =
+        phase.self_nanos.load(std::memory_order_relaxed);
+    stats.phases[i].allocations =
+        phase.allocations.load(std::memory_order_relaxed);
+    stats.phases[i].allocated_bytes =
+        phase.allocated_bytes.load(std::memory_order_relaxed);
+    stats.phases[i].peak_live_bytes =
+        phase.peak_live_bytes.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+void ResetStats() {
+  for (auto& counter : internal::stat_counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  for (auto& phase : internal::stat_phases) {
+    phase.calls.store(0, std::memory_order_relaxed);
+    phase.total_nanos.store(0, std::memory_order_relaxed);
+    phase.self_nanos.store(0, std::memory_order_relaxed);
+    phase.allocations.store(0, std::memory_order_relaxed);
+    phase.allocated_bytes.store(0, std::memory_order_relaxed);
+    phase.peak_live_bytes.store(
+        phase.live_bytes.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+}
+
+bool AllocationTrackingEnabled() {
+  return internal::allocation_tracking_linked.load(std::memory_order_relaxed);
+}
+
+std::string StatsReport(const Stats& stats) {
+  int64_t self_sum = 0;
+  for (const PhaseStats& phase : stats.phases) {
+    self_sum += phase.self_nanos;
+  }
+  const bool allocations = AllocationTrackingEnabled();
+  std::string report = absl::StrFormat("%-24s %12s %12s %12s %7s", "phase",
+                                       "calls", "total ms", "self ms",
+                                       "self %");
+  if (allocations) {
+    absl::StrAppendFormat(&report, " %12s %12s %12s", "allocs", "alloc KB",
+                          "peak KB");
+  }
+  report.push_back('\n');
+  for (int i = 0; i < SP_count; ++i) {
+    const PhaseStats& phase = stats.phases[i];
+    if (phase.calls == 0 && phase.allocations == 0) {
+      continue;
+    }
+    absl::StrAppendFormat(
+        &report, "%-24s %12d %12.3f %12.3f %6.1f%%",
+        ToString(static_cast<StatPhase>(i)), phase.calls,
+        phase.total_nanos / 1e6, phase.self_nanos / 1e6,
+        self_sum ? 100.0 * phase.self_nanos / self_sum : 0.0);
+    if (allocations) {
+      absl::StrAppendFormat(&report, " %12d %12d %12d", phase.allocations,
+                            phase.allocated_bytes / 1024,
+                            phase.peak_live_bytes / 1024);
+    }
+    report.push_back('\n');
+  }
+  absl::StrAppendFormat(&report, "\n%-24s %12s\n", "counter", "count");
+  for (int i = 0; i < SC_count; ++i) {
+    absl::StrAppendFormat(&report, "%-24s %12d\n",
+                          ToString(static_cast<StatCounter>(i)),
+                          stats.counters[i]);
+  }
+  return report;
+}
+
+bool ConsumeStatsFlag(int* argc, char** argv) {
+  bool found = false;
+  int kept = 0;
+  for (int i = 0; i < *argc; ++i) {
+    if (i > 0 && std::strcmp(argv[i], "--stats") == 0) {
+      found = true;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+  return found;
+}
+
+namespace internal {
+
+StatPhase RecordAllocation(int64_t bytes) {
+  const StatPhase phase = current_timer ? current_timer->phase() : SP_none;
+  AtomicPhaseStats& stats = stat_phases[phase];
+  stats.allocations.fetch_add(1, std::memory_order_relaxed);
+  stats.allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  const int64_t live =
+      stats.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = stats.peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !stats.peak_live_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+  return phase;
+}
+
+void RecordDeallocation(StatPhase phase, int64_t bytes) {
+  stat_phases[phase].live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+ScopedPhaseTimer::ScopedPhaseTimer(StatPhase phase)
+    : phase_(phase),
+      parent_(current_timer),
+      start_(std::chrono::steady_clock::now()) {
+  current_timer = this;
+}
+
+ScopedPhaseTimer::~ScopedPhaseTimer() {
+  int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+  current_timer = parent_;
+  if (parent_) {
+    parent_->child_nanos_ += elapsed;
+  }
+  internal::AtomicPhaseStats& stats = internal::stat_phases[phase_];
+  stats.calls.fetch_add(1, std::memory_order_relaxed);
+  stats.total_nanos.fetch_add(elapsed, std::memory_order_relaxed);
+  stats.self_nanos.fetch_add(elapsed - child_nanos_,
+                             std::memory_order_relaxed);
+}
+
+}  // namespace nsasm
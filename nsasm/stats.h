@@ -0,0 +1,171 @@
+#ifndef NSASM_STATS_H_
+#define NSASM_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace nsasm {
+
+// Lightweight instrumentation: monotonic event counters, and scoped timers
+// that break the assembler and disassembler down into phases.
+//
+// Instrumentation points are written with the NSASM_STATS_* macros below,
+// which expand to nothing unless NSASM_ENABLE_STATS is defined.  Build with
+// `--define nsasm_stats=1` to enable them.  The functions and classes here are
+// always available, so that tools can report (or explain the absence of)
+// statistics either way.
+//
+// Counters and timers are process-wide and safe to update from any thread.
+//
+// Heap allocations can also be charged to the innermost running phase on the
+// allocating thread, by linking in the `alloc_tracking` library (which
+// replaces the global operator new and delete).
+
+#ifdef NSASM_ENABLE_STATS
+constexpr bool kStatsEnabled = true;
+#else
+constexpr bool kStatsEnabled = false;
+#endif
+
+enum StatCounter : uint8_t {
+  SC_instructions_decoded,  // calls to Decode()
+  SC_worklist_visits,       // addresses taken from a propagation worklist
+  SC_flag_merges,           // states merged into an address's existing state
+  SC_weakening_revisits,    // revisits because a merge weakened a state
+  SC_expression_nodes,      // Expression nodes constructed
+  SC_count,
+};
+
+enum StatPhase : uint8_t {
+  SP_tokenize,
+  SP_parse,
+  SP_deduce_mode,
+  SP_decode,
+  SP_propagate,
+  SP_listing,
+  SP_none,  // outside any phase; only allocations are charged here
+  SP_count,
+};
+
+absl::string_view ToString(StatCounter counter);
+absl::string_view ToString(StatPhase phase);
+
+struct PhaseStats {
+  int64_t calls = 0;
+  // Total time spent in the phase, including nested phases.
+  int64_t total_nanos = 0;
+  // Time spent in the phase, excluding nested phases on the same thread.
+  int64_t self_nanos = 0;
+
+  // Heap allocations made while this was the innermost phase, if allocation
+  // tracking is linked in.
+  int64_t allocations = 0;
+  int64_t allocated_bytes = 0;
+  // The most bytes allocated in this phase that were live at once.
+  int64_t peak_live_bytes = 0;
+};
+
+struct Stats {
+  int64_t counters[SC_count] = {};
+  PhaseStats phases[SP_count];
+};
+
+namespace internal {
+
+struct AtomicPhaseStats {
+  std::atomic<int64_t> calls;
+  std::atomic<int64_t> total_nanos;
+  std::atomic<int64_t> self_nanos;
+  std::atomic<int64_t> allocations;
+  std::atomic<int64_t> allocated_bytes;
+  std::atomic<int64_t> live_bytes;
+  std::atomic<int64_t> peak_live_bytes;
+};
+
+extern std::atomic<int64_t> stat_counters[SC_count];
+extern AtomicPhaseStats stat_phases[SP_count];
+extern std::atomic<bool> allocation_tracking_linked;
+
+// Charges an allocation of `bytes` to the calling thread's innermost phase,
+// and returns that phase.  Never allocates.
+StatPhase RecordAllocation(int64_t bytes);
+
+// Releases `bytes` allocated in `phase`.  Never allocates.
+void RecordDeallocation(StatPhase phase, int64_t bytes);
+
+}  // namespace internal
+
+inline void IncrementStat(StatCounter counter, int64_t amount = 1) {
+  internal::stat_counters[counter].fetch_add(amount,
+                                             std::memory_order_relaxed);
+}
+
+// Returns a snapshot of every counter and phase timer.
+Stats GetStats();
+
+// Zeroes every counter and phase timer.  Allocation peaks restart from the
+// bytes currently live.
+void ResetStats();
+
+// Returns true if the `alloc_tracking` library is linked in, so that phases
+// have allocation statistics.
+bool AllocationTrackingEnabled();
+
+// Returns a human-readable table of `stats`: the calls and time spent in each
+// phase (and, if tracked, its allocations), followed by the counters.  Phases
+// that were never entered are omitted.
+std::string StatsReport(const Stats& stats);
+
+// Removes every "--stats" argument from `argv`, adjusting `*argc` to match.
+// Returns true if there were any.
+bool ConsumeStatsFlag(int* argc, char** argv);
+
+// Times the enclosing scope as one call of `phase`.
+//
+// Timers nest: time spent in an inner timer on the same thread is subtracted
+// from the self time of the outer one.
+class ScopedPhaseTimer {
+ public:
+  explicit ScopedPhaseTimer(StatPhase phase);
+  ~ScopedPhaseTimer();
+
+  ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+  ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+  StatPhase phase() const { return phase_; }
+
+ private:
+  StatPhase phase_;
+  ScopedPhaseTimer* parent_;
+  std::chrono::steady_clock::time_point start_;
+  int64_t child_nanos_ = 0;
+};
+
+}  // namespace nsasm
+
+#define NSASM_STATS_CONCAT_INNER(a, b) a##b
+#define NSASM_STATS_CONCAT(a, b) NSASM_STATS_CONCAT_INNER(a, b)
+
+#ifdef NSASM_ENABLE_STATS
+// Adds one to the named StatCounter (for example, `SC_flag_merges`).
+#define NSASM_STATS_INCREMENT(counter) \
+  ::nsasm::IncrementStat(::nsasm::counter)
+// Times the rest of the enclosing scope as the named StatPhase (for example,
+// `SP_decode`).
+#define NSASM_STATS_TIMER(phase)                                   \
+  ::nsasm::ScopedPhaseTimer NSASM_STATS_CONCAT(nsasm_stats_timer_, \
+                                               __LINE__)(::nsasm::phase)
+#else
+#define NSASM_STATS_INCREMENT(counter) \
+  do {                                 \
+  } while (false)
+#define NSASM_STATS_TIMER(phase) \
+  do {                           \
+  } while (false)
+#endif
+
+#endif  // NSASM_STATS_H_
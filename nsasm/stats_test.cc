@@ -0,0 +1,128 @@
+#include "nsasm/stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nsasm/assemble.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/rom.h"
+#include "nsasm/token.h"
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+namespace nsasm {
+namespace {
+
+TEST(Stats, counters) {
+  ResetStats();
+  IncrementStat(SC_flag_merges);
+  IncrementStat(SC_flag_merges, 2);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < 1000; ++j) {
+        IncrementStat(SC_worklist_visits);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  Stats stats = GetStats();
+  EXPECT_EQ(stats.counters[SC_flag_merges], 3);
+  EXPECT_EQ(stats.counters[SC_worklist_visits], 4000);
+  EXPECT_EQ(stats.counters[SC_instructions_decoded], 0);
+
+  ResetStats();
+  EXPECT_EQ(GetStats().counters[SC_flag_merges], 0);
+}
+
+TEST(Stats, nested_timers) {
+  ResetStats();
+  {
+    ScopedPhaseTimer outer(SP_propagate);
+    for (int i = 0; i < 3; ++i) {
+      ScopedPhaseTimer inner(SP_decode);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  Stats stats = GetStats();
+  const PhaseStats& outer = stats.phases[SP_propagate];
+  const PhaseStats& inner = stats.phases[SP_decode];
+  EXPECT_EQ(outer.calls, 1);
+  EXPECT_EQ(inner.calls, 3);
+  EXPECT_GE(inner.total_nanos, 3000000);
+  EXPECT_EQ(inner.self_nanos, inner.total_nanos);
+  // The outer timer's self time excludes the time spent in the inner one.
+  EXPECT_GE(outer.total_nanos, inner.total_nanos);
+  EXPECT_EQ(outer.self_nanos, outer.total_nanos - inner.total_nanos);
+}
+
+TEST(Stats, report) {
+  ResetStats();
+  IncrementStat(SC_expression_nodes, 42);
+  { ScopedPhaseTimer timer(SP_tokenize); }
+  std::string report = StatsReport(GetStats());
+  EXPECT_THAT(report, HasSubstr("tokenize"));
+  EXPECT_THAT(report, Not(HasSubstr("propagate")));
+  EXPECT_THAT(report, HasSubstr("expression nodes"));
+  EXPECT_THAT(report, HasSubstr("42\n"));
+}
+
+TEST(Stats, consume_flag) {
+  std::string program = "prog", stats = "--stats", path = "rom.sfc";
+  std::vector<char*> argv = {&program[0], &stats[0], &path[0], &stats[0],
+                             nullptr};
+  int argc = 4;
+  EXPECT_TRUE(ConsumeStatsFlag(&argc, argv.data()));
+  EXPECT_EQ(argc, 2);
+  EXPECT_EQ(argv[0], &program[0]);
+  EXPECT_EQ(argv[1], &path[0]);
+  EXPECT_EQ(argv[2], nullptr);
+
+  EXPECT_FALSE(ConsumeStatsFlag(&argc, argv.data()));
+  EXPECT_EQ(argc, 2);
+}
+
+#ifdef NSASM_ENABLE_STATS
+TEST(Stats, instrumentation) {
+  ResetStats();
+  auto tokens = Tokenize("LDA #$12 + 1", Location());
+  NSASM_ASSERT_OK(tokens);
+  NSASM_ASSERT_OK(Assemble(*tokens));
+  Stats stats = GetStats();
+  EXPECT_EQ(stats.phases[SP_tokenize].calls, 1);
+  EXPECT_EQ(stats.phases[SP_parse].calls, 1);
+  EXPECT_EQ(stats.phases[SP_deduce_mode].calls, 1);
+  EXPECT_GE(stats.counters[SC_expression_nodes], 3);
+
+  // A loop entered with 8-bit A, whose body widens A.  The loop head and the
+  // REP are each revisited once, when their states are weakened.
+  std::vector<uint8_t> data(0x10000, 0x00);
+  const std::vector<uint8_t> code = {
+      0xea,        // $808000: NOP
+      0xc2, 0x20,  // $808001: REP #$20
+      0x80, 0xfb,  // $808003: BRA $808000
+  };
+  std::copy(code.begin(), code.end(), data.begin());
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+  ResetStats();
+  NSASM_ASSERT_OK(Disassemble(rom, 0x808000, FlagState(B_off, B_on, B_on)));
+  stats = GetStats();
+  EXPECT_EQ(stats.phases[SP_propagate].calls, 1);
+  EXPECT_EQ(stats.counters[SC_instructions_decoded], 3);
+  EXPECT_EQ(stats.counters[SC_weakening_revisits], 2);
+  EXPECT_GE(stats.counters[SC_flag_merges], 1);
+  EXPECT_GE(stats.counters[SC_worklist_visits], 5);
+}
+#endif  // NSASM_ENABLE_STATS
+
+}  // namespace
+}  // namespace nsasm
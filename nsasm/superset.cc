@@ -0,0 +1,245 @@
+#include "nsasm/superset.h"
+
+#include <algorithm>
+#include <array>
+
+#include "nsasm/addressing_mode.h"
+#include "nsasm/opcode_map.h"
+#include "nsasm/parallel.h"
+#include "nsasm/trace.h"
+
+namespace nsasm {
+
+namespace {
+
+constexpr uint8_t kAllWidths = (1 << SupersetDisassembly::kWidthCount) - 1;
+
+struct OpcodeInfo {
+  Mnemonic mnemonic;
+  AddressingMode addressing_mode;
+};
+
+// Mnemonic and addressing mode of each opcode, so that candidates can be
+// examined without building Instruction objects.
+const std::array<OpcodeInfo, 256>& OpcodeTable() {
+  static const std::array<OpcodeInfo, 256> table = [] {
+    std::array<OpcodeInfo, 256> result;
+    for (int opcode = 0; opcode < 256; ++opcode) {
+      Instruction instruction = DecodeOpcode(opcode);
+      result[opcode] = {instruction.mnemonic, instruction.addressing_mode};
+    }
+    return result;
+  }();
+  return table;
+}
+
+// Returns true for opcodes that are never considered code.  BRK and COP are
+// valid instructions, but are far more often zero bytes and data.
+bool IsInvalidOpcode(Mnemonic m) {
+  return m == M_brk || m == M_cop || m == M_stp || m == M_wdm;
+}
+
+// Returns true if control never continues to the next instruction.
+bool IsExit(Mnemonic m) {
+  return m == M_jmp || m == M_rts || m == M_rtl || m == M_rti ||
+         m == M_bra || m == M_brl;
+}
+
+int CandidateLength(const OpcodeInfo& info, int width) {
+  if (info.addressing_mode == A_imm_fm) {
+    return (width & 1) ? 3 : 2;
+  }
+  if (info.addressing_mode == A_imm_fx) {
+    return (width & 2) ? 3 : 2;
+  }
+  return InstructionLength(info.addressing_mode);
+}
+
+}  // namespace
+
+FlagState SupersetDisassembly::WidthFlagState(int width) {
+  return FlagState(B_off, (width & 1) ? B_off : B_on,
+                   (width & 2) ? B_off : B_on);
+}
+
+SupersetDisassembly::SupersetDisassembly(const Rom& rom)
+    : rom_(&rom), bank_size_(rom.mapping_mode() == kLoRom ? 0x8000 : 0x10000) {
+  const int bank_count = (rom.data().size() + bank_size_ - 1) / bank_size_;
+  for (int bank = 0; bank < bank_count; ++bank) {
+    banks_.emplace_back(new std::atomic<uint8_t>[bank_size_]());
+  }
+}
+
+SupersetDisassembly SupersetDisassembly::Build(const Rom& rom,
+                                               int num_threads) {
+  SupersetDisassembly superset(rom);
+  const int bank_count = superset.banks_.size();
+  ParallelFor(num_threads, bank_count,
+              [&superset](int bank) { superset.DecodeBank(bank); });
+
+  // Pruning only ever clears bits, so repeating sweeps until nothing changes
+  // reaches the same result however the sweeps interleave.
+  std::atomic<bool> changed(true);
+  while (changed) {
+    changed = false;
+    ParallelFor(num_threads, bank_count, [&superset, &changed](int bank) {
+      if (superset.PruneBank(bank)) {
+        changed = true;
+      }
+    });
+  }
+  return superset;
+}
+
+void SupersetDisassembly::DecodeBank(int bank) {
+  TraceSpan span("superset_decode_bank", "bank", bank);
+  const std::vector<uint8_t>& data = rom_->data();
+  const auto& table = OpcodeTable();
+  const int bank_start = bank * bank_size_;
+  const int bank_end =
+      std::min<int>(bank_start + bank_size_, data.size());
+  std::atomic<uint8_t>* slots = banks_[bank].get();
+
+  for (int rom_address = bank_start; rom_address < bank_end; ++rom_address) {
+    if (!ROMToSnesAddress(rom_address, rom_->mapping_mode()).ok()) {
+      continue;
+    }
+    const OpcodeInfo& info = table[data[rom_address]];
+    if (IsInvalidOpcode(info.mnemonic)) {
+      continue;
+    }
+    uint8_t mask = 0;
+    for (int width = 0; width < kWidthCount; ++width) {
+      // Instructions may not run past the end of their bank.
+      if (rom_address + CandidateLength(info, width) <= bank_end) {
+        mask |= 1 << width;
+      }
+    }
+    slots[rom_address - bank_start].store(mask, std::memory_order_relaxed);
+  }
+}
+
+bool SupersetDisassembly::PruneBank(int bank) {
+  TraceSpan span("superset_prune_bank", "bank", bank);
+  const std::vector<uint8_t>& data = rom_->data();
+  const auto& table = OpcodeTable();
+  const Mapping mapping = rom_->mapping_mode();
+  const int bank_start = bank * bank_size_;
+  const int bank_end =
+      std::min<int>(bank_start + bank_size_, data.size());
+  std::atomic<uint8_t>* slots = banks_[bank].get();
+  bool changed = false;
+
+  // Candidates mostly depend on later candidates, so sweep backwards.
+  for (int rom_address = bank_end - 1; rom_address >= bank_start;
+       --rom_address) {
+    std::atomic<uint8_t>& slot = slots[rom_address - bank_start];
+    const uint8_t mask = slot.load(std::memory_order_relaxed);
+    if (mask == 0) {
+      continue;
+    }
+    const int snes_address = *ROMToSnesAddress(rom_address, mapping);
+    // ROM address of the start of this SNES bank.  (In LoRom, this is
+    // outside the ROM bank, since only the upper half of the SNES bank is
+    // ROM.)
+    const int bank_origin = rom_address - (snes_address & 0xffff);
+    // Returns the ROM address of `target` in this SNES bank, or -1 if it is
+    // not in this ROM bank.
+    auto in_bank = [&](int target) {
+      int target_rom_address = bank_origin + (target & 0xffff);
+      if (target_rom_address < bank_start || target_rom_address >= bank_end) {
+        return -1;
+      }
+      return target_rom_address;
+    };
+    // Returns true if the candidate at `target_rom_address` is valid at any of
+    // the widths in `widths`.
+    auto valid = [this](int target_rom_address, uint8_t widths) {
+      return (Slot(target_rom_address).load(std::memory_order_relaxed) &
+              widths) != 0;
+    };
+
+    const OpcodeInfo& info = table[data[rom_address]];
+    const Mnemonic m = info.mnemonic;
+    uint8_t new_mask = mask;
+    for (int width = 0; width < kWidthCount; ++width) {
+      if (!(mask & (1 << width))) {
+        continue;
+      }
+      const int length = CandidateLength(info, width);
+      const uint8_t* operand = data.data() + rom_address + 1;
+      bool ok = true;
+
+      if (!IsExit(m)) {
+        uint8_t next_widths = 1 << width;
+        if (m == M_rep || m == M_sep) {
+          int bits = ((operand[0] & 0x20) ? 1 : 0) |
+                     ((operand[0] & 0x10) ? 2 : 0);
+          next_widths = 1 << ((m == M_rep) ? (width | bits) : (width & ~bits));
+        } else if (m == M_plp || m == M_xce) {
+          next_widths = kAllWidths;
+        }
+        int next = in_bank(snes_address + length);
+        ok = next >= 0 && valid(next, next_widths);
+      }
+
+      const bool is_branch =
+          info.addressing_mode == A_rel8 ||
+          (info.addressing_mode == A_rel16 && m == M_brl);
+      if (ok && is_branch) {
+        int offset = (info.addressing_mode == A_rel8)
+                         ? int8_t(operand[0])
+                         : int16_t(operand[0] | (operand[1] << 8));
+        int target = in_bank(snes_address + length + offset);
+        ok = target >= 0 && valid(target, 1 << width);
+      }
+
+      if (ok && (m == M_jmp || m == M_jsr) &&
+          info.addressing_mode == A_dir_w) {
+        // Jumps out of ROM are allowed; the target may be code in RAM.
+        int target = in_bank(operand[0] | (operand[1] << 8));
+        ok = target < 0 || valid(target, 1 << width);
+      }
+      if (ok && (m == M_jmp || m == M_jsl) &&
+          info.addressing_mode == A_dir_l) {
+        int target = operand[0] | (operand[1] << 8) | (operand[2] << 16);
+        auto target_rom_address = SnesToROMAddress(target, mapping);
+        ok = !target_rom_address.ok() ||
+             *target_rom_address >= int(data.size()) ||
+             valid(*target_rom_address, 1 << width);
+      }
+
+      if (!ok) {
+        new_mask &= ~(1 << width);
+      }
+    }
+    if (new_mask != mask) {
+      slot.store(new_mask, std::memory_order_relaxed);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+int SupersetDisassembly::ValidWidths(int address) const {
+  auto rom_address = SnesToROMAddress(address, rom_->mapping_mode());
+  if (!rom_address.ok() || *rom_address >= int(rom_->data().size())) {
+    return 0;
+  }
+  return Slot(*rom_address).load(std::memory_order_relaxed);
+}
+
+int64_t SupersetDisassembly::CandidateCount() const {
+  int64_t count = 0;
+  for (const auto& bank : banks_) {
+    for (int i = 0; i < bank_size_; ++i) {
+      uint8_t mask = bank[i].load(std::memory_order_relaxed);
+      for (; mask; mask &= mask - 1) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
+
+}  // namespace nsasm
@@ -0,0 +1,78 @@
+#ifndef NSASM_SUPERSET_H_
+#define NSASM_SUPERSET_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "nsasm/flag_state.h"
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+// Superset disassembly of a whole ROM.
+//
+// Recursive disassembly only finds code reachable from known entry points, and
+// misses code reached through jump tables and computed jumps.  A superset
+// disassembly instead considers a candidate instruction at every byte of the
+// ROM, for each combination of `m` and `x` widths.  Candidates that are not
+// valid instructions (BRK, COP, STP, WDM, or instructions running off the end
+// of a bank), and candidates from which control must eventually reach one,
+// are pruned.  What remains is a superset of the real code.
+//
+// Successors of a candidate are its fallthrough and branch targets, and the
+// targets of JMP, JML, JSR and JSL to fixed ROM addresses.  REP and SEP change
+// the width used for the next instruction; PLP and XCE make it unknown, in
+// which case the successor is only invalid if it is invalid at every width.
+class SupersetDisassembly {
+ public:
+  // Candidate widths are numbered 0-3: bit 0 is set for 16-bit `m`, bit 1 for
+  // 16-bit `x`.
+  static constexpr int kWidthCount = 4;
+  static FlagState WidthFlagState(int width);
+
+  SupersetDisassembly(SupersetDisassembly&&) = default;
+  SupersetDisassembly& operator=(SupersetDisassembly&&) = default;
+
+  // Runs superset disassembly over all of `rom`.  Banks are decoded in
+  // parallel on `num_threads` threads (or a default number, if zero.)
+  static SupersetDisassembly Build(const Rom& rom, int num_threads = 0);
+
+  // Returns a bitmask of the widths at which a candidate instruction starting
+  // at SNES address `address` survived pruning.  Returns 0 for addresses not
+  // in ROM.
+  int ValidWidths(int address) const;
+
+  bool IsCandidate(int address) const { return ValidWidths(address) != 0; }
+
+  // As `ValidWidths()`, but takes an address in the ROM image, which must be
+  // in range.  Cheap enough to call for every byte of a ROM.
+  int ValidWidthsAtRomAddress(int rom_address) const {
+    return Slot(rom_address).load(std::memory_order_relaxed);
+  }
+
+  // Returns the number of (address, width) candidates that survived pruning.
+  int64_t CandidateCount() const;
+
+ private:
+  SupersetDisassembly(const Rom& rom);
+
+  // Returns the bank array and index holding `rom_address`.
+  std::atomic<uint8_t>& Slot(int rom_address) const {
+    return banks_[rom_address / bank_size_][rom_address % bank_size_];
+  }
+
+  void DecodeBank(int bank);
+  bool PruneBank(int bank);
+
+  const Rom* rom_;
+  int bank_size_;
+  // One flat array per ROM bank.  Each byte holds a mask of valid widths for
+  // the candidate starting at the corresponding ROM address.
+  std::vector<std::unique_ptr<std::atomic<uint8_t>[]>> banks_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_SUPERSET_H_
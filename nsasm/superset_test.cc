@@ -0,0 +1,87 @@
+#include "nsasm/superset.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/test_util.h"
+
+namespace nsasm {
+namespace {
+
+constexpr int m8x8 = 0;
+constexpr int m16x8 = 1;
+
+TEST(Superset, prunes_paths_into_invalid_code) {
+  Rom rom = MakeRom({
+      0xa9, 0x60, 0x60,  // 8000: LDA #$6060 (m16), or LDA #$60; RTS (m8)
+      0x60,              // 8003: RTS
+      0xea,              // 8004: NOP  -- falls into BRK
+  });
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom, 2);
+
+  EXPECT_EQ(superset.ValidWidths(0x8000), 0xf);
+  EXPECT_EQ(superset.ValidWidths(0x8001), 0xf);  // RTS
+  EXPECT_EQ(superset.ValidWidths(0x8003), 0xf);
+  EXPECT_EQ(superset.ValidWidths(0x8004), 0);
+  EXPECT_EQ(superset.ValidWidths(0x8005), 0);  // BRK
+  EXPECT_EQ(superset.ValidWidths(0x7fff), 0);  // not ROM
+}
+
+TEST(Superset, widths_follow_rep_and_sep) {
+  Rom rom = MakeRom({
+      0xc2, 0x20,        // 8000: REP #$20
+      0xa9, 0x34, 0x00,  // 8002: LDA #$0034 -- m8 decoding hits BRK
+      0xe2, 0x20,        // 8005: SEP #$20
+      0x60,              // 8007: RTS
+  });
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom);
+  // REP survives at every width, since it always continues at m16.
+  EXPECT_EQ(superset.ValidWidths(0x8000), 0xf);
+  EXPECT_EQ(superset.ValidWidths(0x8002) & (1 << m16x8), 1 << m16x8);
+  EXPECT_EQ(superset.ValidWidths(0x8002) & (1 << m8x8), 0);
+}
+
+TEST(Superset, branches_and_calls) {
+  Rom rom = MakeRom({
+      0xd0, 0x03,        // 8000: BNE $8005   -- target is BRK
+      0x60,              // 8002: RTS
+      0x80, 0xfd,        // 8003: BRA $8002
+      0x00,              // 8005: BRK
+      0x20, 0x05, 0x80,  // 8006: JSR $8005   -- calls BRK
+      0x20, 0x00, 0x12,  // 8009: JSR $1200   -- RAM, allowed
+      0x60,              // 800c: RTS
+  });
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom);
+  EXPECT_EQ(superset.ValidWidths(0x8000), 0);
+  EXPECT_EQ(superset.ValidWidths(0x8003), 0xf);
+  EXPECT_EQ(superset.ValidWidths(0x8006), 0);
+  EXPECT_EQ(superset.ValidWidths(0x8009), 0xf);
+}
+
+TEST(Superset, covers_recursive_disassembly) {
+  std::vector<uint8_t> code = {
+      0xc2, 0x30,        // 8000: REP #$30
+      0xa2, 0x10, 0x00,  // 8002: LDX #$0010
+      0xbd, 0x00, 0x90,  // 8005: LDA $9000,X
+      0xca,              // 8008: DEX
+      0x10, 0xfa,        // 8009: BPL $8005
+      0xe2, 0x30,        // 800b: SEP #$30
+      0x6b,              // 800d: RTL
+  };
+  Rom rom = MakeRom(code, 0x40000);
+  auto disassembly = Disassemble(rom, 0x8000, FlagState(B_off, B_on, B_on));
+  NSASM_ASSERT_OK(disassembly);
+  SupersetDisassembly superset = SupersetDisassembly::Build(rom, 4);
+  for (const auto& node : *disassembly) {
+    SCOPED_TRACE(node.first);
+    EXPECT_TRUE(superset.IsCandidate(node.first));
+  }
+  EXPECT_GT(superset.CandidateCount(), 0);
+  // Other banks contain nothing but BRK.
+  EXPECT_FALSE(superset.IsCandidate(0x018000));
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,28 @@
+#include "nsasm/test_util.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+
+namespace nsasm {
+
+Rom MakeRom(const std::vector<uint8_t>& code, int size) {
+  std::vector<uint8_t> data(size, 0x00);
+  std::copy(code.begin(), code.end(), data.begin());
+  return Rom(kLoRom, "test.sfc", std::move(data));
+}
+
+std::string RenderDisassembly(const Disassembly& disassembly) {
+  std::string result;
+  for (const auto& node : disassembly) {
+    absl::StrAppendFormat(&result, "%06x %d %s ;%s -> %s\n", node.first,
+                          node.second.label_id,
+                          node.second.instruction.ToString(),
+                          node.second.current_flag_state.ToString(),
+                          node.second.next_flag_state.ToString());
+  }
+  return result;
+}
+
+}  // namespace nsasm
@@ -0,0 +1,24 @@
+#ifndef NSASM_TEST_UTIL_H_
+#define NSASM_TEST_UTIL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nsasm/disassemble.h"
+#include "nsasm/rom.h"
+
+// Fixtures shared by the tests of the disassembler and its analyses.
+
+namespace nsasm {
+
+// Returns a LoRom image of `size` bytes with `code` placed at SNES address
+// $008000, and the rest of the ROM filled with BRK.
+Rom MakeRom(const std::vector<uint8_t>& code, int size = 0x10000);
+
+// Renders a disassembly as text, one instruction per line, for comparisons.
+std::string RenderDisassembly(const Disassembly& disassembly);
+
+}  // namespace nsasm
+
+#endif  // NSASM_TEST_UTIL_H_
@@ -4,6 +4,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "nsasm/mnemonic.h"
+#include "nsasm/stats.h"
 
 namespace nsasm {
 
@@ -60,6 +61,7 @@ std::string Token::ToString() const {
 }
 
 ErrorOr<std::vector<Token>> Tokenize(absl::string_view sv, Location loc) {
+  NSASM_STATS_TIMER(SP_tokenize);
   std::vector<Token> result;
   while (true) {
     sv = absl::StripLeadingAsciiWhitespace(sv);
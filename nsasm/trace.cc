@@ -0,0 +1,183 @@
+#include "nsasm/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/strip.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+namespace nsasm {
+
+namespace internal {
+
+std::atomic<bool> tracing_enabled(false);
+
+}  // namespace internal
+
+namespace {
+
+int64_t ClockNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct TraceEvent {
+  const char* name;
+  const char* arg_name;
+  int64_t arg_value;
+  int64_t start_nanos;
+  int64_t duration_nanos;
+};
+
+// Ring buffer of the events recorded by one thread.  Only the owning thread
+// writes to it.
+struct ThreadBuffer {
+  ThreadBuffer(int tid, int capacity)
+      : tid(tid), capacity(capacity), events(new TraceEvent[capacity]) {}
+
+  const int tid;
+  const int capacity;
+  std::unique_ptr<TraceEvent[]> events;
+  // Total number of events ever recorded; the most recent `capacity` are kept.
+  std::atomic<int64_t> recorded{0};
+};
+
+// Buffers for every thread that has recorded an event in the current trace.
+struct TraceRegistry {
+  absl::Mutex mu;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers ABSL_GUARDED_BY(mu);
+  int events_per_thread ABSL_GUARDED_BY(mu) = 0;
+  // Clock reading, in nanoseconds, when the trace started.
+  std::atomic<int64_t> start_nanos{0};
+  // Incremented by each StartTracing(), so that threads notice their buffers
+  // are gone.
+  std::atomic<int> generation{0};
+};
+
+TraceRegistry& Registry() {
+  static TraceRegistry* registry = new TraceRegistry;
+  return *registry;
+}
+
+struct ThreadState {
+  ThreadBuffer* buffer = nullptr;
+  int generation = -1;
+};
+thread_local ThreadState thread_state;
+
+// Returns this thread's buffer for the current trace, creating it if needed.
+ThreadBuffer* CurrentBuffer() {
+  TraceRegistry& registry = Registry();
+  const int generation = registry.generation.load(std::memory_order_acquire);
+  if (thread_state.generation != generation) {
+    absl::MutexLock lock(&registry.mu);
+    registry.buffers.push_back(absl::make_unique<ThreadBuffer>(
+        registry.buffers.size() + 1, registry.events_per_thread));
+    thread_state.buffer = registry.buffers.back().get();
+    thread_state.generation = generation;
+  }
+  return thread_state.buffer;
+}
+
+}  // namespace
+
+namespace internal {
+
+int64_t TraceNow() {
+  return ClockNanos() -
+         Registry().start_nanos.load(std::memory_order_relaxed);
+}
+
+void RecordSpan(const char* name, const char* arg_name, int64_t arg_value,
+                int64_t start_nanos) {
+  const int64_t end_nanos = TraceNow();
+  ThreadBuffer* buffer = CurrentBuffer();
+  const int64_t index = buffer->recorded.load(std::memory_order_relaxed);
+  buffer->events[index % buffer->capacity] = {
+      name, arg_name, arg_value, start_nanos, end_nanos - start_nanos};
+  buffer->recorded.store(index + 1, std::memory_order_release);
+}
+
+}  // namespace internal
+
+void StartTracing(int events_per_thread) {
+  TraceRegistry& registry = Registry();
+  {
+    absl::MutexLock lock(&registry.mu);
+    registry.buffers.clear();
+    registry.events_per_thread = std::max(events_per_thread, 1);
+    registry.start_nanos.store(ClockNanos(), std::memory_order_relaxed);
+    registry.generation.fetch_add(1, std::memory_order_release);
+  }
+  internal::tracing_enabled.store(true, std::memory_order_release);
+}
+
+void StopTracing() {
+  internal::tracing_enabled.store(false, std::memory_order_release);
+}
+
+std::string TraceJson() {
+  TraceRegistry& registry = Registry();
+  absl::MutexLock lock(&registry.mu);
+  std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto& buffer : registry.buffers) {
+    const int64_t recorded = buffer->recorded.load(std::memory_order_acquire);
+    const int64_t begin = std::max<int64_t>(0, recorded - buffer->capacity);
+    for (int64_t i = begin; i < recorded; ++i) {
+      const TraceEvent& event = buffer->events[i % buffer->capacity];
+      absl::StrAppendFormat(&json,
+                            "%s\n{\"name\":\"%s\",\"cat\":\"nsasm\","
+                            "\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                            "\"ts\":%.3f,\"dur\":%.3f",
+                            first ? "" : ",", event.name, buffer->tid,
+                            event.start_nanos / 1e3,
+                            event.duration_nanos / 1e3);
+      if (event.arg_name) {
+        absl::StrAppendFormat(&json, ",\"args\":{\"%s\":%d}", event.arg_name,
+                              event.arg_value);
+      }
+      json.push_back('}');
+      first = false;
+    }
+  }
+  json.append("\n]}\n");
+  return json;
+}
+
+ErrorOr<int64_t> WriteTraceFile(const std::string& path) {
+  std::string json = TraceJson();
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    return Error("Failed to open file for writing").SetLocation(path);
+  }
+  size_t written = std::fwrite(json.data(), 1, json.size(), file);
+  if (std::fclose(file) != 0 || written != json.size()) {
+    return Error("Failed to write trace").SetLocation(path);
+  }
+  return static_cast<int64_t>(written);
+}
+
+absl::optional<std::string> ConsumeTraceFlag(int* argc, char** argv) {
+  absl::optional<std::string> path;
+  int kept = 0;
+  for (int i = 0; i < *argc; ++i) {
+    absl::string_view arg = argv[i];
+    if (i > 0 && absl::ConsumePrefix(&arg, "--trace=")) {
+      path = std::string(arg);
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+  return path;
+}
+
+}  // namespace nsasm
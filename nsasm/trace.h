@@ -0,0 +1,92 @@
+#ifndef NSASM_TRACE_H_
+#define NSASM_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "absl/types/optional.h"
+#include "nsasm/error.h"
+
+namespace nsasm {
+
+// Optional timeline recording, written in the Chrome trace-event JSON format
+// (viewable in chrome://tracing or Perfetto).
+//
+// While tracing is on, each TraceSpan records one complete event when it goes
+// out of scope.  Events go into a ring buffer owned by the recording thread,
+// so recording takes no locks; once a thread's buffer is full, its oldest
+// events are overwritten.  While tracing is off, a TraceSpan costs one relaxed
+// atomic load.
+//
+// `StartTracing()`, `StopTracing()` and `TraceJson()` must not be called while
+// traced work is running on other threads.
+
+// Discards any previous trace, and starts recording.  Each thread keeps at
+// most `events_per_thread` of its most recent events.
+void StartTracing(int events_per_thread = 1 << 15);
+
+// Stops recording.  Events recorded so far are kept until the next
+// `StartTracing()`.
+void StopTracing();
+
+// Returns the recorded events as a JSON trace.
+std::string TraceJson();
+
+// Writes the recorded events to `path` as a JSON trace.  Returns the number of
+// bytes written.
+ErrorOr<int64_t> WriteTraceFile(const std::string& path);
+
+// Removes every "--trace=<path>" argument from `argv`, adjusting `*argc` to
+// match.  Returns the path given by the last one, if any.
+absl::optional<std::string> ConsumeTraceFlag(int* argc, char** argv);
+
+namespace internal {
+
+extern std::atomic<bool> tracing_enabled;
+
+// Returns nanoseconds since tracing started.
+int64_t TraceNow();
+
+void RecordSpan(const char* name, const char* arg_name, int64_t arg_value,
+                int64_t start_nanos);
+
+}  // namespace internal
+
+inline bool TracingEnabled() {
+  return internal::tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Records the enclosing scope as a span in the trace, if tracing is on.
+//
+// `name` and `arg_name` must be string literals (or otherwise outlive the
+// trace); they are stored by pointer.  If `arg_name` is given, the span is
+// annotated with `arg_value`.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name, const char* arg_name = nullptr,
+                     int64_t arg_value = 0)
+      : name_(TracingEnabled() ? name : nullptr),
+        arg_name_(arg_name),
+        arg_value_(arg_value),
+        start_nanos_(name_ ? internal::TraceNow() : 0) {}
+
+  ~TraceSpan() {
+    if (name_) {
+      internal::RecordSpan(name_, arg_name_, arg_value_, start_nanos_);
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  const char* arg_name_;
+  int64_t arg_value_;
+  int64_t start_nanos_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_TRACE_H_
@@ -0,0 +1,78 @@
+#include "nsasm/trace.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nsasm/parallel.h"
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+namespace nsasm {
+namespace {
+
+// Returns the number of times `needle` occurs in `haystack`.
+int CountOf(const std::string& haystack, const std::string& needle) {
+  int count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+TEST(Trace, spans) {
+  { TraceSpan span("before_start"); }
+  StartTracing();
+  {
+    TraceSpan outer("outer", "address", 0x808000);
+    ParallelFor(4, 16, [](int i) { TraceSpan span("task", "index", i); });
+  }
+  StopTracing();
+  { TraceSpan span("after_stop"); }
+
+  std::string json = TraceJson();
+  EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0),
+            0);
+  EXPECT_THAT(json, HasSubstr("\"name\":\"outer\""));
+  EXPECT_THAT(json, HasSubstr("\"args\":{\"address\":8421376}"));
+  EXPECT_EQ(CountOf(json, "\"name\":\"task\""), 16);
+  EXPECT_EQ(CountOf(json, "\"name\":\"parallel_for_worker\""), 4);
+  EXPECT_EQ(CountOf(json, "\"ph\":\"X\""), 21);
+  EXPECT_THAT(json, Not(HasSubstr("before_start")));
+  EXPECT_THAT(json, Not(HasSubstr("after_stop")));
+}
+
+TEST(Trace, ring_buffer_keeps_newest_events) {
+  StartTracing(4);
+  for (int i = 0; i < 10; ++i) {
+    TraceSpan span("event", "index", i);
+  }
+  StopTracing();
+  std::string json = TraceJson();
+  EXPECT_EQ(CountOf(json, "\"name\":\"event\""), 4);
+  EXPECT_THAT(json, Not(HasSubstr("\"index\":5}")));
+  EXPECT_THAT(json, HasSubstr("\"index\":6}"));
+  EXPECT_THAT(json, HasSubstr("\"index\":9}"));
+
+  // Restarting discards the previous trace.
+  StartTracing();
+  StopTracing();
+  EXPECT_EQ(CountOf(TraceJson(), "\"name\""), 0);
+}
+
+TEST(Trace, consume_flag) {
+  std::string program = "prog", flag = "--trace=out.json", path = "rom.sfc";
+  std::vector<char*> argv = {&program[0], &path[0], &flag[0], nullptr};
+  int argc = 3;
+  EXPECT_EQ(ConsumeTraceFlag(&argc, argv.data()), "out.json");
+  EXPECT_EQ(argc, 2);
+  EXPECT_EQ(argv[1], &path[0]);
+  EXPECT_EQ(argv[2], nullptr);
+  EXPECT_FALSE(ConsumeTraceFlag(&argc, argv.data()).has_value());
+}
+
+}  // namespace
+}  // namespace nsasm
@@ -0,0 +1,224 @@
+#include "nsasm/workspace.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "nsasm/assemble.h"
+#include "nsasm/budget.h"
+#include "nsasm/listing.h"
+#include "nsasm/mnemonic.h"
+#include "nsasm/opcode_map.h"
+#include "nsasm/token.h"
+
+namespace nsasm {
+
+namespace {
+
+// Returns a 64-bit FNV-1a hash of `text`.
+uint64_t HashText(absl::string_view text) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (char ch : text) {
+    hash ^= static_cast<uint8_t>(ch);
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+ErrorOr<std::string> ReadFile(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    return Error("Failed to open file").SetLocation(path);
+  }
+  std::string contents;
+  char buffer[1 << 16];
+  size_t bytes_read;
+  while ((bytes_read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, bytes_read);
+  }
+  const bool failed = std::ferror(file);
+  std::fclose(file);
+  if (failed) {
+    return Error("Failed to read file").SetLocation(path);
+  }
+  return contents;
+}
+
+}  // namespace
+
+ErrorOr<std::vector<Statement>> AssembleLine(absl::string_view line,
+                                             const Location& location) {
+  auto tokens = Tokenize(line, location);
+  NSASM_RETURN_IF_ERROR_WITH_LOCATION(tokens, location);
+  auto statements = Assemble(*tokens);
+  NSASM_RETURN_IF_ERROR_WITH_LOCATION(statements, location);
+  return std::move(*statements);
+}
+
+std::string SourceListing(const std::vector<std::vector<Statement>>& lines) {
+  std::string listing;
+  for (const std::vector<Statement>& line : lines) {
+    for (const Statement& statement : line) {
+      if (absl::holds_alternative<std::string>(statement)) {
+        listing.append(absl::get<std::string>(statement)).append(":\n");
+      } else if (absl::holds_alternative<Instruction>(statement)) {
+        listing.append("    ");
+        absl::get<Instruction>(statement).AppendTo(&listing);
+        listing.push_back('\n');
+      } else {
+        listing.append("    ");
+        absl::get<Directive>(statement).AppendTo(&listing);
+        listing.push_back('\n');
+      }
+    }
+  }
+  return listing;
+}
+
+SourceFile ParseSource(const std::string& path, absl::string_view text) {
+  SourceFile source;
+  // A final newline ends the last line, rather than starting another.
+  absl::ConsumeSuffix(&text, "\n");
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(text, '\n')) {
+    ++line_number;
+    source.lines.emplace_back();
+    auto statements = AssembleLine(line, Location{path, line_number});
+    if (!statements.ok()) {
+      source.errors.push_back(statements.error());
+      continue;
+    }
+    for (const Statement& statement : *statements) {
+      if (absl::holds_alternative<std::string>(statement)) {
+        source.symbols.emplace(absl::get<std::string>(statement), line_number);
+      }
+    }
+    source.lines.back() = std::move(*statements);
+  }
+  source.listing = SourceListing(source.lines);
+
+  std::vector<Error> budget_errors = CheckCycleBudgets(path, source.lines);
+  if (!budget_errors.empty()) {
+    source.errors.insert(source.errors.end(), budget_errors.begin(),
+                         budget_errors.end());
+    std::stable_sort(source.errors.begin(), source.errors.end(),
+                     [](const Error& lhs, const Error& rhs) {
+                       return lhs.location().offset < rhs.location().offset;
+                     });
+  }
+  return source;
+}
+
+ErrorOr<FileStamp> StampFile(const std::string& path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return Error("Failed to open file").SetLocation(path);
+  }
+  FileStamp stamp;
+  stamp.mtime_nanos =
+      int64_t{info.st_mtim.tv_sec} * 1000000000 + info.st_mtim.tv_nsec;
+  stamp.size = info.st_size;
+  return stamp;
+}
+
+Workspace::Workspace() {
+  // Each of these builds a static lookup table on first use.
+  ToMnemonic("LDA");
+  ToDirectiveName(".ORG");
+  DirectiveTypeByName(D_org);
+  ImmediateArgumentUsesMBit(M_lda);
+}
+
+ErrorOr<const SourceFile*> Workspace::Source(const std::string& path) {
+  auto stamp = StampFile(path);
+  NSASM_RETURN_IF_ERROR(stamp);
+  auto it = sources_.find(path);
+  if (it != sources_.end() && it->second.stamp == *stamp) {
+    ++source_stats_.hits;
+    return &it->second.source;
+  }
+
+  auto text = ReadFile(path);
+  NSASM_RETURN_IF_ERROR(text);
+  const uint64_t hash = HashText(*text);
+  if (it != sources_.end() && it->second.hash == hash) {
+    ++source_stats_.revalidated;
+    it->second.stamp = *stamp;
+    return &it->second.source;
+  }
+
+  ++source_stats_.loads;
+  CachedSource& cached = sources_[path];
+  cached.stamp = *stamp;
+  cached.hash = hash;
+  cached.source = ParseSource(path, *text);
+  return &cached.source;
+}
+
+ErrorOr<Workspace::CachedRom*> Workspace::FindRom(const std::string& path) {
+  auto stamp = StampFile(path);
+  NSASM_RETURN_IF_ERROR(stamp);
+  auto it = roms_.find(path);
+  if (it != roms_.end() && it->second.stamp == *stamp) {
+    ++rom_stats_.hits;
+    return &it->second;
+  }
+
+  auto rom = LoadRomFile(path);
+  NSASM_RETURN_IF_ERROR(rom);
+  if (it != roms_.end() &&
+      it->second.rom->mapping_mode() == rom->mapping_mode() &&
+      it->second.rom->ContentHash() == rom->ContentHash()) {
+    ++rom_stats_.revalidated;
+    it->second.stamp = *stamp;
+    return &it->second;
+  }
+
+  ++rom_stats_.loads;
+  CachedRom& cached = roms_[path];
+  cached.stamp = *stamp;
+  cached.rom = absl::make_unique<Rom>(std::move(*rom));
+  cached.listings.clear();
+  return &cached;
+}
+
+ErrorOr<const Rom*> Workspace::LoadRom(const std::string& path) {
+  auto cached = FindRom(path);
+  NSASM_RETURN_IF_ERROR(cached);
+  return static_cast<const Rom*>((*cached)->rom.get());
+}
+
+ErrorOr<const std::string*> Workspace::DisassemblyListing(
+    const std::string& path, absl::optional<EntryPoint> entry_point) {
+  auto cached = FindRom(path);
+  NSASM_RETURN_IF_ERROR(cached);
+  CachedRom& rom = **cached;
+  const auto key =
+      entry_point.has_value()
+          ? std::make_pair(entry_point->address, entry_point->flag_state.Pack())
+          : std::make_pair(-1, uint16_t{0});
+  auto it = rom.listings.find(key);
+  if (it != rom.listings.end()) {
+    ++listing_stats_.hits;
+    return &it->second;
+  }
+
+  auto disassembly =
+      entry_point.has_value()
+          ? Disassemble(*rom.rom, entry_point->address, entry_point->flag_state)
+          : DisassembleAll(*rom.rom, VectorEntryPoints(*rom.rom));
+  NSASM_RETURN_IF_ERROR(disassembly);
+  ++listing_stats_.loads;
+  std::string& listing = rom.listings[key];
+  {
+    ListingWriter writer(&listing);
+    writer.WriteDisassembly(*disassembly);
+  }
+  return &listing;
+}
+
+}  // namespace nsasm
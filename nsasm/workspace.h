@@ -0,0 +1,133 @@
+#ifndef NSASM_WORKSPACE_H_
+#define NSASM_WORKSPACE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/variant.h"
+#include "nsasm/directive.h"
+#include "nsasm/disassemble.h"
+#include "nsasm/error.h"
+#include "nsasm/instruction.h"
+#include "nsasm/rom.h"
+#include "nsasm/statement.h"
+
+namespace nsasm {
+
+// Tokenizes and assembles one line of source.  Errors are reported at
+// `location`.
+ErrorOr<std::vector<Statement>> AssembleLine(absl::string_view line,
+                                             const Location& location);
+
+// A source file, tokenized and assembled line by line.
+struct SourceFile {
+  // The statements on each line; `lines[i]` holds line i + 1.  Lines that
+  // failed to assemble are empty.
+  std::vector<std::vector<Statement>> lines;
+  // Errors from lines that failed to assemble, and from cycle budgets that
+  // failed their checks (see CheckCycleBudgets()), in line order.  Each
+  // error's location offset is its line number.
+  std::vector<Error> errors;
+  // Every label defined in the file, mapped to the line defining it.
+  std::map<std::string, int> symbols;
+  // The statements, one per line, as interactive_assemble prints them.
+  std::string listing;
+};
+
+// Returns the statements of `lines`, one per line, as interactive_assemble
+// prints them.
+std::string SourceListing(const std::vector<std::vector<Statement>>& lines);
+
+// Assembles source text, read from `path`.
+SourceFile ParseSource(const std::string& path, absl::string_view text);
+
+// The modification time and size of a file.
+struct FileStamp {
+  int64_t mtime_nanos = 0;
+  int64_t size = 0;
+
+  bool operator==(const FileStamp& rhs) const {
+    return mtime_nanos == rhs.mtime_nanos && size == rhs.size;
+  }
+  bool operator!=(const FileStamp& rhs) const { return !(*this == rhs); }
+};
+
+// Returns the stamp of the file at `path`.
+ErrorOr<FileStamp> StampFile(const std::string& path);
+
+// In-memory caches of parsed source files, loaded ROMs and their disassembly
+// listings, for long-lived processes such as nsasmd.
+//
+// Each lookup checks the file's modification time and size.  If they have
+// changed, the file is read again and its contents hashed; only if the
+// contents differ is it parsed (or disassembled) again.  Touching a file
+// without changing it therefore costs one read.
+//
+// Construction also builds the assembler's lazily-initialized lookup tables,
+// so that the first request does not pay for them.
+//
+// Not thread-safe.
+class Workspace {
+ public:
+  struct CacheStats {
+    int64_t hits = 0;         // file unchanged since the last lookup
+    int64_t revalidated = 0;  // file touched, but its contents are unchanged
+    int64_t loads = 0;        // file read and parsed (or disassembled)
+  };
+
+  Workspace();
+
+  Workspace(const Workspace&) = delete;
+  Workspace& operator=(const Workspace&) = delete;
+
+  // Returns the assembled source file at `path`.  The pointer is valid until
+  // the next call for the same path.
+  ErrorOr<const SourceFile*> Source(const std::string& path);
+
+  // Returns the ROM at `path`.  The pointer is valid until the next call for
+  // the same path.
+  ErrorOr<const Rom*> LoadRom(const std::string& path);
+
+  // Returns the listing of the ROM at `path`, disassembled from `entry_point`,
+  // or from every vector in its header if none is given.  The pointer is valid
+  // until the next call for the same path.
+  ErrorOr<const std::string*> DisassemblyListing(
+      const std::string& path, absl::optional<EntryPoint> entry_point);
+
+  const CacheStats& source_stats() const { return source_stats_; }
+  const CacheStats& rom_stats() const { return rom_stats_; }
+  const CacheStats& listing_stats() const { return listing_stats_; }
+
+ private:
+  struct CachedSource {
+    FileStamp stamp;
+    uint64_t hash = 0;
+    SourceFile source;
+  };
+
+  struct CachedRom {
+    FileStamp stamp;
+    std::unique_ptr<Rom> rom;
+    // Listings, keyed by entry address and packed flag state.  Listings from
+    // the header vectors use address -1.
+    std::map<std::pair<int, uint16_t>, std::string> listings;
+  };
+
+  ErrorOr<CachedRom*> FindRom(const std::string& path);
+
+  std::map<std::string, CachedSource> sources_;
+  std::map<std::string, CachedRom> roms_;
+  CacheStats source_stats_;
+  CacheStats rom_stats_;
+  CacheStats listing_stats_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_WORKSPACE_H_
@@ -0,0 +1,165 @@
+#include "nsasm/workspace.h"
+
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nsasm/server.h"
+
+using ::testing::HasSubstr;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+namespace nsasm {
+namespace {
+
+void WriteFile(const std::string& path, const std::string& contents) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fwrite(contents.data(), 1, contents.size(), file);
+  std::fclose(file);
+}
+
+// Sets the modification time of `path` to `seconds` after the epoch.
+void SetMtime(const std::string& path, int seconds) {
+  struct timeval times[2] = {{seconds, 0}, {seconds, 0}};
+  ASSERT_EQ(utimes(path.c_str(), times), 0);
+}
+
+// Returns a minimal LoRom image whose reset vector runs `code` at $00:8000.
+std::string MakeRomImage(const std::vector<uint8_t>& code) {
+  std::string image(0x10000, '\0');
+  std::copy(code.begin(), code.end(), image.begin());
+  // Checksum and complement
+  image[0x7fde] = '\xff';
+  image[0x7fdf] = '\xff';
+  // Emulation mode RESET vector
+  image[0x7ffc] = '\x00';
+  image[0x7ffd] = '\x80';
+  return image;
+}
+
+TEST(ParseSource, lines_symbols_and_errors) {
+  SourceFile source = ParseSource("test.s",
+                                  "start: LDA #$12\n"
+                                  "  STA $10\n"
+                                  "loop BRA loop\n"
+                                  "  LDA (\n");
+  ASSERT_EQ(source.lines.size(), 4);
+  EXPECT_EQ(source.lines[0].size(), 2);
+  EXPECT_EQ(source.lines[1].size(), 1);
+  EXPECT_TRUE(source.lines[3].empty());
+  EXPECT_THAT(source.symbols,
+              UnorderedElementsAre(Pair("start", 1), Pair("loop", 3)));
+  ASSERT_EQ(source.errors.size(), 1);
+  EXPECT_THAT(source.errors[0].ToString(), HasSubstr("test.s:0x4"));
+  EXPECT_THAT(source.listing, HasSubstr("start:\n    LDA #$12\n"));
+}
+
+TEST(Workspace, source_cache) {
+  const std::string path = testing::TempDir() + "/workspace_source.s";
+  WriteFile(path, "foo: NOP\n");
+  SetMtime(path, 1000);
+
+  Workspace workspace;
+  auto source = workspace.Source(path);
+  NSASM_ASSERT_OK(source);
+  EXPECT_EQ((*source)->symbols.count("foo"), 1);
+  NSASM_ASSERT_OK(workspace.Source(path));
+  EXPECT_EQ(workspace.source_stats().loads, 1);
+  EXPECT_EQ(workspace.source_stats().hits, 1);
+
+  // Touched, but unchanged
+  SetMtime(path, 2000);
+  NSASM_ASSERT_OK(workspace.Source(path));
+  EXPECT_EQ(workspace.source_stats().revalidated, 1);
+  EXPECT_EQ(workspace.source_stats().loads, 1);
+
+  // Changed
+  WriteFile(path, "bar: NOP\n");
+  SetMtime(path, 3000);
+  source = workspace.Source(path);
+  NSASM_ASSERT_OK(source);
+  EXPECT_EQ(workspace.source_stats().loads, 2);
+  EXPECT_EQ((*source)->symbols.count("foo"), 0);
+  EXPECT_EQ((*source)->symbols.count("bar"), 1);
+
+  EXPECT_FALSE(workspace.Source(path + ".missing").ok());
+}
+
+TEST(Workspace, rom_listing_cache) {
+  const std::string path = testing::TempDir() + "/workspace_rom.sfc";
+  // $008000: SEI; $008001: BRA $008001
+  WriteFile(path, MakeRomImage({0x78, 0x80, 0xfe}));
+  SetMtime(path, 1000);
+
+  Workspace workspace;
+  auto listing = workspace.DisassemblyListing(path, absl::nullopt);
+  NSASM_ASSERT_OK(listing);
+  EXPECT_THAT(**listing, HasSubstr("SEI"));
+  const std::string* first = *listing;
+  listing = workspace.DisassemblyListing(path, absl::nullopt);
+  NSASM_ASSERT_OK(listing);
+  EXPECT_EQ(*listing, first);
+  EXPECT_EQ(workspace.listing_stats().loads, 1);
+  EXPECT_EQ(workspace.listing_stats().hits, 1);
+
+  // A different entry point is a separate listing.
+  NSASM_ASSERT_OK(workspace.DisassemblyListing(
+      path, EntryPoint{0x008001, FlagState(B_on, B_on, B_on)}));
+  EXPECT_EQ(workspace.listing_stats().loads, 2);
+
+  // Touching the ROM keeps its listings.
+  SetMtime(path, 2000);
+  NSASM_ASSERT_OK(workspace.DisassemblyListing(path, absl::nullopt));
+  EXPECT_EQ(workspace.rom_stats().revalidated, 1);
+  EXPECT_EQ(workspace.listing_stats().loads, 2);
+
+  // Changing it discards them.
+  WriteFile(path, MakeRomImage({0x18, 0x80, 0xfe}));
+  SetMtime(path, 3000);
+  listing = workspace.DisassemblyListing(path, absl::nullopt);
+  NSASM_ASSERT_OK(listing);
+  EXPECT_THAT(**listing, HasSubstr("CLC"));
+  EXPECT_EQ(workspace.rom_stats().loads, 2);
+  EXPECT_EQ(workspace.listing_stats().loads, 3);
+}
+
+TEST(HandleRequest, protocol) {
+  const std::string source_path = testing::TempDir() + "/request.s";
+  const std::string rom_path = testing::TempDir() + "/request.sfc";
+  WriteFile(source_path, "foo: NOP\nbar: RTS\n");
+  WriteFile(rom_path, MakeRomImage({0x78, 0x80, 0xfe}));
+
+  Workspace workspace;
+  bool shutdown = false;
+  EXPECT_EQ(HandleRequest("assemble " + source_path, &workspace, &shutdown),
+            "ok 26\nfoo:\n    NOP\nbar:\n    RTS\n");
+  EXPECT_EQ(HandleRequest("symbols " + source_path + "\n", &workspace,
+                          &shutdown),
+            "ok 12\nbar 2\nfoo 1\n");
+  EXPECT_THAT(HandleRequest("disassemble " + rom_path + " 8000 m16x16",
+                            &workspace, &shutdown),
+              HasSubstr("008000          SEI"));
+  EXPECT_THAT(HandleRequest("disassemble " + rom_path + " zz", &workspace,
+                            &shutdown),
+              HasSubstr("error"));
+  EXPECT_THAT(HandleRequest("stats", &workspace, &shutdown),
+              HasSubstr("sources: 1 hits, 0 revalidated, 1 loads\n"));
+  EXPECT_EQ(HandleRequest("optimize " + source_path, &workspace, &shutdown),
+            "ok 54\n0 cycles and 0 bytes saved\n\n"
+            "foo:\n    NOP\nbar:\n    RTS\n");
+  EXPECT_THAT(HandleRequest("frobnicate", &workspace, &shutdown),
+              HasSubstr("error"));
+  EXPECT_FALSE(shutdown);
+  EXPECT_EQ(HandleRequest("shutdown", &workspace, &shutdown), "ok 0\n");
+  EXPECT_TRUE(shutdown);
+}
+
+}  // namespace
+}  // namespace nsasm
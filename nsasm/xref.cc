@@ -0,0 +1,126 @@
+#include "nsasm/xref.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "nsasm/rom.h"
+
+namespace nsasm {
+
+namespace {
+
+struct Entry {
+  int target;
+  int from;
+  ReferenceKind kind;
+};
+
+bool IsWrite(Mnemonic m) {
+  return m == M_sta || m == M_stx || m == M_sty || m == M_stz;
+}
+
+bool IsModify(Mnemonic m) {
+  return m == M_asl || m == M_dec || m == M_inc || m == M_lsr ||
+         m == M_rol || m == M_ror || m == M_trb || m == M_tsb;
+}
+
+ReferenceKind DataKind(Mnemonic m) {
+  if (IsWrite(m)) {
+    return RK_write;
+  }
+  if (IsModify(m)) {
+    return RK_modify;
+  }
+  return RK_read;
+}
+
+// Adds the reference made by the instruction at `pc`, if any, to `*entries`.
+void AddReference(int pc, const Instruction& instruction,
+                  std::vector<Entry>* entries) {
+  const Mnemonic m = instruction.mnemonic;
+  const AddressingMode mode = instruction.addressing_mode;
+  if (m == M_per || m == M_pea || m == M_pei) {
+    // Pushed values may be addresses, but nothing is accessed.
+    return;
+  }
+  if (mode == A_rel8 || mode == A_rel16) {
+    const int next_pc = AddToPC(pc, InstructionLength(mode));
+    entries->push_back(
+        {AddToPC(next_pc, *instruction.arg1.Evaluate()), pc, RK_branch});
+    return;
+  }
+  if (mode != A_dir_w && mode != A_dir_wx && mode != A_dir_wy &&
+      mode != A_dir_l && mode != A_dir_lx && mode != A_ind_w &&
+      mode != A_ind_wx && mode != A_lng_w) {
+    return;
+  }
+  auto value = instruction.arg1.Evaluate();
+  if (!value.ok()) {
+    return;
+  }
+  const int program_bank = pc & 0xff0000;
+  int target;
+  ReferenceKind kind;
+  switch (mode) {
+    case A_dir_l:
+    case A_dir_lx:
+      target = *value & 0xffffff;
+      break;
+    case A_ind_w:
+    case A_lng_w:
+      target = *value & 0xffff;
+      break;
+    default:
+      target = program_bank | (*value & 0xffff);
+      break;
+  }
+  if (mode == A_ind_w || mode == A_ind_wx || mode == A_lng_w) {
+    kind = RK_pointer;
+  } else if (m == M_jmp) {
+    kind = RK_jump;
+  } else if (m == M_jsr || m == M_jsl) {
+    kind = RK_call;
+  } else {
+    kind = DataKind(m);
+  }
+  entries->push_back({target, pc, kind});
+}
+
+}  // namespace
+
+XrefIndex XrefIndex::Build(const Disassembly& disassembly) {
+  std::vector<Entry> entries;
+  entries.reserve(disassembly.size());
+  for (const auto& node : disassembly) {
+    AddReference(node.first, node.second.instruction, &entries);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& lhs, const Entry& rhs) {
+              return std::tie(lhs.target, lhs.from, lhs.kind) <
+                     std::tie(rhs.target, rhs.from, rhs.kind);
+            });
+
+  XrefIndex index;
+  index.references_.reserve(entries.size());
+  for (const Entry& entry : entries) {
+    if (index.targets_.empty() || index.targets_.back() != entry.target) {
+      index.targets_.push_back(entry.target);
+      index.offsets_.push_back(index.references_.size());
+    }
+    index.references_.push_back({entry.from, entry.kind});
+  }
+  index.offsets_.push_back(index.references_.size());
+  return index;
+}
+
+absl::Span<const Reference> XrefIndex::ReferencesTo(int address) const {
+  auto it = std::lower_bound(targets_.begin(), targets_.end(), address);
+  if (it == targets_.end() || *it != address) {
+    return {};
+  }
+  const int i = it - targets_.begin();
+  return absl::MakeConstSpan(references_.data() + offsets_[i],
+                             references_.data() + offsets_[i + 1]);
+}
+
+}  // namespace nsasm
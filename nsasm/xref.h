@@ -0,0 +1,67 @@
+#ifndef NSASM_XREF_H_
+#define NSASM_XREF_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "nsasm/disassemble.h"
+
+namespace nsasm {
+
+// How an instruction refers to an address.
+enum ReferenceKind : uint8_t {
+  RK_branch,   // relative branch (BEQ, BRA, BRL, ...)
+  RK_jump,     // JMP or JML to the address
+  RK_call,     // JSR or JSL to the address
+  RK_pointer,  // indirect JMP, JML or JSR through a pointer at the address
+  RK_read,     // load, compare, or other read of the address
+  RK_write,    // store to the address
+  RK_modify,   // read-modify-write (INC, ASL, TSB, ...) of the address
+};
+
+struct Reference {
+  int from;  // address of the referencing instruction
+  ReferenceKind kind;
+};
+
+// Index of the addresses referred to by the instructions of a disassembly.
+//
+// Branch targets, and the absolute (16-bit) and long (24-bit) operands of
+// jumps, calls, loads and stores are indexed.  Direct page, stack relative
+// and immediate operands are not, since their targets are unknown or not
+// addresses.
+//
+// Targets are full 24-bit addresses.  Absolute operands are taken to be in
+// the program bank (for jumps and calls, and for data accesses on the
+// assumption that the data bank matches), except for the pointers read by
+// `JMP ($1234)` and `JML [$1234]`, which are in bank 0.
+//
+// References are stored in compressed row form: one sorted array of targets,
+// and one array of references grouped by target, so lookups are a binary
+// search.
+class XrefIndex {
+ public:
+  static XrefIndex Build(const Disassembly& disassembly);
+
+  // Returns the references to `address`, sorted by referencing address.
+  absl::Span<const Reference> ReferencesTo(int address) const;
+
+  // Returns every referenced address, in order.
+  const std::vector<int>& Targets() const { return targets_; }
+
+  // Returns the total number of references.
+  int ReferenceCount() const { return references_.size(); }
+
+ private:
+  XrefIndex() = default;
+
+  std::vector<int> targets_;
+  // references_[offsets_[i], offsets_[i + 1]) refer to targets_[i].
+  std::vector<int> offsets_;
+  std::vector<Reference> references_;
+};
+
+}  // namespace nsasm
+
+#endif  // NSASM_XREF_H_
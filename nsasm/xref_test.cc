@@ -0,0 +1,63 @@
+#include "nsasm/xref.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::testing::ElementsAre;
+
+namespace nsasm {
+namespace {
+
+MATCHER_P2(IsReference, from, kind, "") {
+  return arg.from == from && arg.kind == kind;
+}
+
+TEST(XrefIndex, references) {
+  std::vector<uint8_t> data(0x10000, 0x00);
+  const std::vector<uint8_t> code = {
+      0xad, 0x00, 0x21,        // $808000: LDA $2100
+      0x8d, 0x00, 0x21,        // $808003: STA $2100
+      0xee, 0x00, 0x21,        // $808006: INC $2100
+      0x8f, 0x00, 0x21, 0x00,  // $808009: STA $002100
+      0xa5, 0x12,              // $80800d: LDA $12
+      0x20, 0x20, 0x80,        // $80800f: JSR $8020
+      0xd0, 0xec,              // $808012: BNE $808000
+      0x7c, 0x00, 0x90,        // $808014: JMP ($9000,X)
+  };
+  std::copy(code.begin(), code.end(), data.begin());
+  data[0x20] = 0x60;  // $808020: RTS
+  Rom rom(kLoRom, "test.sfc", std::move(data));
+  auto disassembly =
+      Disassemble(rom, 0x808000, FlagState(B_off, B_on, B_on));
+  NSASM_ASSERT_OK(disassembly);
+
+  XrefIndex index = XrefIndex::Build(*disassembly);
+  EXPECT_EQ(index.Targets(),
+            std::vector<int>({0x002100, 0x802100, 0x808000, 0x808020,
+                              0x809000}));
+  EXPECT_EQ(index.ReferenceCount(), 7);
+
+  EXPECT_THAT(index.ReferencesTo(0x802100),
+              ElementsAre(IsReference(0x808000, RK_read),
+                          IsReference(0x808003, RK_write),
+                          IsReference(0x808006, RK_modify)));
+  EXPECT_THAT(index.ReferencesTo(0x002100),
+              ElementsAre(IsReference(0x808009, RK_write)));
+  EXPECT_THAT(index.ReferencesTo(0x808000),
+              ElementsAre(IsReference(0x808012, RK_branch)));
+  EXPECT_THAT(index.ReferencesTo(0x808020),
+              ElementsAre(IsReference(0x80800f, RK_call)));
+  EXPECT_THAT(index.ReferencesTo(0x809000),
+              ElementsAre(IsReference(0x808014, RK_pointer)));
+
+  // Unreferenced addresses, including the direct page operand
+  EXPECT_TRUE(index.ReferencesTo(0x000012).empty());
+  EXPECT_TRUE(index.ReferencesTo(0x808001).empty());
+  EXPECT_TRUE(index.ReferencesTo(0xffffff).empty());
+}
+
+}  // namespace
+}  // namespace nsasm
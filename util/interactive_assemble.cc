@@ -2,6 +2,7 @@
 
 #include "nsasm/assemble.h"
 #include "nsasm/error.h"
+#include "nsasm/stats.h"
 #include "nsasm/token.h"
 
 using nsasm::Assemble;
@@ -12,6 +13,12 @@ using nsasm::Tokenize;
 using nsasm::TokenSpan;
 
 int main(int argc, char** argv) {
+  // With --stats, a breakdown of time spent in each phase is printed to stderr
+  // on exit.
+  bool print_stats = nsasm::ConsumeStatsFlag(&argc, argv);
+
+  // Output lines are formatted into one reused buffer.
+  std::string text;
   while (std::cin) {
     std::string line;
     std::cout << "> " << std::flush;
@@ -31,19 +38,31 @@ int main(int argc, char** argv) {
       continue;
     }
 
+    text.clear();
     for (const auto& line : *assembly) {
       if (absl::holds_alternative<std::string>(line)) {
-        std::cout << absl::get<std::string>(line) << ":\n";
+        text.append(absl::get<std::string>(line)).append(":\n");
       }
       if (absl::holds_alternative<Instruction>(line)) {
-        const Instruction& ins = absl::get<Instruction>(line);
-        std::cout << "    " << ins.ToString() << "\n";
+        text.append("    ");
+        absl::get<Instruction>(line).AppendTo(&text);
+        text.push_back('\n');
       }
       if (absl::holds_alternative<Directive>(line)) {
-        const Directive& dir = absl::get<Directive>(line);
-        std::cout << "    " << dir.ToString() << "\n";
+        text.append("    ");
+        absl::get<Directive>(line).AppendTo(&text);
+        text.push_back('\n');
       }
     }
+    std::cout.write(text.data(), text.size());
+  }
+  if (print_stats) {
+    if (nsasm::kStatsEnabled) {
+      std::cerr << nsasm::StatsReport(nsasm::GetStats());
+    } else {
+      std::cerr << "--stats: not available; build with "
+                   "--define nsasm_stats=1\n";
+    }
   }
   return 0;
 }
\ No newline at end of file
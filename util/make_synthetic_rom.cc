@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <string>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "bench/synthetic.h"
+
+// Writes a synthetic ROM image and matching source, for benchmarks and stress
+// tests.
+
+void usage(char* path) {
+  absl::PrintF(
+      "Usage: %s <rom-path> <source-path> [lorom|hirom|exhirom] [<size-in-KB>] "
+      "[<max-source-lines>] [<seed>]\n\n"
+      "Generates a ROM image full of reachable code, and nsasm source for it.\n"
+      "The size defaults to 1024KB (4352KB for ExHiRom), and the source is\n"
+      "unlimited unless a line count is given.\n",
+      path);
+}
+
+bool WriteFile(const std::string& path, const void* data, size_t size) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 0;
+  }
+
+  nsasm::bench::SyntheticRomOptions options;
+  if (argc > 3) {
+    const std::string mapping = argv[3];
+    if (mapping == "lorom") {
+      options.mapping = nsasm::kLoRom;
+    } else if (mapping == "hirom") {
+      options.mapping = nsasm::kHiRom;
+    } else if (mapping == "exhirom") {
+      options.mapping = nsasm::kExHiRom;
+      options.rom_size = 0x440000;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  int size_kb;
+  if (argc > 4) {
+    if (!absl::SimpleAtoi(argv[4], &size_kb)) {
+      usage(argv[0]);
+      return 1;
+    }
+    options.rom_size = size_kb * 1024;
+  }
+  if (argc > 5 && !absl::SimpleAtoi(argv[5], &options.max_source_lines)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (argc > 6 && !absl::SimpleAtoi(argv[6], &options.seed)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  auto rom = nsasm::bench::GenerateSyntheticRom(options);
+  if (!rom.ok()) {
+    absl::PrintF("%s\n", rom.error().ToString());
+    return 1;
+  }
+  if (!WriteFile(argv[1], rom->data.data(), rom->data.size()) ||
+      !WriteFile(argv[2], rom->source.data(), rom->source.size())) {
+    absl::PrintF("Failed to write output\n");
+    return 1;
+  }
+  absl::PrintF("Wrote %d instructions in %d source lines.\n",
+               rom->instruction_count, rom->source_lines);
+  return 0;
+}
@@ -0,0 +1,58 @@
+// nsasm_lsp: a Language Server Protocol server for nsasm source, speaking
+// JSON-RPC over stdin and stdout.  See nsasm/lsp.h for what it provides.
+
+#include <cstdio>
+#include <string>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "nsasm/json.h"
+#include "nsasm/lsp.h"
+
+namespace {
+
+// Reads one message body from `file`, following the LSP base protocol's
+// headers.  Returns false at end of input.
+bool ReadMessage(std::FILE* file, std::string* body) {
+  size_t content_length = 0;
+  bool have_length = false;
+  char header[1024];
+  while (std::fgets(header, sizeof(header), file)) {
+    absl::string_view line = absl::StripTrailingAsciiWhitespace(header);
+    if (line.empty()) {
+      if (!have_length) {
+        continue;
+      }
+      body->resize(content_length);
+      return std::fread(&(*body)[0], 1, content_length, file) ==
+             content_length;
+    }
+    if (absl::StartsWithIgnoreCase(line, "Content-Length:")) {
+      line.remove_prefix(sizeof("Content-Length:") - 1);
+      have_length = absl::SimpleAtoi(line, &content_length);
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  nsasm::LanguageServer server;
+  std::string body;
+  while (!server.exited() && ReadMessage(stdin, &body)) {
+    auto message = nsasm::JsonValue::Parse(body);
+    if (!message.ok()) {
+      std::fprintf(stderr, "nsasm_lsp: %s\n",
+                   message.error().ToString().c_str());
+      continue;
+    }
+    for (const nsasm::JsonValue& reply : server.HandleMessage(*message)) {
+      const std::string framed = nsasm::FrameMessage(reply);
+      std::fwrite(framed.data(), 1, framed.size(), stdout);
+    }
+    std::fflush(stdout);
+  }
+  return server.exited() ? server.exit_code() : 1;
+}
@@ -0,0 +1,271 @@
+// nsasmd: a long-lived assembler daemon, serving requests over a Unix socket.
+//
+//   nsasmd <socket-path>
+//     Serves requests until a "shutdown" request arrives.  Any number of
+//     clients may be connected at once; their requests are handled in turn.
+//
+//   nsasmd --send <socket-path> <request words...>
+//     Sends one request to a running daemon, and prints the response body.
+//     Exits with status 1 if the daemon reports an error.
+//
+// See nsasm/server.h for the request protocol.  Source files, ROMs and
+// disassembly listings are cached between requests, so that editor
+// integrations and scripts do not pay process startup and parsing costs on
+// every invocation.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/strip.h"
+#include "nsasm/server.h"
+#include "nsasm/workspace.h"
+
+namespace {
+
+bool MakeAddress(const char* path, sockaddr_un* address) {
+  if (std::strlen(path) >= sizeof(address->sun_path)) {
+    std::fprintf(stderr, "Socket path too long: %s\n", path);
+    return false;
+  }
+  std::memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  std::strcpy(address->sun_path, path);
+  return true;
+}
+
+bool WriteAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    // MSG_NOSIGNAL: a client hanging up should not kill the daemon.
+    ssize_t n =
+        send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+// Reads from `fd` into `*buffer` until it holds at least `size` bytes.
+bool ReadAtLeast(int fd, size_t size, std::string* buffer) {
+  char chunk[4096];
+  while (buffer->size() < size) {
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) {
+      return false;
+    }
+    buffer->append(chunk, n);
+  }
+  return true;
+}
+
+// Reads from `fd` into `*buffer` until it holds a newline, and returns the
+// newline's position, or npos if the connection closed first.
+size_t ReadLine(int fd, std::string* buffer) {
+  size_t newline;
+  while ((newline = buffer->find('\n')) == std::string::npos) {
+    if (!ReadAtLeast(fd, buffer->size() + 1, buffer)) {
+      return std::string::npos;
+    }
+  }
+  return newline;
+}
+
+// A client connection, which may carry any number of requests, one per line.
+struct Connection {
+  int fd = -1;
+  // Bytes received but not yet handled, and responses not yet sent.
+  std::string input;
+  std::string output;
+  // Set when the client has sent all its requests, or the connection failed.
+  bool eof = false;
+  bool failed = false;
+};
+
+// Reads what is available on `connection`, and handles each complete request
+// received.
+void ReadRequests(Connection* connection, nsasm::Workspace* workspace,
+                  bool* shutdown) {
+  char chunk[4096];
+  ssize_t n = read(connection->fd, chunk, sizeof(chunk));
+  if (n == 0) {
+    connection->eof = true;
+  } else if (n < 0) {
+    connection->failed = errno != EAGAIN && errno != EINTR;
+  } else {
+    connection->input.append(chunk, n);
+  }
+  size_t newline;
+  while (!*shutdown &&
+         (newline = connection->input.find('\n')) != std::string::npos) {
+    connection->output += nsasm::HandleRequest(
+        absl::string_view(connection->input).substr(0, newline), workspace,
+        shutdown);
+    connection->input.erase(0, newline + 1);
+  }
+}
+
+// Sends as much of `connection`'s pending output as it will take.
+void WriteResponses(Connection* connection) {
+  // MSG_NOSIGNAL: a client hanging up should not kill the daemon.
+  ssize_t n = send(connection->fd, connection->output.data(),
+                   connection->output.size(), MSG_NOSIGNAL);
+  if (n < 0) {
+    connection->failed = errno != EAGAIN && errno != EINTR;
+  } else {
+    connection->output.erase(0, n);
+  }
+}
+
+// Serves every connection from one thread, multiplexed with poll(), so that
+// the workspace needs no locking and one idle client cannot starve the rest.
+// Requests are handled one at a time, in the order their lines arrive.  A
+// connection's next requests are read only once its earlier responses are
+// sent, so a client that stops reading holds no more than a chunk of input.
+int Serve(const char* socket_path) {
+  sockaddr_un address;
+  if (!MakeAddress(socket_path, &address)) {
+    return 1;
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0 ||
+      listen(listener, 16) != 0) {
+    std::perror("nsasmd");
+    return 1;
+  }
+
+  nsasm::Workspace workspace;
+  bool shutdown = false;
+  std::vector<Connection> connections;
+  std::vector<pollfd> fds;
+  // After a "shutdown" request, only the responses already made are sent.
+  while (!shutdown || !connections.empty()) {
+    const bool listening = !shutdown;
+    fds.clear();
+    if (listening) {
+      fds.push_back({listener, POLLIN, 0});
+    }
+    for (const Connection& connection : connections) {
+      short events = 0;
+      if (!connection.output.empty()) {
+        events = POLLOUT;
+      } else if (!shutdown && !connection.eof) {
+        events = POLLIN;
+      }
+      fds.push_back({connection.fd, events, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::perror("nsasmd");
+      break;
+    }
+
+    const pollfd* polled = fds.data() + (listening ? 1 : 0);
+    for (size_t i = 0; i < connections.size(); ++i) {
+      Connection& connection = connections[i];
+      if (polled[i].revents & POLLOUT) {
+        WriteResponses(&connection);
+      } else if (polled[i].revents & POLLIN) {
+        ReadRequests(&connection, &workspace, &shutdown);
+      } else if (polled[i].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+        connection.failed = true;
+      }
+    }
+    // Close connections that failed, or have nothing left to send or read.
+    for (size_t i = connections.size(); i-- > 0;) {
+      const Connection& connection = connections[i];
+      if (connection.failed ||
+          (connection.output.empty() && (connection.eof || shutdown))) {
+        close(connection.fd);
+        connections.erase(connections.begin() + i);
+      }
+    }
+
+    if (listening && (fds[0].revents & POLLIN)) {
+      int fd = accept(listener, nullptr, nullptr);
+      if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        connections.emplace_back();
+        connections.back().fd = fd;
+      }
+    }
+  }
+  for (const Connection& connection : connections) {
+    close(connection.fd);
+  }
+  close(listener);
+  unlink(socket_path);
+  return 0;
+}
+
+int Send(const char* socket_path, const std::string& request) {
+  sockaddr_un address;
+  if (!MakeAddress(socket_path, &address)) {
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0) {
+    std::perror("nsasmd");
+    return 1;
+  }
+  std::string buffer;
+  size_t newline;
+  if (!WriteAll(fd, request + "\n") ||
+      (newline = ReadLine(fd, &buffer)) == std::string::npos) {
+    std::fprintf(stderr, "nsasmd: connection closed\n");
+    close(fd);
+    return 1;
+  }
+
+  // Status line: "ok <n>" or "error <n>"
+  absl::string_view status = absl::string_view(buffer).substr(0, newline);
+  const bool ok = absl::ConsumePrefix(&status, "ok ");
+  if (!ok) {
+    absl::ConsumePrefix(&status, "error ");
+  }
+  size_t body_size;
+  if (!absl::SimpleAtoi(status, &body_size) ||
+      !ReadAtLeast(fd, newline + 1 + body_size, &buffer)) {
+    std::fprintf(stderr, "nsasmd: malformed response\n");
+    close(fd);
+    return 1;
+  }
+  close(fd);
+  std::fwrite(buffer.data() + newline + 1, 1, body_size, ok ? stdout : stderr);
+  return ok ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc >= 4 && std::strcmp(argv[1], "--send") == 0) {
+    return Send(argv[2], absl::StrJoin(argv + 3, argv + argc, " "));
+  }
+  if (argc != 2) {
+    std::fprintf(stderr,
+                 "usage: %s <socket-path>\n"
+                 "       %s --send <socket-path> <request...>\n",
+                 argv[0], argv[0]);
+    return 1;
+  }
+  return Serve(argv[1]);
+}
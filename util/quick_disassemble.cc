@@ -1,26 +1,86 @@
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
+#include "nsasm/cfg.h"
+#include "nsasm/cycles.h"
 #include "nsasm/decode.h"
 #include "nsasm/disassemble.h"
+#include "nsasm/expression.h"
 #include "nsasm/instruction.h"
+#include "nsasm/listing.h"
 #include "nsasm/rom.h"
+#include "nsasm/stats.h"
+#include "nsasm/trace.h"
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <vector>
 
 // Test utility to exercise
 
 void usage(char* path) {
   absl::PrintF(
-      "Usage: %s <path-to-rom> [@]<snes-hex-address> [<mode name>]\n\n"
+      "Usage: %s [--stats] [--trace=<path>] [--cycles] <path-to-rom> "
+      "[[@]<snes-hex-address> [<mode name>]]\n\n"
       "Disassembles some code starting at the named offset.\n"
       "If the offset begins with @, dereference the 16-bit address at this "
-      "location.\n",
+      "location.\n"
+      "If no offset is given, disassembles from every vector in the ROM "
+      "header.\n"
+      "With --stats, prints a breakdown of time spent in each phase to "
+      "stderr.\n"
+      "With --trace, writes a timeline of the run to the given path, in the "
+      "Chrome\ntrace-event format.\n"
+      "With --cycles, annotates the listing with estimated cycle counts for "
+      "each\ninstruction, basic block and subroutine.\n",
       path);
 }
 
-int main(int argc, char** argv) {
-  if (argc < 3) {
+// Prints the statistics gathered so far, if requested.
+void MaybePrintStats(bool print_stats) {
+  if (!print_stats) {
+    return;
+  }
+  if (!nsasm::kStatsEnabled) {
+    absl::FPrintF(stderr,
+                  "--stats: not available; build with "
+                  "--define nsasm_stats=1\n");
+    return;
+  }
+  absl::FPrintF(stderr, "%s", nsasm::StatsReport(nsasm::GetStats()));
+}
+
+// Removes a "--cycles" argument, returning true if there was one.
+bool ConsumeCyclesFlag(int* argc, char** argv) {
+  bool found = false;
+  int kept = 0;
+  for (int i = 0; i < *argc; ++i) {
+    if (i > 0 && std::strcmp(argv[i], "--cycles") == 0) {
+      found = true;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argv[kept] = nullptr;
+  *argc = kept;
+  return found;
+}
+
+// Writes `disassembly`, which was disassembled from `entry_points`, annotated
+// with cycle estimates.
+void WriteWithCycles(const nsasm::Rom& rom,
+                     const nsasm::Disassembly& disassembly,
+                     const std::vector<nsasm::EntryPoint>& entry_points,
+                     nsasm::ListingWriter* writer) {
+  nsasm::ControlFlowGraph graph =
+      nsasm::ControlFlowGraph::Build(rom, disassembly, entry_points);
+  nsasm::CycleEstimate cycles =
+      nsasm::CycleEstimate::Compute(graph, disassembly);
+  writer->WriteDisassemblyWithCycles(disassembly, graph, cycles);
+}
+
+int Run(int argc, char** argv, bool print_cycles) {
+  if (argc < 2) {
     usage(argv[0]);
     return 0;
   }
@@ -31,6 +91,31 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (argc == 2) {
+    // Whole-ROM mode: seed the disassembler from the header vectors.
+    nsasm::ListingWriter writer(stdout);
+    for (const nsasm::InterruptVector& vector : rom->Vectors()) {
+      writer.WriteLine(absl::StrFormat("; %-5s (%s) $%06x", vector.name,
+                                       vector.emulation ? "emu" : "native",
+                                       vector.target));
+    }
+    const std::vector<nsasm::EntryPoint> entry_points =
+        nsasm::VectorEntryPoints(*rom);
+    auto disassembly = nsasm::DisassembleAll(*rom, entry_points);
+    if (!disassembly.ok()) {
+      writer.WriteLine(disassembly.error().ToString());
+      return 1;
+    }
+    writer.WriteLine(absl::StrFormat("Disassembled %d instructions.",
+                                     disassembly->size()));
+    if (print_cycles) {
+      WriteWithCycles(*rom, *disassembly, entry_points, &writer);
+    } else {
+      writer.WriteDisassemblyParallel(*disassembly);
+    }
+    return writer.Flush().ok() ? 0 : 1;
+  }
+
   // Default to native mode, with one-byte A and X/Y.
   nsasm::FlagState flag_state(nsasm::B_off, nsasm::B_on, nsasm::B_on);
   if (argc > 3) {
@@ -63,17 +148,38 @@ int main(int argc, char** argv) {
   auto disassembly = nsasm::Disassemble(*rom, pc, flag_state);
   if (!disassembly.ok()) {
     absl::PrintF("%s\n", disassembly.error().ToString());
+    return 1;
   } else {
-    absl::PrintF("Disassembled %d instructions.\n", disassembly->size());
-    absl::PrintF("%06x          .org $%06x\n", rd_address, rd_address);
-    for (const auto& value : *disassembly) {
-      int pc = value.first;
-      std::string label = value.second.label;
-      const nsasm::Instruction& instruction = value.second.instruction;
+    nsasm::ListingWriter writer(stdout);
+    writer.WriteLine(absl::StrFormat("Disassembled %d instructions.",
+                                     disassembly->size()));
+    writer.WriteLine(
+        absl::StrFormat("%06x          .org $%06x", rd_address, rd_address));
+    if (print_cycles) {
+      WriteWithCycles(*rom, *disassembly, {{pc, flag_state}}, &writer);
+    } else {
+      writer.WriteDisassembly(*disassembly);
+    }
+    return writer.Flush().ok() ? 0 : 1;
+  }
+}
 
-      std::string text =
-          absl::StrFormat("%06x %-8s %s", pc, label, instruction.ToString());
-      absl::PrintF("%-30s ;%s\n", text, value.second.next_flag_state.ToString());
+int main(int argc, char** argv) {
+  bool print_stats = nsasm::ConsumeStatsFlag(&argc, argv);
+  auto trace_path = nsasm::ConsumeTraceFlag(&argc, argv);
+  if (trace_path) {
+    nsasm::StartTracing();
+  }
+  bool print_cycles = ConsumeCyclesFlag(&argc, argv);
+  int status = Run(argc, argv, print_cycles);
+  MaybePrintStats(print_stats);
+  if (trace_path) {
+    nsasm::StopTracing();
+    auto written = nsasm::WriteTraceFile(*trace_path);
+    if (!written.ok()) {
+      absl::FPrintF(stderr, "%s\n", written.error().ToString());
+      return 1;
     }
   }
+  return status;
 }